@@ -30,6 +30,7 @@
 #include "framework/ips_action.h"
 #include "framework/module.h"
 #include "protocols/packet.h"
+#include "protocols/packet_manager.h"
 #include "packet_io/active.h"
 
 #define s_name "rewrite"
@@ -83,7 +84,7 @@ static inline void Replace_ApplyChange(Packet* p, Replacement* r)
     else
         len = r->data.size();
 
-    memcpy(start, r->data.c_str(), len);
+    PacketManager::rewrite(p, start, r->data.c_str(), len);
 }
 
 static void Replace_ModifyPacket(Packet* p)
@@ -95,7 +96,6 @@ static void Replace_ModifyPacket(Packet* p)
     {
         Replace_ApplyChange(p, rpl+n);
     }
-    p->packet_flags |= PKT_MODIFIED;
     num_rpl = 0;
 }
 
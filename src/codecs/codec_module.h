@@ -232,5 +232,9 @@ public:
     const RuleMap* get_rules() const override;
 };
 
+// time spent verifying and updating checksums
+struct ProfileStats;
+SO_PUBLIC extern THREAD_LOCAL ProfileStats checksumPerfStats;
+
 #endif
 
@@ -26,6 +26,7 @@
 #include "main/snort_config.h"
 #include "protocols/icmp4.h"
 #include "codecs/ip/checksum.h"
+#include "profiler/profiler.h"
 #include "codecs/codec_module.h"
 #include "protocols/protocol_ids.h"
 #include "protocols/packet.h"
@@ -182,6 +183,7 @@ bool Icmp4Codec::decode(const RawData& raw, CodecData& codec,DecodeData& snort)
 
     if (SnortConfig::icmp_checksums())
     {
+        Profile profile(checksumPerfStats);
         uint16_t csum = checksum::cksum_add((uint16_t*)icmph, raw.len);
 
         if (csum && !codec.is_cooked())
@@ -567,6 +569,7 @@ void Icmp4Codec::update(const ip::IpApi&, const EncodeFlags flags,
 
     if ( !(flags & UPD_COOKED) || (flags & UPD_REBUILT_FRAG) )
     {
+        Profile profile(checksumPerfStats);
         h->cksum = 0;
         h->cksum = checksum::icmp_cksum((uint16_t*)h, updated_len);
     }
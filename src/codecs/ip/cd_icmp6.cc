@@ -29,6 +29,7 @@
 #include "codecs/codec_module.h"
 #include "codecs/codec_module.h"
 #include "codecs/ip/checksum.h"
+#include "profiler/profiler.h"
 #include "packet_io/active.h"
 #include "log/text_log.h"
 #include "main/snort_debug.h"
@@ -123,6 +124,7 @@ bool Icmp6Codec::decode(const RawData& raw, CodecData& codec, DecodeData& snort)
     /* Do checksums */
     if (SnortConfig::icmp_checksums())
     {
+        Profile profile(checksumPerfStats);
         uint16_t csum;
         PegCount* bad_cksum_cnt;
 
@@ -346,6 +348,7 @@ void Icmp6Codec::update(const ip::IpApi& api, const EncodeFlags flags,
 
     if ( !(flags & UPD_COOKED) || (flags & UPD_REBUILT_FRAG) )
     {
+        Profile profile(checksumPerfStats);
         checksum::Pseudoheader6 ps6;
         h->cksum = 0;
 
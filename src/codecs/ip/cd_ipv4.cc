@@ -35,6 +35,7 @@
 #include "utils/stats.h"
 #include "packet_io/active.h"
 #include "codecs/ip/checksum.h"
+#include "profiler/profiler.h"
 #include "main/thread.h"
 #include "codecs/codec_module.h"
 #include "protocols/ip.h"
@@ -237,6 +238,7 @@ bool Ipv4Codec::decode(const RawData& raw, CodecData& codec, DecodeData& snort)
          * need to check them (should make this a command line/config
          * option
          */
+        Profile profile(checksumPerfStats);
         int16_t csum = checksum::ip_cksum((uint16_t*)iph, hlen);
 
         if (csum && !codec.is_cooked())
@@ -682,6 +684,7 @@ void Ipv4Codec::update(const ip::IpApi&, const EncodeFlags flags,
 
     if ( !(flags & UPD_COOKED) || (flags & UPD_REBUILT_FRAG) )
     {
+        Profile profile(checksumPerfStats);
         h->ip_csum = 0;
         h->ip_csum = checksum::ip_cksum((uint16_t*)h, hlen);
     }
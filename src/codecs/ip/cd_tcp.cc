@@ -25,6 +25,7 @@
 #include "framework/codec.h"
 #include "codecs/codec_module.h"
 #include "codecs/ip/checksum.h"
+#include "profiler/profiler.h"
 #include "protocols/tcp.h"
 #include "protocols/tcp_options.h"
 #include "protocols/ipv6.h"
@@ -166,8 +167,10 @@ bool TcpCodec::decode(const RawData& raw, CodecData& codec, DecodeData& snort)
     /* Checksum code moved in front of the other decoder alerts.
        If it's a bad checksum (maybe due to encrypted ESP traffic), the other
        alerts could be false positives. */
-    if ( SnortConfig::tcp_checksums() )
+    if ( SnortConfig::tcp_checksums() and
+        !(codec.ip_layer_cnt == 1 and SnortConfig::tcp_checksum_offloaded(raw.pkth)) )
     {
+        Profile profile(checksumPerfStats);
         uint16_t csum;
         PegCount* bad_cksum_cnt;
 
@@ -684,6 +687,7 @@ void TcpCodec::update(const ip::IpApi& api, const EncodeFlags flags, uint8_t* ra
 
     if ( !(flags & UPD_COOKED) || (flags & UPD_REBUILT_FRAG) )
     {
+        Profile profile(checksumPerfStats);
         h->th_sum = 0;
 
         if ( api.is_ip4() )
@@ -786,3 +790,103 @@ static const CodecApi tcp_api =
 
 const BaseApi* cd_tcp = &tcp_api.base;
 
+
+//-------------------------------------------------------------------------
+// checksum tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+#include <chrono>
+#include "catch/catch.hpp"
+#include "time/stopwatch.h"
+
+static void fill_random(uint8_t* buf, unsigned len, unsigned seed)
+{
+    srand(seed);
+
+    for ( unsigned i = 0; i < len; ++i )
+        buf[i] = rand();
+}
+
+TEST_CASE("checksum kernels match scalar", "[checksum]")
+{
+    const unsigned max = 3000;
+    uint8_t buf[max + 1];
+    fill_random(buf, sizeof(buf), 1);
+
+    // odd lengths and a misaligned start exercise the tails
+    for ( unsigned len = 0; len <= max; len += 7 )
+    {
+        for ( unsigned off = 0; off < 2; ++off )
+        {
+            uint16_t exp = checksum::detail::fold(
+                checksum::detail::sum_scalar(buf + off, len, 0));
+            uint16_t got = checksum::detail::fold(
+                checksum::detail::sum_words(buf + off, len, 0));
+            CHECK(exp == got);
+        }
+    }
+}
+
+TEST_CASE("checksum update matches recompute", "[checksum]")
+{
+    const unsigned len = 60;
+    uint8_t buf[len];
+    uint8_t data[8];
+
+    for ( unsigned seed = 0; seed < 200; ++seed )
+    {
+        fill_random(buf, len, seed);
+        fill_random(data, sizeof(data), seed + 1000);
+
+        // checksum at the front; edits go anywhere after it
+        uint16_t sum = 0;
+        memcpy(buf, &sum, 2);
+        sum = checksum::cksum_add((uint16_t*)buf, len);
+        memcpy(buf, &sum, 2);
+
+        unsigned off = 2 + seed % (len - 2 - sizeof(data));
+        unsigned n = 1 + seed % sizeof(data);
+
+        sum = checksum::cksum_update(sum, buf + off, data, n, off & 1);
+        memcpy(buf + off, data, n);
+
+        // a valid checksum sums to zero, either +0 or -0
+        memcpy(buf, &sum, 2);
+        uint16_t check = checksum::cksum_add((uint16_t*)buf, len);
+        CHECK((check == 0 or check == 0xffff));
+    }
+}
+
+// run with: snort --catch-test '[.perf]'
+TEST_CASE("checksum throughput", "[.perf][checksum]")
+{
+    const unsigned len = 1500;
+    const unsigned num = 200000;
+    uint8_t buf[len];
+    fill_random(buf, len, 2);
+
+    Stopwatch<std::chrono::steady_clock> scalar, simd;
+    uint64_t a = 0, b = 0;
+
+    scalar.start();
+    for ( unsigned i = 0; i < num; ++i )
+        a += checksum::detail::fold(checksum::detail::sum_scalar(buf, len, i));
+    scalar.stop();
+
+    simd.start();
+    for ( unsigned i = 0; i < num; ++i )
+        b += checksum::detail::fold(checksum::detail::sum_words(buf, len, i));
+    simd.stop();
+
+    CHECK(a == b);
+
+    auto s = std::chrono::duration_cast<std::chrono::microseconds>(scalar.get()).count();
+    auto v = std::chrono::duration_cast<std::chrono::microseconds>(simd.get()).count();
+
+    WARN("1500 byte checksums MB/s scalar = " << (s ? (double)len * num / s : 0.0) <<
+        ", simd = " << (v ? (double)len * num / v : 0.0));
+}
+
+#endif
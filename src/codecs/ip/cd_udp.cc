@@ -32,6 +32,7 @@
 #include "protocols/ipv4.h"
 #include "protocols/protocol_ids.h"
 #include "codecs/ip/checksum.h"
+#include "profiler/profiler.h"
 #include "log/text_log.h"
 #include "framework/codec.h"
 #include "packet_io/active.h"
@@ -223,6 +224,8 @@ bool UdpCodec::decode(const RawData& raw, CodecData& codec, DecodeData& snort)
         uint16_t csum;
         PegCount* bad_cksum_cnt;
 
+        Profile profile(checksumPerfStats);
+
         if (snort.ip_api.is_ip4())
         {
             bad_cksum_cnt = &(stats.bad_ip4_cksum);
@@ -410,6 +413,7 @@ void UdpCodec::update(const ip::IpApi& ip_api, const EncodeFlags flags,
 
     if ( !(flags & UPD_COOKED) || (flags & UPD_REBUILT_FRAG) )
     {
+        Profile profile(checksumPerfStats);
         h->uh_chk = 0;
 
         if (ip_api.is_ip4())
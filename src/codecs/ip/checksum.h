@@ -22,8 +22,14 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cstddef>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CKSUM_SIMD_X86
+#include <immintrin.h>
+#endif
+
 #include <protocols/protocol_ids.h>
 
 namespace checksum
@@ -56,6 +62,12 @@ inline uint16_t icmp_cksum(const uint16_t* buf, std::size_t len, const Pseudohea
 inline uint16_t icmp_cksum(const uint16_t* buf, std::size_t len);
 inline uint16_t ip_cksum(const uint16_t* buf, std::size_t len);
 
+//  incrementally update a checksum after len bytes of the data it covers
+//  change from old_data to new_data (RFC 1624).  odd is set if the bytes
+//  start at an odd offset from the start of the checksummed data.
+inline uint16_t cksum_update(
+    uint16_t cksum, const void* old_data, const void* new_data, std::size_t len, bool odd = false);
+
 /*
  *  NOTE: Since multiple dynamic libraries use checksums, the choice
  *          is to either include all of the checksum details in a header,
@@ -89,84 +101,136 @@ struct Psuedoheader6Union
     };
 };
 
-inline uint16_t cksum_add(const uint16_t* buf, std::size_t len, uint32_t cksum)
+// partial sums are kept in 64 bits and folded at the end.  summing 32 bit
+// words (or 16 bit words in 32 bit lanes) gives the same ones complement
+// sum as summing 16 bit words since 2^16 == 1 mod 2^16 - 1 (RFC 1071).
+
+inline uint16_t fold(uint64_t sum)
+{
+    sum = (sum >> 32) + (sum & 0xffffffff);
+    sum = (sum >> 32) + (sum & 0xffffffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    return (uint16_t)sum;
+}
+
+inline uint64_t sum_scalar(const uint8_t* p, std::size_t len, uint64_t sum)
+{
+    uint32_t w[2];
+
+    while ( len >= 8 )
+    {
+        memcpy(w, p, 8);
+        sum += w[0];
+        sum += w[1];
+        p += 8;
+        len -= 8;
+    }
+    if ( len >= 4 )
+    {
+        memcpy(w, p, 4);
+        sum += w[0];
+        p += 4;
+        len -= 4;
+    }
+    if ( len >= 2 )
+    {
+        uint16_t h;
+        memcpy(&h, p, 2);
+        sum += h;
+        p += 2;
+        len -= 2;
+    }
+    if ( len )
+        sum += *p;
+
+    return sum;
+}
+
+#ifdef CKSUM_SIMD_X86
+
+// each 32 bit lane of a and b takes one 16 bit word per vector so blocks
+// of at most 64K can't overflow them.
+#define CKSUM_SIMD_BLOCK 65536
+
+__attribute__((target("sse2")))
+inline uint64_t sum_sse2(const uint8_t* p, std::size_t len, uint64_t sum)
 {
-    const uint16_t* sp = buf;
-    std::size_t n, sn;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_set1_epi32(0xffff);
 
-    if (len > 1 )
+    while ( len >= 16 )
     {
-        sn = ((len / 2) & 0xF);  // == len/2 % 16
-        n = (((len / 2) + 15) / 16);   // ceiling of (len / 2) / 16
+        std::size_t n = (len < CKSUM_SIMD_BLOCK ? len : CKSUM_SIMD_BLOCK) & ~(std::size_t)15;
+        __m128i a = zero, b = zero;
 
-        switch (sn)
+        for ( std::size_t i = 0; i < n; i += 16 )
         {
-        case 0:
-            sn = 16;
-            cksum += sp[15];
-        case 15:
-            cksum += sp[14];
-        case 14:
-            cksum += sp[13];
-        case 13:
-            cksum += sp[12];
-        case 12:
-            cksum += sp[11];
-        case 11:
-            cksum += sp[10];
-        case 10:
-            cksum += sp[9];
-        case 9:
-            cksum += sp[8];
-        case 8:
-            cksum  += sp[7];
-        case 7:
-            cksum += sp[6];
-        case 6:
-            cksum += sp[5];
-        case 5:
-            cksum += sp[4];
-        case 4:
-            cksum += sp[3];
-        case 3:
-            cksum += sp[2];
-        case 2:
-            cksum += sp[1];
-        case 1:
-            cksum += sp[0];
+            __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+            a = _mm_add_epi32(a, _mm_and_si128(v, lo));
+            b = _mm_add_epi32(b, _mm_srli_epi32(v, 16));
         }
-        sp += sn;
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, _mm_add_epi32(a, b));
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+        p += n;
+        len -= n;
+    }
+    return sum_scalar(p, len, sum);
+}
+
+__attribute__((target("avx2")))
+inline uint64_t sum_avx2(const uint8_t* p, std::size_t len, uint64_t sum)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lo = _mm256_set1_epi32(0xffff);
 
-        /* XXX - unroll loop using Duff's device. */
-        while (--n > 0)
+    while ( len >= 32 )
+    {
+        std::size_t n = (len < CKSUM_SIMD_BLOCK ? len : CKSUM_SIMD_BLOCK) & ~(std::size_t)31;
+        __m256i a = zero, b = zero;
+
+        for ( std::size_t i = 0; i < n; i += 32 )
         {
-            cksum += sp[0];
-            cksum += sp[1];
-            cksum += sp[2];
-            cksum += sp[3];
-            cksum += sp[4];
-            cksum += sp[5];
-            cksum += sp[6];
-            cksum += sp[7];
-            cksum += sp[8];
-            cksum += sp[9];
-            cksum += sp[10];
-            cksum += sp[11];
-            cksum += sp[12];
-            cksum += sp[13];
-            cksum += sp[14];
-            cksum += sp[15];
-            sp += 16;
+            __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+            a = _mm256_add_epi32(a, _mm256_and_si256(v, lo));
+            b = _mm256_add_epi32(b, _mm256_srli_epi32(v, 16));
         }
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi32(a, b));
+
+        for ( auto l : lanes )
+            sum += l;
+
+        p += n;
+        len -= n;
     }
+    return sum_scalar(p, len, sum);
+}
+
+#endif
 
-    if (len & 1)
-        cksum += (*(unsigned char*)sp);
+// short buffers such as headers aren't worth the vector setup
+inline uint64_t sum_words(const uint8_t* p, std::size_t len, uint64_t sum)
+{
+#ifdef CKSUM_SIMD_X86
+    if ( len >= 64 )
+    {
+        if ( __builtin_cpu_supports("avx2") )
+            return sum_avx2(p, len, sum);
 
-    cksum  = (cksum >> 16) + (cksum & 0x0000ffff);
-    cksum += (cksum >> 16);
+        if ( __builtin_cpu_supports("sse2") )
+            return sum_sse2(p, len, sum);
+    }
+#endif
+    return sum_scalar(p, len, sum);
+}
 
-    return (uint16_t)(~cksum);
+inline uint16_t cksum_add(const uint16_t* buf, std::size_t len, uint32_t cksum)
+{
+    uint64_t sum = sum_words(reinterpret_cast<const uint8_t*>(buf), len, cksum);
+    return (uint16_t)(~fold(sum));
 }
 
 inline void add_ipv4_pseudoheader(const Pseudoheader* const ph4,
@@ -342,6 +406,26 @@ inline uint16_t ip_cksum(const uint16_t* buf, std::size_t len)
 
 inline uint16_t cksum_add(const uint16_t* buf, std::size_t len)
 { return detail::cksum_add(buf, len, 0); }
+
+// HC' = ~(~HC + ~m + m') (eqn 3) avoids the -0 problem of eqn 2
+inline uint16_t cksum_update(
+    uint16_t cksum, const void* old_data, const void* new_data, std::size_t len, bool odd)
+{
+    uint16_t m = detail::fold(detail::sum_words((const uint8_t*)old_data, len, 0));
+    uint16_t n = detail::fold(detail::sum_words((const uint8_t*)new_data, len, 0));
+
+    // the sum of data shifted by one byte is the byte swapped sum
+    if ( odd )
+    {
+        m = (uint16_t)((m << 8) | (m >> 8));
+        n = (uint16_t)((n << 8) | (n >> 8));
+    }
+    uint64_t sum = (uint16_t)~cksum;
+    sum += (uint16_t)~m;
+    sum += n;
+
+    return (uint16_t)~detail::fold(sum);
+}
 } // namespace checksum
 
 #endif  /* CODECS_CHECKSUM_H */
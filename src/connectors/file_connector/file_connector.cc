@@ -21,15 +21,22 @@
 #include "file_connector.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <glob.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <fstream>
 #include <string>
 #include <vector>
 
 #include "file_connector_module.h"
+#include "log/messages.h"
 #include "main/snort_types.h"
 #include "main/snort_debug.h"
 #include "main/thread.h"
@@ -49,11 +56,20 @@ FileConnectorMsgHandle::FileConnectorMsgHandle(const uint32_t length)
 
     connector_msg.length = length;
     connector_msg.data = new uint8_t[length];
+    mapped = false;
+}
+
+FileConnectorMsgHandle::FileConnectorMsgHandle(uint8_t* data, const uint32_t length)
+{
+    connector_msg.length = length;
+    connector_msg.data = data;
+    mapped = true;
 }
 
 FileConnectorMsgHandle::~FileConnectorMsgHandle()
 {
-    delete[] connector_msg.data;
+    if ( !mapped )
+        delete[] connector_msg.data;
 }
 
 FileConnectorCommon::FileConnectorCommon(FileConnectorConfig::FileConnectorConfigSet* conf)
@@ -77,11 +93,107 @@ FileConnector::FileConnector(FileConnectorConfig* file_connector_config)
 {
     DebugMessage(DEBUG_CONNECTORS,"FileConnector::FileConnector()\n");
     config = file_connector_config;
+    map_fd = -1;
+    map_base = nullptr;
+    map_size = map_offset = synced = 0;
+    unsynced = 0;
+    map_full = false;
 }
 
 FileConnector::~FileConnector()
 {
     DebugMessage(DEBUG_CONNECTORS,"FileConnector::~FileConnector()\n");
+    unmap_file();
+}
+
+// The transmit file is preallocated to mmap_size and shared so records are
+// written straight into the page cache.  The receive file is mapped
+// private so a consumer that writes to a message can't change the file.
+bool FileConnector::map_file(const std::string& pathname)
+{
+    FileConnectorConfig* cfg = (FileConnectorConfig*)config;
+    bool transmit = ( cfg->direction == Connector::CONN_TRANSMIT );
+
+    if ( transmit )
+        map_fd = open(pathname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    else
+        map_fd = open(pathname.c_str(), O_RDONLY);
+
+    if ( map_fd < 0 )
+    {
+        ErrorMessage("file_connector: can't open %s: %s\n", pathname.c_str(), strerror(errno));
+        return false;
+    }
+
+    if ( transmit )
+    {
+        if ( ftruncate(map_fd, cfg->mmap_size) )
+        {
+            ErrorMessage("file_connector: can't size %s: %s\n", pathname.c_str(), strerror(errno));
+            unmap_file();
+            return false;
+        }
+        map_size = cfg->mmap_size;
+    }
+    else
+    {
+        struct stat st;
+
+        if ( fstat(map_fd, &st) )
+        {
+            unmap_file();
+            return false;
+        }
+        map_size = st.st_size;
+    }
+
+    // an empty receive file just has no messages
+    if ( !map_size )
+        return true;
+
+    void* p = transmit ?
+        mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, map_fd, 0) :
+        mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, map_fd, 0);
+
+    if ( p == MAP_FAILED )
+    {
+        ErrorMessage("file_connector: can't map %s: %s\n", pathname.c_str(), strerror(errno));
+        map_size = 0;
+        unmap_file();
+        return false;
+    }
+
+    map_base = (uint8_t*)p;
+
+    if ( !transmit )
+        madvise(map_base, map_size, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+// A transmit file is cut back to the records written so it can also be
+// read with the binary format.
+void FileConnector::unmap_file()
+{
+    if ( map_base )
+    {
+        if ( ((FileConnectorConfig*)config)->direction == Connector::CONN_TRANSMIT )
+            msync(map_base, map_offset, MS_SYNC);
+
+        munmap(map_base, map_size);
+        map_base = nullptr;
+    }
+
+    if ( map_fd >= 0 )
+    {
+        if ( ((FileConnectorConfig*)config)->direction == Connector::CONN_TRANSMIT )
+            (void)ftruncate(map_fd, map_offset);
+
+        close(map_fd);
+        map_fd = -1;
+    }
+    map_size = map_offset = synced = 0;
+    unsynced = 0;
 }
 
 ConnectorMsgHandle* FileConnector::alloc_message(const uint32_t length, const uint8_t** data)
@@ -101,12 +213,53 @@ void FileConnector::discard_message(ConnectorMsgHandle* msg)
     delete fmsg;
 }
 
+// Records have the binary format layout.  Pages are handed to msync()
+// asynchronously every sync_count messages instead of per message.
+bool FileConnector::transmit_message_mapped(FileConnectorMsgHandle* fmsg)
+{
+    FileConnectorMsgHdr fc_hdr(fmsg->connector_msg.length);
+    size_t len = sizeof(fc_hdr) + fmsg->connector_msg.length;
+
+    if ( !map_base or map_size - map_offset < len )
+    {
+        if ( map_base and !map_full )
+            ErrorMessage("file_connector: mmap_size %zu is full\n", map_size);
+
+        map_full = true;
+        delete fmsg;
+        return false;
+    }
+
+    uint8_t* rec = map_base + map_offset;
+    memcpy(rec, &fc_hdr, sizeof(fc_hdr));
+    memcpy(rec + sizeof(fc_hdr), fmsg->connector_msg.data, fmsg->connector_msg.length);
+    map_offset += len;
+
+    unsigned sync_count = ((FileConnectorConfig*)config)->sync_count;
+
+    if ( sync_count and ++unsynced >= sync_count )
+    {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t start = synced & ~(page - 1);
+
+        msync(map_base + start, map_offset - start, MS_ASYNC);
+        synced = map_offset;
+        unsynced = 0;
+    }
+
+    delete fmsg;
+    return true;
+}
+
 bool FileConnector::transmit_message(ConnectorMsgHandle* msg)
 {
     DebugMessage(DEBUG_CONNECTORS,"FileConnector::transmit_message()\n");
     FileConnectorMsgHandle* fmsg = (FileConnectorMsgHandle*)msg;
     FileConnectorConfig* cfg = (FileConnectorConfig*)config;
 
+    if ( cfg->mmap_format )
+        return transmit_message_mapped(fmsg);
+
     if ( cfg->text_format )
     {
         unsigned char* message = (unsigned char*)(fmsg->connector_msg.data + sizeof(SCMsgHdr));
@@ -212,12 +365,40 @@ ConnectorMsgHandle* FileConnector::receive_message_text()
     return handle;
 }
 
+// The message is returned in place.  The rest of a preallocated file that
+// wasn't cut back (the writer didn't exit cleanly) is zeros so reading
+// stops at the first header without the current version.
+ConnectorMsgHandle* FileConnector::receive_message_mapped()
+{
+    FileConnectorMsgHdr fc_hdr(0);
+
+    if ( map_size - map_offset < sizeof(fc_hdr) )
+        return nullptr;
+
+    memcpy(&fc_hdr, map_base + map_offset, sizeof(fc_hdr));
+
+    if ( fc_hdr.version != FILE_FORMAT_VERSION or
+        map_size - map_offset - sizeof(fc_hdr) < fc_hdr.connector_msg_length )
+    {
+        map_offset = map_size;
+        return nullptr;
+    }
+
+    uint8_t* data = map_base + map_offset + sizeof(fc_hdr);
+    map_offset += sizeof(fc_hdr) + fc_hdr.connector_msg_length;
+
+    return new FileConnectorMsgHandle(data, fc_hdr.connector_msg_length);
+}
+
 // Reading messages from files can never block.  Either a message exists
 //  or it does not.
 ConnectorMsgHandle* FileConnector::receive_message(bool)
 {
     DebugMessage(DEBUG_CONNECTORS,"FileConnector::receive_message()\n");
 
+    if ( ((FileConnectorConfig*)config)->mmap_format )
+        return map_base ? receive_message_mapped() : nullptr;
+
     if ( !file.is_open() )
         return nullptr;
     else
@@ -258,6 +439,13 @@ static Connector* file_connector_tinit_transmit(std::string filename,
 
     filename += "_transmit";
     (void)get_instance_file(pathname, filename.c_str());
+
+    if ( cfg->mmap_format )
+    {
+        file_connector->map_file(pathname);
+        return file_connector;
+    }
+
     file_connector->file.open(pathname,
         (std::ios::out | (cfg->text_format ? (std::ios::openmode)0 : std::ios::binary)) );
 
@@ -275,6 +463,13 @@ static Connector* file_connector_tinit_receive(std::string filename,
 
     filename += "_receive";
     (void)get_instance_file(pathname, filename.c_str());
+
+    if ( cfg->mmap_format )
+    {
+        file_connector->map_file(pathname);
+        return file_connector;
+    }
+
     file_connector->file.open(pathname, (std::ios::in | std::ios::binary) );
 
     DebugFormat(DEBUG_CONNECTORS,"file_connector:file_connector_tinit_receive(): pathname: %s\n",
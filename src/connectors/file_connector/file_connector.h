@@ -22,6 +22,7 @@
 #define FILE_CONNECTOR_H
 
 #include <fstream>
+#include <string>
 
 #include "file_connector_config.h"
 #include "framework/connector.h"
@@ -48,8 +49,15 @@ class FileConnectorMsgHandle : public ConnectorMsgHandle
 {
 public:
     FileConnectorMsgHandle(const uint32_t length);
+
+    // view of a message in a receive mapping; the data isn't owned
+    FileConnectorMsgHandle(uint8_t* data, const uint32_t length);
+
     ~FileConnectorMsgHandle();
     ConnectorMsg connector_msg;
+
+private:
+    bool mapped;
 };
 
 class FileConnectorCommon : public ConnectorCommon
@@ -74,11 +82,27 @@ public:
     Direction get_connector_direction()
     { return( ((FileConnectorConfig*)config)->direction ); }
 
+    // mmap format; pathname is opened and mapped for the configured
+    // direction.  Received messages point into the mapping and must be
+    // discarded before the connector is deleted.
+    bool map_file(const std::string& pathname);
+    void unmap_file();
+
     std::fstream file;
 
 private:
     ConnectorMsgHandle* receive_message_binary();
     ConnectorMsgHandle* receive_message_text();
+    ConnectorMsgHandle* receive_message_mapped();
+    bool transmit_message_mapped(FileConnectorMsgHandle*);
+
+    int map_fd;
+    uint8_t* map_base;
+    size_t map_size;
+    size_t map_offset;      // next record to read or write
+    size_t synced;          // transmit bytes already passed to msync()
+    unsigned unsynced;      // transmitted messages since the last msync()
+    bool map_full;
 };
 
 #endif
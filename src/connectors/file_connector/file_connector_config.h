@@ -30,11 +30,22 @@ class FileConnectorConfig : public ConnectorConfig
 {
 public:
     FileConnectorConfig()
-    { direction = Connector::CONN_UNDEFINED; text_format = false; }
+    {
+        direction = Connector::CONN_UNDEFINED;
+        text_format = false;
+        mmap_format = false;
+        mmap_size = 64 * 1024 * 1024;
+        sync_count = 1000;
+    }
 
     bool text_format;
+    bool mmap_format;
     std::string name;
 
+    // mmap format only
+    size_t mmap_size;       // preallocated transmit file size
+    unsigned sync_count;    // transmitted messages per msync(), 0 for none
+
     typedef std::vector<FileConnectorConfig*> FileConnectorConfigSet;
 };
 
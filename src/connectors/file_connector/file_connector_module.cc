@@ -30,9 +30,15 @@ static const Parameter file_connector_params[] =
     { "name", Parameter::PT_STRING, nullptr, nullptr,
       "channel name" },
 
-    { "format", Parameter::PT_ENUM, "binary | text", nullptr,
+    { "format", Parameter::PT_ENUM, "binary | text | mmap", nullptr,
       "file format" },
 
+    { "mmap_size", Parameter::PT_INT, "4096:", "67108864",
+      "size in bytes of the preallocated transmit file for the mmap format" },
+
+    { "sync_count", Parameter::PT_INT, "0:", "1000",
+      "mmap format transmit messages per msync; 0 syncs only at exit" },
+
     { "direction", Parameter::PT_ENUM, "receive | transmit | duplex", nullptr,
       "usage" },
 
@@ -87,7 +93,16 @@ bool FileConnectorModule::set(const char* fqn, Value& v, SnortConfig*)
         config->name = v.get_string();
 
     else if ( v.is("format") )
+    {
         config->text_format = ( v.get_long() == 1 );
+        config->mmap_format = ( v.get_long() == 2 );
+    }
+
+    else if ( v.is("mmap_size") )
+        config->mmap_size = v.get_long();
+
+    else if ( v.is("sync_count") )
+        config->sync_count = v.get_long();
 
     else if ( v.is("direction") )
         switch ( v.get_long() )
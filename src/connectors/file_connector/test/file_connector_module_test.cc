@@ -104,6 +104,49 @@ TEST(file_connector_module, test)
     delete config_set;
 }
 
+TEST(file_connector_module, mmap)
+{
+    Value format_val("mmap");
+    Value size_val(8192.0);
+    Value sync_val(10.0);
+    Parameter format_param =
+        {"format", Parameter::PT_ENUM, "binary | text | mmap", nullptr, "format"};
+    Parameter size_param =
+        {"mmap_size", Parameter::PT_INT, "4096:", nullptr, "mmap_size"};
+    Parameter sync_param =
+        {"sync_count", Parameter::PT_INT, "0:", nullptr, "sync_count"};
+
+    FileConnectorModule module;
+
+    format_val.set(&format_param);
+    format_val.set_enum(2);
+    size_val.set(&size_param);
+    sync_val.set(&sync_param);
+
+    module.begin("file_connector", 0, nullptr);
+    module.begin("file_connector", 1, nullptr);
+    module.set("file_connector.format", format_val, nullptr);
+    module.set("file_connector.mmap_size", size_val, nullptr);
+    module.set("file_connector.sync_count", sync_val, nullptr);
+    module.end("file_connector", 1, nullptr);
+    module.end("file_connector", 0, nullptr);
+
+    FileConnectorConfig::FileConnectorConfigSet* config_set = module.get_and_clear_config();
+    CHECK(config_set->size() == 1);
+
+    FileConnectorConfig config = *(config_set->front());
+    CHECK(config.mmap_format == true);
+    CHECK(config.text_format == false);
+    CHECK(config.mmap_size == 8192);
+    CHECK(config.sync_count == 10);
+
+    for ( auto conf : *config_set )
+        delete conf;
+
+    config_set->clear();
+    delete config_set;
+}
+
 int main(int argc, char** argv)
 {
     return CommandLineTestRunner::RunAllTests(argc, argv);
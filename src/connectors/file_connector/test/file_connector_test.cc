@@ -55,6 +55,8 @@ const char* get_instance_file(std::string& file, const char* name)
 
 void Debug::print(const char*, int, uint64_t, const char*, ...) { }
 
+void ErrorMessage(const char*, ...) { }
+
 FileConnectorModule::FileConnectorModule() :
     Module("FC", "FC Help", nullptr)
 { }
@@ -330,6 +332,130 @@ TEST(file_connector_binary, alloc_transmit_rename_receive_discard)
     file_connector->mod_dtor(mod);
 }
 
+TEST_GROUP(file_connector_mmap)
+{
+    FileConnectorConfig tx_config;
+    FileConnectorConfig rx_config;
+
+    void setup()
+    {
+        // FIXIT-L workaround for CppUTest mem leak detector issue
+        MemoryLeakWarningPlugin::turnOffNewDeleteOverloads();
+        fc_api = (ConnectorApi*)file_connector;
+        tx_config.direction = Connector::CONN_TRANSMIT;
+        tx_config.connector_name = "tx_m";
+        tx_config.name = "tx_m";
+        tx_config.mmap_format = true;
+        tx_config.mmap_size = 4096;
+        tx_config.sync_count = 2;
+        rx_config.direction = Connector::CONN_RECEIVE;
+        rx_config.connector_name = "rx_m";
+        rx_config.name = "rx_m";
+        rx_config.mmap_format = true;
+        mod = file_connector->mod_ctor();
+        connector_common = fc_api->ctor(mod);
+    }
+
+    void teardown()
+    {
+        fc_api->dtor(connector_common);
+        file_connector->mod_dtor(mod);
+        std::remove("file_connector_tx_m_transmit");
+        std::remove("file_connector_rx_m_receive");
+        MemoryLeakWarningPlugin::turnOnNewDeleteOverloads();
+    }
+
+    unsigned transmit(unsigned num, unsigned len)
+    {
+        Connector* tx = fc_api->tinit(&tx_config);
+        unsigned sent = 0;
+
+        for ( unsigned i = 0; i < num; i++ )
+        {
+            const uint8_t* data = nullptr;
+            ConnectorMsgHandle* h = tx->alloc_message(len + i, &data);
+            memset((uint8_t*)data, i, len + i);
+
+            if ( tx->transmit_message(h) )
+                sent++;
+        }
+        fc_api->tterm(tx);
+        std::rename("file_connector_tx_m_transmit", "file_connector_rx_m_receive");
+        return sent;
+    }
+};
+
+TEST(file_connector_mmap, transmit_receive)
+{
+    CHECK(transmit(3, 40) == 3);
+
+    Connector* rx = fc_api->tinit(&rx_config);
+    ConnectorMsgHandle* handles[3];
+
+    for ( unsigned i = 0; i < 3; i++ )
+    {
+        handles[i] = rx->receive_message(false);
+        CHECK(handles[i] != nullptr);
+
+        ConnectorMsg* msg = rx->get_connector_msg(handles[i]);
+        CHECK(msg->length == 40 + i);
+        CHECK(msg->data[0] == i and msg->data[msg->length - 1] == i);
+    }
+
+    // views are back to back in the mapping
+    CHECK(rx->get_connector_msg(handles[1])->data ==
+        rx->get_connector_msg(handles[0])->data + 40 + sizeof(FileConnectorMsgHdr));
+
+    CHECK(rx->receive_message(false) == nullptr);
+
+    for ( auto h : handles )
+        rx->discard_message(h);
+
+    fc_api->tterm(rx);
+}
+
+TEST(file_connector_mmap, full)
+{
+    // 106 byte records in 4096 bytes
+    tx_config.mmap_size = 4096;
+    CHECK(transmit(50, 100) < 50);
+
+    Connector* rx = fc_api->tinit(&rx_config);
+    unsigned got = 0;
+    ConnectorMsgHandle* h;
+
+    while ( (h = rx->receive_message(false)) )
+    {
+        rx->discard_message(h);
+        got++;
+    }
+    fc_api->tterm(rx);
+
+    CHECK(got > 0 and got < 50);
+}
+
+// the transmit file is cut back so the binary format can read it too
+TEST(file_connector_mmap, binary_receive)
+{
+    CHECK(transmit(2, 40) == 2);
+
+    rx_config.mmap_format = false;
+    Connector* rx = fc_api->tinit(&rx_config);
+
+    ConnectorMsgHandle* h = rx->receive_message(false);
+    CHECK(h != nullptr);
+    CHECK(rx->get_connector_msg(h)->length == 40);
+    rx->discard_message(h);
+
+    h = rx->receive_message(false);
+    CHECK(h != nullptr);
+    CHECK(rx->get_connector_msg(h)->length == 41);
+    rx->discard_message(h);
+
+    CHECK(rx->receive_message(false) == nullptr);
+    fc_api->tterm(rx);
+}
+
 TEST_GROUP(file_connector_msg_handle)
 {
     void setup()
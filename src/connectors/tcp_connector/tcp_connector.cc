@@ -27,7 +27,9 @@
 #include <sys/socket.h>
 #include <netdb.h>
 #include <poll.h>
+#include <sys/uio.h>
 
+#include <chrono>
 #include <fstream>
 #include <string>
 #include <thread>
@@ -76,103 +78,99 @@ TcpConnectorCommon::~TcpConnectorCommon()
     delete config_set;
 }
 
-enum ReadDataOutcome { SUCCESS = 0, TRUNCATED, ERROR, CLOSED, PARTIAL, AGAIN };
-
-static ReadDataOutcome read_data(int sockfd, uint8_t *data, uint16_t length, ssize_t *read_offset)
+// Read as much as is available into the free end of the buffer, moving
+// any partial message to the front first.  One recv() usually brings in
+// many messages.
+bool TcpConnector::fill_receive_buffer()
 {
-    ssize_t bytes_read, offset;
+    if ( rx_head == rx_tail )
+        rx_head = rx_tail = 0;
 
-    offset = *read_offset;
-    bytes_read = recv(sockfd, data + offset, length - offset, 0);
-    if (bytes_read == 0)
-    {
-        if ( offset != 0 )
-            return TRUNCATED;
-        return CLOSED;
-    }
-    if ( bytes_read == -1 )
+    else if ( rx_head > 0 )
     {
-        if (errno == EAGAIN || errno == EINTR)
-        {
-            if (offset > 0)
-                return PARTIAL;
-            return AGAIN;
-        }
-        return ERROR;
+        memmove(rx_buf.data(), rx_buf.data() + rx_head, rx_tail - rx_head);
+        rx_tail -= rx_head;
+        rx_head = 0;
     }
-    *read_offset = offset + bytes_read;
-    if ((offset + bytes_read) < length)
-        return PARTIAL;
 
-    return SUCCESS;
-}
+    ssize_t bytes_read;
 
-static ReadDataOutcome read_message_data(int sockfd, uint16_t length, uint8_t *data)
-{
-    ssize_t offset;
-    ReadDataOutcome rval;
+    do
+    {
+        bytes_read = recv(sock_fd, rx_buf.data() + rx_tail, rx_buf.size() - rx_tail, 0);
+    } while ( bytes_read == -1 && (errno == EAGAIN || errno == EINTR) );
 
-    if ( length > 0 )
+    if ( bytes_read == 0 )
     {
-        offset = 0;
-        do
-        {
-            rval = read_data(sockfd, data, length, &offset);
-        } while (rval == PARTIAL || rval == AGAIN);
+        if ( rx_tail != rx_head )
+            LogMessage("TcpC Input Thread: Connection closed while reading message data\n");
+        else
+            LogMessage("TcpC Input Thread: Connection closed\n");
 
-        if (rval != SUCCESS)
-            return rval;
+        rx_head = rx_tail = 0;
+        return false;
     }
 
-    return SUCCESS;
-}
+    if ( bytes_read == -1 )
+    {
+        ErrorMessage("TcpC Input Thread: Unable to receive message data: %s (%d)\n",
+            strerror(errno), errno);
+        return false;
+    }
 
+    rx_tail += bytes_read;
+    return true;
+}
 
-static TcpConnectorMsgHandle* read_message(int sock_fd)
+// Queue each whole message in the buffer; a partial message stays for
+// the next fill.  When the queue is full the rest waits in the buffer and
+// ultimately in the socket so the sender is slowed instead of messages
+// being dropped.
+void TcpConnector::parse_receive_buffer()
 {
     TcpConnectorMsgHdr hdr;
-    ReadDataOutcome outcome;
 
-    outcome = read_message_data(sock_fd, sizeof(hdr), (uint8_t*)&hdr);
-    if (outcome != SUCCESS)
+    while ( rx_tail - rx_head >= sizeof(hdr) and !receive_ring->full() )
     {
-        if (outcome == CLOSED)
-            LogMessage("TcpC Input Thread: Connection closed\n");
-        else
-            ErrorMessage("TcpC Input Thread: Unable to receive message header: %d\n", (int)outcome);
-        return nullptr;
-    }
+        memcpy(&hdr, rx_buf.data() + rx_head, sizeof(hdr));
 
-    if (hdr.version != TCP_FORMAT_VERSION)
-    {
-        ErrorMessage("TcpC Input Thread: Received header with invalid version 0x%d\n", (int)hdr.version);
-        return nullptr;
-    }
+        if (hdr.version != TCP_FORMAT_VERSION)
+        {
+            ErrorMessage("TcpC Input Thread: Received header with invalid version 0x%d\n",
+                (int)hdr.version);
 
-    TcpConnectorMsgHandle* handle = new TcpConnectorMsgHandle(hdr.connector_msg_length);
+            // the stream can't be resynchronized
+            rx_head = rx_tail = 0;
+            return;
+        }
 
-    if ((outcome = read_message_data(sock_fd, hdr.connector_msg_length, handle->connector_msg.data)) != SUCCESS)
-    {
-        if (outcome == CLOSED)
-            LogMessage("TcpC Input Thread: Connection closed while reading message data");
-        else
-            ErrorMessage("TcpC Input Thread: Unable to receive local message data: %d\n", (int)outcome);
-        delete handle;
-        return nullptr;
-    }
+        if ( rx_tail - rx_head < sizeof(hdr) + hdr.connector_msg_length )
+            return;
 
-    return handle;
+        TcpConnectorMsgHandle* handle = new TcpConnectorMsgHandle(hdr.connector_msg_length);
+        memcpy(handle->connector_msg.data, rx_buf.data() + rx_head + sizeof(hdr),
+            hdr.connector_msg_length);
+
+        rx_head += sizeof(hdr) + hdr.connector_msg_length;
+        receive_ring->put(handle);
+    }
 }
- 
+
 void TcpConnector::process_receive()
 {
-    TcpConnectorMsgHdr hdr;
     struct pollfd pfds[1];
     int rval;
 
+    // queue what is already here before reading more
+    parse_receive_buffer();
+
+    if ( receive_ring->full() )
+        return;
+
+    // don't wait for more if there is something to return now
     pfds[0].events = POLLIN;
     pfds[0].fd = sock_fd;
-    rval = poll(pfds, 1, 1000);
+    rval = poll(pfds, 1, receive_ring->empty() ? 1000 : 0);
     if (rval == -1)
     {
         if (errno != EINTR)
@@ -187,10 +185,8 @@ void TcpConnector::process_receive()
     }
     else if (rval > 0 && pfds[0].revents & POLLIN)
     {
-        TcpConnectorMsgHandle* handle;
-        if ( (handle = read_message(sock_fd)) != nullptr )
-            if ( !receive_ring->put(handle) )
-                ErrorMessage("TcpC Input Thread: overrun\n");
+        if ( fill_receive_buffer() )
+            parse_receive_buffer();
     }
 }
 
@@ -199,6 +195,10 @@ void TcpConnector::receive_processing_thread()
     while (run_thread)
     {
         process_receive();
+
+        // wait for the packet thread to make room
+        if ( receive_ring->full() )
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
 }
 
@@ -223,7 +223,9 @@ TcpConnector::TcpConnector(TcpConnectorConfig* tcp_connector_config, int sfd)
     DebugMessage(DEBUG_CONNECTORS,"TcpConnector::TcpConnector()\n");
     receive_thread = nullptr;
     config = tcp_connector_config;
-    receive_ring = new ReceiveRing(50);
+    receive_ring = new ReceiveRing(1024);
+    rx_buf.resize(TCP_RECEIVE_BUFFER_SIZE);
+    rx_head = rx_tail = 0;
     sock_fd = sfd;
     if ( tcp_connector_config->async_receive )
         start_receive_thread();
@@ -268,16 +270,18 @@ bool TcpConnector::transmit_message(ConnectorMsgHandle* msg)
 
     TcpConnectorMsgHdr tcpc_hdr(tmsg->connector_msg.length);
 
-    if ( send( sock_fd, (const char*)&tcpc_hdr, sizeof(tcpc_hdr), 0 ) != sizeof(tcpc_hdr) )
-    {
-        ErrorMessage("TcpConnector: failed to transmit header\n");
-        delete tmsg;
-        return false;
-    }
+    // header and body go in one system call
+    struct iovec iov[2];
+    iov[0].iov_base = &tcpc_hdr;
+    iov[0].iov_len = sizeof(tcpc_hdr);
+    iov[1].iov_base = tmsg->connector_msg.data;
+    iov[1].iov_len = tmsg->connector_msg.length;
+
+    ssize_t total = sizeof(tcpc_hdr) + tmsg->connector_msg.length;
 
-    if ( send( sock_fd, (const char*)tmsg->connector_msg.data, tmsg->connector_msg.length, 0 ) !=
-        tmsg->connector_msg.length )
+    if ( writev(sock_fd, iov, 2) != total )
     {
+        ErrorMessage("TcpConnector: failed to transmit message\n");
         delete tmsg;
         return false;
     }
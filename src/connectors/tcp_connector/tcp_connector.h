@@ -23,6 +23,7 @@
 
 #include <fstream>
 #include <thread>
+#include <vector>
 
 #include "tcp_connector_config.h"
 #include "framework/connector.h"
@@ -32,6 +33,9 @@
 
 #define TCP_FORMAT_VERSION (1)
 
+// holds at least one maximum size message and its header
+#define TCP_RECEIVE_BUFFER_SIZE (128 * 1024)
+
 //-------------------------------------------------------------------------
 // class stuff
 //-------------------------------------------------------------------------
@@ -88,7 +92,14 @@ private:
     void start_receive_thread();
     void stop_receive_thread();
     void receive_processing_thread();
+    bool fill_receive_buffer();
+    void parse_receive_buffer();
     ReceiveRing* receive_ring;
+
+    // bytes received but not yet parsed are in [rx_head, rx_tail)
+    std::vector<uint8_t> rx_buf;
+    size_t rx_head;
+    size_t rx_tail;
 };
 
 #endif
@@ -0,0 +1,343 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// tcp_connector_loopback_test.cc
+// TcpConnector over a real loopback connection and a throughput benchmark
+
+#include "connectors/tcp_connector/tcp_connector.h"
+#include "connectors/tcp_connector/tcp_connector_module.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+#include "main/snort_debug.h"
+#include "time/stopwatch.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+//-------------------------------------------------------------------------
+// stubs
+//-------------------------------------------------------------------------
+
+void show_stats(PegCount*, const PegInfo*, unsigned, const char*) { }
+void show_stats(PegCount*, const PegInfo*, IndexVec&, const char*) { }
+void show_stats(PegCount*, const PegInfo*, IndexVec&, const char*, FILE*) { }
+
+unsigned get_instance_id()
+{ return 0; }
+
+void Debug::print(const char*, int, uint64_t, const char*, ...) { }
+void ErrorMessage(const char*, ...) { }
+void LogMessage(const char*, ...) { }
+
+TcpConnectorModule::TcpConnectorModule() :
+    Module("TCPC", "TCPC Help", nullptr)
+{ }
+
+TcpConnectorConfig::TcpConnectorConfigSet* TcpConnectorModule::get_and_clear_config()
+{ return new TcpConnectorConfig::TcpConnectorConfigSet; }
+
+TcpConnectorModule::~TcpConnectorModule() { }
+ProfileStats* TcpConnectorModule::get_profile() const { return nullptr; }
+bool TcpConnectorModule::set(const char*, Value&, SnortConfig*) { return true; }
+bool TcpConnectorModule::begin(const char*, int, SnortConfig*) { return true; }
+bool TcpConnectorModule::end(const char*, int, SnortConfig*) { return true; }
+const PegInfo* TcpConnectorModule::get_pegs() const { return nullptr; }
+PegCount* TcpConnectorModule::get_counts() const { return nullptr; }
+
+//-------------------------------------------------------------------------
+// helpers
+//-------------------------------------------------------------------------
+
+// connect two sockets over 127.0.0.1; Nagle is off so the legacy framing
+// isn't stalled by delayed acks
+static bool make_pair(int& tx, int& rx)
+{
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sin);
+
+    if ( lfd < 0 or bind(lfd, (struct sockaddr*)&sin, sizeof(sin)) or listen(lfd, 1) or
+        getsockname(lfd, (struct sockaddr*)&sin, &len) )
+        return false;
+
+    tx = socket(AF_INET, SOCK_STREAM, 0);
+
+    if ( tx < 0 or connect(tx, (struct sockaddr*)&sin, sizeof(sin)) )
+        return false;
+
+    rx = accept(lfd, nullptr, nullptr);
+    close(lfd);
+
+    int on = 1;
+    setsockopt(tx, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    return rx >= 0;
+}
+
+static void fill(uint8_t* data, unsigned len, unsigned seq)
+{
+    for ( unsigned i = 0; i < len; i++ )
+        data[i] = (uint8_t)(seq + i);
+}
+
+static bool transmit(TcpConnector& tc, unsigned len, unsigned seq)
+{
+    const uint8_t* data;
+    ConnectorMsgHandle* h = tc.alloc_message(len, &data);
+    fill((uint8_t*)data, len, seq);
+    return tc.transmit_message(h);
+}
+
+//-------------------------------------------------------------------------
+// tests
+//-------------------------------------------------------------------------
+
+TEST_GROUP(tcp_connector_loopback)
+{
+    TcpConnectorConfig config;
+    TcpConnector* tx = nullptr;
+    TcpConnector* rx = nullptr;
+
+    void setup()
+    {
+        MemoryLeakWarningPlugin::turnOffNewDeleteOverloads();
+        config.async_receive = false;
+
+        int tfd, rfd;
+        CHECK(make_pair(tfd, rfd));
+
+        tx = new TcpConnector(&config, tfd);
+        rx = new TcpConnector(&config, rfd);
+    }
+
+    void teardown()
+    {
+        delete tx;
+        delete rx;
+        MemoryLeakWarningPlugin::turnOnNewDeleteOverloads();
+    }
+};
+
+// many messages arrive with one read and are returned in bulk
+TEST(tcp_connector_loopback, receive_many)
+{
+    const unsigned num = 100;
+    unsigned lens[num];
+
+    for ( unsigned i = 0; i < num; i++ )
+    {
+        lens[i] = 1 + (i * 37) % 500;
+        CHECK(transmit(*tx, lens[i], i));
+    }
+
+    ConnectorMsgHandle* handles[16];
+    unsigned got = 0;
+
+    for ( int tries = 0; got < num and tries < 1000; tries++ )
+    {
+        rx->process_receive();
+        unsigned n;
+
+        while ( (n = rx->receive_messages(handles, 16)) > 0 )
+        {
+            for ( unsigned i = 0; i < n; i++ )
+            {
+                ConnectorMsg* msg = rx->get_connector_msg(handles[i]);
+                uint8_t expect[512];
+                fill(expect, lens[got], got);
+
+                CHECK(msg->length == lens[got]);
+                CHECK(!memcmp(msg->data, expect, msg->length));
+
+                rx->discard_message(handles[i]);
+                got++;
+            }
+        }
+    }
+    CHECK(got == num);
+    CHECK(rx->receive_messages(handles, 16) == 0);
+}
+
+// a message split across reads is held until complete
+TEST(tcp_connector_loopback, receive_split)
+{
+    const unsigned len = 60000;
+    CHECK(transmit(*tx, len, 7));
+    CHECK(transmit(*tx, 10, 8));
+
+    ConnectorMsgHandle* handles[2];
+    unsigned got = 0;
+
+    for ( int tries = 0; got < 2 and tries < 1000; tries++ )
+    {
+        rx->process_receive();
+        got += rx->receive_messages(handles + got, 2 - got);
+    }
+    CHECK(got == 2);
+    CHECK(rx->get_connector_msg(handles[0])->length == len);
+    CHECK(rx->get_connector_msg(handles[1])->length == 10);
+
+    rx->discard_message(handles[0]);
+    rx->discard_message(handles[1]);
+}
+
+//-------------------------------------------------------------------------
+// benchmark; ignored by default, run with -ri
+//-------------------------------------------------------------------------
+
+// the original framing: one send or recv for each header and body
+static void legacy_send(int fd, const uint8_t* data, uint16_t len)
+{
+    TcpConnectorMsgHdr hdr(len);
+    send(fd, &hdr, sizeof(hdr), 0);
+    send(fd, data, len, 0);
+}
+
+static bool legacy_recv_all(int fd, uint8_t* buf, size_t len)
+{
+    size_t got = 0;
+
+    while ( got < len )
+    {
+        ssize_t n = recv(fd, buf + got, len - got, 0);
+
+        if ( n <= 0 )
+            return false;
+
+        got += n;
+    }
+    return true;
+}
+
+static double legacy_rate(unsigned num, unsigned len)
+{
+    int tfd, rfd;
+    CHECK(make_pair(tfd, rfd));
+
+    Stopwatch<std::chrono::steady_clock> sw;
+    sw.start();
+
+    std::thread sender([tfd, num, len]()
+    {
+        uint8_t data[1024];
+        fill(data, len, 0);
+
+        for ( unsigned i = 0; i < num; i++ )
+            legacy_send(tfd, data, len);
+    });
+
+    uint8_t buf[1024];
+    TcpConnectorMsgHdr hdr;
+
+    for ( unsigned i = 0; i < num; i++ )
+    {
+        if ( !legacy_recv_all(rfd, (uint8_t*)&hdr, sizeof(hdr)) or
+            !legacy_recv_all(rfd, buf, hdr.connector_msg_length) )
+            break;
+    }
+
+    sender.join();
+    sw.stop();
+
+    close(tfd);
+    close(rfd);
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+    return num * 1.0e9 / ns;
+}
+
+static double connector_rate(unsigned num, unsigned len)
+{
+    TcpConnectorConfig config;
+    config.async_receive = false;
+
+    int tfd, rfd;
+    CHECK(make_pair(tfd, rfd));
+
+    TcpConnector tx(&config, tfd);
+    TcpConnector rx(&config, rfd);
+
+    Stopwatch<std::chrono::steady_clock> sw;
+    sw.start();
+
+    std::thread sender([&tx, num, len]()
+    {
+        for ( unsigned i = 0; i < num; i++ )
+            transmit(tx, len, 0);
+    });
+
+    ConnectorMsgHandle* handles[64];
+    unsigned got = 0;
+
+    while ( got < num )
+    {
+        rx.process_receive();
+        unsigned n;
+
+        while ( (n = rx.receive_messages(handles, 64)) > 0 )
+        {
+            for ( unsigned i = 0; i < n; i++ )
+                rx.discard_message(handles[i]);
+
+            got += n;
+        }
+    }
+
+    sender.join();
+    sw.stop();
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+    return num * 1.0e9 / ns;
+}
+
+TEST_GROUP(tcp_connector_perf) { };
+
+IGNORE_TEST(tcp_connector_perf, loopback)
+{
+    const unsigned num = 200000;
+    unsigned lens[] = { 32, 128, 512 };
+
+    printf("\nmessages/sec over loopback\n");
+    printf("    len      legacy   connector\n");
+
+    for ( auto len : lens )
+    {
+        double a = legacy_rate(num, len);
+        double b = connector_rate(num, len);
+        printf("%7u %11.0f %11.0f\n", len, a, b);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -24,6 +24,7 @@
 
 #include <sys/socket.h>
 #include <sys/poll.h>
+#include <sys/uio.h>
 #include <netdb.h>
 
 #include "main/snort_debug.h"
@@ -52,7 +53,6 @@ static bool s_poll_error = false;
 static bool s_poll_undesirable = false;
 static bool s_poll_data_available = false;
 static int s_rec_error = 0;
-static int s_rec_error_size = -1;
 static bool s_rec_return_zero = false;
 
 static int s_send_ret_header = sizeof(TcpConnectorMsgHdr);
@@ -80,12 +80,13 @@ void ErrorMessage(const char*, ...) { }
 void LogMessage(const char*, ...) { }
 
 int connect (int, __CONST_SOCKADDR_ARG, socklen_t) { return s_connect_return; }
-ssize_t send (int, const void*, size_t n, int)
+// the header is written first; a short header write ends the call
+ssize_t writev (int, const struct iovec* iov, int)
 {
-    if ( n == sizeof(TcpConnectorMsgHdr) )
+    if ( s_send_ret_header != (int)iov[0].iov_len )
         return s_send_ret_header;
     else
-        return s_send_ret_other;
+        return s_send_ret_header + s_send_ret_other;
 }
 
 int poll (struct pollfd* fds, nfds_t nfds, int)
@@ -110,21 +111,20 @@ int poll (struct pollfd* fds, nfds_t nfds, int)
 
 ssize_t recv (int, void *buf, size_t n, int)
 {
-    if ( (s_rec_error_size == -1) ||
-        ( (s_rec_error_size != -1) && (s_rec_error_size == (int)n) ) )
+    if ( s_rec_return_zero )
+        return 0;
+
+    if ( (errno = s_rec_error) != 0 )
     {
-        if ( s_rec_return_zero )
-            return 0;
-
-        if ( (errno = s_rec_error) != 0 )
-        {
-            s_rec_error = 0;
-            return -1;
-        }
+        s_rec_error = 0;
+        return -1;
     }
 
-    if ( (s_rec_message != nullptr)  && (s_rec_message_size >= n) )
+    if ( (s_rec_message != nullptr) && (s_rec_message_size > 0) )
     {
+        if ( n > s_rec_message_size )
+            n = s_rec_message_size;
+
         memcpy( buf, s_rec_message, n);
         s_rec_message_size -= n;
         s_rec_message += n;
@@ -157,7 +157,6 @@ static void set_normal_status()
     s_poll_undesirable = false;
     s_poll_data_available = false;
     s_rec_error = 0;
-    s_rec_error_size = -1;
     s_rec_return_zero = false;
 }
 
@@ -761,11 +760,9 @@ TEST(tcp_connector_no_tinit_tterm_call, receive_recv_body_closed)
     TcpConnectorMsgHdr* hdr = (TcpConnectorMsgHdr*)message;
     hdr->version = TCP_FORMAT_VERSION;
     hdr->connector_msg_length = 10;
-    s_rec_error_size = 10;  // only indicate the error on the 10 byte recv()
     s_rec_message = message;
-    s_rec_message_size = size; // also trigger the read action
+    s_rec_message_size = size - 5; // closed after half the body
     s_poll_data_available = true;
-    s_rec_return_zero = true;
     connector = tcpc_api->tinit(&connector_config);
     CHECK(connector != nullptr);
     TcpConnector* tcpc = (TcpConnector*)connector;
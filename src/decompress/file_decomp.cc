@@ -31,6 +31,8 @@
 #include <zlib.h>
 
 #include "main/snort_types.h"
+#include "main/thread.h"
+#include "time/stopwatch.h"
 #include "utils/util.h"
 #include "detection/detection_util.h"
 
@@ -77,7 +79,7 @@ static struct sig_map_s
 #define SIG_CHR_INDEX_MASK  (0x07)
 #define SIG_CHR_INDEX_SHIFT (0)
 
-static uint8_t File_Decomp_Buffer[DECODE_BLEN];
+static THREAD_LOCAL uint8_t File_Decomp_Buffer[DECODE_BLEN];
 
 void keep_decomp_lib() { }
 
@@ -213,9 +215,40 @@ static fd_status_t Initialize_Decompression(fd_session_p_t SessionPtr)
     return( Ret_Code );
 }
 
+/* Stop the session for good when a budget is used up */
+static fd_status_t Budget_Exceeded(fd_session_p_t SessionPtr, int Event)
+{
+    SessionPtr->Error_Event = Event;
+    SessionPtr->State = STATE_COMPLETE;
+    File_Decomp_Alert(SessionPtr, Event);
+    return( File_Decomp_DecompError );
+}
+
 static fd_status_t Process_Decompression(fd_session_p_t SessionPtr)
 {
     fd_status_t Ret_Code = File_Decomp_OK;
+    uint32_t Avail_Out = SessionPtr->Avail_Out;
+    uint32_t Held_Out = 0;
+
+    /* Only let the decompressor produce what the ratio allows for the
+       input seen so far plus this call's input, so a bomb can't make us
+       do the work before we find out. */
+    if ( SessionPtr->Max_Ratio )
+    {
+        uint64_t Allowed = (uint64_t)SessionPtr->Max_Ratio *
+            ((uint64_t)SessionPtr->Total_In + SessionPtr->Avail_In);
+
+        Allowed = (Allowed > SessionPtr->Total_Out) ? Allowed - SessionPtr->Total_Out : 0;
+
+        if ( Allowed < Avail_Out )
+        {
+            Held_Out = Avail_Out - (uint32_t)Allowed;
+            SessionPtr->Avail_Out = (uint32_t)Allowed;
+        }
+    }
+
+    Stopwatch<SnortClock> Timer;
+    Timer.start();
 
     switch ( SessionPtr->File_Type )
     {
@@ -233,9 +266,18 @@ static fd_status_t Process_Decompression(fd_session_p_t SessionPtr)
         return( File_Decomp_Error );
     }
 
+    SessionPtr->Time_Used += Timer.get();
+    SessionPtr->Avail_Out += Held_Out;
+
     if ( Ret_Code == File_Decomp_Complete )
         SessionPtr->State = STATE_COMPLETE;
 
+    else if ( (Ret_Code == File_Decomp_BlockOut) && Held_Out )
+        return Budget_Exceeded(SessionPtr, FILE_DECOMP_ERR_RATIO_EXCEEDED);
+
+    else if ( (SessionPtr->Max_Time > 0_ticks) && (SessionPtr->Time_Used > SessionPtr->Max_Time) )
+        return Budget_Exceeded(SessionPtr, FILE_DECOMP_ERR_TIME_EXCEEDED);
+
     return( Ret_Code );
 }
 
@@ -295,7 +337,7 @@ fd_status_t File_Decomp_SetBuf(fd_session_p_t SessionPtr)
             return( File_Decomp_Error );
 
         /* Calc whats left in allowance */
-        remainder = (SessionPtr->Total_Out - SessionPtr->Decompr_Depth);
+        remainder = (SessionPtr->Decompr_Depth - SessionPtr->Total_Out);
 
         /* Use smaller of remainder or value provided */
         SessionPtr->Avail_Out = (remainder < SessionPtr->Avail_Out) ?
@@ -309,7 +351,7 @@ fd_status_t File_Decomp_SetBuf(fd_session_p_t SessionPtr)
         if ( SessionPtr->Total_In > SessionPtr->Compr_Depth )
             return( File_Decomp_Error );
 
-        remainder = (SessionPtr->Total_In - SessionPtr->Compr_Depth);
+        remainder = (SessionPtr->Compr_Depth - SessionPtr->Total_In);
 
         SessionPtr->Avail_In = (remainder < SessionPtr->Avail_In) ?
             remainder : SessionPtr->Avail_In;
@@ -333,6 +375,9 @@ fd_session_p_t File_Decomp_New()
     New_Session->Next_In = NULL;
     New_Session->Avail_Out = 0;
     New_Session->Next_Out = NULL;
+    New_Session->Max_Ratio = 0;
+    New_Session->Max_Time = 0_ticks;
+    New_Session->Time_Used = 0_ticks;
 
     return New_Session;
 }
@@ -550,4 +595,188 @@ TEST_CASE("Process_Decompression-not_active", "[file_decomp]")
     REQUIRE(Process_Decompression(p_s) == File_Decomp_Error);
 }
 
+TEST_CASE("File_Decomp_SetBuf-Decompr_Depth-remainder", "[file_decomp]")
+{
+    fd_session_p_t p_s;
+
+    REQUIRE((p_s = File_Decomp_New()) != (fd_session_p_t)NULL);
+    p_s->Total_Out = 4;
+    p_s->Decompr_Depth = 10;
+    p_s->Compr_Depth = 0;
+    REQUIRE(File_Decomp_SetBuf(p_s) == File_Decomp_OK);
+    REQUIRE(p_s->Avail_Out == 6);
+    delete p_s;
+}
+
+static const char pdf_head[] =
+    "%PDF-1.4\n% comment line\n"
+    "1 0 obj\n<</Length 20>>\nstream\nplain stream data\nendstream\nendobj\n"
+    "2 0 obj\n<</Length 99 /Filter /FlateDecode>>\nstream\n";
+static const char pdf_tail[] =
+    "\nendstream\nendobj\nxref\n0 3\ntrailer\n<</Size 3>>\nstartxref\n9\n%%EOF\n";
+
+// n copies of text deflated into buf; returns the compressed length
+static unsigned deflate_text(uint8_t* buf, unsigned len, const char* text, unsigned n)
+{
+    unsigned text_len = strlen(text);
+    uint8_t* plain = new uint8_t[text_len * n];
+
+    for ( unsigned i = 0; i < n; ++i )
+        memcpy(plain + i * text_len, text, text_len);
+
+    uLongf zlen = len;
+    REQUIRE(compress(buf, &zlen, plain, text_len * n) == Z_OK);
+
+    delete[] plain;
+    return zlen;
+}
+
+// a pdf with one deflated stream holding n copies of text
+static unsigned make_pdf(uint8_t* buf, unsigned len, const char* text, unsigned n)
+{
+    unsigned off = sizeof(pdf_head) - 1;
+    memcpy(buf, pdf_head, off);
+
+    off += deflate_text(buf + off, len - off - sizeof(pdf_tail), text, n);
+
+    memcpy(buf + off, pdf_tail, sizeof(pdf_tail) - 1);
+    return off + sizeof(pdf_tail) - 1;
+}
+
+// a zlib compressed swf whose body is n copies of text
+static unsigned make_swf(uint8_t* buf, unsigned len, const char* text, unsigned n)
+{
+    const unsigned hdr_len = SWF_SIG_LEN + SWF_VER_LEN + SWF_UCL_LEN;
+    uint32_t swf_len = hdr_len + strlen(text) * n;
+
+    memcpy(buf, "CWS\x0a", 4);
+
+    for ( unsigned i = 0; i < 4; ++i )
+        buf[4 + i] = (uint8_t)(swf_len >> (8 * i));
+
+    return hdr_len + deflate_text(buf + hdr_len, len - hdr_len, text, n);
+}
+
+// put back the uncompressed signature so the output is a whole swf
+static const uint32_t swf_modes = FILE_SWF_ZLIB_BIT | FILE_REVERT_BIT;
+
+// feed the file in chunks of seg bytes after the first 16 and return the
+// number of bytes written to out
+static unsigned run_decomp(
+    uint32_t modes, uint8_t* in, unsigned in_len, uint8_t* out, unsigned seg,
+    uint32_t ratio, fd_status_t& last)
+{
+    fd_session_p_t p_s = File_Decomp_New();
+    p_s->Modes = modes;
+    p_s->Compr_Depth = p_s->Decompr_Depth = 0;
+    p_s->Max_Ratio = ratio;
+    p_s->Alert_Callback = nullptr;
+    p_s->Alert_Context = nullptr;
+
+    REQUIRE(File_Decomp_Init(p_s) == File_Decomp_OK);
+    REQUIRE(File_Decomp_SetBuf(p_s) == File_Decomp_OK);
+
+    unsigned off = 0;
+    unsigned n = 16;
+    last = File_Decomp_OK;
+
+    while ( off < in_len )
+    {
+        if ( n > in_len - off )
+            n = in_len - off;
+
+        p_s->Next_In = in + off;
+        p_s->Avail_In = n;
+        last = File_Decomp(p_s);
+
+        if ( (last != File_Decomp_OK) && (last != File_Decomp_BlockIn) )
+            break;
+
+        off += n - p_s->Avail_In;
+        n = seg;
+    }
+
+    unsigned written = p_s->Next_Out - p_s->Buffer;
+    memcpy(out, p_s->Buffer, written);
+    File_Decomp_StopFree(p_s);
+    return written;
+}
+
+TEST_CASE("File_Decomp-pdf_segments", "[file_decomp]")
+{
+    uint8_t in[2048], exp[8192], got[8192];
+    unsigned len = make_pdf(in, sizeof(in), "inflated pdf text ", 100);
+    fd_status_t last;
+
+    unsigned exp_n = run_decomp(FILE_PDF_DEFL_BIT, in, len, exp, len, 0, last);
+    REQUIRE(exp_n > 1800);
+    CHECK(memmem(exp, exp_n, "inflated pdf text inflated", 26) != nullptr);
+    CHECK(memmem(exp, exp_n, "plain stream data", 17) != nullptr);
+    CHECK(memmem(exp, exp_n, "%%EOF", 5) != nullptr);
+
+    for ( unsigned seg : { 1, 3, 7, 64 } )
+    {
+        unsigned got_n = run_decomp(FILE_PDF_DEFL_BIT, in, len, got, seg, 0, last);
+        REQUIRE(exp_n == got_n);
+        CHECK(!memcmp(exp, got, exp_n));
+    }
+}
+
+TEST_CASE("File_Decomp-swf_segments", "[file_decomp]")
+{
+    uint8_t in[2048], exp[8192], got[8192];
+    unsigned len = make_swf(in, sizeof(in), "inflated swf text ", 100);
+    fd_status_t last;
+
+    unsigned exp_n = run_decomp(swf_modes, in, len, exp, len, 0, last);
+    CHECK(last == File_Decomp_Complete);
+    REQUIRE(exp_n == 8 + 1800);
+    CHECK(!memcmp(exp, "FWS\x0a", 4));
+    CHECK(!memcmp(exp + 4, in + 4, 4));
+    CHECK(!memcmp(exp + 8, "inflated swf text inflated", 26));
+
+    for ( unsigned seg : { 1, 3, 7, 64 } )
+    {
+        unsigned got_n = run_decomp(swf_modes, in, len, got, seg, 0, last);
+        CHECK(last == File_Decomp_Complete);
+        REQUIRE(exp_n == got_n);
+        CHECK(!memcmp(exp, got, exp_n));
+    }
+}
+
+TEST_CASE("File_Decomp-ratio_budget", "[file_decomp]")
+{
+    uint8_t in[2048], out[DECODE_BLEN];
+    fd_status_t last;
+    unsigned len, n;
+
+    SECTION("pdf")
+    {
+        len = make_pdf(in, sizeof(in), "0000000000000000", 4000);
+
+        n = run_decomp(FILE_PDF_DEFL_BIT, in, len, out, len, 20, last);
+        CHECK(last == File_Decomp_DecompError);
+        CHECK(n <= 20 * len);
+
+        n = run_decomp(FILE_PDF_DEFL_BIT, in, len, out, len, 0, last);
+        CHECK(last != File_Decomp_DecompError);
+        CHECK(n > 64000);
+    }
+    SECTION("swf")
+    {
+        len = make_swf(in, sizeof(in), "0000000000000000", 4000);
+
+        for ( unsigned seg : { 16u, len } )
+        {
+            n = run_decomp(swf_modes, in, len, out, seg, 20, last);
+            CHECK(last == File_Decomp_DecompError);
+            CHECK(n <= 20 * len);
+        }
+
+        n = run_decomp(swf_modes, in, len, out, len, 0, last);
+        CHECK(last == File_Decomp_Complete);
+        CHECK(n == 8 + 64000);
+    }
+}
+
 #endif
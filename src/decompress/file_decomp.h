@@ -27,6 +27,7 @@
 #include <string.h>
 
 #include "main/snort_types.h"
+#include "time/clock_defs.h"
 
 /* Function return codes used internally and with caller */
 enum fd_status_t
@@ -71,7 +72,9 @@ enum FileDecompError
     FILE_DECOMP_ERR_PDF_DEFL_FAILURE,
     FILE_DECOMP_ERR_PDF_UNSUP_COMP_TYPE,
     FILE_DECOMP_ERR_PDF_CASC_COMP,
-    FILE_DECOMP_ERR_PDF_PARSE_FAILURE
+    FILE_DECOMP_ERR_PDF_PARSE_FAILURE,
+    FILE_DECOMP_ERR_RATIO_EXCEEDED,
+    FILE_DECOMP_ERR_TIME_EXCEEDED
 };
 
 /* Private Types */
@@ -123,6 +126,11 @@ struct fd_session_t
     uint32_t Decompr_Depth;
     uint32_t Modes;      // Bit mapped set of potential file/algo modes
 
+    // Per file budgets, zero means unlimited; exceeding either ends the
+    // session with File_Decomp_DecompError
+    uint32_t Max_Ratio;    // Total_Out may not exceed Max_Ratio * Total_In
+    hr_duration Max_Time;  // time spent in File_Decomp() for this file
+
     int Error_Event;     // Specific event indicated by DecomprError return
 
     // Internal State
@@ -130,6 +138,7 @@ struct fd_session_t
     uint8_t Decomp_Type; // Active decompression type
     uint8_t Sig_State;   // Sig search state machine
     uint8_t State;       // main state machine
+    hr_duration Time_Used;  // time spent in File_Decomp() so far
 };
 
 // FIXIT-L don't obfuscate pointers
@@ -223,7 +232,7 @@ inline bool Put_N(fd_session_p_t SessionPtr, uint8_t* c, uint16_t N)
 {
     if ( (SessionPtr->Next_Out != NULL) && (SessionPtr->Avail_Out >= N) )
     {
-        strncpy( (char*)SessionPtr->Next_Out, (const char*)c, N);
+        memcpy(SessionPtr->Next_Out, c, N);
         SessionPtr->Next_Out += N;
         SessionPtr->Avail_Out -= N;
         SessionPtr->Total_Out += N;
@@ -255,17 +264,17 @@ inline bool Move_1(fd_session_p_t SessionPtr)
 
 /* If the input queue has at least N bytes available AND there's at
    space for at least N bytes in the output queue, then move all N bytes. */
-inline bool Move_N(fd_session_p_t SessionPtr, uint16_t N)
+inline bool Move_N(fd_session_p_t SessionPtr, uint32_t N)
 {
     if ( (SessionPtr->Next_Out != NULL) && (SessionPtr->Avail_Out >= N) &&
         (SessionPtr->Next_In != NULL) && (SessionPtr->Avail_In >= N) )
     {
-        strncpy( (char*)SessionPtr->Next_Out, (const char*)SessionPtr->Next_In, N);
+        memcpy(SessionPtr->Next_Out, SessionPtr->Next_In, N);
         SessionPtr->Next_Out += N;
         SessionPtr->Next_In += N;
         SessionPtr->Avail_In -= N;
         SessionPtr->Avail_Out -= N;
-        SessionPtr->Avail_Out -= N;
+        SessionPtr->Total_In += N;
         SessionPtr->Total_Out += N;
         return( true );
     }
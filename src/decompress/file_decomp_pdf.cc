@@ -823,6 +823,41 @@ static inline fd_status_t Handle_State_START(fd_session_p_t SessionPtr, uint8_t
     return( File_Decomp_OK );
 }
 
+/* While skipping a comment or spinning on the first byte of an end token
+   the parser state only changes on one or two specific bytes.  Return the
+   length of the leading run of bytes that leave the state untouched. */
+static inline uint32_t Skip_Run(fd_PDF_Parse_p_t p, const uint8_t* Data, uint32_t Len)
+{
+    const uint8_t* Stop;
+
+    if ( p->State == P_COMMENT )
+    {
+        uint32_t n = 0;
+
+        while ( (n < Len) && !IS_EOL(Data[n]) )
+            n++;
+
+        return( n );
+    }
+
+    if ( p->Elem_Index != 0 )
+        return( 0 );
+
+    if ( (p->State == P_IND_OBJ) && (p->Sub_State == P_ENDSTREAM_TOKEN) )
+        Stop = (const uint8_t*)memchr(Data, TOK_STRM_CLOSE[0], Len);
+
+    else if ( (p->State == P_IND_OBJ) && (p->Sub_State == P_ENDOBJ_TOKEN) )
+        Stop = (const uint8_t*)memchr(Data, TOK_OBJ_CLOSE[0], Len);
+
+    else if ( (p->State == P_XREF) && (p->Sub_State == P_XREF_END_TOKEN) )
+        Stop = (const uint8_t*)memchr(Data, TOK_XRF_END[0], Len);
+
+    else
+        return( 0 );
+
+    return( Stop ? (uint32_t)(Stop - Data) : Len );
+}
+
 /* Incrementally search the incoming data for a PDF compressed stream
    (of the type that we can decompress).  Move bytes to outgoing data
    up to the beginning of the compressed segment.  If the FILE_REVERT_BIT
@@ -845,6 +880,17 @@ static fd_status_t Locate_Stream_Beginning(fd_session_p_t SessionPtr)
         if ( SessionPtr->Avail_Out == 0 )
             return( File_Decomp_BlockOut );
 
+        /* Pass long stretches of stream data, comments and xref tables
+           through in one copy rather than one byte per trip around the loop */
+        uint32_t Run = (SessionPtr->Avail_In < SessionPtr->Avail_Out) ?
+            SessionPtr->Avail_In : SessionPtr->Avail_Out;
+
+        if ( (Run = Skip_Run(p, SessionPtr->Next_In, Run)) > 0 )
+        {
+            (void)Move_N(SessionPtr, Run);
+            continue;
+        }
+
         /* Get next byte in input queue */
         c = *SessionPtr->Next_In;
 
@@ -39,6 +39,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #include "main/snort_config.h"
 #include "hash/sfghash.h"
 #include "ips_options/ips_flow.h"
@@ -68,6 +72,31 @@
 
 static unsigned mpse_count = 0;
 
+// port groups are keyed by their sorted rule indices while they are built
+// so that groups with identical rule sets, whether from different ports,
+// services, or policies, share one set of search engines and nfp tree
+typedef std::vector<unsigned> RuleSet;
+
+struct RuleSetHash
+{
+    size_t operator()(const RuleSet& rules) const
+    {
+        uint64_t h = 0xcbf29ce484222325;
+
+        for ( auto idx : rules )
+            h = (h ^ idx) * 0x100000001b3;
+
+        return (size_t)h;
+    }
+};
+
+typedef std::unordered_map<RuleSet, PortGroup*, RuleSetHash> PortGroupCache;
+
+static PortGroupCache* pg_cache = nullptr;
+static unsigned pg_count = 0;
+static unsigned pg_shared = 0;
+static unsigned mpse_shared = 0;
+
 static void fpDeletePMX(void* data);
 
 static int fpGetFinalPattern(
@@ -1044,6 +1073,12 @@ static void fpDeletePMX(void* data)
 void fpDeletePortGroup(void* data)
 {
     PortGroup* pg = (PortGroup*)data;
+
+    if ( pg->share_count )
+    {
+        pg->share_count--;
+        return;
+    }
     pg->delete_nfp_rules();
 
     for (int i = PM_TYPE_PKT; i < PM_TYPE_MAX; i++)
@@ -1059,6 +1094,48 @@ void fpDeletePortGroup(void* data)
     snort_free(pg);
 }
 
+static void fpAddRuleSetRule(RuleSet& rules, OptTreeNode* otn)
+{
+    // same filter as fpAddPortGroupRule()
+    if ( otn->sigInfo.text_rule and otn->enabled )
+        rules.push_back(otn->ruleIndex);
+}
+
+static void fpFinishRuleSet(RuleSet& rules)
+{
+    std::sort(rules.begin(), rules.end());
+    rules.erase(std::unique(rules.begin(), rules.end()), rules.end());
+}
+
+static PortGroup* fpGetSharedPortGroup(const RuleSet& rules)
+{
+    if ( !pg_cache or rules.empty() )
+        return nullptr;
+
+    auto it = pg_cache->find(rules);
+
+    if ( it == pg_cache->end() )
+        return nullptr;
+
+    PortGroup* pg = it->second;
+    pg->share_count++;
+    pg_shared++;
+
+    for ( int i = PM_TYPE_PKT; i < PM_TYPE_MAX; ++i )
+        if ( pg->mpse[i] )
+            mpse_shared++;
+
+    return pg;
+}
+
+static void fpAddSharedPortGroup(const RuleSet& rules, PortGroup* pg)
+{
+    pg_count++;
+
+    if ( pg_cache and !rules.empty() )
+        (*pg_cache)[rules] = pg;
+}
+
 /*
  *  Create the PortGroup for these PortObject2 entitiies
  *
@@ -1089,6 +1166,40 @@ static int fpCreatePortObject2PortGroup(
     if (po->rule_hash == NULL)
         return 0;
 
+    /* Reuse the group built for an identical set of rules */
+    RuleSet rules;
+
+    for (pox = po; pox; pox = (pox == poaa) ? nullptr : poaa)
+    {
+        for (node = sfghash_findfirst(pox->rule_hash);
+            node;
+            node = sfghash_findnext(pox->rule_hash))
+        {
+            int* prindex = (int*)node->data;
+
+            if (prindex == NULL)
+                continue;
+
+            parser_get_rule_ids(*prindex, gid, sid);
+            otn = OtnLookup(sc->otn_map, gid, sid);
+            assert(otn);
+
+            if ( is_network_protocol(otn->proto) )
+                fpAddRuleSetRule(rules, otn);
+        }
+    }
+    fpFinishRuleSet(rules);
+
+    if ( (pg = fpGetSharedPortGroup(rules)) )
+    {
+        if (fp->get_debug_print_rule_group_build_details())
+            LogMessage("Sharing identical port group\n");
+
+        po->data = pg;
+        po->data_free = fpDeletePortGroup;
+        return 0;
+    }
+
     /* create a port_group */
     pg = (PortGroup*)snort_calloc(sizeof(PortGroup));
 
@@ -1146,6 +1257,8 @@ static int fpCreatePortObject2PortGroup(
     if (fpFinishPortGroup(sc, pg, fp) != 0)
         return 0;
 
+    fpAddSharedPortGroup(rules, pg);
+
     po->data = pg;
     po->data_free = fpDeletePortGroup;
 
@@ -1392,13 +1505,31 @@ static void fpBuildServicePortGroupByServiceOtnList(
     SnortConfig* sc, SFGHASH* p, const char* srvc, SF_LIST* list, FastPatternConfig* fp)
 {
     OptTreeNode* otn;
-    PortGroup* pg = (PortGroup*)snort_calloc(sizeof(PortGroup));
+    SF_LNODE* cursor;
+    RuleSet rules;
+
+    for (otn = (OptTreeNode*)sflist_first(list, &cursor);
+        otn;
+        otn = (OptTreeNode*)sflist_next(&cursor))
+    {
+        fpAddRuleSetRule(rules, otn);
+    }
+    fpFinishRuleSet(rules);
+
+    PortGroup* pg = fpGetSharedPortGroup(rules);
+
+    if ( pg )
+    {
+        sfghash_add(p, srvc, pg);
+        return;
+    }
+
+    pg = (PortGroup*)snort_calloc(sizeof(PortGroup));
 
     /*
      * add each rule to the port group pattern matchers,
      * or to the no-content rule list
      */
-    SF_LNODE* cursor;
 
     for (otn = (OptTreeNode*)sflist_first(list, &cursor);
         otn;
@@ -1411,6 +1542,8 @@ static void fpBuildServicePortGroupByServiceOtnList(
     if (fpFinishPortGroup(sc, pg, fp) != 0)
         return;
 
+    fpAddSharedPortGroup(rules, pg);
+
     /* Add the port_group using it's service name */
     sfghash_add(p, srvc, pg);
 }
@@ -1737,6 +1870,10 @@ int fpCreateFastPacketDetection(SnortConfig* sc)
     }
 
     mpse_count = 0;
+    pg_count = pg_shared = mpse_shared = 0;
+
+    PortGroupCache cache;
+    pg_cache = &cache;
 
     MpseManager::start_search_engine(fp->get_search_api());
 
@@ -1774,9 +1911,19 @@ int fpCreateFastPacketDetection(SnortConfig* sc)
     if (fp->get_debug_print_rule_group_build_details())
         LogMessage("Service Based Rule Maps Done....\n");
 
+    pg_cache = nullptr;
+
     fp_print_port_groups(port_tables);
     fp_print_service_groups(sc->spgmmTable);
 
+    if ( pg_shared )
+    {
+        LogLabel("port group sharing");
+        LogMessage("%25.25s: %-12u\n", "unique groups", pg_count);
+        LogMessage("%25.25s: %-12u\n", "shared groups", pg_shared);
+        LogMessage("%25.25s: %-12u\n", "shared engines", mpse_shared);
+    }
+
     if ( mpse_count )
     {
         LogLabel("search engine");
@@ -250,11 +250,16 @@ int fpCreateServiceMaps(SnortConfig* sc)
         hashNode = sfghash_findnext(sc->otn_map))
     {
         otn = (OptTreeNode*)hashNode->data;
+
+        // the otn is shared by every policy that has the rule so it is
+        // only added once for each protocol its rtns use
+        bool added[SNORT_PROTO_USER + 1] = { };
+
         for ( policyId = 0;
             policyId < otn->proto_node_num;
             policyId++ )
         {
-            rtn = getRtnFromOtn(otn);
+            rtn = getRtnFromOtn(otn, policyId);
 
             if ( rtn )
             {
@@ -266,6 +271,13 @@ int fpCreateServiceMaps(SnortConfig* sc)
                 if ( !otn->enabled )
                     continue;
 
+                int proto = (rtn->proto > SNORT_PROTO_USER) ? SNORT_PROTO_USER : rtn->proto;
+
+                if ( added[proto] )
+                    continue;
+
+                added[proto] = true;
+
                 for (svc_idx = 0; svc_idx < otn->sigInfo.num_services; svc_idx++)
                 {
                     if (ServiceMapAddOtn(sc->srmmTable, rtn->proto,
@@ -47,6 +47,7 @@ RateFilterConfig* RateFilter_ConfigNew()
 {
     RateFilterConfig* rf_config = (RateFilterConfig*)snort_calloc(sizeof(*rf_config));
     rf_config->memcap = 1024 * 1024;
+    rf_config->sync_interval = 1;
     return rf_config;
 }
 
@@ -72,6 +73,11 @@ void RateFilter_Cleanup()
     SFRF_Delete();
 }
 
+void RateFilter_ThreadTerm()
+{
+    SFRF_ThreadTerm();
+}
+
 /*
  * Create and Add a Thresholding Event Object
  */
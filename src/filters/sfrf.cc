@@ -32,12 +32,17 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
+#include <atomic>
+#include <mutex>
+
 #include "detection/rules.h"
 #include "detection/treenodes.h"
 #include "utils/util.h"
 #include "utils/sflsq.h"
 #include "hash/sfghash.h"
 #include "hash/sfxhash.h"
+#include "main/thread.h"
+#include "main/thread_config.h"
 #include "sfip/sf_ipvar.h"
 
 // Number of hash rows for gid 1 (rules)
@@ -71,6 +76,9 @@ typedef struct
  * hash for each threshold configure (identified by Tid) and source or
  * destination IP address.  For rule based tracking, IP is cleared in the
  * created node. Nodes are deleted when hash performs ANR on hash.
+ *
+ * Each packet thread has its own tracking hash.  count is the total for
+ * all threads as of the last sync plus this thread's pending changes.
  */
 typedef struct
 {
@@ -93,9 +101,39 @@ typedef struct
     /*  time when new action was activated due to rate limit exceeding.
     */
     time_t revertTime;
+
+    /* change in count since the last sync with the global hash.
+     */
+    int pending;
 } tSFRFTrackingNode;
 
+/* Global tracking node; the sum of the counts synced by all threads for
+ * the sampling period that started at tstart.
+ */
+typedef struct
+{
+    // automatically initialized to 0 when allocated
+    int valid;
+
+    unsigned count;
+    time_t tstart;
+} tSFRFGlobalNode;
+
+// Packet threads count events in rf_local_hash without locking.  Counts
+// are added into rf_hash, and the totals read back, at most every
+// sync_interval seconds of packet time or on every event if sync_interval
+// is 0.  Each thread's table gets an equal share of rf_memcap so rate
+// filters use at most twice the configured memcap.  rf_generation changes
+// when rf_hash is flushed or deleted so that each thread discards its own
+// table.
 SFXHASH* rf_hash = NULL;
+static std::mutex rf_hash_mutex;
+static unsigned rf_memcap = 0;
+static std::atomic<unsigned> rf_generation(0);
+
+static THREAD_LOCAL SFXHASH* rf_local_hash = NULL;
+static THREAD_LOCAL unsigned rf_local_generation = 0;
+static THREAD_LOCAL time_t rf_last_sync = 0;
 
 // private methods ...
 static int _checkThreshold(
@@ -113,7 +151,13 @@ static int _checkSamplingPeriod(
 static tSFRFTrackingNode* _getSFRFTrackingNode(
     const sfip_t*,
     unsigned tid,
-    time_t curTime
+    time_t curTime,
+    tSFRFTrackingNodeKey&
+    );
+
+static void _syncTrackingNode(
+    const tSFRFTrackingNodeKey*,
+    tSFRFTrackingNode*
     );
 
 static void _updateDependentThresholds(
@@ -136,7 +180,7 @@ static void _updateDependentThresholds(
 */
 #define SFRF_BYTES (sizeof(tSFRFTrackingNodeKey) + sizeof(tSFRFTrackingNode))
 
-static void SFRF_New(unsigned nbytes)
+static SFXHASH* SFRF_NewHash(unsigned nbytes, unsigned datasize)
 {
     int nrows;
 
@@ -147,11 +191,11 @@ static void SFRF_New(unsigned nbytes)
     }
     nrows = nbytes / (SFRF_BYTES);
 
-    /* Create global hash table for all of the IP Nodes */
-    rf_hash = sfxhash_new(
+    /* Create hash table for all of the IP Nodes */
+    return sfxhash_new(
         nrows,  /* try one node per row - for speed */
         sizeof(tSFRFTrackingNodeKey), /* keys size */
-        sizeof(tSFRFTrackingNode),     /* data size */
+        datasize,  /* data size */
         nbytes,                  /* memcap **/
         1,         /* ANR flag - true ?- Automatic Node Recovery=ANR */
         0,         /* ANR callback - none */
@@ -159,19 +203,82 @@ static void SFRF_New(unsigned nbytes)
         1);       /* Recycle nodes ?*/
 }
 
+static void SFRF_New(unsigned nbytes)
+{
+    rf_memcap = nbytes;
+    rf_hash = SFRF_NewHash(nbytes, sizeof(tSFRFGlobalNode));
+}
+
+// (re)create this thread's table if there is none or rf_hash was reset
+static bool SFRF_NewLocal()
+{
+    unsigned gen = rf_generation;
+
+    if ( rf_local_hash and rf_local_generation == gen )
+        return true;
+
+    if ( rf_local_hash )
+        sfxhash_delete(rf_local_hash);
+
+    // the packet threads share one memcap on top of the global table's
+    unsigned nthreads = ThreadConfig::get_instance_max();
+    unsigned nbytes = nthreads ? rf_memcap / nthreads : rf_memcap;
+
+    rf_local_hash = SFRF_NewHash(nbytes, sizeof(tSFRFTrackingNode));
+    rf_local_generation = gen;
+    rf_last_sync = 0;
+
+    return rf_local_hash != NULL;
+}
+
 void SFRF_Delete()
 {
+    std::lock_guard<std::mutex> lock(rf_hash_mutex);
+
     if ( !rf_hash )
         return;
 
     sfxhash_delete(rf_hash);
     rf_hash = NULL;
+    rf_generation++;
 }
 
 void SFRF_Flush()
 {
+    std::lock_guard<std::mutex> lock(rf_hash_mutex);
+
     if ( rf_hash )
         sfxhash_make_empty(rf_hash);
+
+    rf_generation++;
+}
+
+/* Add this thread's pending counts into the global hash and take back
+ * the totals.
+ */
+void SFRF_Sync()
+{
+    if ( !rf_local_hash or rf_local_generation != rf_generation )
+        return;
+
+    std::lock_guard<std::mutex> lock(rf_hash_mutex);
+
+    for ( SFXHASH_NODE* hnode = sfxhash_ghead(rf_local_hash); hnode;
+        hnode = sfxhash_gnext(hnode) )
+    {
+        _syncTrackingNode((tSFRFTrackingNodeKey*)hnode->key, (tSFRFTrackingNode*)hnode->data);
+    }
+}
+
+void SFRF_ThreadTerm()
+{
+    SFRF_Sync();
+
+    if ( rf_local_hash )
+    {
+        sfxhash_delete(rf_local_hash);
+        rf_local_hash = NULL;
+    }
 }
 
 static void SFRF_ConfigNodeFree(void* item)
@@ -356,6 +463,7 @@ static char* get_netip(const sfip_t* ip)
  *  @param ip     Event/Packet Src IP address- should be host ordered for comparison
  *  @param curTime Current Event/Packet time in seconds
  *  @param op operation of type SFRF_COUNT_OPERATION
+ *  @param sync_interval 0 to sync the tracking node now
  *
  *  @return  integer
  *  @retval   !0 : rate limit is reached. Return value contains new action.
@@ -365,13 +473,15 @@ static int SFRF_TestObject(
     tSFRFConfigNode* cfgNode,
     const sfip_t* ip,
     time_t curTime,
-    SFRF_COUNT_OPERATION op
+    SFRF_COUNT_OPERATION op,
+    unsigned sync_interval
     )
 {
     tSFRFTrackingNode* dynNode;
+    tSFRFTrackingNodeKey key;
     int retValue = -1;
 
-    dynNode = _getSFRFTrackingNode(ip, cfgNode->tid, curTime);
+    dynNode = _getSFRFTrackingNode(ip, cfgNode->tid, curTime, key);
 
     if ( dynNode == NULL )
         return retValue;
@@ -390,6 +500,7 @@ static int SFRF_TestObject(
         if ( (dynNode->count+1) != 0 )
         {
             dynNode->count++;
+            dynNode->pending++;
         }
         break;
     case SFRF_COUNT_DECREMENT:
@@ -399,16 +510,24 @@ static int SFRF_TestObject(
             if ( dynNode->count != 0 )
             {
                 dynNode->count--;
+                dynNode->pending--;
             }
         }
         break;
     case SFRF_COUNT_RESET:
+        dynNode->pending -= dynNode->count;
         dynNode->count = 0;
         break;
     default:
         break;
     }
 
+    if ( !sync_interval )
+    {
+        std::lock_guard<std::mutex> lock(rf_hash_mutex);
+        _syncTrackingNode(&key, dynNode);
+    }
+
     retValue = _checkThreshold(cfgNode, dynNode, curTime);
 
     // we drop after the session count has been incremented
@@ -417,7 +536,10 @@ static int SFRF_TestObject(
     // threshold would never be exceeded.
     if ( !cfgNode->seconds && dynNode->count > cfgNode->count )
         if ( cfgNode->newAction == RULE_TYPE__DROP )
+        {
             dynNode->count--;
+            dynNode->pending--;
+        }
 
 #ifdef SFRF_DEBUG
     printf("--SFRF_DEBUG: %d-%d-%d: %d Packet IP %s, op: %d, count %d, action %d\n",
@@ -476,6 +598,13 @@ int SFRF_TestThreshold(
     if ( gid >= SFRF_MAX_GENID )
         return status; /* bogus gid */
 
+    if ( config->sync_interval and
+        (unsigned)(curTime - rf_last_sync) >= config->sync_interval )
+    {
+        SFRF_Sync();
+        rf_last_sync = curTime;
+    }
+
     // Some events (like 'TCP connection closed' raised by preprocessor may
     // not have any configured threshold but may impact thresholds for other
     // events (like 'TCP connection opened'
@@ -535,14 +664,14 @@ int SFRF_TestThreshold(
         case SFRF_TRACK_BY_SRC:
             if ( SFRF_AppliesTo(cfgNode, sip) )
             {
-                newStatus = SFRF_TestObject(cfgNode, sip, curTime, op);
+                newStatus = SFRF_TestObject(cfgNode, sip, curTime, op, config->sync_interval);
             }
             break;
 
         case SFRF_TRACK_BY_DST:
             if ( SFRF_AppliesTo(cfgNode, dip) )
             {
-                newStatus = SFRF_TestObject(cfgNode, dip, curTime, op);
+                newStatus = SFRF_TestObject(cfgNode, dip, curTime, op, config->sync_interval);
             }
             break;
 
@@ -550,7 +679,7 @@ int SFRF_TestThreshold(
         {
             sfip_t cleared;
             sfip_clear(cleared);
-            newStatus = SFRF_TestObject(cfgNode, &cleared, curTime, op);
+            newStatus = SFRF_TestObject(cfgNode, &cleared, curTime, op, config->sync_interval);
         }
         break;
 
@@ -659,7 +788,9 @@ static int _checkSamplingPeriod(
                 dynNode->overRate = (dynNode->count > cfgNode->count);
             dynNode->tlast = curTime;
 #endif
+            // unsynced changes belong to the period that just ended
             dynNode->count = 0;
+            dynNode->pending = 0;
             return 1;
         }
     }
@@ -787,17 +918,56 @@ static void _updateDependentThresholds(
     }
 }
 
+/* Add the node's pending count to the global node and take back the total.
+ * A node that started a newer sampling period than the global node also
+ * starts it for all threads.  rf_hash_mutex must be held.
+ */
+static void _syncTrackingNode(
+    const tSFRFTrackingNodeKey* key,
+    tSFRFTrackingNode* dynNode
+    )
+{
+    if ( !rf_hash )
+        return;
+
+    SFXHASH_NODE* hnode = sfxhash_get_node(rf_hash, (const void*)key);
+
+    // keep counting locally if the global memcap is reached
+    if ( !hnode || !hnode->data )
+        return;
+
+    tSFRFGlobalNode* global = (tSFRFGlobalNode*)hnode->data;
+
+    if ( !global->valid || dynNode->tstart > global->tstart )
+    {
+        global->valid = 1;
+        global->count = 0;
+        global->tstart = dynNode->tstart;
+    }
+
+    int count = (int)global->count + dynNode->pending;
+    global->count = (count > 0) ? (unsigned)count : 0;
+
+    dynNode->count = global->count;
+    dynNode->tstart = global->tstart;
+    dynNode->pending = 0;
+}
+
 static tSFRFTrackingNode* _getSFRFTrackingNode(
     const sfip_t* ip,
     unsigned tid,
-    time_t curTime
+    time_t curTime,
+    tSFRFTrackingNodeKey& key
     )
 {
     tSFRFTrackingNode* dynNode = NULL;
-    tSFRFTrackingNodeKey key;
     SFXHASH_NODE* hnode = NULL;
 
+    if ( !SFRF_NewLocal() )
+        return NULL;
+
     /* Setup key */
+    memset(&key, 0, sizeof(key));
     key.ip = *(ip);
     key.tid = tid;
     key.policyId = get_network_policy()->policy_id;
@@ -805,7 +975,7 @@ static tSFRFTrackingNode* _getSFRFTrackingNode(
     /*
      * Check for any Permanent sid objects for this gid or add this one ...
      */
-    hnode = sfxhash_get_node(rf_hash, (void*)&key);
+    hnode = sfxhash_get_node(rf_local_hash, (void*)&key);
     if ( hnode && hnode->data )
     {
         dynNode = (tSFRFTrackingNode*)hnode->data;
@@ -818,6 +988,17 @@ static tSFRFTrackingNode* _getSFRFTrackingNode(
             dynNode->tlast = curTime;
 #endif
             dynNode->filterState = FS_OFF;
+
+            // start from what the other threads have counted
+            std::lock_guard<std::mutex> lock(rf_hash_mutex);
+            SFXHASH_NODE* gnode = rf_hash ? sfxhash_find_node(rf_hash, &key) : NULL;
+
+            if ( gnode && gnode->data && ((tSFRFGlobalNode*)gnode->data)->valid )
+            {
+                tSFRFGlobalNode* global = (tSFRFGlobalNode*)gnode->data;
+                dynNode->count = global->count;
+                dynNode->tstart = global->tstart;
+            }
         }
     }
     return dynNode;
@@ -141,6 +141,10 @@ struct RateFilterConfig
 
     int memcap;
 
+    // seconds of packet time between syncs of per thread counts; 0 for
+    // every event
+    unsigned sync_interval;
+
     int internal_event_mask;
 };
 
@@ -149,6 +153,8 @@ struct RateFilterConfig
  */
 void SFRF_Delete();
 void SFRF_Flush();
+void SFRF_Sync();
+void SFRF_ThreadTerm();
 int SFRF_ConfigAdd(struct SnortConfig*, RateFilterConfig*, tSFRFConfigNode*);
 
 int SFRF_TestThreshold(
@@ -25,6 +25,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "catch/catch.hpp"
 
 #include "main/snort_types.h"
@@ -1029,3 +1033,111 @@ TEST_CASE("sfrf minimum memcap", "[sfrf]")
     Term();
 }
 
+//---------------------------------------------------------------
+
+// each thread sends the same number of events for one rule; returns the
+// number that were not rate limited
+static unsigned ThreadTest(unsigned sync_interval, unsigned num_threads, unsigned events)
+{
+    RateFilterConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.memcap = MEM_DEFAULT;
+    cfg.sync_interval = sync_interval;
+
+    tSFRFConfigNode node;
+    memset(&node, 0, sizeof(node));
+    node.gid = 1;
+    node.sid = 9999;
+    node.tracking = SFRF_TRACK_BY_RULE;
+    node.count = 100;
+    node.seconds = 60;
+    node.newAction = (RuleType)RULE_NEW;
+    node.timeout = 60;
+
+    CHECK(SFRF_ConfigAdd(snort_conf, &cfg, &node) == 0);
+
+    std::atomic<unsigned> passed(0);
+    std::vector<std::thread> threads;
+
+    for ( unsigned t = 0; t < num_threads; ++t )
+    {
+        threads.push_back(std::thread([&cfg, &passed, events]()
+        {
+            sfip_t sip, dip;
+            sfip_pton(IP4_SRC, &sip);
+            sfip_pton(IP4_DST, &dip);
+
+            for ( unsigned i = 0; i < events; ++i )
+            {
+                if ( SFRF_TestThreshold(&cfg, 1, 9999, &sip, &dip, 10, SFRF_COUNT_INCREMENT) < 0 )
+                    passed++;
+            }
+            SFRF_ThreadTerm();
+        }));
+    }
+
+    for ( auto& th : threads )
+        th.join();
+
+    sfghash_delete(cfg.genHash[1]);
+    SFRF_Delete();
+
+    return passed;
+}
+
+TEST_CASE("sfrf threads", "[sfrf]")
+{
+    SECTION("sync every event")
+    {
+        // the global count is exact
+        CHECK(ThreadTest(0, 4, 250) == 100);
+    }
+    SECTION("sync interval")
+    {
+        // all events have the same time so the threads never sync after
+        // their first event and each one allows up to count
+        unsigned passed = ThreadTest(1, 4, 250);
+        CHECK(passed >= 100);
+        CHECK(passed <= 400);
+    }
+}
+
+// changes that were not synced before a sampling period ended must not be
+// counted in the next period
+TEST_CASE("sfrf period reset", "[sfrf]")
+{
+    RateFilterConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.memcap = MEM_DEFAULT;
+    cfg.sync_interval = 150;
+
+    tSFRFConfigNode node;
+    memset(&node, 0, sizeof(node));
+    node.gid = 1;
+    node.sid = 9998;
+    node.tracking = SFRF_TRACK_BY_RULE;
+    node.count = 3;
+    node.seconds = 100;
+    node.newAction = (RuleType)RULE_NEW;
+    node.timeout = 100;
+
+    CHECK(SFRF_ConfigAdd(snort_conf, &cfg, &node) == 0);
+
+    sfip_t sip, dip;
+    sfip_pton(IP4_SRC, &sip);
+    sfip_pton(IP4_DST, &dip);
+
+    // first period starts at 160 after a sync
+    for ( unsigned i = 0; i < 3; ++i )
+        CHECK(SFRF_TestThreshold(&cfg, 1, 9998, &sip, &dip, 160, SFRF_COUNT_INCREMENT) < 0);
+
+    // second period starts at 260 before the next sync at 310
+    CHECK(SFRF_TestThreshold(&cfg, 1, 9998, &sip, &dip, 260, SFRF_COUNT_INCREMENT) < 0);
+    CHECK(SFRF_TestThreshold(&cfg, 1, 9998, &sip, &dip, 310, SFRF_COUNT_INCREMENT) < 0);
+    CHECK(SFRF_TestThreshold(&cfg, 1, 9998, &sip, &dip, 310, SFRF_COUNT_INCREMENT) < 0);
+    CHECK(SFRF_TestThreshold(&cfg, 1, 9998, &sip, &dip, 310, SFRF_COUNT_INCREMENT) >= 0);
+
+    SFRF_ThreadTerm();
+    sfghash_delete(cfg.genHash[1]);
+    SFRF_Delete();
+}
@@ -0,0 +1,60 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// bypass_stats.h
+
+#ifndef BYPASS_STATS_H
+#define BYPASS_STATS_H
+
+#include <cstdint>
+#include <type_traits>
+
+#include "framework/counts.h"
+
+// why a flow was handed back to the daq uninspected
+enum class BypassReason : uint8_t
+{
+    NONE,
+    ENCRYPTED,
+    SIZE,
+    AGE,
+    MAX
+};
+
+struct BypassStats
+{
+    using reason_t = std::underlying_type<BypassReason>::type;
+
+    // packets and bytes are those still seen after the bypass, ie when the
+    // daq can't whitelist or the flow is tunneled
+    PegCount flows[static_cast<reason_t>(BypassReason::MAX)] { };
+    PegCount packets[static_cast<reason_t>(BypassReason::MAX)] { };
+    PegCount bytes[static_cast<reason_t>(BypassReason::MAX)] { };
+
+    void update(BypassReason reason)
+    { ++flows[static_cast<reason_t>(reason)]; }
+
+    void update(BypassReason reason, uint32_t len)
+    {
+        ++packets[static_cast<reason_t>(reason)];
+        bytes[static_cast<reason_t>(reason)] += len;
+    }
+};
+
+#endif
+
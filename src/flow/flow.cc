@@ -216,11 +216,18 @@ int Flow::set_flow_data(FlowData* fd)
         flow_data->prev = fd;
 
     flow_data = fd;
+
+    if ( fd->get_id() - 1 < FLOW_DATA_SLOTS )
+        flow_data_slots[fd->get_id() - 1] = fd;
+
     return 0;
 }
 
 FlowData* Flow::get_flow_data(unsigned id)
 {
+    if ( id - 1 < FLOW_DATA_SLOTS )
+        return flow_data_slots[id - 1];
+
     FlowData* fd = flow_data;
 
     while (fd)
@@ -235,6 +242,9 @@ FlowData* Flow::get_flow_data(unsigned id)
 
 void Flow::free_flow_data(FlowData* fd)
 {
+    if ( fd->get_id() - 1 < FLOW_DATA_SLOTS )
+        flow_data_slots[fd->get_id() - 1] = nullptr;
+
     if ( fd == flow_data )
     {
         flow_data = fd->next;
@@ -272,6 +282,7 @@ void Flow::free_flow_data()
         delete tmp;
     }
     flow_data = nullptr;
+    memset(flow_data_slots, 0, sizeof(flow_data_slots));
 }
 
 void Flow::call_handlers(Packet* p, bool eof)
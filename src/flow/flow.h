@@ -30,6 +30,7 @@
 #include <assert.h>
 
 #include "sfip/sfip_t.h"
+#include "flow/bypass_stats.h"
 #include "flow/flow_key.h"
 #include "framework/inspector.h"
 #include "framework/codec.h"
@@ -64,6 +65,7 @@
 #define SSNFLAG_CLIENT_SWAPPED      0x00400000
 
 #define SSNFLAG_PROXIED             0x01000000
+#define SSNFLAG_MONITORED           0x02000000 /* reputation is watching */
 #define SSNFLAG_NONE                0x00000000 /* nothing, an MT bag of chips */
 
 #define SSNFLAG_SEEN_BOTH (SSNFLAG_SEEN_SERVER | SSNFLAG_SEEN_CLIENT)
@@ -99,6 +101,11 @@ struct Packet;
 
 typedef void (* StreamAppDataFree)(void*);
 
+// FlowData ids are assigned densely from 1 as inspectors are registered so
+// the first FLOW_DATA_SLOTS ids are found by direct index; any others are
+// found by walking the flow_data list.  Each slot costs a pointer per flow.
+#define FLOW_DATA_SLOTS 16
+
 class SO_PUBLIC FlowData
 {
 public:
@@ -314,12 +321,15 @@ public:  // FIXIT-M privatize if possible
 
     // everything from here down is zeroed
     FlowData* flow_data;
+    FlowData* flow_data_slots[FLOW_DATA_SLOTS];  // indexed by id - 1
     Inspector* clouseau;  // service identifier
     Inspector* gadget;    // service handler
     Inspector* data;
     const char* service;
 
     uint64_t expire_time;
+    uint64_t bytes;       // wire bytes both ways
+    long start_time;      // first packet, seconds
 
     sfip_t client_ip; // FIXIT-L family and bits should be changed to uint16_t
     sfip_t server_ip; // or uint8_t to reduce sizeof from 24 to 20
@@ -347,6 +357,7 @@ public:  // FIXIT-M privatize if possible
 
     uint8_t  response_count;
     bool disable_inspect;
+    BypassReason bypass_reason;
 
 private:
     void clean();
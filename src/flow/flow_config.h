@@ -21,6 +21,10 @@
 #ifndef FLOW_CONFIG_H
 #define FLOW_CONFIG_H
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 // configured by the stream module for each cache instance
 
 struct FlowConfig
@@ -30,5 +34,16 @@ struct FlowConfig
     unsigned nominal_timeout = 0;
 };
 
+// configured by the stream module for all caches.  size and age bypass
+// is limited to the given services and appids if any are given.
+struct FlowBypassConfig
+{
+    uint64_t bytes = 0;
+    unsigned seconds = 0;
+
+    std::vector<std::string> services;
+    std::vector<int32_t> app_ids;
+};
+
 #endif
 
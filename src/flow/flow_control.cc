@@ -35,12 +35,17 @@
 #include "protocols/vlan.h"
 #include "sfip/sf_ip.h"
 #include "stream/stream.h"
+#include "utils/bitop.h"
 
 #include "expect_cache.h"
 #include "flow_cache.h"
 #include "flow_config.h"
 #include "session.h"
 
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
 FlowControl::FlowControl()
 { }
 
@@ -72,6 +77,7 @@ static THREAD_LOCAL PegCount tcp_count = 0;
 static THREAD_LOCAL PegCount udp_count = 0;
 static THREAD_LOCAL PegCount user_count = 0;
 static THREAD_LOCAL PegCount file_count = 0;
+static THREAD_LOCAL BypassStats bypass_stats;
 
 PegCount FlowControl::get_flows(PktType type)
 {
@@ -87,6 +93,9 @@ PegCount FlowControl::get_flows(PktType type)
     }
 }
 
+const BypassStats& FlowControl::get_bypass_stats() const
+{ return bypass_stats; }
+
 PegCount FlowControl::get_total_prunes(PktType type) const
 {
     auto cache = get_cache(type);
@@ -104,6 +113,7 @@ void FlowControl::clear_counts()
     ip_count = icmp_count = 0;
     tcp_count = udp_count = 0;
     user_count = file_count = 0;
+    bypass_stats = BypassStats();
 
     FlowCache* cache;
 
@@ -428,6 +438,11 @@ unsigned FlowControl::process(Flow* flow, Packet* p)
 
     flow->set_direction(p);
 
+    if ( !flow->start_time )
+        flow->start_time = p->pkth->ts.tv_sec;
+
+    flow->bytes += p->pkth->pktlen;
+
     // This requires the packet direction to be set
     if ( p->proto_bits & PROTO_BIT__MPLS )
         flow->set_mpls_layer_per_dir(p);
@@ -442,6 +457,9 @@ unsigned FlowControl::process(Flow* flow, Packet* p)
         assert(flow->ssn_client);
         assert(flow->ssn_server);
         flow->session->process(p);
+
+        if ( bypass_config )
+            check_bypass(flow, p);
         break;
 
     case Flow::FlowState::ALLOW:
@@ -450,6 +468,9 @@ unsigned FlowControl::process(Flow* flow, Packet* p)
         else
             DisableInspection();
 
+        if ( flow->bypass_reason != BypassReason::NONE )
+            bypass_stats.update(flow->bypass_reason, p->pkth->pktlen);
+
         p->ptrs.decode_flags |= DECODE_PKT_TRUST;
         break;
 
@@ -740,6 +761,82 @@ void FlowControl::process_file(Packet* p)
     file_count += process(flow, p);
 }
 
+//-------------------------------------------------------------------------
+// bypass
+//-------------------------------------------------------------------------
+
+void FlowControl::init_bypass(const FlowBypassConfig& fbc)
+{
+    bypass_config = (fbc.bytes or fbc.seconds) ? &fbc : nullptr;
+}
+
+static bool bypass_service(const FlowBypassConfig& fbc, const Flow* flow)
+{
+    if ( fbc.services.empty() and fbc.app_ids.empty() )
+        return true;
+
+    if ( flow->service )
+    {
+        for ( auto& s : fbc.services )
+            if ( s == flow->service )
+                return true;
+    }
+    for ( auto id : fbc.app_ids )
+    {
+        if ( id == flow->application_ids[APP_PROTOID_SERVICE] or
+            id == flow->application_ids[APP_PROTOID_PAYLOAD] )
+            return true;
+    }
+    return false;
+}
+
+bool FlowControl::bypass_allowed(Flow* flow, BypassReason reason)
+{
+    // encrypted flows are always stopped, as ssl did before there was a
+    // bypass policy; the rest only applies to size and age
+    if ( reason == BypassReason::ENCRYPTED )
+        return true;
+
+    if ( !bypass_config or !bypass_service(*bypass_config, flow) )
+        return false;
+
+    // rules may still be waiting on a flowbit set by this flow
+    if ( flow->bitop and !flow->bitop->is_clear() )
+        return false;
+
+    return !(flow->get_session_flags() & SSNFLAG_MONITORED);
+}
+
+bool FlowControl::bypass(Flow* flow, Packet* p, BypassReason reason)
+{
+    if ( flow->bypass_reason != BypassReason::NONE or !bypass_allowed(flow, reason) )
+        return false;
+
+    Stream::stop_inspection(flow, p, SSN_DIR_BOTH, -1, 0);
+    flow->bypass_reason = reason;
+    bypass_stats.update(reason);
+    return true;
+}
+
+// backups, video, and the like are most of the bytes and almost none of
+// the alerts so once they are big or old enough they go back to the daq
+void FlowControl::check_bypass(Flow* flow, Packet* p)
+{
+    BypassReason reason;
+
+    if ( bypass_config->bytes and flow->bytes >= bypass_config->bytes )
+        reason = BypassReason::SIZE;
+
+    else if ( bypass_config->seconds and
+        p->pkth->ts.tv_sec - flow->start_time >= (long)bypass_config->seconds )
+        reason = BypassReason::AGE;
+
+    else
+        return;
+
+    bypass(flow, p, reason);
+}
+
 //-------------------------------------------------------------------------
 // expected
 //-------------------------------------------------------------------------
@@ -798,3 +895,236 @@ bool FlowControl::is_expected(Packet* p)
     return exp_cache->is_expected(p);
 }
 
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+class TestSession : public Session
+{
+public:
+    TestSession(Flow* f) : Session(f) { }
+    void clear() override { }
+};
+
+class FlowBypassTest
+{
+public:
+    FlowBypassTest() : session(&flow)
+    {
+        flow.pkt_type = PktType::UDP;
+        flow.session = &session;
+        flow.start_time = 100;
+
+        pkth.ts.tv_sec = 100;
+        pkt.pkth = &pkth;
+
+        bypass_stats = BypassStats();
+    }
+
+    void set_config()
+    { fc.init_bypass(cfg); }
+
+    bool configured()
+    { return fc.bypass_config != nullptr; }
+
+    bool allowed(BypassReason reason)
+    { return fc.bypass_allowed(&flow, reason); }
+
+    // add len wire bytes at time secs and return why the flow was bypassed
+    BypassReason check(uint64_t len, long secs)
+    {
+        flow.bytes += len;
+        pkth.ts.tv_sec = secs;
+        fc.check_bypass(&flow, &pkt);
+        return flow.bypass_reason;
+    }
+
+    PegCount flows(BypassReason reason)
+    { return fc.get_bypass_stats().flows[static_cast<BypassStats::reason_t>(reason)]; }
+
+    FlowControl fc;
+    Flow flow;
+    TestSession session;
+    FlowBypassConfig cfg;
+    Packet pkt { false };
+    DAQ_PktHdr_t pkth { };
+};
+
+TEST_CASE( "bypass encrypted", "[bypass]" )
+{
+    FlowBypassTest t;
+
+    SECTION( "no policy" )
+    {
+        CHECK( t.fc.bypass(&t.flow, &t.pkt, BypassReason::ENCRYPTED) );
+    }
+    SECTION( "flowbits set" )
+    {
+        BitOp bits(8);
+        bits.set(1);
+        t.flow.bitop = &bits;
+        CHECK( t.fc.bypass(&t.flow, &t.pkt, BypassReason::ENCRYPTED) );
+        t.flow.bitop = nullptr;
+    }
+    SECTION( "monitored" )
+    {
+        t.flow.set_session_flags(SSNFLAG_MONITORED);
+        CHECK( t.fc.bypass(&t.flow, &t.pkt, BypassReason::ENCRYPTED) );
+    }
+    CHECK( t.flow.bypass_reason == BypassReason::ENCRYPTED );
+    CHECK( t.flow.flow_state == Flow::FlowState::ALLOW );
+    CHECK( t.flow.ssn_state.ignore_direction == SSN_DIR_BOTH );
+
+    // only counted once
+    CHECK( !t.fc.bypass(&t.flow, &t.pkt, BypassReason::ENCRYPTED) );
+    CHECK( !t.fc.bypass(&t.flow, &t.pkt, BypassReason::SIZE) );
+    CHECK( t.flows(BypassReason::ENCRYPTED) == 1 );
+    CHECK( t.flows(BypassReason::SIZE) == 0 );
+}
+
+TEST_CASE( "bypass thresholds", "[bypass]" )
+{
+    FlowBypassTest t;
+
+    SECTION( "no policy" )
+    {
+        t.set_config();
+        CHECK( !t.configured() );
+        CHECK( !t.allowed(BypassReason::SIZE) );
+        CHECK( !t.allowed(BypassReason::AGE) );
+        CHECK( !t.fc.bypass(&t.flow, &t.pkt, BypassReason::SIZE) );
+        CHECK( t.flow.bypass_reason == BypassReason::NONE );
+    }
+    SECTION( "bytes" )
+    {
+        t.cfg.bytes = 1000;
+        t.set_config();
+        CHECK( t.check(500, 200) == BypassReason::NONE );
+        CHECK( t.check(499, 200) == BypassReason::NONE );
+        CHECK( t.check(1, 200) == BypassReason::SIZE );
+        CHECK( t.flows(BypassReason::SIZE) == 1 );
+        CHECK( t.flows(BypassReason::AGE) == 0 );
+    }
+    SECTION( "seconds" )
+    {
+        t.cfg.seconds = 10;
+        t.set_config();
+        CHECK( t.check(100000, 105) == BypassReason::NONE );
+        CHECK( t.check(0, 109) == BypassReason::NONE );
+        CHECK( t.check(0, 110) == BypassReason::AGE );
+        CHECK( t.flows(BypassReason::AGE) == 1 );
+        CHECK( t.flows(BypassReason::SIZE) == 0 );
+    }
+    SECTION( "size before age" )
+    {
+        t.cfg.bytes = 1000;
+        t.cfg.seconds = 10;
+        t.set_config();
+        CHECK( t.check(1000, 110) == BypassReason::SIZE );
+    }
+    SECTION( "once" )
+    {
+        t.cfg.bytes = 1000;
+        t.set_config();
+        CHECK( t.check(1000, 100) == BypassReason::SIZE );
+        CHECK( t.check(1000, 100) == BypassReason::SIZE );
+        CHECK( t.flows(BypassReason::SIZE) == 1 );
+    }
+    SECTION( "reload off" )
+    {
+        t.cfg.bytes = 1000;
+        t.set_config();
+        CHECK( t.configured() );
+
+        FlowBypassConfig off;
+        t.fc.init_bypass(off);
+        CHECK( !t.configured() );
+        CHECK( !t.allowed(BypassReason::SIZE) );
+    }
+}
+
+TEST_CASE( "bypass vetoes", "[bypass]" )
+{
+    FlowBypassTest t;
+    t.cfg.bytes = 1000;
+    t.set_config();
+
+    SECTION( "flowbits" )
+    {
+        BitOp bits(8);
+        t.flow.bitop = &bits;
+        bits.set(3);
+        CHECK( t.check(1000, 100) == BypassReason::NONE );
+        bits.clear(3);
+        CHECK( t.check(0, 100) == BypassReason::SIZE );
+        t.flow.bitop = nullptr;
+    }
+    SECTION( "monitored" )
+    {
+        t.flow.set_session_flags(SSNFLAG_MONITORED);
+        CHECK( t.check(1000, 100) == BypassReason::NONE );
+        CHECK( t.flows(BypassReason::SIZE) == 0 );
+    }
+}
+
+TEST_CASE( "bypass filters", "[bypass]" )
+{
+    FlowBypassTest t;
+    t.cfg.bytes = 1000;
+
+    SECTION( "services" )
+    {
+        t.cfg.services = { "http" };
+        t.set_config();
+        CHECK( !t.allowed(BypassReason::SIZE) );
+
+        t.flow.service = "ftp";
+        CHECK( t.check(1000, 100) == BypassReason::NONE );
+
+        t.flow.service = "http";
+        CHECK( t.check(0, 100) == BypassReason::SIZE );
+    }
+    SECTION( "app ids" )
+    {
+        t.cfg.app_ids = { 676 };
+        t.set_config();
+
+        t.flow.application_ids[APP_PROTOID_SERVICE] = 5;
+        CHECK( t.check(1000, 100) == BypassReason::NONE );
+
+        t.flow.application_ids[APP_PROTOID_PAYLOAD] = 676;
+        CHECK( t.check(0, 100) == BypassReason::SIZE );
+    }
+    SECTION( "services or app ids" )
+    {
+        t.cfg.services = { "http" };
+        t.cfg.app_ids = { 676 };
+        t.set_config();
+
+        t.flow.application_ids[APP_PROTOID_SERVICE] = 676;
+        CHECK( t.check(1000, 100) == BypassReason::SIZE );
+    }
+}
+
+TEST_CASE( "bypass pegs", "[bypass]" )
+{
+    BypassStats bs;
+
+    bs.update(BypassReason::SIZE);
+    bs.update(BypassReason::SIZE, 60);
+    bs.update(BypassReason::SIZE, 1500);
+    bs.update(BypassReason::AGE, 40);
+
+    CHECK( bs.flows[static_cast<BypassStats::reason_t>(BypassReason::SIZE)] == 1 );
+    CHECK( bs.packets[static_cast<BypassStats::reason_t>(BypassReason::SIZE)] == 2 );
+    CHECK( bs.bytes[static_cast<BypassStats::reason_t>(BypassReason::SIZE)] == 1560 );
+
+    CHECK( bs.flows[static_cast<BypassStats::reason_t>(BypassReason::AGE)] == 0 );
+    CHECK( bs.packets[static_cast<BypassStats::reason_t>(BypassReason::AGE)] == 1 );
+    CHECK( bs.bytes[static_cast<BypassStats::reason_t>(BypassReason::AGE)] == 40 );
+
+    CHECK( bs.flows[static_cast<BypassStats::reason_t>(BypassReason::ENCRYPTED)] == 0 );
+}
+#endif
@@ -28,6 +28,7 @@
 #include <cstdint>
 #include <vector>
 
+#include "flow/bypass_stats.h"
 #include "flow/flow_config.h"
 #include "framework/counts.h"
 #include "framework/decode_data.h"
@@ -66,6 +67,11 @@ public:
     void init_user(const FlowConfig&, InspectSsnFunc);
     void init_file(const FlowConfig&, InspectSsnFunc);
     void init_exp(uint32_t max);
+    void init_bypass(const FlowBypassConfig&);
+
+    // stop inspecting the flow for the given reason if the bypass policy
+    // allows it; the remaining packets are whitelisted
+    bool bypass(Flow*, Packet*, BypassReason);
 
     void delete_flow(const FlowKey*);
     void delete_flow(Flow*, PruneReason);
@@ -92,6 +98,7 @@ public:
     PegCount get_flows(PktType);
     PegCount get_total_prunes(PktType) const;
     PegCount get_prunes(PktType, PruneReason) const;
+    const BypassStats& get_bypass_stats() const;
 
     void clear_counts();
 
@@ -104,6 +111,9 @@ private:
     unsigned process(Flow*, Packet*);
     void preemptive_cleanup();
 
+    bool bypass_allowed(Flow*, BypassReason);
+    void check_bypass(Flow*, Packet*);
+
 private:
     FlowCache* ip_cache = nullptr;
     FlowCache* icmp_cache = nullptr;
@@ -128,10 +138,15 @@ private:
     InspectSsnFunc get_file = nullptr;
 
     class ExpectCache* exp_cache = nullptr;
+    const FlowBypassConfig* bypass_config = nullptr;
     PktType last_pkt_type = PktType::NONE;
 
     std::vector<PktType> types;
     unsigned next = 0;
+
+#ifdef UNIT_TEST
+    friend class FlowBypassTest;
+#endif
 };
 
 #endif
@@ -34,7 +34,7 @@
 #include "stream/stream.h"
 #include "time/packet_time.h"
 
-static const uint8_t HA_MESSAGE_VERSION = 3;
+static const uint8_t HA_MESSAGE_VERSION = 4;
 
 // define message size and content constants.
 static const uint8_t KEY_SIZE_IP6 = sizeof(FlowKey);
@@ -51,13 +51,15 @@ enum
 
 typedef std::array<FlowHAClient*, MAX_CLIENTS> ClientMap;
 
-THREAD_LOCAL SimpleStats ha_stats;
+THREAD_LOCAL HAStats ha_stats;
 THREAD_LOCAL ProfileStats ha_perf_stats;
 
 static THREAD_LOCAL HighAvailability* ha;
 PortBitSet* HighAvailabilityManager::ports = nullptr;
 bool HighAvailabilityManager::use_daq_channel = false;
 bool HighAvailabilityManager::shutting_down = false;
+uint16_t HighAvailabilityManager::batch_size = 0;
+struct timeval HighAvailabilityManager::batch_delay;
 struct timeval FlowHAState::min_session_lifetime;
 struct timeval FlowHAState::min_sync_interval;
 uint8_t s_handle_counter = 1; // stream client (index == 0) always exists
@@ -215,17 +217,11 @@ static uint8_t write_flow_key(Flow* flow, HAMessage* msg)
     const FlowKey* key = flow->key;
     assert(key);
 
-    if (is_ip6_key(flow->key) )
-    {
-        hdr->key_type = KEY_TYPE_IP6;
-        memcpy(msg->cursor, key, KEY_SIZE_IP6);
-        msg->cursor += KEY_SIZE_IP6;
-        return KEY_SIZE_IP6;
-    }
 // FIXIT-H - remove the #ifdef COMPRESSED_KEY sections when the ip6/ip4 logic is implemented
-//   and the compressed key is available for use.  Until then all keys are IP6 and larger.
+//   and the compressed key is available for use.  Until then all keys are sent as IP6 so
+//   the receiver can always find where a batched message ends.
 #ifdef COMPRESSED_KEY
-    else
+    if ( !is_ip6_key(key) )
     {
         hdr->key_type = KEY_TYPE_IP4;
         memcpy(msg->cursor, &key->ip_l[3], sizeof(key->ip_l[3]));
@@ -238,7 +234,10 @@ static uint8_t write_flow_key(Flow* flow, HAMessage* msg)
         return KEY_SIZE_IP4;
     }
 #endif
-    return 0;
+    hdr->key_type = KEY_TYPE_IP6;
+    memcpy(msg->cursor, key, KEY_SIZE_IP6);
+    msg->cursor += KEY_SIZE_IP6;
+    return KEY_SIZE_IP6;
 }
 
 // Regardless of the message cursor, extract the key and
@@ -281,7 +280,12 @@ static uint8_t read_flow_key(FlowKey* key, HAMessage* msg)
 static inline uint8_t key_size(Flow* flow)
 {
     assert(flow->key);
+#ifdef COMPRESSED_KEY
     return is_ip6_key(flow->key) ? KEY_SIZE_IP6 : KEY_SIZE_IP4;
+#else
+    UNUSED(flow);
+    return KEY_SIZE_IP6;
+#endif
 }
 
 static uint16_t calculate_msg_header_length(Flow* flow)
@@ -326,8 +330,10 @@ static void write_update_msg_client( FlowHAClient* client, Flow* flow, HAMessage
     assert(client);
     assert(msg);
 
+    uint8_t* start = msg->cursor;
     client->place(msg,(uint8_t*)&(client->header),(uint8_t)sizeof(client->header));
     client->produce(flow, msg);
+    ha_stats.client_bytes_sent[client->header.client] += msg->cursor - start;
 }
 
 static void write_update_msg_content(Flow* flow, HAMessage* msg)
@@ -393,6 +399,7 @@ static void consume_receive_update_message(HAMessage* msg)
             ErrorMessage("Consuming HA Update message - error from client consume()\n");
             break;
         }
+        ha_stats.client_bytes_received[header->client] += sizeof(HAClientHeader) + header->length;
     }
 }
 
@@ -400,9 +407,6 @@ static void consume_receive_message(HAMessage* msg)
 {
     HAMessageHeader* hdr = (HAMessageHeader*)msg->content();
 
-    if ( hdr->version != HA_MESSAGE_VERSION)
-        return;
-
     switch ( hdr->event )
     {
         case HA_DELETE_EVENT:
@@ -420,6 +424,36 @@ static void consume_receive_message(HAMessage* msg)
     }
 }
 
+// The length of the HA message starting at hdr or 0 if it is malformed.
+// Each message gives its own length so the receiver can walk a batch
+// without knowing how the sender packed it.
+static uint16_t get_message_length(const HAMessageHeader* hdr, uint32_t avail)
+{
+    if ( avail < sizeof(HAMessageHeader) )
+        return 0;
+
+    uint32_t len = sizeof(HAMessageHeader) + hdr->total_length;
+
+    if ( hdr->key_type == KEY_TYPE_IP6 )
+        len += KEY_SIZE_IP6;
+#ifdef COMPRESSED_KEY
+    else if ( hdr->key_type == KEY_TYPE_IP4 )
+        len += KEY_SIZE_IP4;
+#endif
+    else
+        return 0;
+
+    return ( len <= avail ) ? (uint16_t)len : 0;
+}
+
+static inline uint64_t usec_between(const struct timeval& a, const struct timeval& b)
+{
+    if ( b.tv_sec < a.tv_sec or (b.tv_sec == a.tv_sec and b.tv_usec < a.tv_usec) )
+        return 0;
+
+    return (uint64_t)(b.tv_sec - a.tv_sec) * USEC_PER_SEC + b.tv_usec - a.tv_usec;
+}
+
 HighAvailability::HighAvailability(PortBitSet* ports, bool)
 {
     SCPort port;
@@ -452,6 +486,8 @@ HighAvailability::HighAvailability(PortBitSet* ports, bool)
     for ( int i=0; i<MAX_CLIENTS; i++ )
         (*s_client_map)[i] = nullptr;
 
+    batch.resize(HighAvailabilityManager::batch_size);
+
     // Only looking for side channel processing - FIXIT-H
 }
 
@@ -461,6 +497,7 @@ HighAvailability::~HighAvailability()
 
     if ( sc )
     {
+        flush();
         sc->unregister_receive_handler();
     }
 
@@ -477,12 +514,121 @@ void HighAvailability::receive_handler(SCMessage* sc_msg)
     // SC received messages must have reference back to SideChannel object
     assert(sc_msg->sc);
 
-    HAMessage ha_msg(sc_msg);
-    consume_receive_message(&ha_msg);
+    // apply each HA message in the batch
+    uint8_t* content = sc_msg->content;
+    uint32_t avail = sc_msg->content_length;
+
+    while ( avail )
+    {
+        const HAMessageHeader* hdr = (HAMessageHeader*)content;
+
+        if ( avail >= sizeof(HAMessageHeader) and hdr->version != HA_MESSAGE_VERSION )
+        {
+            if ( !version_warned )
+            {
+                ErrorMessage("Consuming HA batch - peer sent version %u, expected %u\n",
+                    hdr->version, HA_MESSAGE_VERSION);
+                version_warned = true;
+            }
+            ha_stats.bad_batches++;
+            break;
+        }
+
+        uint16_t len = get_message_length(hdr, avail);
+
+        if ( !len )
+        {
+            ErrorMessage("Consuming HA batch - malformed message\n");
+            ha_stats.bad_batches++;
+            break;
+        }
+
+        HAMessage ha_msg(content, len);
+        consume_receive_message(&ha_msg);
+        ha_stats.msgs_received++;
+
+        content += len;
+        avail -= len;
+    }
+    ha_stats.batches_received++;
 
     sc_msg->sc->discard_message(sc_msg);
 }
 
+// Build an HA message for the flow in the batch or, if it doesn't fit in
+// an empty batch, in a side channel message of its own.
+void HighAvailability::send(Flow* flow, HAEvent event, uint16_t content_len)
+{
+    const uint32_t len = calculate_msg_header_length(flow) + content_len;
+    SCMessage* sc_msg = nullptr;
+    uint8_t* content;
+
+    if ( len > batch.size() )
+    {
+        // keep messages in order
+        flush_batch(&ha_stats.full_flushes);
+
+        sc_msg = sc->alloc_transmit_message(len);
+        assert(sc_msg);
+        content = sc_msg->content;
+    }
+    else
+    {
+        if ( batch_len + len > batch.size() )
+            flush_batch(&ha_stats.full_flushes);
+
+        if ( !batch_msgs )
+            packet_gettimeofday(&batch_start);
+
+        content = &batch[batch_len];
+        batch_len += len;
+        batch_msgs++;
+    }
+
+    HAMessage ha_msg(content, len);
+    write_msg_header(flow, event, content_len, &ha_msg);
+
+    if ( event == HA_UPDATE_EVENT )
+        write_update_msg_content(flow, &ha_msg);
+
+    ha_stats.msgs_sent++;
+
+    if ( sc_msg )
+    {
+        sc->transmit_message(sc_msg);
+        ha_stats.batches_sent++;
+    }
+}
+
+void HighAvailability::flush_batch(PegCount* reason)
+{
+    if ( !batch_msgs )
+        return;
+
+    SCMessage* sc_msg = sc->alloc_transmit_message(batch_len);
+    assert(sc_msg);
+
+    memcpy(sc_msg->content, batch.data(), batch_len);
+    sc->transmit_message(sc_msg);
+
+    struct timeval now;
+    packet_gettimeofday(&now);
+
+    ha_stats.batch_delay_usec += usec_between(batch_start, now) * batch_msgs;
+    ha_stats.batches_sent++;
+
+    if ( reason )
+        (*reason)++;
+
+    batch_len = 0;
+    batch_msgs = 0;
+}
+
+void HighAvailability::flush()
+{
+    flush_batch(nullptr);
+}
+
 void HighAvailability::process_update(Flow* flow, const DAQ_PktHdr_t* pkthdr)
 {
     DebugMessage(DEBUG_HA,"HighAvailability::process_update()\n");
@@ -501,16 +647,7 @@ void HighAvailability::process_update(Flow* flow, const DAQ_PktHdr_t* pkthdr)
             flow->ha_state->check_any(FlowHAState::NEW) ) )
         return;
 
-    const uint16_t header_len = calculate_msg_header_length(flow);
-    const uint16_t content_len = calculate_update_msg_content_length(flow);
-
-    SCMessage* sc_msg = sc->alloc_transmit_message((uint32_t)(header_len+content_len));
-    assert(sc_msg);
-    HAMessage ha_msg(sc_msg);
-
-    write_msg_header(flow, HA_UPDATE_EVENT, content_len, &ha_msg);
-    write_update_msg_content(flow, &ha_msg);
-    sc->transmit_message(sc_msg);
+    send(flow, HA_UPDATE_EVENT, calculate_update_msg_content_length(flow));
 
     flow->ha_state->clear(FlowHAState::NEW | FlowHAState::MODIFIED |
         FlowHAState::MAJOR | FlowHAState::CRITICAL);
@@ -533,31 +670,40 @@ void HighAvailability::process_deletion(Flow* flow)
     if ( !sc )
         return;
 
-    const uint32_t msg_len = calculate_msg_header_length(flow);
-    SCMessage* sc_msg = sc->alloc_transmit_message(msg_len);
-    HAMessage ha_msg(sc_msg);
-
     // No content, only header+key
-    write_msg_header(flow, HA_DELETE_EVENT, 0, &ha_msg);
-
-    sc->transmit_message(sc_msg);
+    send(flow, HA_DELETE_EVENT, 0);
 
     flow->ha_state->add(FlowHAState::DELETED);
 }
 
 void HighAvailability::process_receive()
 {
-    if ( sc != nullptr )
-        sc->process(DISPATCH_ALL_RECEIVE);
+    if ( sc == nullptr )
+        return;
+
+    if ( batch_msgs )
+    {
+        struct timeval now;
+        packet_gettimeofday(&now);
+
+        if ( usec_between(batch_start, now) >=
+            (uint64_t)HighAvailabilityManager::batch_delay.tv_sec * USEC_PER_SEC +
+            HighAvailabilityManager::batch_delay.tv_usec )
+            flush_batch(&ha_stats.timed_flushes);
+    }
+    sc->process(DISPATCH_ALL_RECEIVE);
 }
 
 // Called by the configuration parsing activity in the main thread.
 bool HighAvailabilityManager::instantiate(PortBitSet* mod_ports, bool mod_use_daq_channel,
-        struct timeval* min_session_lifetime, struct timeval* min_sync_interval)
+        struct timeval* min_session_lifetime, struct timeval* min_sync_interval,
+        uint16_t mod_batch_size, struct timeval* mod_batch_delay)
 {
     DebugMessage(DEBUG_HA,"HighAvailabilityManager::instantiate()\n");
     ports = mod_ports;
     FlowHAState::config_timers(*min_session_lifetime, *min_sync_interval);
+    batch_size = mod_batch_size;
+    batch_delay = *mod_batch_delay;
 #ifdef HAVE_DAQ_EXT_MODFLOW
     use_daq_channel = mod_use_daq_channel;
 #else
@@ -573,6 +719,7 @@ void HighAvailabilityManager::pre_config_init()
     DebugFormat(DEBUG_HA,"HighAvailabilityManager::pre_config_init(): key size: %zu\n",
         sizeof(FlowKey));
     ports = nullptr;
+    batch_size = 0;
 }
 
 // Called within the packet thread prior to packet processing
@@ -621,6 +768,12 @@ void HighAvailabilityManager::process_receive()
         ha->process_receive();
 }
 
+void HighAvailabilityManager::flush()
+{
+    if ( ha != nullptr )
+        ha->flush();
+}
+
 // Called in the packet threads to determine whether or not HA is active
 bool HighAvailabilityManager::active()
 {
@@ -20,7 +20,10 @@
 #ifndef HA_H
 #define HA_H
 
+#include <vector>
+
 #include "flow/flow_key.h"
+#include "framework/counts.h"
 #include "main/snort_types.h"
 #include "packet_io/sfdaq.h"
 #include "side_channel/side_channel.h"
@@ -42,6 +45,20 @@ const FlowHAClientHandle ALL_CLIENTS = 0xffff;
 //   session client has handle of 0 and index of 0
 const uint8_t MAX_CLIENTS = 17;
 
+struct HAStats
+{
+    PegCount msgs_sent;
+    PegCount batches_sent;
+    PegCount full_flushes;
+    PegCount timed_flushes;
+    PegCount batch_delay_usec;
+    PegCount msgs_received;
+    PegCount batches_received;
+    PegCount bad_batches;
+    PegCount client_bytes_sent[MAX_CLIENTS];
+    PegCount client_bytes_received[MAX_CLIENTS];
+};
+
 enum HAEvent
 {
     HA_DELETE_EVENT = 1,
@@ -101,22 +118,27 @@ struct __attribute__((__packed__)) HAClientHeader
     uint8_t length;
 };
 
-// Describe the message being produced or consumed.
+// Describe the message being produced or consumed.  A side channel
+// message may carry several HA messages back to back; each HAMessage
+// covers just one of them.
 class HAMessage
 {
 public:
     HAMessage(SCMessage* msg)
-    { sc_msg = msg; }
+    { buf = msg->content; len = msg->content_length; }
+    HAMessage(uint8_t* content, uint16_t length)
+    { buf = content; len = length; }
     ~HAMessage() { }
 
     uint8_t* content()
-    { return sc_msg->content; }
+    { return buf; }
     uint16_t content_length()
-    { return sc_msg->content_length; }
+    { return len; }
     uint8_t* cursor;
 
 private:
-    SCMessage* sc_msg;
+    uint8_t* buf;
+    uint16_t len;
 };
 
 // A FlowHAClient subclass for each producer/consumer of flow HA data
@@ -152,9 +174,24 @@ public:
     void process_deletion(Flow*);
     void process_receive();
 
+    // transmit any staged messages now
+    void flush();
+
 private:
     void receive_handler(SCMessage*);
+    void send(Flow*, HAEvent, uint16_t content_len);
+    void flush_batch(PegCount* reason);
+
     SideChannel* sc = nullptr;
+
+    // messages staged for the next side channel message
+    std::vector<uint8_t> batch;
+    uint16_t batch_len = 0;
+    uint16_t batch_msgs = 0;
+    struct timeval batch_start;
+
+    // a peer running another version is only reported once
+    bool version_warned = false;
 };
 
 // Top level management of HighAvailability components.
@@ -165,7 +202,11 @@ public:
     static void pre_config_init();
 
     // Invoked by the module configuration parsing to create HA instance
-    static bool instantiate(PortBitSet*,bool,struct timeval*,struct timeval*);
+    // batch_size is the most bytes of HA messages packed into one side
+    // channel message (0 to send each on its own) and batch_delay is
+    // the longest a staged message waits for company
+    static bool instantiate(PortBitSet*,bool,struct timeval*,struct timeval*,
+        uint16_t batch_size, struct timeval* batch_delay);
     static void thread_init();
     static void thread_term_beginning(); // thread is about to be terminated
     static void thread_term();
@@ -179,8 +220,12 @@ public:
     // Anytime a flow is deleted, potentially generate a deletion message
     static void process_deletion(Flow*);
 
-    // Look for and dispatch receive messages.
+    // Look for and dispatch receive messages.  Also transmits staged
+    // messages once batch_delay has elapsed.
     static void process_receive();
+
+    // Transmit staged messages regardless of age; e.g. when idle.
+    static void flush();
     static void set_modified(Flow*);
     static bool in_standby(Flow*);
 
@@ -189,6 +234,10 @@ private:
     static bool use_daq_channel;
     static PortBitSet* ports;
     static bool shutting_down;
+
+    friend class HighAvailability;
+    static uint16_t batch_size;
+    static struct timeval batch_delay;
 };
 #endif
 
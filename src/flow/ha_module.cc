@@ -21,6 +21,8 @@
 #include "ha_module.h"
 
 #include <cmath>
+#include <string>
+#include <vector>
 
 #include "ha.h"
 #include "log/messages.h"
@@ -29,10 +31,18 @@
 
 static const PegInfo ha_pegs[] =
 {
+    { "msgs sent", "HA messages sent" },
+    { "batches sent", "side channel messages sent" },
+    { "full flushes", "batches sent because the next message didn't fit" },
+    { "timed flushes", "batches sent because batch_delay elapsed" },
+    { "batch delay usec", "total time messages waited in batches" },
+    { "msgs received", "HA messages received" },
+    { "batches received", "side channel messages received" },
+    { "bad batches", "side channel messages with malformed HA messages" },
     { nullptr, nullptr }
 };
 
-extern THREAD_LOCAL SimpleStats ha_stats;
+extern THREAD_LOCAL HAStats ha_stats;
 extern THREAD_LOCAL ProfileStats ha_perf_stats;
 
 //-------------------------------------------------------------------------
@@ -56,6 +66,12 @@ static const Parameter ha_params[] =
     { "min_sync", Parameter::PT_REAL, "0.0:100.0", "1.0",
       "minimum interval between HA updates" },
 
+    { "batch_size", Parameter::PT_INT, "0:65535", "1400",
+      "maximum bytes of HA messages packed into one side channel message; 0 disables batching" },
+
+    { "batch_delay", Parameter::PT_REAL, "0.0:1.0", "0.001",
+      "maximum time in seconds an HA message waits to be batched" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -76,6 +92,8 @@ HighAvailabilityModule::HighAvailabilityModule() :
     config.ports = nullptr;
     convert_real_seconds_to_timeval(1.0, &config.min_session_lifetime);
     convert_real_seconds_to_timeval(0.1, &config.min_sync_interval);
+    config.batch_size = 1400;
+    convert_real_seconds_to_timeval(0.001, &config.batch_delay);
 }
 
 HighAvailabilityModule::~HighAvailabilityModule()
@@ -115,6 +133,14 @@ bool HighAvailabilityModule::set(const char* fqn, Value& v, SnortConfig*)
     {
         convert_real_seconds_to_timeval(v.get_real(), &config.min_sync_interval);
     }
+    else if ( v.is("batch_size") )
+    {
+        config.batch_size = v.get_long();
+    }
+    else if ( v.is("batch_delay") )
+    {
+        convert_real_seconds_to_timeval(v.get_real(), &config.batch_delay);
+    }
     else
         return false;
 
@@ -144,7 +170,8 @@ bool HighAvailabilityModule::end(const char* fqn, int idx, SnortConfig*)
 
     if ( config.enabled &&
         !HighAvailabilityManager::instantiate(config.ports, config.daq_channel,
-                        &config.min_session_lifetime, &config.min_sync_interval) )
+                        &config.min_session_lifetime, &config.min_sync_interval,
+                        config.batch_size, &config.batch_delay) )
     {
         ParseWarning(WARN_CONF, "Illegal HighAvailability configuration");
         return false;
@@ -153,8 +180,48 @@ bool HighAvailabilityModule::end(const char* fqn, int idx, SnortConfig*)
     return true;
 }
 
+// the per client byte counts follow the fixed pegs in HAStats; their
+// names are built from the client index so they track MAX_CLIENTS
+static std::vector<std::string> ha_peg_text;
+static std::vector<PegInfo> ha_peg_names;
+
+static void add_client_pegs(const char* dir)
+{
+    for ( unsigned i = 0; i < MAX_CLIENTS; ++i )
+    {
+        bool session = (i == SESSION_HA_CLIENT_INDEX);
+        std::string name = session ? "session" : "client " + std::to_string(i);
+        std::string help = session ? "session client" : name;
+
+        ha_peg_text.push_back(name + " bytes " + dir);
+        ha_peg_text.push_back(help + " bytes " + dir);
+    }
+}
+
 const PegInfo* HighAvailabilityModule::get_pegs() const
-{ return ha_pegs; }
+{
+    if ( ha_peg_names.size() )
+        return &ha_peg_names[0];
+
+    const PegInfo* p = ha_pegs;
+
+    while ( p->name )
+        ha_peg_names.push_back(*p++);
+
+    static_assert(sizeof(HAStats) / sizeof(PegCount) == array_size(ha_pegs) - 1 + 2 * MAX_CLIENTS,
+        "HAStats and ha_pegs are out of sync");
+
+    // text first so the c_str()s below stay put
+    ha_peg_text.reserve(4 * MAX_CLIENTS);
+    add_client_pegs("sent");
+    add_client_pegs("received");
+
+    for ( unsigned i = 0; i < ha_peg_text.size(); i += 2 )
+        ha_peg_names.push_back({ ha_peg_text[i].c_str(), ha_peg_text[i+1].c_str() });
+
+    ha_peg_names.push_back(*p);
+    return &ha_peg_names[0];
+}
 
 PegCount* HighAvailabilityModule::get_counts() const
 { return (PegCount*)&ha_stats; }
@@ -34,9 +34,11 @@ struct HighAvailabilityConfig
     PortBitSet* ports = nullptr;
     struct timeval min_session_lifetime;
     struct timeval min_sync_interval;
+    uint16_t batch_size;
+    struct timeval batch_delay;
 };
 
-extern THREAD_LOCAL SimpleStats ha_stats;
+extern THREAD_LOCAL struct HAStats ha_stats;
 extern THREAD_LOCAL ProfileStats ha_perf_stats;
 
 class HighAvailabilityModule : public Module
@@ -0,0 +1,202 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// flow_test.cc
+// unit test main and FlowData lookup benchmark
+
+#include "flow/flow.h"
+
+#include <chrono>
+#include <stdio.h>
+
+#include "flow/ha.h"
+#include "framework/inspector.h"
+#include "protocols/layer.h"
+#include "time/stopwatch.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+//-------------------------------------------------------------------------
+// stubs
+//-------------------------------------------------------------------------
+
+unsigned THREAD_LOCAL Inspector::slot = 0;
+
+bool HighAvailabilityManager::active() { return false; }
+FlowHAState::FlowHAState() { }
+void FlowHAState::reset() { }
+
+namespace ip
+{
+uint8_t IpApi::ttl() const { return 0; }
+}
+
+namespace layer
+{
+bool set_outer_ip_api(const Packet* const, ip::IpApi&, int8_t&) { return false; }
+const Layer* get_mpls_layer(const Packet* const) { return nullptr; }
+}
+
+//-------------------------------------------------------------------------
+// helpers
+//-------------------------------------------------------------------------
+
+#define MAX_TEST_ID (FLOW_DATA_SLOTS + 8)
+
+class TestFlowData : public FlowData
+{
+public:
+    TestFlowData(unsigned u) : FlowData(u) { ++live; }
+    ~TestFlowData() { --live; }
+
+    static unsigned live;
+};
+
+unsigned TestFlowData::live = 0;
+
+//-------------------------------------------------------------------------
+// tests
+//-------------------------------------------------------------------------
+
+TEST_GROUP(flow_data)
+{
+    Flow* flow;
+
+    void setup()
+    {
+        flow = new Flow;
+        TestFlowData::live = 0;
+    }
+
+    void teardown()
+    {
+        flow->free_flow_data();
+        CHECK(TestFlowData::live == 0);
+        delete flow;
+    }
+};
+
+// ids on both sides of the slot table
+TEST(flow_data, set_get)
+{
+    TestFlowData* fd[MAX_TEST_ID + 1] = { };
+
+    for ( unsigned id = 1; id <= MAX_TEST_ID; ++id )
+    {
+        fd[id] = new TestFlowData(id);
+        flow->set_flow_data(fd[id]);
+    }
+
+    for ( unsigned id = 1; id <= MAX_TEST_ID; ++id )
+        POINTERS_EQUAL(fd[id], flow->get_flow_data(id));
+
+    POINTERS_EQUAL(nullptr, flow->get_flow_data(MAX_TEST_ID + 1));
+    CHECK(TestFlowData::live == MAX_TEST_ID);
+}
+
+// setting the same id again replaces and frees the old data
+TEST(flow_data, replace)
+{
+    unsigned ids[] = { 1, FLOW_DATA_SLOTS, FLOW_DATA_SLOTS + 1 };
+
+    for ( auto id : ids )
+    {
+        flow->set_flow_data(new TestFlowData(id));
+        TestFlowData* fd = new TestFlowData(id);
+        flow->set_flow_data(fd);
+        POINTERS_EQUAL(fd, flow->get_flow_data(id));
+    }
+    CHECK(TestFlowData::live == 3);
+}
+
+TEST(flow_data, free_one)
+{
+    for ( unsigned id = 1; id <= MAX_TEST_ID; ++id )
+        flow->set_flow_data(new TestFlowData(id));
+
+    flow->free_flow_data(2u);
+    flow->free_flow_data((uint32_t)FLOW_DATA_SLOTS + 2);
+
+    POINTERS_EQUAL(nullptr, flow->get_flow_data(2));
+    POINTERS_EQUAL(nullptr, flow->get_flow_data(FLOW_DATA_SLOTS + 2));
+    CHECK(flow->get_flow_data(3) != nullptr);
+    CHECK(flow->get_flow_data(FLOW_DATA_SLOTS + 3) != nullptr);
+    CHECK(TestFlowData::live == MAX_TEST_ID - 2);
+}
+
+TEST(flow_data, free_all)
+{
+    for ( unsigned id = 1; id <= MAX_TEST_ID; ++id )
+        flow->set_flow_data(new TestFlowData(id));
+
+    flow->free_flow_data();
+
+    for ( unsigned id = 1; id <= MAX_TEST_ID; ++id )
+        POINTERS_EQUAL(nullptr, flow->get_flow_data(id));
+
+    CHECK(TestFlowData::live == 0);
+}
+
+//-------------------------------------------------------------------------
+// benchmark; ignored by default, run with -ri
+//-------------------------------------------------------------------------
+
+TEST_GROUP(flow_data_perf) { };
+
+IGNORE_TEST(flow_data_perf, lookup)
+{
+    const unsigned iterations = 10000000;
+    const unsigned num_ids = 8;
+
+    Flow flow;
+    unsigned hits = 0;
+
+    // a typical mix: most inspectors in the slot table and a couple past it
+    unsigned ids[num_ids] = { 1, 2, 3, 5, 8, 13, FLOW_DATA_SLOTS + 1, FLOW_DATA_SLOTS + 4 };
+
+    for ( auto id : ids )
+        flow.set_flow_data(new TestFlowData(id));
+
+    Stopwatch<std::chrono::steady_clock> sw;
+    sw.start();
+
+    for ( unsigned i = 0; i < iterations; ++i )
+        hits += flow.get_flow_data(ids[i % num_ids]) != nullptr;
+
+    sw.stop();
+    flow.free_flow_data();
+
+    CHECK(hits == iterations);
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+
+    printf("\nsizeof(Flow) = %zu (%zu for FlowData slots)\n",
+        sizeof(Flow), sizeof(flow.flow_data_slots));
+    printf("get_flow_data: %.2f ns per lookup\n", (double)ns / iterations);
+}
+
+//-------------------------------------------------------------------------
+// main
+//-------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
@@ -31,7 +31,7 @@
 
 void LogMessage(const char*,...) { }
 
-THREAD_LOCAL SimpleStats ha_stats;
+THREAD_LOCAL HAStats ha_stats;
 THREAD_LOCAL ProfileStats ha_perf_stats;
 
 void show_stats(PegCount*, const PegInfo*, unsigned, const char*) { }
@@ -59,7 +59,8 @@ static char* make_bit_string(int bit)
     return bit_string;
 }
 
-bool HighAvailabilityManager::instantiate(PortBitSet* mod_ports, bool mod_use_daq_channel, struct timeval*, struct timeval*)
+bool HighAvailabilityManager::instantiate(PortBitSet* mod_ports, bool mod_use_daq_channel, struct timeval*, struct timeval*,
+    uint16_t, struct timeval*)
 {
     s_instantiate_called = true;
     s_port_1_set = mod_ports->test(1);
@@ -22,13 +22,14 @@
 #include "flow/ha.h"
 
 #include "flow/flow.h"
+#include "flow/ha_module.h"
 #include "main/snort_debug.h"
 #include "stream/stream.h"
 
 #include <CppUTest/CommandLineTestRunner.h>
 #include <CppUTest/TestHarness.h>
 
-#define MSG_SIZE 100
+#define MSG_SIZE 256
 #define TEST_KEY 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47
 
 class StreamHAClient;
@@ -38,20 +39,21 @@ static const uint8_t s_test_key[] =
 TEST_KEY
 };
 
-static const uint8_t s_delete_message[] =
+// total_length is in host order; see set_total_length()
+static uint8_t s_delete_message[] =
 {
     0x01,
-    0x03,
+    0x04,
     0x00,
     0x00,
     0x01,
 TEST_KEY
 };
 
-static const uint8_t s_update_stream_message[] =
+static uint8_t s_update_stream_message[] =
 {
     0x02,
-    0x03,
+    0x04,
     0x00,
     0x00,
     0x01,
@@ -83,6 +85,10 @@ static StreamHAClient* s_ha_client;
 static FlowHAClient* s_other_ha_client;
 static std::function<void (SCMessage*)> s_handler = nullptr;
 static SCMsgHdr s_sc_header = { 0, 1, 0, 0, };
+static unsigned s_transmit_count = 0;
+
+static void set_total_length(uint8_t* msg, uint16_t len)
+{ ((HAMessageHeader*)msg)->total_length = len; }
 
 class StreamHAClient : public FlowHAClient
 {
@@ -145,7 +151,8 @@ void Stream::delete_flow(const FlowKey* flowkey)
     s_delete_session_called = true;
 }
 
-void ErrorMessage(const char*,...) { }
+static unsigned s_error_count = 0;
+void ErrorMessage(const char*,...) { s_error_count++; }
 void LogMessage(const char*,...) { }
 
 void Debug::print(const char*, int, uint64_t, const char*, ...) { }
@@ -196,6 +203,7 @@ bool SideChannel::process(int)
 bool SideChannel::transmit_message(SCMessage* msg)
 {
     s_transmit_message_called = true;
+    s_transmit_count++;
     s_message_content = msg->content;
     s_message_length = msg->content_length;
     return true; }
@@ -239,7 +247,7 @@ TEST(high_availability_manager_test, inst_init_term)
     port_set.set(1);
     struct timeval age = { 1, 0 };
     struct timeval interval = { 0, 500000 };
-    HighAvailabilityManager::instantiate(&port_set, false, &age, &interval);
+    HighAvailabilityManager::instantiate(&port_set, false, &age, &interval, 0, &age);
     HighAvailabilityManager::thread_init();
     s_ha_client = new StreamHAClient;
     CHECK(HighAvailabilityManager::active()==true);
@@ -321,7 +329,7 @@ TEST_GROUP(high_availability_test)
         port_set.set(1);
         struct timeval age = { 1, 0 };
         struct timeval interval = { 0, 500000 };
-        HighAvailabilityManager::instantiate(&port_set, false, &age, &interval);
+        HighAvailabilityManager::instantiate(&port_set, false, &age, &interval, 0, &age);
         HighAvailabilityManager::thread_init();
         s_ha_client = new StreamHAClient;
         s_other_ha_client = new OtherHAClient;
@@ -348,6 +356,7 @@ TEST(high_availability_test, receive_deletion)
 
 TEST(high_availability_test, receive_update_stream_only)
 {
+    set_total_length(s_update_stream_message, 12);
     s_stream_consume_called = false;
     s_message_content = (uint8_t*)s_update_stream_message;
     s_message_length = sizeof(s_update_stream_message);
@@ -392,6 +401,182 @@ TEST(high_availability_test, transmit_update_both_update)
     CHECK(s_transmit_message_called == true);
 }
 
+// messages are staged up to batch_size bytes or batch_delay
+TEST_GROUP(high_availability_batch_test)
+{
+    void setup()
+    {
+        MemoryLeakWarningPlugin::turnOffNewDeleteOverloads();
+        HighAvailabilityManager::pre_config_init();
+        PortBitSet port_set;
+        port_set.set(1);
+        struct timeval age = { 1, 0 };
+        struct timeval interval = { 0, 500000 };
+        struct timeval delay = { 0, 1000 };
+        HighAvailabilityManager::instantiate(&port_set, false, &age, &interval, 3 * 53, &delay);
+        HighAvailabilityManager::thread_init();
+        s_ha_client = new StreamHAClient;
+        memset(&ha_stats, 0, sizeof(ha_stats));
+        s_message_content = nullptr;
+        s_message_length = 0;
+        s_transmit_count = 0;
+        s_packet_time.tv_sec = 100;
+        s_packet_time.tv_usec = 0;
+    }
+
+    void teardown()
+    {
+        delete s_ha_client;
+        HighAvailabilityManager::thread_term();
+        MemoryLeakWarningPlugin::turnOnNewDeleteOverloads();
+    }
+};
+
+TEST(high_availability_batch_test, transmit_full_and_timed)
+{
+    Flow flows[4];
+
+    for ( auto& f : flows )
+        f.ha_state->clear(FlowHAState::NEW);
+
+    // three 53 byte deletions fill the batch
+    for ( int i = 0; i < 3; i++ )
+        HighAvailabilityManager::process_deletion(&flows[i]);
+
+    HighAvailabilityManager::process_receive();
+    CHECK(s_transmit_count == 0);
+
+    HighAvailabilityManager::process_deletion(&flows[3]);
+    CHECK(s_transmit_count == 1);
+    CHECK(s_message_length == 3 * 53);
+    CHECK(ha_stats.full_flushes == 1);
+
+    s_message_content = nullptr;
+    s_packet_time.tv_usec = 999;
+    HighAvailabilityManager::process_receive();
+    CHECK(s_transmit_count == 1);
+
+    s_packet_time.tv_usec = 1000;
+    HighAvailabilityManager::process_receive();
+    CHECK(s_transmit_count == 2);
+    CHECK(s_message_length == 53);
+    CHECK(ha_stats.timed_flushes == 1);
+
+    CHECK(ha_stats.msgs_sent == 4);
+    CHECK(ha_stats.batches_sent == 2);
+    CHECK(ha_stats.batch_delay_usec == 1000);
+}
+
+// updates and deletions stay in order across a flush
+TEST(high_availability_batch_test, transmit_update_then_flush)
+{
+    Flow flow;
+    flow.ha_state->clear(FlowHAState::NEW);
+
+    s_stream_update_required = true;
+    s_other_update_required = false;
+    HighAvailabilityManager::process_update(&flow, &s_pkthdr);
+    HighAvailabilityManager::process_deletion(&flow);
+    CHECK(s_transmit_count == 0);
+
+    HighAvailabilityManager::flush();
+    CHECK(s_transmit_count == 1);
+    CHECK(s_message_length == 65 + 53);
+    CHECK(s_message_content[0] == HA_UPDATE_EVENT);
+    CHECK(s_message_content[65] == HA_DELETE_EVENT);
+    CHECK(ha_stats.client_bytes_sent[0] == 12);
+    CHECK(ha_stats.client_bytes_received[0] == 0);
+
+    HighAvailabilityManager::flush();
+    CHECK(s_transmit_count == 1);
+}
+
+// ip4 keys are sent whole so the receiver can still walk the batch
+TEST(high_availability_batch_test, transmit_ip4_key)
+{
+    Flow flows[2];
+    FlowKey keys[2];
+
+    memset(keys, 0, sizeof(keys));
+    keys[0].ip_l[2] = keys[0].ip_h[2] = htonl(0xFFFF);
+    keys[0].ip_l[3] = htonl(0x0a000001);
+    keys[0].ip_h[3] = htonl(0x0a000002);
+    keys[1].ip_l[3] = keys[1].ip_h[3] = 1;
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        flows[i].ha_state->clear(FlowHAState::NEW);
+        flows[i].key = &keys[i];
+    }
+
+    HighAvailabilityManager::process_deletion(&flows[0]);
+    HighAvailabilityManager::process_deletion(&flows[1]);
+    HighAvailabilityManager::flush();
+
+    CHECK(s_transmit_count == 1);
+    CHECK(s_message_length == 2 * 53);
+    CHECK(s_message_content[4] == s_message_content[53 + 4]);
+
+    HighAvailabilityManager::process_receive();
+
+    CHECK(ha_stats.msgs_received == 2);
+    CHECK(ha_stats.bad_batches == 0);
+    CHECK(memcmp(&s_flowkey, &keys[1], sizeof(s_flowkey)) == 0);
+}
+
+TEST(high_availability_batch_test, receive_batch)
+{
+    uint8_t batch[sizeof(s_update_stream_message) + sizeof(s_delete_message) + 1];
+
+    set_total_length(s_update_stream_message, 12);
+    memcpy(batch, s_update_stream_message, sizeof(s_update_stream_message));
+    memcpy(batch + sizeof(s_update_stream_message), s_delete_message, sizeof(s_delete_message));
+
+    s_stream_consume_called = false;
+    s_delete_session_called = false;
+    s_message_content = batch;
+    s_message_length = sizeof(batch) - 1;
+    HighAvailabilityManager::process_receive();
+
+    CHECK(s_stream_consume_called == true);
+    CHECK(s_delete_session_called == true);
+    CHECK(ha_stats.msgs_received == 2);
+    CHECK(ha_stats.batches_received == 1);
+    CHECK(ha_stats.bad_batches == 0);
+
+    // a trailing partial message is dropped
+    s_delete_session_called = false;
+    s_message_length = sizeof(batch);
+    HighAvailabilityManager::process_receive();
+
+    CHECK(s_delete_session_called == true);
+    CHECK(ha_stats.msgs_received == 4);
+    CHECK(ha_stats.bad_batches == 1);
+    CHECK(ha_stats.client_bytes_received[0] != 0);
+    CHECK(ha_stats.client_bytes_sent[0] == 0);
+}
+
+// a peer running another version is counted every time but logged once
+TEST(high_availability_batch_test, receive_other_version)
+{
+    uint8_t msg[sizeof(s_delete_message)];
+    memcpy(msg, s_delete_message, sizeof(msg));
+    msg[1]++;  // version
+
+    s_delete_session_called = false;
+    s_message_content = msg;
+    s_message_length = sizeof(msg);
+    s_error_count = 0;
+
+    HighAvailabilityManager::process_receive();
+    HighAvailabilityManager::process_receive();
+
+    CHECK(s_delete_session_called == false);
+    CHECK(ha_stats.msgs_received == 0);
+    CHECK(ha_stats.bad_batches == 2);
+    CHECK(s_error_count == 1);
+}
+
 int main(int argc, char** argv)
 {
     return CommandLineTestRunner::RunAllTests(argc, argv);
@@ -30,7 +30,7 @@
 #include "framework/base_api.h"
 
 // this is the current version of the api
-#define CONNECTOR_API_VERSION ((BASE_API_VERSION << 16) | 0)
+#define CONNECTOR_API_VERSION ((BASE_API_VERSION << 16) | 1)
 
 //-------------------------------------------------------------------------
 // api for class
@@ -68,6 +68,18 @@ public:
     virtual void discard_message(ConnectorMsgHandle*) = 0;
     virtual bool transmit_message(ConnectorMsgHandle*) = 0;
     virtual ConnectorMsgHandle* receive_message(bool block) = 0;
+
+    // get up to max messages without blocking; returns the number received
+    virtual unsigned receive_messages(ConnectorMsgHandle** handles, unsigned max)
+    {
+        unsigned n = 0;
+
+        while ( n < max and (handles[n] = receive_message(false)) )
+            ++n;
+
+        return n;
+    }
+
     virtual ConnectorMsg* get_connector_msg(ConnectorMsgHandle*) = 0;
     virtual Direction get_connector_direction() = 0;
 
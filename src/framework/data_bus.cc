@@ -51,43 +51,231 @@ private:
     const Packet* packet;
 };
 
+//-------------------------------------------------------------------------
+// event id registry
+//-------------------------------------------------------------------------
+
+// shared by all buses so a given name has the same id everywhere; only
+// touched while configuring so no locking is needed
+static std::vector<std::string> event_names { PACKET_EVENT, FILE_EVENT };
+static DataIdMap event_ids { { PACKET_EVENT, PACKET_EVENT_ID }, { FILE_EVENT, FILE_EVENT_ID } };
+
+unsigned DataBus::get_id(const char* key)
+{
+    auto it = event_ids.find(key);
+
+    if ( it != event_ids.end() )
+        return it->second;
+
+    unsigned id = event_names.size();
+    event_names.push_back(key);
+    event_ids[key] = id;
+    return id;
+}
+
+//-------------------------------------------------------------------------
+// bus
+//-------------------------------------------------------------------------
+
 DataBus::DataBus() { }
 
 DataBus::~DataBus()
 {
-    for ( auto& p : map )
-        for ( auto* h : p.second )
+    for ( auto& v : lists )
+        for ( auto* h : v )
             delete h;
 }
 
 // add handler to list of handlers to be notified upon
 // publication of given event
-void DataBus::subscribe(const char* key, DataHandler* h)
+void DataBus::subscribe(unsigned id, DataHandler* h)
 {
-    DataList& v = map[key];
-    v.push_back(h);
+    if ( id >= lists.size() )
+        lists.resize(id + 1);
+
+    lists[id].push_back(h);
+
+    if ( id < event_names.size() )
+        ids[event_names[id]] = id;
 }
 
 // notify subscribers of event
-void DataBus::publish(const char* key, DataEvent& e, Flow* f)
+void DataBus::publish(unsigned id, DataEvent& e, Flow* f)
 {
-    DataList& v = map[key];
+    if ( id >= lists.size() )
+        return;
 
-    for ( auto* h : v )
+    for ( auto* h : lists[id] )
         h->handle(e, f);
 }
 
-void DataBus::publish(const char* key, const uint8_t* buf, unsigned len, Flow* f)
+void DataBus::publish(unsigned id, const uint8_t* buf, unsigned len, Flow* f)
 {
+    if ( id >= lists.size() or lists[id].empty() )
+        return;
+
     BufferEvent e(buf, len);
-    publish(key, e, f);
+    publish(id, e, f);
 }
 
-void DataBus::publish(const char* key, Packet* p, Flow* f)
+void DataBus::publish(unsigned id, Packet* p, Flow* f)
 {
+    if ( id >= lists.size() or lists[id].empty() )
+        return;
+
     PacketEvent e(p);
     if ( !f )
         f = p->flow;
-    publish(key, e, f);
+    publish(id, e, f);
+}
+
+//-------------------------------------------------------------------------
+// by name
+//-------------------------------------------------------------------------
+
+// publishing by name must not modify the registry since it runs on the
+// packet threads; names that were never subscribed have no handlers
+bool DataBus::find_id(const char* key, unsigned& id) const
+{
+    auto it = ids.find(key);
+
+    if ( it == ids.end() )
+        return false;
+
+    id = it->second;
+    return true;
+}
+
+void DataBus::subscribe(const char* key, DataHandler* h)
+{
+    subscribe(get_id(key), h);
+}
+
+void DataBus::publish(const char* key, DataEvent& e, Flow* f)
+{
+    unsigned id;
+
+    if ( find_id(key, id) )
+        publish(id, e, f);
+}
+
+void DataBus::publish(const char* key, const uint8_t* buf, unsigned len, Flow* f)
+{
+    unsigned id;
+
+    if ( find_id(key, id) )
+        publish(id, buf, len, f);
+}
+
+void DataBus::publish(const char* key, Packet* p, Flow* f)
+{
+    unsigned id;
+
+    if ( find_id(key, id) )
+        publish(id, p, f);
+}
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+#include <chrono>
+
+#include "catch/catch.hpp"
+#include "time/stopwatch.h"
+
+class CountHandler : public DataHandler
+{
+public:
+    CountHandler(unsigned& n) : count(n) { }
+
+    void handle(DataEvent& e, Flow*) override
+    {
+        unsigned len;
+        if ( e.get_data(len) )
+            count += len;
+        else
+            ++count;
+    }
+
+private:
+    unsigned& count;
+};
+
+TEST_CASE("data bus builtin ids", "[data_bus]")
+{
+    CHECK(DataBus::get_id(PACKET_EVENT) == PACKET_EVENT_ID);
+    CHECK(DataBus::get_id(FILE_EVENT) == FILE_EVENT_ID);
+
+    unsigned a = DataBus::get_id("data_bus.test.a");
+    CHECK(a >= MAX_BUILTIN_EVENT_ID);
+    CHECK(DataBus::get_id("data_bus.test.a") == a);
+    CHECK(DataBus::get_id("data_bus.test.b") != a);
+}
+
+TEST_CASE("data bus publish by id and name", "[data_bus]")
+{
+    unsigned a = 0, b = 0;
+    unsigned id_a = DataBus::get_id("data_bus.test.a");
+
+    DataBus bus;
+    bus.subscribe(id_a, new CountHandler(a));
+    bus.subscribe("data_bus.test.b", new CountHandler(b));
+
+    uint8_t buf[8] = { };
+
+    bus.publish(id_a, buf, 3);
+    CHECK(a == 3);
+
+    bus.publish("data_bus.test.a", buf, 2);
+    CHECK(a == 5);
+
+    bus.publish(DataBus::get_id("data_bus.test.b"), buf, 4);
+    CHECK(b == 4);
+
+    // no subscribers
+    bus.publish("data_bus.test.none", buf, 4);
+    bus.publish(DataBus::get_id("data_bus.test.none") + 100, buf, 4);
+    CHECK(a == 5);
+    CHECK(b == 4);
 }
 
+TEST_CASE("data bus publish cost", "[.perf][data_bus]")
+{
+    const unsigned iterations = 10000000;
+    unsigned n = 0;
+    unsigned id = DataBus::get_id("data_bus.perf");
+
+    DataBus bus;
+    bus.subscribe(id, new CountHandler(n));
+
+    for ( unsigned i = 0; i < 16; ++i )
+        bus.subscribe(DataBus::get_id(("data_bus.perf." + std::to_string(i)).c_str()),
+            new CountHandler(n));
+
+    uint8_t buf[1] = { };
+    Stopwatch<std::chrono::steady_clock> sw;
+
+    sw.start();
+    for ( unsigned i = 0; i < iterations; ++i )
+        bus.publish(id, buf, 1);
+    sw.stop();
+    auto by_id = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+
+    sw.reset();
+    sw.start();
+    for ( unsigned i = 0; i < iterations; ++i )
+        bus.publish("data_bus.perf", buf, 1);
+    sw.stop();
+    auto by_name = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+
+    CHECK(n == 2 * iterations);
+
+    WARN("publish by id: " << by_id / iterations << " ns, by name: " <<
+        by_name / iterations << " ns");
+}
+
+#endif
+
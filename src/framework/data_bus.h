@@ -27,13 +27,18 @@
 // at arbitrary points, eg when service is identified, or when a URI is
 // available, or when a flow clears.
 
-#include <map>
+// Event names are interned into small integer ids so that publishing is
+// just an index into a flat array of handler lists.  Well known events
+// have fixed ids defined below; any other name gets the next free id when
+// first subscribed or looked up with get_id().  Ids are assigned while
+// configuring and are the same for every DataBus.
+
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-// FIXIT-P evaluate perf; focus is on correctness
 typedef std::vector<class DataHandler*> DataList;
-typedef std::map<std::string, DataList> DataMap;
+typedef std::unordered_map<std::string, unsigned> DataIdMap;
 
 #include "main/snort_types.h"
 
@@ -69,29 +74,52 @@ protected:
     DataHandler() { }
 };
 
+// common data events
+#define PACKET_EVENT "detection.packet"
+#define FILE_EVENT "file_event"
+
+// ids of the common data events; these must match the order of the names
+// in the registry in data_bus.cc
+enum DataEventId
+{
+    PACKET_EVENT_ID,
+    FILE_EVENT_ID,
+    MAX_BUILTIN_EVENT_ID
+};
+
 class SO_PUBLIC DataBus
 {
 public:
     DataBus();
     ~DataBus();
 
-    void subscribe(const char* key, DataHandler*);
-    void publish(const char* key, DataEvent&, Flow* = nullptr);
+    // map an event name to its id, assigning a new one if needed; only
+    // call this while configuring
+    static unsigned get_id(const char* key);
+
+    void subscribe(unsigned id, DataHandler*);
+    void publish(unsigned id, DataEvent&, Flow* = nullptr);
 
     // convenience methods
+    void publish(unsigned id, const uint8_t*, unsigned, Flow* = nullptr);
+    void publish(unsigned id, Packet*, Flow* = nullptr);
+
+    // by name, for compatibility; these look up the id on each call
+    void subscribe(const char* key, DataHandler*);
+    void publish(const char* key, DataEvent&, Flow* = nullptr);
     void publish(const char* key, const uint8_t*, unsigned, Flow* = nullptr);
     void publish(const char* key, Packet*, Flow* = nullptr);
 
 private:
-    DataMap map;
+    bool find_id(const char* key, unsigned& id) const;
+
+    std::vector<DataList> lists;  // indexed by event id
+    DataIdMap ids;                // names subscribed on this bus
 };
 
 // FIXIT-L this should be in snort_confg.h or similar but that
 // requires refactoring to work as installed header
 SO_PUBLIC DataBus& get_data_bus();
 
-// common data events
-#define PACKET_EVENT "detection.packet"
-
 #endif
 
@@ -0,0 +1,390 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// lru_cache_sharded.h
+
+#ifndef LRU_CACHE_SHARDED_H
+#define LRU_CACHE_SHARDED_H
+
+// LruCacheSharded -- A concurrent drop-in for LruCacheShared.  Keys are
+// spread over num_shards independently locked shards by hash so threads
+// working on different keys rarely meet on a lock.  Within a shard,
+// recency is approximated with CLOCK: find() only sets a referenced bit
+// instead of moving the entry to the front of a list, and eviction skips
+// (and clears) referenced entries.  Hot entries therefore cost a lock and
+// a read, not a list splice.
+//
+// Differences from LruCacheShared:
+// -- each shard holds at most ceil(max_size / num_shards) entries, so the
+//    cache may hold up to num_shards - 1 entries more than max_size and
+//    may evict before max_size is reached if keys hash unevenly
+// -- eviction order is approximately, not strictly, least recently used
+// -- get_all_data() returns entries shard by shard, most recently
+//    inserted first
+
+#include <stdint.h>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "hash/lru_cache_shared.h"
+
+template<typename Key, typename Data, typename Hash, unsigned num_shards = 16>
+class LruCacheSharded
+{
+public:
+    LruCacheSharded() = delete;
+    LruCacheSharded(const LruCacheSharded& arg) = delete;
+    LruCacheSharded& operator=(const LruCacheSharded& arg) = delete;
+
+    LruCacheSharded(const size_t initial_size)
+    {
+        static_assert(num_shards > 0, "need at least one shard");
+
+        //  Eviction needs an entry to evict so shards hold at least one.
+        max_size = initial_size ? initial_size : 1;
+
+        //  Size each shard's buckets up front so inserts up to the initial
+        //  size never rehash under the shard lock.
+        for ( auto& s : shards )
+        {
+            s.max_size = shard_size(max_size);
+            s.map.reserve(s.max_size);
+        }
+    }
+
+    //  Get current number of elements in the cache.
+    size_t size()
+    {
+        size_t n = 0;
+
+        for ( auto& s : shards )
+        {
+            std::lock_guard<std::mutex> shard_lock(s.mutex);
+            n += s.current_size;
+        }
+        return n;
+    }
+
+    size_t get_max_size()
+    {
+        std::lock_guard<std::mutex> size_lock(size_mutex);
+        return max_size;
+    }
+
+    //  Modify the maximum number of entries allowed in the cache.
+    //  If the size is reduced, entries are evicted.
+    bool set_max_size(size_t newsize);
+
+    //  Add data to cache or replace data if it already exists.
+    void insert(const Key& key, const Data& data);
+
+    //  Find Data associated with Key.  If update is true, mark entry as
+    //  recently used.
+    //  Returns true and copies data if the key is found.
+    bool find(const Key& key, Data& data, bool update=true);
+
+    //  Remove entry associated with Key.
+    //  Returns true if entry existed, false otherwise.
+    bool remove(const Key& key);
+
+    //  Remove entry associated with key and return removed data.
+    bool remove(const Key& key, Data& data);
+
+    //  Remove all elements from the cache.
+    void clear();
+
+    //  Return all data from the cache; see above for order.
+    std::vector<std::pair<Key, Data> > get_all_data();
+
+    const PegInfo* get_pegs() const
+    {
+        return lru_cache_shared_peg_names;
+    }
+
+    //  Sums the shard counts; the result is a snapshot that is only
+    //  rewritten by the next call.
+    PegCount* get_counts() const;
+
+private:
+    struct Entry
+    {
+        Key key;
+        Data data;
+        bool referenced;
+
+        Entry(const Key& k, const Data& d) : key(k), data(d), referenced(false) { }
+    };
+
+    using EntryList = std::list<Entry>;
+    using EntryIter = typename EntryList::iterator;
+    using EntryMap = std::unordered_map<Key, EntryIter, Hash>;
+    using EntryMapIter = typename EntryMap::iterator;
+
+    //  Shards are aligned so that their locks don't share cache lines.
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        size_t max_size = 0;
+        size_t current_size = 0;
+
+        //  Entries in a ring; hand is the next eviction candidate and
+        //  new entries go just behind it.  end() means begin().
+        EntryList list;
+        EntryIter hand = list.end();
+        EntryMap map;
+
+        LruCacheSharedStats stats;
+
+        void advance()
+        {
+            if ( hand == list.end() or ++hand == list.end() )
+                hand = list.begin();
+        }
+
+        void erase(EntryMapIter map_iter)
+        {
+            if ( hand == map_iter->second )
+                advance();
+
+            list.erase(map_iter->second);
+            map.erase(map_iter);
+            current_size--;
+
+            if ( !current_size )
+                hand = list.end();
+        }
+
+        void evict()
+        {
+            if ( hand == list.end() )
+                hand = list.begin();
+
+            while ( hand->referenced )
+            {
+                hand->referenced = false;
+                advance();
+            }
+            erase(map.find(hand->key));
+        }
+    };
+
+    static size_t shard_size(size_t n)
+    { return (n + num_shards - 1) / num_shards; }
+
+    Shard& get_shard(const Key& key)
+    {
+        // mix so that shard selection and the shard's own buckets don't
+        // depend on the same low bits of the hash
+        uint64_t h = Hash()(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return shards[h % num_shards];
+    }
+
+    std::mutex size_mutex;
+    size_t max_size;
+
+    Shard shards[num_shards];
+
+    mutable std::mutex stats_mutex;
+    mutable LruCacheSharedStats stats;
+};
+
+template<typename Key, typename Data, typename Hash, unsigned num_shards>
+bool LruCacheSharded<Key, Data, Hash, num_shards>::set_max_size(size_t newsize)
+{
+    if (newsize <= 0)
+        return false;   //  Not allowed to set size to zero.
+
+    std::lock_guard<std::mutex> size_lock(size_mutex);
+
+    for ( auto& s : shards )
+    {
+        std::lock_guard<std::mutex> shard_lock(s.mutex);
+        s.max_size = shard_size(newsize);
+
+        while ( s.current_size > s.max_size )
+            s.evict();
+    }
+
+    max_size = newsize;
+    return true;
+}
+
+template<typename Key, typename Data, typename Hash, unsigned num_shards>
+void LruCacheSharded<Key, Data, Hash, num_shards>::insert(const Key& key, const Data& data)
+{
+    Shard& s = get_shard(key);
+    std::lock_guard<std::mutex> shard_lock(s.mutex);
+
+    EntryMapIter map_iter = s.map.find(key);
+
+    if ( map_iter != s.map.end() )
+    {
+        //  Replace in place; a replaced entry counts as a reference.
+        map_iter->second->data = data;
+        map_iter->second->referenced = true;
+        s.stats.replaces++;
+        return;
+    }
+    s.stats.adds++;
+
+    if ( s.current_size >= s.max_size )
+    {
+        s.evict();
+        s.stats.prunes++;
+    }
+
+    //  Insert just behind the hand so the new entry is the last one the
+    //  hand reaches.
+    EntryIter pos = (s.hand == s.list.end()) ? s.list.end() : s.hand;
+    EntryIter it = s.list.emplace(pos, key, data);
+    s.map[key] = it;
+    s.current_size++;
+
+    if ( s.hand == s.list.end() )
+        s.hand = it;
+}
+
+template<typename Key, typename Data, typename Hash, unsigned num_shards>
+bool LruCacheSharded<Key, Data, Hash, num_shards>::find(const Key& key, Data& data, bool update)
+{
+    Shard& s = get_shard(key);
+    std::lock_guard<std::mutex> shard_lock(s.mutex);
+
+    EntryMapIter map_iter = s.map.find(key);
+
+    if ( map_iter == s.map.end() )
+    {
+        s.stats.find_misses++;
+        return false;
+    }
+
+    Entry& e = *map_iter->second;
+    data = e.data;
+
+    //  Only write when the bit changes to keep hot entries' lines clean.
+    if ( update and !e.referenced )
+        e.referenced = true;
+
+    s.stats.find_hits++;
+    return true;
+}
+
+template<typename Key, typename Data, typename Hash, unsigned num_shards>
+bool LruCacheSharded<Key, Data, Hash, num_shards>::remove(const Key& key)
+{
+    Shard& s = get_shard(key);
+    std::lock_guard<std::mutex> shard_lock(s.mutex);
+
+    EntryMapIter map_iter = s.map.find(key);
+
+    if ( map_iter == s.map.end() )
+        return false;
+
+    s.erase(map_iter);
+    s.stats.removes++;
+    return true;
+}
+
+template<typename Key, typename Data, typename Hash, unsigned num_shards>
+bool LruCacheSharded<Key, Data, Hash, num_shards>::remove(const Key& key, Data& data)
+{
+    Shard& s = get_shard(key);
+    std::lock_guard<std::mutex> shard_lock(s.mutex);
+
+    EntryMapIter map_iter = s.map.find(key);
+
+    if ( map_iter == s.map.end() )
+        return false;
+
+    data = map_iter->second->data;
+    s.erase(map_iter);
+    s.stats.removes++;
+    return true;
+}
+
+template<typename Key, typename Data, typename Hash, unsigned num_shards>
+void LruCacheSharded<Key, Data, Hash, num_shards>::clear()
+{
+    for ( auto& s : shards )
+    {
+        std::lock_guard<std::mutex> shard_lock(s.mutex);
+        s.map.clear();
+        s.list.clear();
+        s.hand = s.list.end();
+        s.current_size = 0;
+    }
+    std::lock_guard<std::mutex> shard_lock(shards[0].mutex);
+    shards[0].stats.clears++;
+}
+
+template<typename Key, typename Data, typename Hash, unsigned num_shards>
+std::vector<std::pair<Key, Data> > LruCacheSharded<Key, Data, Hash, num_shards>::get_all_data()
+{
+    std::vector<std::pair<Key, Data> > vec;
+
+    for ( auto& s : shards )
+    {
+        std::lock_guard<std::mutex> shard_lock(s.mutex);
+
+        if ( s.list.empty() )
+            continue;
+
+        //  Walk backwards from just behind the hand.
+        EntryIter it = (s.hand == s.list.end()) ? s.list.begin() : s.hand;
+
+        for ( size_t i = 0; i < s.current_size; ++i )
+        {
+            if ( it == s.list.begin() )
+                it = s.list.end();
+            --it;
+            vec.push_back(std::make_pair(it->key, it->data));
+        }
+    }
+    return vec;
+}
+
+template<typename Key, typename Data, typename Hash, unsigned num_shards>
+PegCount* LruCacheSharded<Key, Data, Hash, num_shards>::get_counts() const
+{
+    const unsigned num = sizeof(LruCacheSharedStats) / sizeof(PegCount);
+
+    std::lock_guard<std::mutex> stats_lock(stats_mutex);
+    PegCount* sum = (PegCount*)&stats;
+
+    for ( unsigned i = 0; i < num; ++i )
+        sum[i] = 0;
+
+    for ( auto& s : shards )
+    {
+        std::lock_guard<std::mutex> shard_lock(s.mutex);
+        const PegCount* pc = (const PegCount*)&s.stats;
+
+        for ( unsigned i = 0; i < num; ++i )
+            sum[i] += pc[i];
+    }
+    return sum;
+}
+
+#endif
+
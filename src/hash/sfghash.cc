@@ -101,7 +101,7 @@ SFGHASH* sfghash_new(int nrows, int keysize, int userkeys, SfgHashFree userfree)
 
     SFGHASH* h = (SFGHASH*)snort_calloc(sizeof(SFGHASH));
 
-    h->sfhashfcn = sfhashfcn_new(nrows);
+    h->sfhashfcn = sfhashfcn_new(nrows, keysize);
     h->table = (SFGHASH_NODE**)snort_calloc(nrows, sizeof(SFGHASH_NODE*));
 
     for ( int i = 0; i < nrows; i++ )
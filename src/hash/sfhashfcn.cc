@@ -31,18 +31,32 @@
 
 #include "sfhashfcn.h"
 
+#include <mutex>
+#include <random>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SFHASH_CRC32C_X86
+#include <immintrin.h>
+#endif
+
 #include "sfprimetable.h"
 #include "main/snort_types.h"
 #include "main/snort_config.h"
 
-SFHASHFCN* sfhashfcn_new(int m)
+SFHASHFCN* sfhashfcn_new(int m, int keysize)
 {
     SFHASHFCN* p;
     static int one=1;
+    static std::mt19937_64 gen;
+
+    // packet threads build tables in tinit
+    static std::mutex gen_mutex;
+    std::lock_guard<std::mutex> lock(gen_mutex);
 
     if ( one ) /* one time init */
     {
         srand( (unsigned)time(0) );
+        gen.seed(std::random_device()());
         one = 0;
     }
 
@@ -53,15 +67,19 @@ SFHASHFCN* sfhashfcn_new(int m)
         p->seed     = 3193;
         p->scale    = 719;
         p->hardener = 133824503;
+        p->mix_seed[0] = 0x2d358dccaa6c78a5ull;
+        p->mix_seed[1] = 0x8bb84b93962eacc9ull;
     }
     else
     {
         p->seed     = sf_nearest_prime( (rand()%m)+3191);
         p->scale    = sf_nearest_prime( (rand()%m)+709);
         p->hardener = (rand()*rand()) + 133824503;
+        p->mix_seed[0] = gen();
+        p->mix_seed[1] = gen();
     }
 
-    p->hash_fcn   = &sfhashfcn_hash;
+    p->hash_fcn   = keysize > 0 ? &sfhashfcn_mix : &sfhashfcn_hash;
     p->keycmp_fcn = &memcmp;
 
     return p;
@@ -87,6 +105,152 @@ unsigned sfhashfcn_hash(SFHASHFCN* p, unsigned char* d, int n)
     return hash ^ p->hardener;
 }
 
+//-------------------------------------------------------------------------
+// word wise hashes
+//-------------------------------------------------------------------------
+
+// xxhash64 primes
+#define MIX_P1 0x9e3779b185ebca87ull
+#define MIX_P2 0xc2b2ae3d27d4eb4full
+#define MIX_P3 0x165667b19e3779f9ull
+#define MIX_P4 0x85ebca77c2b2ae63ull
+#define MIX_P5 0x27d4eb2f165667c5ull
+
+static inline uint64_t rotl64(uint64_t x, unsigned k)
+{ return (x << k) | (x >> (64 - k)); }
+
+static inline uint64_t load64(const unsigned char* d)
+{
+    uint64_t v;
+    memcpy(&v, d, sizeof(v));
+    return v;
+}
+
+static inline uint32_t load32(const unsigned char* d)
+{
+    uint32_t v;
+    memcpy(&v, d, sizeof(v));
+    return v;
+}
+
+static inline uint64_t mix_round(uint64_t acc, uint64_t v)
+{
+    acc += v * MIX_P2;
+    acc = rotl64(acc, 31);
+    return acc * MIX_P1;
+}
+
+// two independent lanes take 16 bytes per step; the tail is folded in 8,
+// 4, and 1 byte at a time and the result is avalanched so the low bits
+// used to index power of 2 tables depend on every key bit.
+unsigned sfhashfcn_mix(SFHASHFCN* p, unsigned char* d, int n)
+{
+    const unsigned char* end = d + n;
+    uint64_t a = p->mix_seed[0] + MIX_P1;
+    uint64_t b = p->mix_seed[1] + MIX_P2;
+
+    while ( end - d >= 16 )
+    {
+        a = mix_round(a, load64(d));
+        b = mix_round(b, load64(d + 8));
+        d += 16;
+    }
+
+    uint64_t h = rotl64(a, 1) + rotl64(b, 7) + (uint64_t)n * MIX_P5;
+
+    if ( end - d >= 8 )
+    {
+        h ^= mix_round(0, load64(d));
+        h = rotl64(h, 27) * MIX_P1 + MIX_P4;
+        d += 8;
+    }
+
+    if ( end - d >= 4 )
+    {
+        h ^= (uint64_t)load32(d) * MIX_P1;
+        h = rotl64(h, 23) * MIX_P2 + MIX_P3;
+        d += 4;
+    }
+
+    while ( d < end )
+    {
+        h ^= *d++ * MIX_P5;
+        h = rotl64(h, 11) * MIX_P1;
+    }
+
+    h ^= h >> 33;
+    h *= MIX_P2;
+    h ^= h >> 29;
+    h *= MIX_P3;
+    h ^= h >> 32;
+
+    return (unsigned)h;
+}
+
+#ifdef SFHASH_CRC32C_X86
+// crc32c is linear so the seed doesn't keep an attacker from building
+// colliding keys; use it for tables whose keys aren't under outside
+// control.  the final multiply spreads the crc into the low bits.
+__attribute__((target("sse4.2")))
+static unsigned crc32c_sse42(SFHASHFCN* p, unsigned char* d, int n)
+{
+    const unsigned char* end = d + n;
+    uint64_t crc = p->seed;
+
+    while ( end - d >= 8 )
+    {
+        crc = _mm_crc32_u64(crc, load64(d));
+        d += 8;
+    }
+
+    if ( end - d >= 4 )
+    {
+        crc = _mm_crc32_u32((uint32_t)crc, load32(d));
+        d += 4;
+    }
+
+    while ( d < end )
+        crc = _mm_crc32_u8((uint32_t)crc, *d++);
+
+    return (unsigned)((crc * MIX_P1) >> 32);
+}
+#endif
+
+unsigned sfhashfcn_crc32c(SFHASHFCN* p, unsigned char* d, int n)
+{
+#ifdef SFHASH_CRC32C_X86
+    if ( __builtin_cpu_supports("sse4.2") )
+        return crc32c_sse42(p, d, n);
+#endif
+    return sfhashfcn_mix(p, d, n);
+}
+
+SfHashType sfhashfcn_set_type(SFHASHFCN* p, SfHashType type)
+{
+    switch ( type )
+    {
+    case SFHASH_BYTES:
+        p->hash_fcn = &sfhashfcn_hash;
+        break;
+
+    case SFHASH_CRC32C:
+#ifdef SFHASH_CRC32C_X86
+        if ( __builtin_cpu_supports("sse4.2") )
+        {
+            p->hash_fcn = &crc32c_sse42;
+            break;
+        }
+#endif
+        type = SFHASH_MIX;
+        // fall through
+
+    case SFHASH_MIX:
+        p->hash_fcn = &sfhashfcn_mix;
+        break;
+    }
+    return type;
+}
+
 /**
  * Make sfhashfcn use a separate set of opcodes for the backend.
  *
@@ -20,6 +20,7 @@
 #ifndef SFHASHFCN_H
 #define SFHASHFCN_H
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -55,20 +56,35 @@ SO_PUBLIC void mix_str(
     // n == 0 => strlen(s)
     const char* s, unsigned n = 0);
 
+// the hash family is selectable per table with sfhashfcn_set_type()
+enum SfHashType
+{
+    SFHASH_BYTES,   // seeded multiply-add, one byte at a time
+    SFHASH_CRC32C,  // sse4.2 crc32c in 8 byte strides (else SFHASH_MIX)
+    SFHASH_MIX      // seeded 64 bit multiply-rotate mix in 16 byte strides
+};
+
 struct SFHASHFCN
 {
     unsigned seed;
     unsigned scale;
     unsigned hardener;
+    uint64_t mix_seed[2];
     // FIXIT-H use types for these callbacks
     unsigned (* hash_fcn)(SFHASHFCN*, unsigned char* d, int n);
     int (* keycmp_fcn)(const void* s1, const void* s2, size_t n);
 };
 
-SFHASHFCN* sfhashfcn_new(int nrows);
+// keysize > 0 means all keys are that size and selects SFHASH_MIX
+SFHASHFCN* sfhashfcn_new(int nrows, int keysize = 0);
 void sfhashfcn_free(SFHASHFCN*);
 
 unsigned sfhashfcn_hash(SFHASHFCN*, unsigned char* d, int n);
+unsigned sfhashfcn_crc32c(SFHASHFCN*, unsigned char* d, int n);
+unsigned sfhashfcn_mix(SFHASHFCN*, unsigned char* d, int n);
+
+// keeps keycmp_fcn; returns the type actually set
+SfHashType sfhashfcn_set_type(SFHASHFCN*, SfHashType);
 
 int sfhashfcn_set_keyops(
     SFHASHFCN*,
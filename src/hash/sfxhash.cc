@@ -95,6 +95,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <utility>
+#include <vector>
+
 #include "main/snort_types.h"
 #include "main/snort_debug.h"
 #include "utils/util.h"
@@ -120,6 +123,456 @@ static inline void s_free(SFXHASH* t, void* p)
     sfmemcap_free(&t->mc, p);
 }
 
+//-------------------------------------------------------------------------
+// flat tables
+//
+// nodes live in fixed size slots (node + pad + key + data) carved from
+// chunks allocated against the memcap; a slot never moves so node, key,
+// and data pointers stay valid until the node is freed.  rindex holds the
+// slot number.  the index is a Robin Hood open addressed array of 8 byte
+// entries holding the full hash and slot so probes stay in a few cache
+// lines and a slot is only touched when the hash matches.  lookups don't
+// relink anything; they just set the slot's reference state which the
+// CLOCK hand clears as it sweeps for a node to recover.
+//-------------------------------------------------------------------------
+
+static void sfxhash_glink_node(SFXHASH*, SFXHASH_NODE*);
+static void sfxhash_gunlink_node(SFXHASH*, SFXHASH_NODE*);
+
+#define FLAT_CHUNK_SLOTS 64   // per chunk; the chunk starts with their states
+
+#define FLAT_FREE 0
+#define FLAT_USED 1
+#define FLAT_REF  2
+
+struct SFXHASH_FLAT_TABLE
+{
+    struct Entry
+    {
+        uint32_t hash;
+        uint32_t slot;  // slot number + 1; 0 is empty
+    };
+
+    Entry* index;
+    unsigned mask;        // index size - 1
+    unsigned max_load;    // grow the index before it is 7/8 full
+
+    std::vector<uint8_t*> chunks;
+    unsigned slot_size;
+    unsigned nslots;      // slots carved so far
+    SFXHASH_NODE* free;   // freed slots linked through gnext
+
+    unsigned hand;        // CLOCK position
+    unsigned clean;       // slots from the hand known not to be FLAT_USED
+    SFXHASH_NODE* mru;    // last node found or added
+};
+
+static inline SFXHASH_NODE* flat_node(SFXHASH_FLAT_TABLE* f, unsigned slot)
+{
+    uint8_t* chunk = f->chunks[slot / FLAT_CHUNK_SLOTS];
+    return (SFXHASH_NODE*)(chunk + FLAT_CHUNK_SLOTS + (slot % FLAT_CHUNK_SLOTS) * f->slot_size);
+}
+
+static inline uint8_t& flat_state(SFXHASH_FLAT_TABLE* f, unsigned slot)
+{ return f->chunks[slot / FLAT_CHUNK_SLOTS][slot % FLAT_CHUNK_SLOTS]; }
+
+static inline unsigned flat_hash(SFXHASH* t, const void* key)
+{ return t->sfhashfcn->hash_fcn(t->sfhashfcn, (unsigned char*)key, t->keysize); }
+
+static inline unsigned flat_dist(SFXHASH_FLAT_TABLE* f, unsigned pos)
+{ return (pos - f->index[pos].hash) & f->mask; }
+
+static bool flat_new_index(SFXHASH* t, unsigned size)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+    auto index = (SFXHASH_FLAT_TABLE::Entry*)s_alloc(t, size * sizeof(SFXHASH_FLAT_TABLE::Entry));
+
+    if ( !index )
+        return false;
+
+    SFXHASH_FLAT_TABLE::Entry* old = f->index;
+    unsigned old_size = old ? f->mask + 1 : 0;
+
+    f->index = index;
+    f->mask = size - 1;
+    f->max_load = size - size / 8;
+
+    for ( unsigned i = 0; i < old_size; ++i )
+    {
+        if ( !old[i].slot )
+            continue;
+
+        SFXHASH_FLAT_TABLE::Entry e = old[i];
+        unsigned pos = e.hash & f->mask;
+        unsigned d = 0;
+
+        while ( index[pos].slot )
+        {
+            unsigned ed = flat_dist(f, pos);
+
+            if ( ed < d )
+            {
+                std::swap(e, index[pos]);
+                d = ed;
+            }
+            pos = (pos + 1) & f->mask;
+            ++d;
+        }
+        index[pos] = e;
+    }
+
+    if ( old )
+        s_free(t, old);
+
+    return true;
+}
+
+static void flat_insert(SFXHASH_FLAT_TABLE* f, unsigned hash, unsigned slot)
+{
+    SFXHASH_FLAT_TABLE::Entry e = { hash, slot + 1 };
+    unsigned pos = hash & f->mask;
+    unsigned d = 0;
+
+    while ( f->index[pos].slot )
+    {
+        unsigned ed = flat_dist(f, pos);
+
+        if ( ed < d )
+        {
+            std::swap(e, f->index[pos]);
+            d = ed;
+        }
+        pos = (pos + 1) & f->mask;
+        ++d;
+    }
+    f->index[pos] = e;
+}
+
+// backward shift so no tombstones are needed
+static void flat_erase(SFXHASH_FLAT_TABLE* f, unsigned pos)
+{
+    unsigned next = (pos + 1) & f->mask;
+
+    while ( f->index[next].slot and flat_dist(f, next) )
+    {
+        f->index[pos] = f->index[next];
+        pos = next;
+        next = (next + 1) & f->mask;
+    }
+    f->index[pos].slot = 0;
+}
+
+// returns the index position of the key or -1
+static int flat_find_pos(SFXHASH* t, const void* key, unsigned hash)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+    unsigned pos = hash & f->mask;
+
+    for ( unsigned d = 0; ; ++d, pos = (pos + 1) & f->mask )
+    {
+        const SFXHASH_FLAT_TABLE::Entry& e = f->index[pos];
+
+        if ( !e.slot or flat_dist(f, pos) < d )
+            return -1;
+
+        if ( e.hash == hash and
+            !t->sfhashfcn->keycmp_fcn(flat_node(f, e.slot - 1)->key, key, t->keysize) )
+            return pos;
+    }
+}
+
+static SFXHASH_NODE* flat_find_node(SFXHASH* t, const void* key, unsigned hash)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+    int pos = flat_find_pos(t, key, hash);
+
+    if ( pos < 0 )
+    {
+        t->find_fail++;
+        return nullptr;
+    }
+
+    unsigned slot = f->index[pos].slot - 1;
+
+    // don't dirty the state line when it is already referenced
+    if ( flat_state(f, slot) != FLAT_REF )
+        flat_state(f, slot) = FLAT_REF;
+
+    SFXHASH_NODE* hnode = flat_node(f, slot);
+    f->mru = hnode;
+
+    t->find_success++;
+    return hnode;
+}
+
+// take the node out of the index and global list; the slot is not freed
+static void flat_unlink(SFXHASH* t, SFXHASH_NODE* hnode)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+    unsigned hash = flat_hash(t, hnode->key);
+    unsigned pos = hash & f->mask;
+
+    while ( f->index[pos].slot != (unsigned)hnode->rindex + 1 )
+        pos = (pos + 1) & f->mask;
+
+    flat_erase(f, pos);
+
+    if ( t->cnode == hnode )
+        t->cnode = hnode->gnext;
+
+    if ( f->mru == hnode )
+        f->mru = nullptr;
+
+    sfxhash_gunlink_node(t, hnode);
+    t->count--;
+}
+
+// the first node the hand would recover without clearing any references.
+// only recovery makes a slot FLAT_USED so the scan resumes where the last
+// one stopped until the hand sweeps again, and the hand skips free slots
+// since recovery would; draining the table through lru stays linear.
+static SFXHASH_NODE* flat_peek_victim(SFXHASH* t)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+
+    if ( !t->count )
+        return nullptr;
+
+    while ( flat_state(f, f->hand) == FLAT_FREE )
+    {
+        f->hand = (f->hand + 1) % f->nslots;
+
+        if ( f->clean )
+            f->clean--;
+    }
+
+    for ( ; f->clean < f->nslots; ++f->clean )
+    {
+        unsigned slot = (f->hand + f->clean) % f->nslots;
+
+        if ( flat_state(f, slot) == FLAT_USED )
+            return flat_node(f, slot);
+    }
+    return flat_node(f, f->hand);
+}
+
+// CLOCK: referenced nodes get another lap; give up after two laps since
+// the user may refuse every node
+static SFXHASH_NODE* flat_recover(SFXHASH* t)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+
+    if ( !t->count )
+        return nullptr;
+
+    f->clean = 0;
+
+    for ( unsigned n = 0; n < 2 * f->nslots; ++n )
+    {
+        unsigned slot = f->hand;
+        f->hand = (f->hand + 1) % f->nslots;
+
+        uint8_t& s = flat_state(f, slot);
+
+        if ( s == FLAT_FREE )
+            continue;
+
+        if ( s == FLAT_REF )
+        {
+            s = FLAT_USED;
+            continue;
+        }
+
+        SFXHASH_NODE* hnode = flat_node(f, slot);
+
+        if ( t->anrfree )
+        {
+            t->anr_tries++;
+
+            if ( t->anrfree(hnode->key, hnode->data) )
+                continue;
+        }
+
+        flat_unlink(t, hnode);
+        t->anr_count++;
+        return hnode;
+    }
+    return nullptr;
+}
+
+static SFXHASH_NODE* flat_newnode(SFXHASH* t)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+    SFXHASH_NODE* hnode = nullptr;
+
+    // the index can't grow past the memcap either
+    bool room = t->count < f->max_load or flat_new_index(t, 2 * (f->mask + 1));
+
+    if ( room and f->free )
+    {
+        hnode = f->free;
+        f->free = hnode->gnext;
+    }
+    else if ( room and (!t->max_nodes or t->count < t->max_nodes) )
+    {
+        if ( !(f->nslots % FLAT_CHUNK_SLOTS) )
+        {
+            auto chunk = (uint8_t*)s_alloc(t, FLAT_CHUNK_SLOTS * (1 + f->slot_size));
+
+            if ( chunk )
+                f->chunks.push_back(chunk);
+        }
+        if ( f->nslots < f->chunks.size() * FLAT_CHUNK_SLOTS )
+        {
+            hnode = flat_node(f, f->nslots);
+            hnode->rindex = f->nslots++;
+            f->clean = 0;
+        }
+    }
+
+    if ( !hnode and t->anr_flag )
+        hnode = flat_recover(t);
+
+    return hnode;
+}
+
+static int flat_add(SFXHASH* t, const void* key, void* data, void** data_ptr, SFXHASH_NODE** node)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+    unsigned hash = flat_hash(t, key);
+    SFXHASH_NODE* hnode = flat_find_node(t, key, hash);
+
+    if ( hnode )
+    {
+        t->cnode = hnode;
+
+        if ( data_ptr )
+            *data_ptr = hnode->data;
+
+        *node = hnode;
+        return SFXHASH_INTABLE;
+    }
+
+    hnode = flat_newnode(t);
+
+    if ( !hnode )
+    {
+        *node = nullptr;
+        return SFXHASH_NOMEM;
+    }
+
+    hnode->key = (char*)hnode + sizeof(SFXHASH_NODE);
+    memcpy(hnode->key, key, t->keysize);
+
+    if ( t->datasize )
+    {
+        hnode->data = (char*)hnode + sizeof(SFXHASH_NODE) + t->pad + t->keysize;
+
+        if ( data )
+            memcpy(hnode->data, data, t->datasize);
+
+        if ( data_ptr )
+            *data_ptr = hnode->data;
+    }
+    else
+        hnode->data = data;
+
+    flat_insert(f, hash, hnode->rindex);
+    flat_state(f, hnode->rindex) = FLAT_REF;
+    sfxhash_glink_node(t, hnode);
+
+    f->mru = hnode;
+    t->count++;
+
+    *node = hnode;
+    return SFXHASH_OK;
+}
+
+static void flat_free_node(SFXHASH* t, SFXHASH_NODE* hnode)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+
+    flat_unlink(t, hnode);
+
+    if ( t->usrfree )
+        t->usrfree(hnode->key, hnode->data);
+
+    flat_state(f, hnode->rindex) = FLAT_FREE;
+    hnode->gnext = f->free;
+    f->free = hnode;
+}
+
+static bool flat_new(SFXHASH* t, unsigned nrows)
+{
+    SFXHASH_FLAT_TABLE* f = new SFXHASH_FLAT_TABLE;
+
+    f->index = nullptr;
+    f->slot_size = (sizeof(SFXHASH_NODE) + t->pad + t->keysize + t->datasize + 7) & ~7u;
+    f->nslots = 0;
+    f->free = nullptr;
+    f->hand = 0;
+    f->clean = 0;
+    f->mru = nullptr;
+
+    t->flat = f;
+
+    // the index is masked so its size must be a power of 2 even when the
+    // caller asked for the magnitude of nrows as is
+    unsigned size = 8;
+
+    while ( size < nrows )
+        size <<= 1;
+
+    if ( flat_new_index(t, size) )
+        return true;
+
+    delete f;
+    t->flat = nullptr;
+    return false;
+}
+
+static void flat_delete(SFXHASH* t)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+
+    if ( t->usrfree )
+    {
+        for ( SFXHASH_NODE* hnode = t->ghead; hnode; hnode = hnode->gnext )
+            t->usrfree(hnode->key, hnode->data);
+    }
+
+    for ( auto chunk : f->chunks )
+        s_free(t, chunk);
+
+    if ( f->index )
+        s_free(t, f->index);
+
+    delete f;
+    t->flat = nullptr;
+}
+
+static void flat_make_empty(SFXHASH* t)
+{
+    while ( t->ghead )
+        flat_free_node(t, t->ghead);
+
+    t->flat->hand = 0;
+    t->flat->clean = 0;
+}
+
+static unsigned flat_maxdepth(SFXHASH* t)
+{
+    SFXHASH_FLAT_TABLE* f = t->flat;
+    unsigned max_depth = 0;
+
+    for ( unsigned pos = 0; pos <= f->mask; ++pos )
+    {
+        if ( f->index[pos].slot and flat_dist(f, pos) + 1 > max_depth )
+            max_depth = flat_dist(f, pos) + 1;
+    }
+    return max_depth;
+}
+
 /*
  *   User access to the memory management, do they need it ? WaitAndSee
  */
@@ -179,7 +632,8 @@ SFXHASH* sfxhash_new(int nrows, int keysize, int datasize, unsigned long maxmem,
     int anr_flag,
     SFXHASH_FREE_FCN anrfree,
     SFXHASH_FREE_FCN usrfree,
-    int recycle_flag)
+    int recycle_flag,
+    int flags)
 {
     int i;
     SFXHASH* h;
@@ -199,30 +653,42 @@ SFXHASH* sfxhash_new(int nrows, int keysize, int datasize, unsigned long maxmem,
     h = (SFXHASH*)snort_calloc(sizeof(SFXHASH));
 
     /* this has a default hashing function */
-    h->sfhashfcn = sfhashfcn_new(nrows);
+    h->sfhashfcn = sfhashfcn_new(nrows, keysize);
     sfmemcap_init(&h->mc, maxmem);
 
-    /* Allocate the array of node ptrs */
-    h->table = (SFXHASH_NODE**)s_alloc(h, sizeof(SFXHASH_NODE*) * nrows);
-
-    if ( !h->table )
-    {
-        snort_free(h->sfhashfcn);
-        snort_free(h);
-        return 0;
-    }
-
-    for ( i=0; i<nrows; i++ )
-    {
-        h->table[i] = 0;
-    }
-
     h->anrfree  = anrfree;
     h->usrfree  = usrfree;
     h->keysize  = keysize;
 
     h->pad = 0;
     h->datasize = datasize;
+
+    if ( flags & SFXHASH_FLAT )
+    {
+        if ( !flat_new(h, nrows) )
+        {
+            sfhashfcn_free(h->sfhashfcn);
+            snort_free(h);
+            return 0;
+        }
+    }
+    else
+    {
+        /* Allocate the array of node ptrs */
+        h->table = (SFXHASH_NODE**)s_alloc(h, sizeof(SFXHASH_NODE*) * nrows);
+
+        if ( !h->table )
+        {
+            snort_free(h->sfhashfcn);
+            snort_free(h);
+            return 0;
+        }
+
+        for ( i=0; i<nrows; i++ )
+        {
+            h->table[i] = 0;
+        }
+    }
     h->nrows    = nrows;
     h->max_nodes = 0;
     h->crow     = 0;
@@ -320,6 +786,9 @@ void sfxhash_delete(SFXHASH* h)
     if ( !h )
         return;
 
+    if ( h->flat )
+        flat_delete(h);
+
     if ( h->sfhashfcn )
         sfhashfcn_free(h->sfhashfcn);
 
@@ -364,7 +833,10 @@ int sfxhash_make_empty(SFXHASH* h)
     if (h == NULL)
         return -1;
 
-    for (i = 0; i < h->nrows; i++)
+    if ( h->flat )
+        flat_make_empty(h);
+
+    for (i = 0; h->table && i < h->nrows; i++)
     {
         for (n = h->table[i]; n != NULL; n = tmp)
         {
@@ -481,7 +953,10 @@ static void sfxhash_gunlink_node(SFXHASH* t, SFXHASH_NODE* hnode)
  */
 void sfxhash_gmovetofront(SFXHASH* t, SFXHASH_NODE* hnode)
 {
-    if ( hnode != t->ghead )
+    if ( t->flat )
+        flat_state(t->flat, hnode->rindex) = FLAT_REF;
+
+    else if ( hnode != t->ghead )
     {
         sfxhash_gunlink_node(t, hnode);
         sfxhash_glink_node(t, hnode);
@@ -681,6 +1156,9 @@ static int sfxhash_add_ex(SFXHASH* t, const void* key, void* data, void** data_p
     int index;
     SFXHASH_NODE* hnode;
 
+    if ( t->flat )
+        return flat_add(t, key, data, data_ptr, &hnode);
+
     /* Enforce uniqueness: Check for the key in the table */
     hnode = sfxhash_find_node_row(t, key, &index);
 
@@ -767,6 +1245,12 @@ SFXHASH_NODE* sfxhash_get_node(SFXHASH* t, const void* key)
     int index;
     SFXHASH_NODE* hnode;
 
+    if ( t->flat )
+    {
+        flat_add(t, key, nullptr, nullptr, &hnode);
+        return hnode;
+    }
+
     /* Enforce uniqueness: Check for the key in the table */
     hnode = sfxhash_find_node_row(t, key, &index);
 
@@ -832,6 +1316,9 @@ SFXHASH_NODE* sfxhash_find_node(SFXHASH* t, const void* key)
 {
     int rindex;
 
+    if ( t->flat )
+        return flat_find_node(t, key, flat_hash(t, key));
+
     return sfxhash_find_node_row(t, key, &rindex);
 }
 
@@ -850,7 +1337,10 @@ void* sfxhash_find(SFXHASH* t, void* key)
     SFXHASH_NODE* hnode;
     int rindex;
 
-    hnode = sfxhash_find_node_row(t, key, &rindex);
+    if ( t->flat )
+        hnode = flat_find_node(t, key, flat_hash(t, key));
+    else
+        hnode = sfxhash_find_node_row(t, key, &rindex);
 
     if ( hnode )
         return hnode->data;
@@ -940,9 +1430,7 @@ SFXHASH_NODE* sfxhash_gfindfirst(SFXHASH* t)
  */
 void* sfxhash_mru(SFXHASH* t)
 {
-    SFXHASH_NODE* hnode;
-
-    hnode = sfxhash_ghead(t);
+    SFXHASH_NODE* hnode = sfxhash_mru_node(t);
 
     if ( hnode )
         return hnode->data;
@@ -961,9 +1449,7 @@ void* sfxhash_mru(SFXHASH* t)
  */
 void* sfxhash_lru(SFXHASH* t)
 {
-    SFXHASH_NODE* hnode;
-
-    hnode = t->gtail;
+    SFXHASH_NODE* hnode = sfxhash_lru_node(t);
 
     if ( hnode )
         return hnode->data;
@@ -984,6 +1470,9 @@ SFXHASH_NODE* sfxhash_mru_node(SFXHASH* t)
 {
     SFXHASH_NODE* hnode;
 
+    if ( t->flat )
+        return t->flat->mru;
+
     hnode = sfxhash_ghead(t);
 
     if ( hnode )
@@ -1005,6 +1494,9 @@ SFXHASH_NODE* sfxhash_lru_node(SFXHASH* t)
 {
     SFXHASH_NODE* hnode;
 
+    if ( t->flat )
+        return flat_peek_victim(t);
+
     hnode = t->gtail;
 
     if ( hnode )
@@ -1030,6 +1522,9 @@ unsigned sfxhash_maxdepth(SFXHASH* t)
 
     SFXHASH_NODE* hnode;
 
+    if ( t->flat )
+        return flat_maxdepth(t);
+
     for ( i=0; i<t->nrows; i++ )
     {
         unsigned cur_depth = 0;
@@ -1051,6 +1546,12 @@ unsigned sfxhash_maxdepth(SFXHASH* t)
  */
 int sfxhash_free_node(SFXHASH* t, SFXHASH_NODE* hnode)
 {
+    if ( t->flat )
+    {
+        flat_free_node(t, hnode);
+        return SFXHASH_OK;
+    }
+
     sfxhash_unlink_node(t, hnode);   /* unlink from the hash table row list */
 
     sfxhash_gunlink_node(t, hnode);   /* unlink from global-hash-node list */
@@ -1093,6 +1594,17 @@ int sfxhash_remove(SFXHASH* t, void* key)
         (unsigned char*)key,
         t->keysize);
 
+    if ( t->flat )
+    {
+        int pos = flat_find_pos(t, key, hashkey);
+
+        if ( pos < 0 )
+            return SFXHASH_ERR;
+
+        flat_free_node(t, flat_node(t->flat, t->flat->index[pos].slot - 1));
+        return SFXHASH_OK;
+    }
+
 //    index = hashkey % t->nrows;
     /* Modulus is slow */
     index   = hashkey & (t->nrows - 1);
@@ -1151,6 +1663,13 @@ SFXHASH_NODE* sfxhash_findfirst(SFXHASH* t)
     if (!t)
         return NULL;
 
+    if ( t->flat )
+    {
+        n = t->ghead;
+        t->cnode = n ? n->gnext : NULL;
+        return n;
+    }
+
     /* Start with 1st row */
     for ( t->crow=0; t->crow < t->nrows; t->crow++ )
     {
@@ -1189,7 +1708,10 @@ SFXHASH_NODE* sfxhash_findnext(SFXHASH* t)
     /*
       Preload next node into current node
     */
-    sfxhash_next(t);
+    if ( t->flat )
+        t->cnode = n->gnext;
+    else
+        sfxhash_next(t);
 
     return n;
 }
@@ -33,6 +33,7 @@
 #include "main/snort_types.h"
 
 struct SFHASHFCN;
+struct SFXHASH_FLAT_TABLE;
 
 #define SFXHASH_NOMEM    -2
 #define SFXHASH_ERR      -1
@@ -91,14 +92,24 @@ struct SFXHASH
 
     SFXHASH_FREE_FCN anrfree;
     SFXHASH_FREE_FCN usrfree;
+
+    SFXHASH_FLAT_TABLE* flat; // set for SFXHASH_FLAT tables
 };
 
+// sfxhash_new flags
+// SFXHASH_FLAT stores nodes with their key and data in fixed size slots
+// that are found through an open addressed index and recovered by CLOCK
+// instead of LRU.  nodes don't move once added.  the global list is kept
+// in insertion order and lru returns the next CLOCK victim.
+#define SFXHASH_FLAT 0x01
+
 SO_PUBLIC int sfxhash_calcrows(int num);
 SO_PUBLIC SFXHASH* sfxhash_new(int nrows, int keysize, int datasize, unsigned long memcap,
     int anr_flag,
     SFXHASH_FREE_FCN anrfunc,
     SFXHASH_FREE_FCN usrfunc,
-    int recycle_flag);
+    int recycle_flag,
+    int flags = 0);
 
 SO_PUBLIC void sfxhash_set_max_nodes(SFXHASH* h, int max_nodes);
 
@@ -0,0 +1,403 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// lru_cache_sharded_test.cc
+// unit tests for LruCacheSharded class and benchmark against LruCacheShared
+
+#include "hash/lru_cache_sharded.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "time/stopwatch.h"
+
+//  A single shard makes eviction order deterministic.
+typedef LruCacheSharded<int, std::string, std::hash<int>, 1> ClockCache;
+typedef LruCacheSharded<int, std::string, std::hash<int> > ShardedCache;
+
+TEST_GROUP(lru_cache_sharded)
+{
+};
+
+TEST(lru_cache_sharded, constructor_test)
+{
+    ShardedCache lru_cache(5);
+
+    CHECK(lru_cache.get_max_size() == 5);
+    CHECK(lru_cache.size() == 0);
+}
+
+//  A size of 0 is treated as 1 so inserts always have room.
+TEST(lru_cache_sharded, zero_size_test)
+{
+    std::string data;
+    ClockCache lru_cache(0);
+
+    CHECK(lru_cache.get_max_size() == 1);
+
+    lru_cache.insert(1, "one");
+    lru_cache.insert(2, "two");
+
+    CHECK(lru_cache.size() == 1);
+    CHECK(lru_cache.find(2, data));
+    CHECK("two" == data);
+}
+
+TEST(lru_cache_sharded, insert_test)
+{
+    std::string data;
+    ShardedCache lru_cache(100);
+
+    for (int i = 0; i < 50; i++)
+        lru_cache.insert(i, std::to_string(i));
+
+    for (int i = 0; i < 50; i++)
+    {
+        CHECK(true == lru_cache.find(i, data));
+        CHECK(std::to_string(i) == data);
+    }
+
+    CHECK(false == lru_cache.find(50, data));
+
+    lru_cache.insert(1, "newone");
+    CHECK(true == lru_cache.find(1, data));
+    CHECK("newone" == data);
+
+    CHECK(50 == lru_cache.size());
+    CHECK(50 == lru_cache.get_all_data().size());
+}
+
+//  Unreferenced entries go in insertion order.
+TEST(lru_cache_sharded, clock_removal_test)
+{
+    ClockCache lru_cache(5);
+
+    for (int i = 0; i < 10; i++)
+        lru_cache.insert(i, std::to_string(i));
+
+    CHECK(5 == lru_cache.size());
+
+    auto vec = lru_cache.get_all_data();
+    CHECK(5 == vec.size());
+    CHECK((vec[0] == std::make_pair(9, std::string("9"))));
+    CHECK((vec[1] == std::make_pair(8, std::string("8"))));
+    CHECK((vec[2] == std::make_pair(7, std::string("7"))));
+    CHECK((vec[3] == std::make_pair(6, std::string("6"))));
+    CHECK((vec[4] == std::make_pair(5, std::string("5"))));
+}
+
+//  Found entries get a second chance.
+TEST(lru_cache_sharded, second_chance_test)
+{
+    std::string data;
+    ClockCache lru_cache(5);
+
+    for (int i = 0; i < 5; i++)
+        lru_cache.insert(i, std::to_string(i));
+
+    lru_cache.find(0, data);
+    lru_cache.find(2, data);
+    lru_cache.find(4, data, false);  // no update
+
+    lru_cache.insert(5, "5");   // evicts 1
+    lru_cache.insert(6, "6");   // evicts 3
+    lru_cache.insert(7, "7");   // evicts 4
+
+    CHECK(5 == lru_cache.size());
+    CHECK(false == lru_cache.find(1, data, false));
+    CHECK(false == lru_cache.find(3, data, false));
+    CHECK(false == lru_cache.find(4, data, false));
+
+    int keep[] = { 0, 2, 5, 6, 7 };
+
+    for ( auto k : keep )
+        CHECK(true == lru_cache.find(k, data, false));
+}
+
+TEST(lru_cache_sharded, set_max_size_test)
+{
+    ShardedCache lru_cache(2000);
+
+    CHECK(false == lru_cache.set_max_size(0));
+
+    for (int i = 0; i < 1000; i++)
+        lru_cache.insert(i, std::to_string(i));
+
+    CHECK(1000 == lru_cache.size());
+
+    //  2 per shard
+    CHECK(true == lru_cache.set_max_size(32));
+    CHECK(32 == lru_cache.get_max_size());
+    CHECK(lru_cache.size() <= 32);
+
+    //  Resizing doesn't count as pruning.
+    PegCount* stats = lru_cache.get_counts();
+    CHECK(stats[2] == 0);
+
+    for (int i = 0; i < 1000; i++)
+        lru_cache.insert(i, std::to_string(i));
+
+    CHECK(lru_cache.size() <= 32);
+}
+
+TEST(lru_cache_sharded, remove_test)
+{
+    std::string data;
+    ClockCache lru_cache(5);
+
+    for (int i = 0; i < 5; i++)
+    {
+        lru_cache.insert(i, std::to_string(i));
+        CHECK(true == lru_cache.find(i, data));
+        CHECK(data == std::to_string(i));
+
+        CHECK(true == lru_cache.remove(i));
+        CHECK(false == lru_cache.find(i, data));
+    }
+
+    CHECK(0 == lru_cache.size());
+
+    lru_cache.insert(1, "one");
+    CHECK(1 == lru_cache.size());
+    CHECK(true == lru_cache.remove(1, data));
+    CHECK(data == "one");
+    CHECK(0 == lru_cache.size());
+
+    lru_cache.insert(1, "one");
+    lru_cache.insert(2, "two");
+    lru_cache.insert(3, "three");
+    CHECK(3 == lru_cache.size());
+
+    CHECK(false == lru_cache.remove(4));
+    CHECK(false == lru_cache.remove(5, data));
+
+    //  Remove the hand.
+    CHECK(true == lru_cache.remove(1));
+
+    auto vec = lru_cache.get_all_data();
+    CHECK(2 == vec.size());
+    CHECK((vec[0] == std::make_pair(3, std::string("three"))));
+    CHECK((vec[1] == std::make_pair(2, std::string("two"))));
+
+    for (int i = 4; i < 10; i++)
+        lru_cache.insert(i, std::to_string(i));
+
+    CHECK(5 == lru_cache.size());
+
+    lru_cache.clear();
+    CHECK(0 == lru_cache.size());
+    CHECK(0 == lru_cache.get_all_data().size());
+
+    lru_cache.insert(1, "one");
+    CHECK(true == lru_cache.find(1, data));
+}
+
+//  Counts are summed over the shards.
+TEST(lru_cache_sharded, stats_test)
+{
+    std::string data;
+    ClockCache lru_cache(5);
+
+    for (int i = 0; i < 10; i++)
+        lru_cache.insert(i, std::to_string(i));
+
+    lru_cache.insert(8, "new-eight");
+    lru_cache.insert(9, "new-nine");
+
+    CHECK(5 == lru_cache.size());
+
+    lru_cache.find(7, data);
+    lru_cache.find(8, data);
+    lru_cache.find(9, data);
+
+    lru_cache.remove(7);
+    lru_cache.remove(8);
+    lru_cache.remove(9, data);
+    CHECK("new-nine" == data);
+
+    lru_cache.find(8, data);
+    lru_cache.find(9, data);
+
+    lru_cache.remove(100);
+    lru_cache.clear();
+
+    PegCount* stats = lru_cache.get_counts();
+
+    CHECK(stats[0] == 10);  //  adds
+    CHECK(stats[1] == 2);   //  replaces
+    CHECK(stats[2] == 5);   //  prunes
+    CHECK(stats[3] == 3);   //  find hits
+    CHECK(stats[4] == 2);   //  find misses
+    CHECK(stats[5] == 3);   //  removes
+    CHECK(stats[6] == 1);   //  clears
+
+    ShardedCache sharded(100);
+
+    for (int i = 0; i < 64; i++)
+        sharded.insert(i, std::to_string(i));
+
+    for (int i = 0; i < 128; i++)
+        sharded.find(i, data);
+
+    stats = sharded.get_counts();
+    CHECK(stats[0] == 64);
+    CHECK(stats[3] == 64);
+    CHECK(stats[4] == 64);
+
+    const PegInfo* pegs = sharded.get_pegs();
+    CHECK(!strcmp(pegs[0].name, "lru cache adds"));
+    CHECK(!strcmp(pegs[6].name, "lru cache clears"));
+}
+
+TEST(lru_cache_sharded, threads_test)
+{
+    const int num_threads = 8;
+    const int num_keys = 4096;
+
+    LruCacheSharded<int, int, std::hash<int> > lru_cache(num_keys / 2);
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> errors(0);
+
+    for (int t = 0; t < num_threads; t++)
+    {
+        threads.push_back(std::thread([&lru_cache, &errors, t]()
+        {
+            int data;
+
+            for (int i = 0; i < 20000; i++)
+            {
+                int key = (i * 7 + t) % num_keys;
+
+                if ( !lru_cache.find(key, data) )
+                    lru_cache.insert(key, key);
+
+                else if ( data != key )
+                    errors++;
+
+                if ( i % 97 == 0 )
+                    lru_cache.remove(key);
+            }
+        }));
+    }
+
+    //  Counts may be read while the shards are busy; lookups only grow.
+    threads.push_back(std::thread([&lru_cache, &errors]()
+    {
+        PegCount last = 0;
+
+        for (int i = 0; i < 2000; i++)
+        {
+            PegCount* stats = lru_cache.get_counts();
+            PegCount lookups = stats[3] + stats[4];
+
+            if ( lookups < last )
+                errors++;
+
+            last = lookups;
+        }
+    }));
+
+    for ( auto& th : threads )
+        th.join();
+
+    CHECK(errors == 0);
+    CHECK(lru_cache.get_counts()[3] + lru_cache.get_counts()[4] == num_threads * 20000);
+    CHECK(lru_cache.size() <= num_keys / 2);
+    CHECK(lru_cache.size() == lru_cache.get_all_data().size());
+}
+
+//-------------------------------------------------------------------------
+// benchmark; ignored by default, run with -ri
+//-------------------------------------------------------------------------
+
+//  Lookups skewed like host traffic: 90% go to 64 hot hosts.  Misses are
+//  inserted.
+template<typename Cache>
+static double run_threads(Cache& cache, unsigned num_threads, unsigned num_keys)
+{
+    const unsigned lookups = 400000;
+    std::vector<std::thread> threads;
+
+    Stopwatch<std::chrono::steady_clock> sw;
+    sw.start();
+
+    for ( unsigned t = 0; t < num_threads; t++ )
+    {
+        threads.push_back(std::thread([&cache, t, num_keys]()
+        {
+            uint32_t x = 2463534242u + t;
+            int data;
+
+            for ( unsigned i = 0; i < lookups; i++ )
+            {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+
+                int key = (x % 10) ? (x >> 8) % 64 : (x >> 8) % num_keys;
+
+                if ( !cache.find(key, data) )
+                    cache.insert(key, key);
+            }
+        }));
+    }
+
+    for ( auto& th : threads )
+        th.join();
+
+    sw.stop();
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+    return (double)ns / ((double)lookups * num_threads);
+}
+
+TEST_GROUP(lru_cache_sharded_perf) { };
+
+IGNORE_TEST(lru_cache_sharded_perf, threads)
+{
+    const unsigned num_keys = 65536;
+    unsigned counts[] = { 1, 8, 32 };
+
+    printf("\nns per lookup (wall clock / total lookups)\n");
+    printf("threads     shared    sharded\n");
+
+    for ( auto n : counts )
+    {
+        LruCacheShared<int, int, std::hash<int> > shared(num_keys / 2);
+        LruCacheSharded<int, int, std::hash<int> > sharded(num_keys / 2);
+
+        double a = run_threads(shared, n, num_keys);
+        double b = run_threads(sharded, n, num_keys);
+
+        printf("%7u %10.1f %10.1f\n", n, a, b);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
+
@@ -0,0 +1,264 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// sfhashfcn_test.cc
+// unit tests for the sfhashfcn hash family and benchmark of hash
+// throughput and ZHash lookups with each
+
+#include "hash/sfhashfcn.h"
+#include "hash/zhash.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "main/thread.h"
+#include "time/stopwatch.h"
+
+struct SnortConfig;
+THREAD_LOCAL SnortConfig* snort_conf = nullptr;
+
+typedef unsigned (* HashFcn)(SFHASHFCN*, unsigned char*, int);
+
+static const SfHashType types[] = { SFHASH_BYTES, SFHASH_CRC32C, SFHASH_MIX };
+static const char* const type_names[] = { "bytes", "crc32c", "mix" };
+
+//  Fill keys with a counter like addresses and ports.
+static void make_key(unsigned char* key, unsigned len, uint32_t n)
+{
+    memset(key, 0, len);
+
+    for ( unsigned i = 0; i < len and i < sizeof(n); ++i )
+        key[len - 1 - i] = (unsigned char)(n >> (8 * i));
+}
+
+TEST_GROUP(sfhashfcn)
+{
+    SFHASHFCN* p = nullptr;
+
+    void setup()
+    { p = sfhashfcn_new(1024, 16); }
+
+    void teardown()
+    { sfhashfcn_free(p); }
+};
+
+TEST(sfhashfcn, default_type)
+{
+    CHECK(p->hash_fcn == sfhashfcn_mix);
+
+    SFHASHFCN* q = sfhashfcn_new(1024);
+    CHECK(q->hash_fcn == sfhashfcn_hash);
+    sfhashfcn_free(q);
+}
+
+TEST(sfhashfcn, set_type)
+{
+    CHECK(sfhashfcn_set_type(p, SFHASH_BYTES) == SFHASH_BYTES);
+    CHECK(p->hash_fcn == sfhashfcn_hash);
+
+    CHECK(sfhashfcn_set_type(p, SFHASH_MIX) == SFHASH_MIX);
+    CHECK(p->hash_fcn == sfhashfcn_mix);
+
+    SfHashType t = sfhashfcn_set_type(p, SFHASH_CRC32C);
+    CHECK(t == SFHASH_CRC32C or t == SFHASH_MIX);
+    CHECK(p->keycmp_fcn == memcmp);
+}
+
+//  Only the first n bytes count and every length works, including the
+//  partial strides.
+TEST(sfhashfcn, lengths)
+{
+    unsigned char a[64], b[72];
+
+    for ( unsigned i = 0; i < sizeof(a); ++i )
+        a[i] = (unsigned char)(i * 37 + 1);
+
+    for ( auto t : types )
+    {
+        sfhashfcn_set_type(p, t);
+
+        for ( int n = 0; n <= (int)sizeof(a); ++n )
+        {
+            memset(b, 0xa5, sizeof(b));
+            memcpy(b + 3, a, n);
+
+            CHECK(p->hash_fcn(p, a, n) == p->hash_fcn(p, b + 3, n));
+
+            if ( n )
+            {
+                b[3 + n - 1] ^= 0x01;
+                CHECK(p->hash_fcn(p, a, n) != p->hash_fcn(p, b + 3, n));
+            }
+        }
+    }
+}
+
+TEST(sfhashfcn, seeded)
+{
+    SFHASHFCN* q = sfhashfcn_new(1024, 16);
+    unsigned char key[16];
+    unsigned same = 0;
+
+    for ( uint32_t i = 0; i < 64; ++i )
+    {
+        make_key(key, sizeof(key), i);
+
+        if ( sfhashfcn_mix(p, key, sizeof(key)) == sfhashfcn_mix(q, key, sizeof(key)) )
+            same++;
+    }
+    CHECK(same < 2);
+    sfhashfcn_free(q);
+}
+
+//  Sequential keys spread evenly over the low bits used to index power of
+//  2 tables.
+TEST(sfhashfcn, distribution)
+{
+    const unsigned rows = 4096;
+    const unsigned keys = rows * 8;
+    unsigned char key[13];
+
+    for ( auto t : { SFHASH_CRC32C, SFHASH_MIX } )
+    {
+        std::vector<unsigned> counts(rows, 0);
+        sfhashfcn_set_type(p, t);
+
+        for ( uint32_t i = 0; i < keys; ++i )
+        {
+            make_key(key, sizeof(key), i);
+            counts[p->hash_fcn(p, key, sizeof(key)) & (rows - 1)]++;
+        }
+
+        unsigned max = 0;
+
+        for ( auto c : counts )
+            if ( c > max )
+                max = c;
+
+        CHECK(max < 32);
+    }
+}
+
+//-------------------------------------------------------------------------
+// benchmark; ignored by default, run with -ri
+//-------------------------------------------------------------------------
+
+static double ns_per(Stopwatch<std::chrono::steady_clock>& sw, unsigned n)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+    return (double)ns / n;
+}
+
+TEST_GROUP(sfhashfcn_perf) { };
+
+IGNORE_TEST(sfhashfcn_perf, hash)
+{
+    const unsigned sizes[] = { 4, 16, 40, 64 };
+    const unsigned loops = 2000000;
+    unsigned char key[64];
+    volatile unsigned sink = 0;
+
+    SFHASHFCN* p = sfhashfcn_new(1024, 16);
+    memset(key, 0x5a, sizeof(key));
+
+    printf("\nns per hash\n");
+    printf("%6s %10s %10s %10s\n", "bytes", type_names[0], type_names[1], type_names[2]);
+
+    for ( auto len : sizes )
+    {
+        printf("%6u", len);
+
+        for ( auto t : types )
+        {
+            sfhashfcn_set_type(p, t);
+            HashFcn fcn = p->hash_fcn;
+
+            Stopwatch<std::chrono::steady_clock> sw;
+            sw.start();
+
+            for ( unsigned i = 0; i < loops; ++i )
+            {
+                key[0] = (unsigned char)i;
+                sink += fcn(p, key, len);
+            }
+            sw.stop();
+
+            printf(" %10.2f", ns_per(sw, loops));
+        }
+        printf("\n");
+    }
+    sfhashfcn_free(p);
+}
+
+//  FlowKey sized keys in a table sized like the flow cache with a
+//  counter in the addresses so the keys look like real traffic.
+IGNORE_TEST(sfhashfcn_perf, zhash_find)
+{
+    const unsigned num_keys = 65536;
+    const unsigned keysize = 40;
+    const unsigned loops = 20;
+    HashFcn fcns[] = { sfhashfcn_hash, sfhashfcn_crc32c, sfhashfcn_mix };
+
+    std::vector<unsigned char> keys(num_keys * keysize);
+
+    for ( uint32_t i = 0; i < num_keys; ++i )
+    {
+        unsigned char* k = &keys[i * keysize];
+        make_key(k, keysize, i * 2654435761u);
+        memcpy(k + 4, &i, sizeof(i));
+    }
+
+    printf("\nns per zhash find\n");
+
+    for ( unsigned t = 0; t < 3; ++t )
+    {
+        ZHash zh(num_keys, keysize);
+        zh.set_keyops(fcns[t], memcmp);
+
+        for ( unsigned i = 0; i < num_keys; ++i )
+        {
+            zh.push(&keys[i * keysize]);
+            zh.get(&keys[i * keysize]);
+        }
+        CHECK(zh.get_count() == num_keys);
+
+        unsigned found = 0;
+        Stopwatch<std::chrono::steady_clock> sw;
+        sw.start();
+
+        for ( unsigned n = 0; n < loops; ++n )
+            for ( unsigned i = 0; i < num_keys; ++i )
+                if ( zh.find(&keys[i * keysize]) )
+                    found++;
+
+        sw.stop();
+        CHECK(found == num_keys * loops);
+
+        printf("%10s %10.2f\n", type_names[t], ns_per(sw, num_keys * loops));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
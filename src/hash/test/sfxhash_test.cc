@@ -0,0 +1,569 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// sfxhash_test.cc
+// unit tests that run the same operations on chained and SFXHASH_FLAT
+// tables and benchmark of both at several load factors
+
+#include "hash/sfxhash.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+#include <chrono>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "main/thread.h"
+#include "time/stopwatch.h"
+
+struct SnortConfig;
+THREAD_LOCAL SnortConfig* snort_conf = nullptr;
+
+// sfmemcap.o needs this for sfmemcap_SnortStrdup
+int SnortStrncpy(char*, const char*, size_t)
+{ return 0; }
+
+struct Key
+{
+    uint32_t a[4];
+};
+
+struct Data
+{
+    uint32_t n;
+    uint32_t pad[3];
+};
+
+static Key make_key(uint32_t n)
+{
+    Key k = { { n, ~n, n * 2654435761u, 7 } };
+    return k;
+}
+
+static unsigned usr_frees = 0;
+static unsigned anr_refused = 0;
+static bool anr_refuse_all = false;
+
+static int usr_free(void*, void*)
+{
+    usr_frees++;
+    return 0;
+}
+
+// keep the first few keys unless told to keep everything
+static int anr_free(void* key, void*)
+{
+    if ( anr_refuse_all or ((Key*)key)->a[0] < 16 )
+    {
+        anr_refused++;
+        return 1;
+    }
+    return 0;
+}
+
+static SFXHASH* new_table(
+    int flags, int rows = 256, unsigned long memcap = 0, int anr = 0, int datasize = sizeof(Data))
+{
+    return sfxhash_new(rows, sizeof(Key), datasize, memcap, anr,
+        anr ? anr_free : nullptr, usr_free, 1, flags);
+}
+
+static const int modes[] = { 0, SFXHASH_FLAT };
+
+TEST_GROUP(sfxhash)
+{
+    void setup()
+    {
+        usr_frees = anr_refused = 0;
+        anr_refuse_all = false;
+    }
+};
+
+TEST(sfxhash, add_find_remove)
+{
+    const unsigned num = 1000;
+    unsigned finds[2], frees[2];
+
+    for ( int m = 0; m < 2; ++m )
+    {
+        usr_frees = 0;
+        SFXHASH* t = new_table(modes[m]);
+
+        for ( uint32_t i = 0; i < num; ++i )
+        {
+            Key k = make_key(i);
+            Data d = { i, { } };
+            CHECK(sfxhash_add(t, &k, &d) == SFXHASH_OK);
+            CHECK(((Data*)sfxhash_mru(t))->n == i);
+        }
+        CHECK(sfxhash_count(t) == num);
+
+        Key k = make_key(5);
+        Data d = { 55, { } };
+        CHECK(sfxhash_add(t, &k, &d) == SFXHASH_INTABLE);
+        CHECK(((Data*)t->cnode->data)->n == 5);
+
+        for ( uint32_t i = 0; i < num; ++i )
+        {
+            k = make_key(i);
+            Data* pd = (Data*)sfxhash_find(t, &k);
+            CHECK(pd and pd->n == i);
+        }
+
+        for ( uint32_t i = 0; i < num; i += 2 )
+        {
+            k = make_key(i);
+            CHECK(sfxhash_remove(t, &k) == SFXHASH_OK);
+            CHECK(sfxhash_remove(t, &k) == SFXHASH_ERR);
+        }
+        CHECK(sfxhash_count(t) == num / 2);
+
+        for ( uint32_t i = 0; i < num; ++i )
+        {
+            k = make_key(i);
+            CHECK((sfxhash_find(t, &k) != nullptr) == (i & 1));
+        }
+
+        k = make_key(1);
+        SFXHASH_NODE* n = sfxhash_find_node(t, &k);
+        CHECK(n and !memcmp(n->key, &k, sizeof(k)));
+        CHECK(sfxhash_free_node(t, n) == SFXHASH_OK);
+        CHECK(!sfxhash_find(t, &k));
+
+        finds[m] = sfxhash_find_total(t);
+        sfxhash_delete(t);
+        frees[m] = usr_frees;
+    }
+    CHECK(finds[0] == finds[1]);
+    CHECK(frees[0] == num);
+    CHECK(frees[1] == num);
+}
+
+TEST(sfxhash, user_data)
+{
+    int items[8];
+
+    for ( auto mode : modes )
+    {
+        SFXHASH* t = new_table(mode, 16, 0, 0, 0);
+
+        for ( uint32_t i = 0; i < 8; ++i )
+        {
+            Key k = make_key(i);
+            CHECK(sfxhash_add(t, &k, &items[i]) == SFXHASH_OK);
+        }
+        for ( uint32_t i = 0; i < 8; ++i )
+        {
+            Key k = make_key(i);
+            CHECK(sfxhash_find(t, &k) == &items[i]);
+        }
+
+        Key k = make_key(100);
+        SFXHASH_NODE* n = sfxhash_get_node(t, &k);
+        CHECK(n and !n->data);
+        CHECK(sfxhash_get_node(t, &k) == n);
+
+        void* pv;
+        CHECK(sfxhash_add_return_data_ptr(t, &k, &pv) == SFXHASH_ERR);
+
+        sfxhash_delete(t);
+    }
+}
+
+TEST(sfxhash, return_data_ptr)
+{
+    for ( auto mode : modes )
+    {
+        SFXHASH* t = new_table(mode);
+        Key k = make_key(9);
+        void* pv = nullptr;
+
+        CHECK(sfxhash_add_return_data_ptr(t, &k, &pv) == SFXHASH_OK);
+        CHECK(pv);
+        ((Data*)pv)->n = 99;
+
+        void* pv2 = nullptr;
+        CHECK(sfxhash_add_return_data_ptr(t, &k, &pv2) == SFXHASH_INTABLE);
+        CHECK(pv2 == pv);
+        CHECK(((Data*)sfxhash_find(t, &k))->n == 99);
+
+        sfxhash_delete(t);
+    }
+}
+
+//  Nodes don't move when the table grows.
+TEST(sfxhash, stable_nodes)
+{
+    for ( auto mode : modes )
+    {
+        SFXHASH* t = new_table(mode, 8);
+        Key k = make_key(0);
+        Data d = { 0, { } };
+
+        sfxhash_add(t, &k, &d);
+        void* pv = sfxhash_find(t, &k);
+
+        for ( uint32_t i = 1; i < 5000; ++i )
+        {
+            Key k2 = make_key(i);
+            sfxhash_add(t, &k2, &d);
+        }
+        CHECK(sfxhash_find(t, &k) == pv);
+        sfxhash_delete(t);
+    }
+}
+
+TEST(sfxhash, iterate)
+{
+    const unsigned num = 300;
+
+    for ( auto mode : modes )
+    {
+        SFXHASH* t = new_table(mode);
+
+        for ( uint32_t i = 0; i < num; ++i )
+        {
+            Key k = make_key(i);
+            Data d = { i, { } };
+            sfxhash_add(t, &k, &d);
+        }
+
+        std::set<uint32_t> seen;
+
+        for ( SFXHASH_NODE* n = sfxhash_ghead(t); n; n = sfxhash_gnext(n) )
+            seen.insert(((Data*)n->data)->n);
+
+        CHECK(seen.size() == num);
+        seen.clear();
+
+        for ( SFXHASH_NODE* n = sfxhash_gfindfirst(t); n; n = sfxhash_gfindnext(t) )
+            seen.insert(((Data*)n->data)->n);
+
+        CHECK(seen.size() == num);
+        seen.clear();
+
+        // removing the current node is safe
+        for ( SFXHASH_NODE* n = sfxhash_findfirst(t); n; n = sfxhash_findnext(t) )
+        {
+            uint32_t i = ((Data*)n->data)->n;
+            seen.insert(i);
+
+            if ( i % 3 == 0 )
+                CHECK(sfxhash_remove(t, n->key) == SFXHASH_OK);
+        }
+        CHECK(seen.size() == num);
+        CHECK(sfxhash_count(t) == num - (num + 2) / 3);
+
+        sfxhash_delete(t);
+    }
+}
+
+//  A negative nrows is used as is; the flat index still rounds it up.
+TEST(sfxhash, negative_rows)
+{
+    for ( auto mode : modes )
+    {
+        SFXHASH* t = new_table(mode, -100);
+
+        for ( uint32_t i = 0; i < 1000; ++i )
+        {
+            Key k = make_key(i);
+            Data d = { i, { } };
+            CHECK(sfxhash_add(t, &k, &d) == SFXHASH_OK);
+        }
+        CHECK(sfxhash_count(t) == 1000);
+
+        for ( uint32_t i = 0; i < 1000; ++i )
+        {
+            Key k = make_key(i);
+            Data* pd = (Data*)sfxhash_find(t, &k);
+            CHECK(pd and pd->n == i);
+        }
+
+        Key k = make_key(1000);
+        CHECK(!sfxhash_find(t, &k));
+
+        sfxhash_delete(t);
+    }
+}
+
+//  The tag cache empties a table by removing the lru until there is none.
+TEST(sfxhash, lru_drain)
+{
+    for ( auto mode : modes )
+    {
+        SFXHASH* t = new_table(mode);
+
+        for ( uint32_t i = 0; i < 100; ++i )
+        {
+            Key k = make_key(i);
+            Data d = { i, { } };
+            sfxhash_add(t, &k, &d);
+        }
+
+        unsigned n = 0;
+        SFXHASH_NODE* hnode;
+
+        while ( (hnode = sfxhash_lru_node(t)) )
+        {
+            CHECK(sfxhash_lru(t) == hnode->data);
+            sfxhash_free_node(t, hnode);
+            n++;
+        }
+        CHECK(n == 100);
+        CHECK(sfxhash_count(t) == 0);
+        CHECK(!sfxhash_mru(t));
+
+        sfxhash_delete(t);
+    }
+}
+
+//  After recovery has swept some nodes, a drain that also finds nodes
+//  still reaches every node once.
+TEST(sfxhash, lru_drain_recovered)
+{
+    for ( auto mode : modes )
+    {
+        SFXHASH* t = new_table(mode, 256, 0, 1);
+        sfxhash_set_max_nodes(t, 200);
+
+        for ( uint32_t i = 0; i < 300; ++i )
+        {
+            Key k = make_key(i);
+            Data d = { i, { } };
+            sfxhash_add(t, &k, &d);
+        }
+        CHECK(sfxhash_count(t) == 200);
+
+        unsigned n = 0;
+        SFXHASH_NODE* hnode;
+
+        while ( (hnode = sfxhash_lru_node(t)) )
+        {
+            if ( n % 2 )
+            {
+                Key k = make_key(((Data*)hnode->data)->n + 1);
+                sfxhash_find(t, &k);
+            }
+            CHECK(sfxhash_lru(t) == hnode->data);
+            sfxhash_free_node(t, hnode);
+            n++;
+        }
+        CHECK(n == 200);
+        CHECK(sfxhash_count(t) == 0);
+
+        sfxhash_delete(t);
+    }
+}
+
+TEST(sfxhash, make_empty)
+{
+    for ( auto mode : modes )
+    {
+        usr_frees = 0;
+        SFXHASH* t = new_table(mode);
+
+        for ( uint32_t i = 0; i < 50; ++i )
+        {
+            Key k = make_key(i);
+            sfxhash_add(t, &k, nullptr);
+        }
+        CHECK(sfxhash_make_empty(t) == 0);
+        CHECK(usr_frees == 50);
+        CHECK(sfxhash_count(t) == 0);
+        CHECK(!sfxhash_ghead(t));
+
+        for ( uint32_t i = 0; i < 50; ++i )
+        {
+            Key k = make_key(i + 1000);
+            CHECK(sfxhash_add(t, &k, nullptr) == SFXHASH_OK);
+        }
+        CHECK(sfxhash_count(t) == 50);
+        sfxhash_delete(t);
+    }
+}
+
+//  Under a memcap nodes are recovered, skipping those the user keeps, and
+//  without recovery adds fail once the memcap is reached.
+TEST(sfxhash, memcap)
+{
+    const unsigned long memcap = 64 * 1024;
+
+    for ( auto mode : modes )
+    {
+        SFXHASH* t = new_table(mode, 256, memcap, 1);
+        unsigned nomem = 0;
+
+        for ( uint32_t i = 0; i < 20000; ++i )
+        {
+            Key k = make_key(i);
+            Data d = { i, { } };
+
+            if ( sfxhash_add(t, &k, &d) != SFXHASH_OK )
+                nomem++;
+        }
+        CHECK(nomem == 0);
+        CHECK(sfxhash_anr_count(t) > 0);
+        CHECK(anr_refused > 0);
+        CHECK(t->mc.memused <= memcap);
+
+        Key k = make_key(19999);
+        CHECK(sfxhash_find(t, &k));
+
+        k = make_key(3);
+        CHECK(sfxhash_find(t, &k));
+
+        // everything is kept now so there is nothing to recover
+        anr_refuse_all = true;
+        k = make_key(20000);
+        CHECK(sfxhash_add(t, &k, nullptr) == SFXHASH_NOMEM);
+        anr_refuse_all = false;
+
+        sfxhash_delete(t);
+
+        t = new_table(mode, 256, memcap, 0);
+        nomem = 0;
+
+        for ( uint32_t i = 0; i < 20000; ++i )
+        {
+            Key k2 = make_key(i);
+
+            if ( sfxhash_add(t, &k2, nullptr) == SFXHASH_NOMEM )
+                nomem++;
+        }
+        CHECK(nomem > 0);
+        CHECK(sfxhash_count(t) + nomem == 20000);
+        sfxhash_delete(t);
+    }
+}
+
+TEST(sfxhash, max_nodes)
+{
+    for ( auto mode : modes )
+    {
+        SFXHASH* t = new_table(mode, 256, 0, 1);
+        sfxhash_set_max_nodes(t, 100);
+
+        for ( uint32_t i = 0; i < 1000; ++i )
+        {
+            Key k = make_key(i);
+            sfxhash_add(t, &k, nullptr);
+        }
+        CHECK(sfxhash_count(t) == 100);
+        CHECK(sfxhash_anr_count(t) == 900);
+        CHECK(sfxhash_maxdepth(t) > 0);
+
+        sfxhash_delete(t);
+    }
+}
+
+//-------------------------------------------------------------------------
+// benchmark; ignored by default, run with -ri
+//-------------------------------------------------------------------------
+
+static double ns_per(Stopwatch<std::chrono::steady_clock>& sw, unsigned n)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+    return (double)ns / n;
+}
+
+TEST_GROUP(sfxhash_perf) { };
+
+//  Entries per row of a table sized like the portscan and threshold
+//  tables.  Lookups go to random keys so they miss the cache like
+//  traffic from many hosts does.
+IGNORE_TEST(sfxhash_perf, load_factor)
+{
+    const unsigned rows = 1 << 17;
+    const double loads[] = { 0.5, 0.75, 0.85 };
+    const unsigned lookups = 4000000;
+
+    printf("\nns per operation\n");
+    printf("%5s %8s %10s %10s %10s\n", "load", "table", "insert", "hit", "miss");
+
+    for ( auto lf : loads )
+    {
+        unsigned num = (unsigned)(rows * lf);
+        std::vector<Key> keys;
+
+        for ( uint32_t i = 0; i < num; ++i )
+            keys.push_back(make_key(i));
+
+        for ( auto mode : modes )
+        {
+            SFXHASH* t = sfxhash_new(rows, sizeof(Key), sizeof(Data), 0, 0,
+                nullptr, nullptr, 1, mode);
+            Data d = { 0, { } };
+
+            Stopwatch<std::chrono::steady_clock> sw;
+            sw.start();
+
+            for ( auto& k : keys )
+                sfxhash_add(t, &k, &d);
+
+            sw.stop();
+            double insert = ns_per(sw, num);
+
+            uint32_t x = 2463534242u;
+            unsigned found = 0;
+
+            sw.reset();
+            sw.start();
+
+            for ( unsigned i = 0; i < lookups; ++i )
+            {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+
+                if ( sfxhash_find(t, &keys[x % num]) )
+                    found++;
+            }
+            sw.stop();
+            double hit = ns_per(sw, lookups);
+            CHECK(found == lookups);
+
+            sw.reset();
+            sw.start();
+
+            for ( unsigned i = 0; i < lookups; ++i )
+            {
+                Key k = make_key(num + i);
+
+                if ( sfxhash_find(t, &k) )
+                    found++;
+            }
+            sw.stop();
+            double miss = ns_per(sw, lookups);
+            CHECK(found == lookups);
+
+            printf("%5.2f %8s %10.1f %10.1f %10.1f\n", lf,
+                mode ? "flat" : "chained", insert, hit, miss);
+
+            sfxhash_delete(t);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -251,7 +251,7 @@ ZHash::ZHash(int rows, int keysz)
     }
 
     /* this has a default hashing function */
-    sfhashfcn = sfhashfcn_new(rows);
+    sfhashfcn = sfhashfcn_new(rows, keysz);
 
     /* Allocate the array of node ptrs */
     table = new ZHashNode*[rows]();
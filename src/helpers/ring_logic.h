@@ -94,9 +94,10 @@ inline int RingLogic::count()
     return c;
 }
 
+// one slot is always kept open between wx and rx
 inline bool RingLogic::full()
 {
-    return ( count() == sz );
+    return ( write() < 0 );
 }
 
 inline bool RingLogic::empty()
@@ -26,7 +26,7 @@
 
 #include <functional>
 #include "host_tracker/host_tracker.h"
-#include "hash/lru_cache_shared.h"
+#include "hash/lru_cache_sharded.h"
 #include "main/snort_types.h"
 
 
@@ -64,7 +64,7 @@ struct HashHostIpKey
     }
 };
 
-extern LruCacheShared<HostIpKey, std::shared_ptr<HostTracker>, HashHostIpKey> host_cache;
+extern LruCacheSharded<HostIpKey, std::shared_ptr<HostTracker>, HashHostIpKey> host_cache;
 
 void host_cache_add_host_tracker(HostTracker*);
 
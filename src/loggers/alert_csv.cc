@@ -476,6 +476,7 @@ public:
 
     void open() override;
     void close() override;
+    void flush() override;
 
     void alert(Packet*, const char* msg, Event*) override;
 
@@ -505,6 +506,12 @@ void CsvLogger::close()
         TextLog_Term(csv_log);
 }
 
+void CsvLogger::flush()
+{
+    if ( csv_log )
+        TextLog_Flush(csv_log);
+}
+
 void CsvLogger::alert(Packet* p, const char* msg, Event* event)
 {
     Args a = { p, msg, event };
@@ -522,7 +529,9 @@ void CsvLogger::alert(Packet* p, const char* msg, Event* event)
     }
 
     TextLog_NewLine(csv_log);
-    TextLog_Flush(csv_log);
+
+    if ( !batched() )
+        TextLog_Flush(csv_log);
 }
 
 //-------------------------------------------------------------------------
@@ -160,6 +160,7 @@ public:
 
     void open() override;
     void close() override;
+    void flush() override;
 
     void alert(Packet*, const char* msg, Event*) override;
 
@@ -188,6 +189,12 @@ void FastLogger::close()
         TextLog_Term(fast_log);
 }
 
+void FastLogger::flush()
+{
+    if ( fast_log )
+        TextLog_Flush(fast_log);
+}
+
 void FastLogger::alert(Packet* p, const char* msg, Event* event)
 {
     LogTimeStamp(fast_log, p);
@@ -238,7 +245,9 @@ void FastLogger::alert(Packet* p, const char* msg, Event* event)
 #endif
     }
     TextLog_NewLine(fast_log);
-    TextLog_Flush(fast_log);
+
+    if ( !batched() )
+        TextLog_Flush(fast_log);
 }
 
 //-------------------------------------------------------------------------
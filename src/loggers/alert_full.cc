@@ -145,6 +145,7 @@ public:
 
     void open() override;
     void close() override;
+    void flush() override;
 
     void alert(Packet*, const char* msg, Event*) override;
 
@@ -170,6 +171,12 @@ void FullLogger::close()
         TextLog_Term(full_log);
 }
 
+void FullLogger::flush()
+{
+    if ( full_log )
+        TextLog_Flush(full_log);
+}
+
 void FullLogger::alert(Packet* p, const char* msg, Event* event)
 {
     {
@@ -250,7 +257,9 @@ void FullLogger::alert(Packet* p, const char* msg, Event* event)
     {
         TextLog_Puts(full_log, "\n\n");
     }
-    TextLog_Flush(full_log);
+
+    if ( !batched() )
+        TextLog_Flush(full_log);
 }
 
 //-------------------------------------------------------------------------
@@ -165,7 +165,7 @@ static void LogTcpdumpSingle(
     pcap_dump((u_char*)context.dumpd,(struct pcap_pkthdr*)p->pkth,p->pkt);
     context.size += dumpSize;
 
-    if (!SnortConfig::line_buffered_logging())  // FIXIT-L misnomer
+    if (!SnortConfig::line_buffered_logging() and !Logger::batched())  // FIXIT-L misnomer
     {
         fflush( (FILE*)context.dumpd);
     }
@@ -278,6 +278,7 @@ public:
     void open() override;
     void close() override;
     void reset() override;
+    void flush() override;
 
     void log(Packet*, const char* msg, Event*) override;
 
@@ -314,6 +315,12 @@ void PcapLogger::close()
         snort_free(context.file);
 }
 
+void PcapLogger::flush()
+{
+    if ( context.dumpd )
+        fflush((FILE*)context.dumpd);
+}
+
 void PcapLogger::log(Packet* p, const char* msg, Event* event)
 {
     if(!context.dumpd)
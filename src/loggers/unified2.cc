@@ -602,9 +602,10 @@ static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config
     if ((buf == NULL) || (config == NULL) || (u2.stream == NULL))
         return;
 
-    /* Don't use fsync().  It is a total performance killer */
+    /* Don't use fsync().  It is a total performance killer.  Output
+     * threads leave records buffered until the end of the batch. */
     if (((fwcount = fwrite(buf, (size_t)buf_len, 1, u2.stream)) != 1) ||
-        ((ffstatus = fflush(u2.stream)) != 0))
+        (!Logger::batched() && ((ffstatus = fflush(u2.stream)) != 0)))
     {
         /* errno is saved just to avoid other intervening calls
          * (e.g. ErrorMessage) potentially reseting it to something else. */
@@ -844,6 +845,7 @@ public:
 
     void alert(Packet*, const char* msg, Event*) override;
     void log(Packet*, const char* msg, Event*) override;
+    void flush() override;
 
 private:
     Unified2Config config;
@@ -888,6 +890,12 @@ void U2Logger::close()
         fclose(u2.stream);
 }
 
+void U2Logger::flush()
+{
+    if ( u2.stream )
+        fflush(u2.stream);
+}
+
 void U2Logger::alert(Packet* p, const char* msg, Event* event)
 {
     if (p->ptrs.ip_api.is_ip6())
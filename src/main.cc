@@ -49,6 +49,7 @@
 #include "main/snort_module.h"
 #include "main/thread_config.h"
 #include "framework/module.h"
+#include "managers/event_manager.h"
 #include "managers/module_manager.h"
 #include "managers/plugin_manager.h"
 #include "managers/inspector_manager.h"
@@ -928,6 +929,8 @@ static void snort_main()
     if ( SnortConfig::log_verbose() )
         memory::MemoryCap::print();
 
+    EventManager::start_outputs(snort_conf);
+
     main_loop();
 
     for (unsigned idx = 0; idx < max_pigs; idx++)
@@ -939,6 +942,9 @@ static void snort_main()
     delete[] pigs;
     pigs = nullptr;
 
+    // after the packet threads so their queued events are written
+    EventManager::stop_outputs();
+
 #ifdef SHELL
     socket_term();
 #endif
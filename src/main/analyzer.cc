@@ -28,6 +28,7 @@
 #include "thread.h"
 #include "helpers/swapper.h"
 #include "log/messages.h"
+#include "managers/event_manager.h"
 #include "memory/memory_cap.h"
 #include "packet_io/sfdaq.h"
 
@@ -216,6 +217,8 @@ bool Analyzer::handle_command()
         case AC_SWAP:
             if (swap)
             {
+                // queued events refer to the old config
+                EventManager::drain_outputs();
                 swap->apply();
                 swap = nullptr;
             }
@@ -42,6 +42,7 @@
 #include "host_tracker/host_cache_module.h"
 #include "latency/latency_module.h"
 #include "log/messages.h"
+#include "managers/async_output.h"
 #include "managers/module_manager.h"
 #include "managers/plugin_manager.h"
 #include "memory/memory_module.h"
@@ -624,6 +625,9 @@ static const Parameter alerts_params[] =
     { "rate_filter_memcap", Parameter::PT_INT, "0:", "1048576",
       "set available memory for filters" },
 
+    { "rate_filter_sync", Parameter::PT_INT, "0:60", "1",
+      "seconds between merging per thread rate_filter counts; 0 merges on every event" },
+
     { "reference_net", Parameter::PT_STRING, nullptr, nullptr,
       "set the CIDR for homenet "
       "(for use with -l or -B, does NOT change $HOME_NET in IDS mode)" },
@@ -667,6 +671,9 @@ bool AlertsModule::set(const char*, Value& v, SnortConfig* sc)
     else if ( v.is("rate_filter_memcap") )
         sc->rate_filter_config->memcap = v.get_long();
 
+    else if ( v.is("rate_filter_sync") )
+        sc->rate_filter_config->sync_interval = v.get_long();
+
     else if ( v.is("reference_net") )
         return ( sfip_pton(v.get_string(), &sc->homenet) == SFIP_SUCCESS );
 
@@ -694,6 +701,23 @@ static const Parameter output_event_trace_params[] =
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
+static const Parameter output_async_params[] =
+{
+    { "writers", Parameter::PT_INT, "0:32", "0",
+      "number of output threads; 0 calls loggers on the packet threads" },
+
+    { "ring_size", Parameter::PT_INT, "256:1048576", "1024",
+      "KB of queued events per packet thread" },
+
+    { "ring_full", Parameter::PT_ENUM, "drop | block | sample", "drop",
+      "what packet threads do with events when their ring is full" },
+
+    { "sample_rate", Parameter::PT_INT, "1:", "10",
+      "with ring_full = sample, wait for 1 in this many events and drop the rest" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
 static const Parameter output_params[] =
 {
     { "dump_chars_only", Parameter::PT_BOOL, nullptr, "false",
@@ -711,6 +735,9 @@ static const Parameter output_params[] =
     { "event_trace", Parameter::PT_TABLE, output_event_trace_params, nullptr,
       "" },
 
+    { "async", Parameter::PT_TABLE, output_async_params, nullptr,
+      "write events from dedicated output threads" },
+
     { "quiet", Parameter::PT_BOOL, nullptr, "false",
       "suppress non-fatal information (still show alerts, same as -q)" },
 
@@ -743,6 +770,12 @@ class OutputModule : public Module
 public:
     OutputModule() : Module("output", output_help, output_params) { }
     bool set(const char*, Value&, SnortConfig*) override;
+
+    const PegInfo* get_pegs() const override
+    { return async_output_pegs; }
+
+    PegCount* get_counts() const override
+    { return (PegCount*)&async_output_stats; }
 };
 
 bool OutputModule::set(const char*, Value& v, SnortConfig* sc)
@@ -781,6 +814,18 @@ bool OutputModule::set(const char*, Value& v, SnortConfig* sc)
     else if ( v.is("tagged_packet_limit") )
         sc->tagged_packet_limit = v.get_long();
 
+    else if ( v.is("writers") )
+        sc->async_writers = v.get_long();
+
+    else if ( v.is("ring_size") )
+        sc->async_ring_size = v.get_long();
+
+    else if ( v.is("ring_full") )
+        sc->async_full = v.get_long();
+
+    else if ( v.is("sample_rate") )
+        sc->async_sample_rate = v.get_long();
+
     else if ( v.is("verbose") )
         v.update_mask(sc->logging_flags, LOGGING_FLAG__VERBOSE);
 
@@ -965,6 +1010,9 @@ static const Parameter network_params[] =
       "all | ip | noip | tcp | notcp | udp | noudp | icmp | noicmp | none", "none",
       "checksums to verify" },
 
+    { "checksum_offload", Parameter::PT_BOOL, nullptr, "false",
+      "don't verify tcp checksums the daq reports were verified by the nic" },
+
     { "decode_drops", Parameter::PT_BOOL, nullptr, "false",
       "enable dropping of packets by the decoder" },
 
@@ -1012,6 +1060,9 @@ bool NetworkModule::set(const char*, Value& v, SnortConfig* sc)
     else if ( v.is("checksum_eval") )
         ConfigChecksumMode(sc, v.get_string());
 
+    else if ( v.is("checksum_offload") )
+        p->checksum_offload = v.get_bool();
+
     else if ( v.is("decode_drops") )
         p->decoder_drop = v.get_bool();
 
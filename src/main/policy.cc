@@ -47,6 +47,7 @@ NetworkPolicy::NetworkPolicy(PolicyId id)
 
     checksum_eval = CHECKSUM_FLAG__ALL | CHECKSUM_FLAG__DEF;
     checksum_drop = CHECKSUM_FLAG__DEF;
+    checksum_offload = false;
 }
 
 NetworkPolicy::~NetworkPolicy()
@@ -80,7 +81,7 @@ InspectionPolicy::~InspectionPolicy()
 
 void InspectionPolicy::configure()
 {
-    dbus.subscribe(PACKET_EVENT, new AltPktHandler);
+    dbus.subscribe(PACKET_EVENT_ID, new AltPktHandler);
 }
 
 //-------------------------------------------------------------------------
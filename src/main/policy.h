@@ -79,6 +79,7 @@ public:
     uint32_t checksum_drop;
     uint32_t normal_mask;
 
+    bool checksum_offload;
     bool decoder_drop;
 };
 
@@ -35,6 +35,7 @@
 #include <netinet/in.h>
 #include <sys/stat.h>
 
+#include "codecs/codec_module.h"
 #include "decompress/file_decomp.h"
 #include "detection/detect.h"
 #include "detection/detection_util.h"
@@ -71,6 +72,7 @@
 #include "profiler/profiler.h"
 #include "protocols/packet.h"
 #include "protocols/packet_manager.h"
+#include "search_engines/search_tool.h"
 #include "side_channel/side_channel.h"
 #include "stream/stream.h"
 #include "target_based/sftarget_reader.h"
@@ -138,6 +140,9 @@ static ProfileStats* get_profile(const char* key)
     if ( !strcmp(key, "decode") )
         return &decodePerfStats;
 
+    if ( !strcmp(key, "checksum") )
+        return &checksumPerfStats;
+
     if ( !strcmp(key, "eventq") )
         return &eventqPerfStats;
 
@@ -160,6 +165,7 @@ static void register_profiles()
     Profiler::register_module("rule_tree_eval", "rule_eval", get_profile);
     Profiler::register_module("nfp_rule_tree_eval", "rule_eval", get_profile);
     Profiler::register_module("decode", nullptr, get_profile);
+    Profiler::register_module("checksum", nullptr, get_profile);
     Profiler::register_module("eventq", nullptr, get_profile);
     Profiler::register_module("total", nullptr, get_profile);
     Profiler::register_module("daq_meta", nullptr, get_profile);
@@ -278,6 +284,8 @@ void Snort::init(int argc, char** argv)
     else if ( SnortConfig::log_verbose() )
         InspectorManager::print_config(snort_conf);
 
+    SearchTool::show_shared();
+
     if (snort_conf->file_mask != 0)
         umask(snort_conf->file_mask);
     else
@@ -535,6 +543,8 @@ SnortConfig* Snort::get_reload_config(const char* fname)
         return NULL;
     }
 
+    SearchTool::show_shared();
+
     FlowbitResetCounts();  // FIXIT-L updates global hash, put in sc
 
     if ((sc->file_mask != 0) && (sc->file_mask != snort_conf->file_mask))
@@ -604,6 +614,7 @@ void Snort::thread_idle()
     Stream::timeout_flows(time(nullptr));
     perf_monitor_idle_process();
     aux_counts.idle++;
+    HighAvailabilityManager::flush();
     HighAvailabilityManager::process_receive();
 }
 
@@ -673,6 +684,7 @@ void Snort::thread_term()
     ModuleManager::accumulate(snort_conf);
     InspectorManager::thread_term(snort_conf);
     ActionManager::thread_term(snort_conf);
+    RateFilter_ThreadTerm();
 
     IpsManager::clear_options();
     EventManager::close_outputs();
@@ -783,6 +795,11 @@ static DAQ_Verdict update_verdict(DAQ_Verdict verdict, int& inject)
         PacketManager::encode_update(s_packet);
         verdict = DAQ_VERDICT_REPLACE;
     }
+    else if ( s_packet->packet_flags & PKT_CKSUM_ADJUSTED )
+    {
+        // all edits fixed their own checksums
+        verdict = DAQ_VERDICT_REPLACE;
+    }
     else if ( s_packet->packet_flags & PKT_RESIZED )
     {
         // we never increase, only trim, but
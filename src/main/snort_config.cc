@@ -151,6 +151,10 @@ static void init_policies(SnortConfig* sc)
  * among run_modes is how we handle packets via the log_func. */
 SnortConfig::SnortConfig()
 {
+    // only constructed on the main thread
+    static unsigned configs = 0;
+    generation = ++configs;
+
     num_layers = DEFAULT_LAYERMAX;
 
     max_attribute_hosts = DEFAULT_MAX_ATTRIBUTE_HOSTS;
@@ -176,6 +176,16 @@ public:
     uint16_t event_trace_max = 0;
     long int tagged_packet_limit = 256;
 
+    // output threads are started once so only the ring_full
+    // policy and sample rate take effect on reload
+    unsigned async_writers = 0;
+    unsigned async_ring_size = 1024;  // KB per packet thread
+    uint8_t async_full = 0;           // AsyncFullPolicy
+    unsigned async_sample_rate = 10;
+
+    // distinguishes configs across reloads even if an address is reused
+    unsigned generation;
+
     std::string log_dir;
 
     //------------------------------------------------------
@@ -458,6 +468,13 @@ public:
     static bool tcp_checksum_drops()
     { return ::get_network_policy()->checksum_drop & CHECKSUM_FLAG__TCP; }
 
+    // the daq only flags the outermost tcp header
+    static bool tcp_checksum_offloaded(const DAQ_PktHdr_t* h)
+    {
+        return (h->flags & DAQ_PKT_FLAG_HW_TCP_CS_GOOD) and
+            ::get_network_policy()->checksum_offload;
+    }
+
     static bool icmp_checksums()
     { return ::get_network_policy()->checksum_eval & CHECKSUM_FLAG__ICMP; }
 
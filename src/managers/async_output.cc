@@ -0,0 +1,591 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// async_output.cc
+
+#include "async_output.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "codec_manager.h"
+#include "event_manager.h"
+
+#include "events/event.h"
+#include "log/messages.h"
+#include "main/policy.h"
+#include "main/snort_config.h"
+#include "main/thread_config.h"
+#include "protocols/packet.h"
+#include "protocols/packet_manager.h"
+#include "utils/stats.h"
+
+const PegInfo async_output_pegs[] =
+{
+    { "async queued", "events queued for output threads" },
+    { "async dropped", "events discarded because a ring was full" },
+    { "async blocked", "events that waited for room in a full ring" },
+    { nullptr, nullptr }
+};
+
+THREAD_LOCAL AsyncOutputStats async_output_stats;
+
+bool AsyncOutput::running = false;
+
+//-------------------------------------------------------------------------
+// ring
+//
+// byte ring with one producer (a packet thread) and one consumer (an
+// output thread).  records are 8 byte aligned and never wrap; a zero
+// size at the end of the buffer tells the consumer to go back to the
+// start.  head and tail only increase and are reduced modulo size.
+//-------------------------------------------------------------------------
+
+class EventRing
+{
+public:
+    EventRing(unsigned bytes);
+    ~EventRing();
+
+    // producer
+    uint8_t* reserve(unsigned len);
+    void commit();
+
+    // consumer
+    const uint8_t* peek();
+    void release(unsigned len);
+
+    // records written but not yet released
+    uint64_t depth() const
+    { return pushed - popped.load(std::memory_order_acquire); }
+
+    // largest record that is guaranteed to fit
+    unsigned max_record() const
+    { return size / 2; }
+
+private:
+    uint8_t* buf;
+    unsigned size;
+
+    // producer only
+    uint64_t next;
+    uint64_t pushed;
+
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> popped;
+};
+
+EventRing::EventRing(unsigned bytes)
+{
+    size = bytes & ~7u;
+    buf = new uint8_t[size];
+    next = pushed = 0;
+    head = tail = popped = 0;
+}
+
+EventRing::~EventRing()
+{
+    delete[] buf;
+}
+
+uint8_t* EventRing::reserve(unsigned len)
+{
+    uint64_t h = head.load(std::memory_order_relaxed);
+    uint64_t t = tail.load(std::memory_order_acquire);
+
+    unsigned pos = h % size;
+    unsigned skip = (size - pos < len) ? size - pos : 0;
+
+    if ( size - (h - t) < skip + len )
+        return nullptr;
+
+    if ( skip )
+        *(uint32_t*)(buf + pos) = 0;
+
+    next = h + skip + len;
+    return buf + (skip ? 0 : pos);
+}
+
+void EventRing::commit()
+{
+    ++pushed;
+    head.store(next, std::memory_order_release);
+}
+
+const uint8_t* EventRing::peek()
+{
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    uint64_t h = head.load(std::memory_order_acquire);
+
+    if ( t == h )
+        return nullptr;
+
+    unsigned pos = t % size;
+
+    if ( *(uint32_t*)(buf + pos) )
+        return buf + pos;
+
+    // wrap marker; the producer only writes one when a record follows
+    tail.store(t + size - pos, std::memory_order_release);
+    return buf;
+}
+
+void EventRing::release(unsigned len)
+{
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    tail.store(t + len, std::memory_order_release);
+    popped.fetch_add(1, std::memory_order_release);
+}
+
+//-------------------------------------------------------------------------
+// records
+//-------------------------------------------------------------------------
+
+enum RecordType : uint8_t
+{
+    REC_ALERT,
+    REC_LOG
+};
+
+struct EventRecord
+{
+    uint32_t size;           // of the whole record; never zero
+    RecordType type;
+    bool has_event;
+    uint16_t msg_len;        // including terminator, 0 if no message
+    uint32_t packet_flags;
+
+    OutputSet* idx;
+    SnortConfig* conf;
+    unsigned generation;     // of conf; the address may be reused on reload
+
+    Event event;
+    DAQ_PktHdr_t pkth;
+
+    // followed by pkth.caplen bytes of packet and then the message
+};
+
+static inline unsigned record_size(unsigned data_len)
+{
+    return (sizeof(EventRecord) + data_len + 7) & ~7u;
+}
+
+//-------------------------------------------------------------------------
+// shared state
+//-------------------------------------------------------------------------
+
+// output threads drain the same rings after each batch
+static const unsigned batch_size = 64;
+
+// rings are indexed by packet thread instance id
+static std::atomic<EventRing*>* rings = nullptr;
+static unsigned num_rings = 0;
+static unsigned ring_bytes = 0;
+
+static std::vector<std::thread*> writers;
+static std::atomic<bool> stopping;
+
+// high water mark over all rings; a sum of per thread maximums is
+// meaningless so this isn't a peg
+static std::atomic<unsigned> max_depth;
+
+static THREAD_LOCAL EventRing* t_ring = nullptr;
+static THREAD_LOCAL unsigned t_full = 0;
+
+// of the config the output thread is running with
+static THREAD_LOCAL unsigned t_generation = 0;
+
+//-------------------------------------------------------------------------
+// output thread
+//-------------------------------------------------------------------------
+
+static void dispatch(const EventRecord* rec, Packet* p)
+{
+    if ( rec->generation != t_generation )
+    {
+        snort_conf = rec->conf;
+        t_generation = rec->generation;
+        set_default_policy();
+    }
+
+    const uint8_t* data = (const uint8_t*)(rec + 1);
+
+    // cooked suppresses decoder events, which were already raised
+    PacketManager::decode(p, &rec->pkth, data, true);
+    p->packet_flags |= rec->packet_flags;
+
+    const char* msg = rec->msg_len ? (const char*)data + rec->pkth.caplen : nullptr;
+    Event* event = rec->has_event ? const_cast<Event*>(&rec->event) : nullptr;
+
+    if ( rec->type == REC_ALERT )
+        EventManager::call_alerters(rec->idx, p, msg, event);
+    else
+        EventManager::call_loggers(rec->idx, p, msg, event);
+}
+
+static unsigned drain_ring(EventRing* ring, Packet* p)
+{
+    unsigned n = 0;
+
+    while ( n < batch_size )
+    {
+        const EventRecord* rec = (const EventRecord*)ring->peek();
+
+        if ( !rec )
+            break;
+
+        dispatch(rec, p);
+        ring->release(rec->size);
+        ++n;
+    }
+    return n;
+}
+
+static void writer(unsigned id, unsigned num_writers, SnortConfig* sc)
+{
+    set_thread_type(STHREAD_TYPE_OUTPUT);
+    set_instance_id(id);
+
+    snort_conf = sc;
+    t_generation = sc->generation;
+    set_default_policy();
+
+    CodecManager::thread_init(sc);
+    Packet* p = new Packet(false);
+
+    EventManager::open_outputs();
+
+    while ( true )
+    {
+        // check before draining so the last pass sees every record
+        bool done = stopping.load(std::memory_order_acquire);
+        unsigned n = 0;
+
+        for ( unsigned i = id; i < num_rings; i += num_writers )
+        {
+            EventRing* ring = rings[i].load(std::memory_order_acquire);
+
+            if ( ring )
+                n += drain_ring(ring, p);
+        }
+
+        if ( n )
+            EventManager::flush_outputs();
+
+        else if ( done )
+            break;
+
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EventManager::close_outputs();
+    delete p;
+
+    // packets decoded here were already counted by the packet threads
+    CodecManager::thread_term(false);
+}
+
+//-------------------------------------------------------------------------
+// main thread
+//-------------------------------------------------------------------------
+
+void AsyncOutput::start(SnortConfig* sc)
+{
+    if ( !sc->async_writers )
+        return;
+
+    num_rings = ThreadConfig::get_instance_max();
+    ring_bytes = sc->async_ring_size * 1024;
+
+    rings = new std::atomic<EventRing*>[num_rings];
+
+    for ( unsigned i = 0; i < num_rings; ++i )
+        rings[i] = nullptr;
+
+    // no point in more writers than rings
+    unsigned n = sc->async_writers < num_rings ? sc->async_writers : num_rings;
+    stopping = false;
+    max_depth = 0;
+
+    for ( unsigned i = 0; i < n; ++i )
+        writers.push_back(new std::thread(writer, i, n, sc));
+
+    running = true;
+    LogMessage("async output: %u output threads, %u KB per packet thread\n",
+        n, sc->async_ring_size);
+}
+
+void AsyncOutput::stop()
+{
+    if ( !running )
+        return;
+
+    stopping.store(true, std::memory_order_release);
+
+    for ( auto* t : writers )
+    {
+        t->join();
+        delete t;
+    }
+    writers.clear();
+
+    for ( unsigned i = 0; i < num_rings; ++i )
+        delete rings[i].load();
+
+    delete[] rings;
+    rings = nullptr;
+    num_rings = 0;
+    running = false;
+
+    LogLabel("async output");
+    LogCount("max depth", max_depth.load());
+}
+
+//-------------------------------------------------------------------------
+// packet thread
+//-------------------------------------------------------------------------
+
+void AsyncOutput::tinit()
+{
+    unsigned id = get_instance_id();
+    assert(id < num_rings);
+
+    // the ring outlives the packet thread so that the output threads can
+    // finish it after the packet thread exits
+    t_ring = new EventRing(ring_bytes);
+    rings[id].store(t_ring, std::memory_order_release);
+}
+
+// wait until this thread's events are written, eg before swapping in a new
+// config, since records point into the current one
+void AsyncOutput::drain()
+{
+    if ( !t_ring )
+        return;
+
+    while ( t_ring->depth() )
+        std::this_thread::yield();
+}
+
+static uint8_t* ring_full(EventRing* ring, unsigned len)
+{
+    switch ( snort_conf->async_full )
+    {
+    case ASYNC_FULL_SAMPLE:
+        if ( ++t_full % snort_conf->async_sample_rate )
+            break;
+        // fall through
+
+    case ASYNC_FULL_BLOCK:
+    {
+        async_output_stats.blocked++;
+        uint8_t* buf;
+
+        while ( !(buf = ring->reserve(len)) )
+            std::this_thread::yield();
+
+        return buf;
+    }
+
+    default:
+        break;
+    }
+    async_output_stats.dropped++;
+    return nullptr;
+}
+
+static void enqueue(
+    RecordType type, OutputSet* idx, Packet* p, const char* msg, Event* event)
+{
+    EventRing* ring = t_ring;
+    assert(ring);
+
+    // loggers need the packet; everything logged today has one
+    if ( !p or !p->pkth or !p->pkt )
+    {
+        async_output_stats.dropped++;
+        return;
+    }
+
+    unsigned caplen = p->pkth->caplen;
+    unsigned msg_len = msg ? strlen(msg) + 1 : 0;
+
+    if ( msg_len > UINT16_MAX )
+        msg_len = UINT16_MAX;
+
+    unsigned len = record_size(caplen + msg_len);
+
+    if ( len > ring->max_record() )
+    {
+        async_output_stats.dropped++;
+        return;
+    }
+
+    uint8_t* buf = ring->reserve(len);
+
+    if ( !buf and !(buf = ring_full(ring, len)) )
+        return;
+
+    EventRecord* rec = (EventRecord*)buf;
+
+    rec->size = len;
+    rec->type = type;
+    rec->has_event = (event != nullptr);
+    rec->msg_len = msg_len;
+    rec->packet_flags = p->packet_flags;
+    rec->idx = idx;
+    rec->conf = snort_conf;
+    rec->generation = snort_conf->generation;
+    rec->pkth = *p->pkth;
+
+    if ( event )
+        rec->event = *event;
+
+    uint8_t* data = (uint8_t*)(rec + 1);
+    memcpy(data, p->pkt, caplen);
+
+    if ( msg_len )
+    {
+        memcpy(data + caplen, msg, msg_len - 1);
+        data[caplen + msg_len - 1] = '\0';
+    }
+
+    ring->commit();
+
+    async_output_stats.queued++;
+    unsigned depth = ring->depth();
+    unsigned max = max_depth.load(std::memory_order_relaxed);
+
+    while ( depth > max and
+        !max_depth.compare_exchange_weak(max, depth, std::memory_order_relaxed) );
+}
+
+void AsyncOutput::alert(OutputSet* idx, Packet* p, const char* msg, Event* event)
+{ enqueue(REC_ALERT, idx, p, msg, event); }
+
+void AsyncOutput::log(OutputSet* idx, Packet* p, const char* msg, Event* event)
+{ enqueue(REC_LOG, idx, p, msg, event); }
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+#include "catch/catch.hpp"
+
+// variable size records with a sequence number and a fill pattern; sizes
+// are chosen to force frequent wraps
+static unsigned test_len(unsigned seq)
+{ return 8 + ((seq * 40503u) % 61) * 8; }
+
+TEST_CASE("event ring wrap", "[async_output]")
+{
+    EventRing ring(1024);
+    unsigned seq = 0, expect = 0;
+
+    for ( unsigned round = 0; round < 1000; ++round )
+    {
+        // fill until full then empty about half
+        while ( true )
+        {
+            unsigned len = test_len(seq);
+            uint8_t* buf = ring.reserve(len);
+
+            if ( !buf )
+                break;
+
+            *(uint32_t*)buf = len;
+            memset(buf + 4, seq & 0xFF, len - 4);
+            ring.commit();
+            ++seq;
+        }
+
+        uint64_t n = ring.depth() / 2 + 1;
+
+        while ( n-- )
+        {
+            const uint8_t* buf = ring.peek();
+            REQUIRE(buf);
+
+            unsigned len = *(const uint32_t*)buf;
+            REQUIRE(len == test_len(expect));
+            CHECK(buf[len - 1] == (expect & 0xFF));
+
+            ring.release(len);
+            ++expect;
+        }
+    }
+    CHECK(ring.depth() == seq - expect);
+}
+
+TEST_CASE("event ring threads", "[async_output]")
+{
+    const unsigned count = 200000;
+    EventRing ring(4096);
+    bool ok = true;
+
+    std::thread consumer([&]()
+    {
+        unsigned expect = 0;
+
+        while ( expect < count )
+        {
+            const uint8_t* buf = ring.peek();
+
+            if ( !buf )
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            unsigned len = *(const uint32_t*)buf;
+
+            if ( len != test_len(expect) or buf[len - 1] != (expect & 0xFF) )
+                ok = false;
+
+            ring.release(len);
+            ++expect;
+        }
+    });
+
+    for ( unsigned seq = 0; seq < count; ++seq )
+    {
+        unsigned len = test_len(seq);
+        uint8_t* buf;
+
+        while ( !(buf = ring.reserve(len)) )
+            std::this_thread::yield();
+
+        *(uint32_t*)buf = len;
+        memset(buf + 4, seq & 0xFF, len - 4);
+        ring.commit();
+    }
+
+    consumer.join();
+    CHECK(ok);
+    CHECK(ring.depth() == 0);
+}
+
+#endif
+
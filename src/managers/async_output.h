@@ -0,0 +1,82 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// async_output.h
+
+#ifndef ASYNC_OUTPUT_H
+#define ASYNC_OUTPUT_H
+
+// AsyncOutput moves Logger calls off the packet threads.  Each packet
+// thread serializes the event, the raw packet, and the message into its
+// own single producer / single consumer ring.  Output threads drain the
+// rings, decode the packet again, and call the configured loggers in
+// batches, flushing once per batch instead of once per event.
+//
+// Loggers run on the output threads with the packet thread's config but
+// without its flow, stream extra data, or active response state.
+
+#include <stdint.h>
+
+#include "framework/counts.h"
+#include "main/thread.h"
+
+struct Event;
+struct OutputSet;
+struct Packet;
+struct SnortConfig;
+
+// SnortConfig::async_full, in the order of the output.async.ring_full enum
+enum AsyncFullPolicy
+{
+    ASYNC_FULL_DROP,    // discard the event
+    ASYNC_FULL_BLOCK,   // wait for room
+    ASYNC_FULL_SAMPLE   // wait for 1 in sample_rate events, discard the rest
+};
+
+struct AsyncOutputStats
+{
+    PegCount queued;
+    PegCount dropped;
+    PegCount blocked;
+};
+
+extern const PegInfo async_output_pegs[];
+extern THREAD_LOCAL AsyncOutputStats async_output_stats;
+
+class AsyncOutput
+{
+public:
+    // main thread, before the packet threads start and after they stop
+    static void start(SnortConfig*);
+    static void stop();
+
+    static bool active()
+    { return running; }
+
+    // packet threads
+    static void tinit();
+    static void drain();
+
+    static void alert(OutputSet*, Packet*, const char* message, Event*);
+    static void log(OutputSet*, Packet*, const char* message, Event*);
+
+private:
+    static bool running;
+};
+
+#endif
+
@@ -248,11 +248,14 @@ void CodecManager::thread_init(SnortConfig* sc)
         ParseError("rand_open() failed.");
 
     rand_get(s_rand, s_id_pool.data(), s_id_pool.size());
+
+    PacketManager::thread_init();
 }
 
-void CodecManager::thread_term()
+void CodecManager::thread_term(bool accumulate)
 {
-    PacketManager::accumulate(); // statistics
+    if ( accumulate )
+        PacketManager::accumulate(); // statistics
 
     for ( CodecApiWrapper& wrap : s_codecs )
     {
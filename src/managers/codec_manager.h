@@ -87,7 +87,7 @@ public:
     // initialize the current threads DLT and Packet struct
     static void thread_init(SnortConfig*);
     // destroy thread_local data
-    static void thread_term();
+    static void thread_term(bool accumulate = true);
     // print all of the codec plugins
     static void dump_plugins();
 
@@ -99,6 +99,10 @@ public:
     { return max_layers; }
 
 private:
+#ifdef UNIT_TEST
+    friend class FastDecodeTest;
+#endif
+
     struct CodecApiWrapper;
 
     static std::vector<CodecApiWrapper> s_codecs;
@@ -29,6 +29,7 @@
 
 #include <list>
 
+#include "async_output.h"
 #include "plugin_manager.h"
 #include "module_manager.h"
 
@@ -230,21 +231,54 @@ void EventManager::instantiate(
 //-------------------------------------------------------------------------
 // execution
 
+// with async output the loggers are opened on the output threads and
+// packet threads just get a ring
 void EventManager::open_outputs()
 {
+    if ( AsyncOutput::active() and is_packet_thread() )
+    {
+        AsyncOutput::tinit();
+        return;
+    }
     for ( auto p : s_loggers.outputs )
         p->open();
 }
 
 void EventManager::close_outputs()
 {
+    if ( AsyncOutput::active() and is_packet_thread() )
+        return;
+
     for ( auto p : s_loggers.outputs )
         p->close();
 }
 
+void EventManager::flush_outputs()
+{
+    for ( auto p : s_loggers.outputs )
+        p->flush();
+}
+
+void EventManager::start_outputs(SnortConfig* sc)
+{ AsyncOutput::start(sc); }
+
+void EventManager::stop_outputs()
+{ AsyncOutput::stop(); }
+
+void EventManager::drain_outputs()
+{
+    if ( AsyncOutput::active() )
+        AsyncOutput::drain();
+}
+
 void EventManager::call_alerters(
     OutputSet* idx, Packet* pkt, const char* message, Event* event)
 {
+    if ( AsyncOutput::active() and is_packet_thread() )
+    {
+        AsyncOutput::alert(idx, pkt, message, event);
+        return;
+    }
     if ( idx )
     {
         for ( auto p : idx->outputs )
@@ -258,6 +292,11 @@ void EventManager::call_alerters(
 void EventManager::call_loggers(
     OutputSet* idx, Packet* pkt, const char* message, Event* event)
 {
+    if ( AsyncOutput::active() and is_packet_thread() )
+    {
+        AsyncOutput::log(idx, pkt, message, event);
+        return;
+    }
     if ( idx )
     {
         for ( auto p : idx->outputs )
@@ -83,6 +83,14 @@ public:
 
     static void open_outputs();
     static void close_outputs();
+    static void flush_outputs();
+
+    // output threads for async output; main thread only
+    static void start_outputs(SnortConfig*);
+    static void stop_outputs();
+
+    // wait for this packet thread's queued events to be written
+    static void drain_outputs();
 
     static void call_alerters(OutputSet*, Packet*, const char* message, Event*);
     static void call_loggers(OutputSet*, Packet*, const char* message, Event*);
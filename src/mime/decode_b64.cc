@@ -25,6 +25,7 @@
 
 #include "decode_base.h"
 #include "decode_buffer.h"
+#include "decode_simd.h"
 
 void B64Decode::reset_decode_state()
 {
@@ -126,6 +127,7 @@ int sf_base64decode(uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf, uint32
 {
     uint8_t* cursor, * endofinbuf;
     uint8_t* outbuf_ptr;
+    uint8_t* bulk_resume;
     uint8_t base64data[4], * base64data_ptr; /* temporary holder for current base64 chunk */
     uint8_t tableval_a, tableval_b, tableval_c, tableval_d;
 
@@ -147,8 +149,31 @@ int sf_base64decode(uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf, uint32
     *bytes_written = 0;
     cursor = inbuf;
     outbuf_ptr = outbuf;
+    bulk_resume = inbuf;
     while ((cursor < endofinbuf) && (n < max_base64_chars))
     {
+        /* On a group boundary hand clean runs of alphabet to the bulk decoder.  Anything
+           it refuses ('=', skipped chars, output nearly full) goes through the loop below
+           one byte at a time, so we don't retry the bulk decoder until that block is past. */
+        if ((base64data_ptr == base64data) && (cursor >= bulk_resume))
+        {
+            uint32_t len = endofinbuf - cursor;
+
+            if (len > max_base64_chars - n)
+                len = max_base64_chars - n;
+
+            uint32_t done = b64_decode_bulk(cursor, len, outbuf_ptr, outbuf_size - *bytes_written);
+
+            cursor += done;
+            n += done;
+            outbuf_ptr += done / 4 * 3;
+            *bytes_written += done / 4 * 3;
+            bulk_resume = cursor + 32;
+
+            if ((cursor >= endofinbuf) || (n >= max_base64_chars))
+                break;
+        }
+
         if (sf_decode64tab[*cursor] != 100)
         {
             *base64data_ptr++ = *cursor;
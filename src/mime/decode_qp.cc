@@ -24,6 +24,7 @@
 #include "utils/util_unfold.h"
 
 #include "decode_buffer.h"
+#include "decode_simd.h"
 
 void QPDecode::reset_decode_state()
 {
@@ -102,6 +103,22 @@ int sf_qpdecode(char* src, uint32_t slen, char* dst, uint32_t dlen, uint32_t* by
 
     while ( (*bytes_read < slen) && (*bytes_copied < dlen))
     {
+        uint32_t run = slen - *bytes_read;
+
+        if ( run > dlen - *bytes_copied )
+            run = dlen - *bytes_copied;
+
+        /* copy runs of literal text in one go */
+        run = qp_literal_span((const uint8_t*)src + *bytes_read, run);
+
+        if ( run )
+        {
+            memcpy(dst + *bytes_copied, src + *bytes_read, run);
+            *bytes_read += run;
+            *bytes_copied += run;
+            continue;
+        }
+
         ch = src[*bytes_read];
         *bytes_read += 1;
         if ( ch == '=' )
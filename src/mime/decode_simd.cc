@@ -0,0 +1,576 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// decode_simd.cc
+
+// the base64 translation and packing follow the nibble lookup scheme
+// described by Mula and Lemire; uuencode uses the same packing since it
+// also carries 6 bits per character.
+
+#include "decode_simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DECODE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#ifdef UNIT_TEST
+#include <string.h>
+#include <chrono>
+#include "catch/catch.hpp"
+#include "decode_b64.h"
+#include "decode_qp.h"
+#include "decode_uu.h"
+#include "time/stopwatch.h"
+#endif
+
+typedef size_t (* DecodeBulkFn)(const uint8_t*, size_t, uint8_t*, size_t);
+typedef size_t (* SpanFn)(const uint8_t*, size_t);
+
+//-------------------------------------------------------------------------
+// scalar
+//-------------------------------------------------------------------------
+
+static size_t bulk_none(const uint8_t*, size_t, uint8_t*, size_t)
+{ return 0; }
+
+static inline bool qp_literal(uint8_t c)
+{
+    if ( c >= 0x20 and c < 0x7f )
+        return c != '=';
+
+    return c == '\t' or c == '\r' or c == '\n';
+}
+
+static size_t qp_span_scalar(const uint8_t* in, size_t len)
+{
+    size_t n = 0;
+
+    while ( n < len and qp_literal(in[n]) )
+        ++n;
+
+    return n;
+}
+
+#ifdef DECODE_SIMD_X86
+
+//-------------------------------------------------------------------------
+// sse4.1
+//-------------------------------------------------------------------------
+
+// returns false if any of the 16 bytes is outside the base64 alphabet
+__attribute__((target("sse4.1")))
+static inline bool b64_translate_16(__m128i& v)
+{
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+    __m128i hi_nib = _mm_and_si128(_mm_srli_epi32(v, 4), mask_2f);
+    __m128i lo_nib = _mm_and_si128(v, mask_2f);
+    __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nib);
+    __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nib);
+
+    if ( !_mm_testz_si128(lo, hi) )
+        return false;
+
+    __m128i eq_2f = _mm_cmpeq_epi8(v, mask_2f);
+    __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nib));
+    v = _mm_add_epi8(v, roll);
+    return true;
+}
+
+// pack 16 sextets into 12 bytes at the bottom of the register
+__attribute__((target("sse4.1")))
+static inline __m128i pack_16(__m128i v)
+{
+    const __m128i shuf = _mm_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(v, shuf);
+}
+
+__attribute__((target("sse4.1")))
+static size_t b64_bulk_sse41(const uint8_t* in, size_t in_len, uint8_t* out, size_t out_avail)
+{
+    size_t done = 0;
+
+    // each store writes 16 bytes of which 12 are decoded data
+    while ( in_len - done >= 16 and out_avail >= 16 )
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + done));
+
+        if ( !b64_translate_16(v) )
+            break;
+
+        _mm_storeu_si128((__m128i*)out, pack_16(v));
+        done += 16;
+        out += 12;
+        out_avail -= 12;
+    }
+    return done;
+}
+
+__attribute__((target("sse4.1")))
+static size_t uu_bulk_sse41(const uint8_t* in, size_t in_len, uint8_t* out, size_t out_avail)
+{
+    const __m128i bias = _mm_set1_epi8(0x20);
+    const __m128i mask = _mm_set1_epi8(0x3f);
+    size_t done = 0;
+
+    while ( in_len - done >= 16 and out_avail >= 16 )
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + done));
+        v = _mm_and_si128(_mm_sub_epi8(v, bias), mask);
+
+        _mm_storeu_si128((__m128i*)out, pack_16(v));
+        done += 16;
+        out += 12;
+        out_avail -= 12;
+    }
+    return done;
+}
+
+// bit i set if byte i is a qp literal
+__attribute__((target("sse4.1")))
+static inline unsigned qp_mask_16(__m128i v)
+{
+    __m128i lit = _mm_and_si128(
+        _mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)), _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+
+    lit = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('=')), lit);
+    lit = _mm_or_si128(lit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    lit = _mm_or_si128(lit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    lit = _mm_or_si128(lit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+
+    return (unsigned)_mm_movemask_epi8(lit);
+}
+
+__attribute__((target("sse4.1")))
+static size_t qp_span_sse41(const uint8_t* in, size_t len)
+{
+    size_t n = 0;
+
+    while ( len - n >= 16 )
+    {
+        unsigned m = qp_mask_16(_mm_loadu_si128((const __m128i*)(in + n)));
+
+        if ( m != 0xFFFF )
+            return n + __builtin_ctz(~m);
+
+        n += 16;
+    }
+    return n + qp_span_scalar(in + n, len - n);
+}
+
+//-------------------------------------------------------------------------
+// avx2
+//-------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static inline bool b64_translate_32(__m256i& v)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+
+    __m256i hi_nib = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask_2f);
+    __m256i lo_nib = _mm256_and_si256(v, mask_2f);
+    __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nib);
+    __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nib);
+
+    if ( !_mm256_testz_si256(lo, hi) )
+        return false;
+
+    __m256i eq_2f = _mm256_cmpeq_epi8(v, mask_2f);
+    __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nib));
+    v = _mm256_add_epi8(v, roll);
+    return true;
+}
+
+// pack 32 sextets into 24 bytes at the bottom of the register
+__attribute__((target("avx2")))
+static inline __m256i pack_32(__m256i v)
+{
+    const __m256i shuf = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+    v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+    v = _mm256_shuffle_epi8(v, shuf);
+    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+}
+
+__attribute__((target("avx2")))
+static size_t b64_bulk_avx2(const uint8_t* in, size_t in_len, uint8_t* out, size_t out_avail)
+{
+    size_t done = 0;
+
+    while ( in_len - done >= 32 and out_avail >= 32 )
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + done));
+
+        if ( !b64_translate_32(v) )
+            break;
+
+        _mm256_storeu_si256((__m256i*)out, pack_32(v));
+        done += 32;
+        out += 24;
+        out_avail -= 24;
+    }
+    return done + b64_bulk_sse41(in + done, in_len - done, out, out_avail);
+}
+
+__attribute__((target("avx2")))
+static size_t uu_bulk_avx2(const uint8_t* in, size_t in_len, uint8_t* out, size_t out_avail)
+{
+    const __m256i bias = _mm256_set1_epi8(0x20);
+    const __m256i mask = _mm256_set1_epi8(0x3f);
+    size_t done = 0;
+
+    while ( in_len - done >= 32 and out_avail >= 32 )
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + done));
+        v = _mm256_and_si256(_mm256_sub_epi8(v, bias), mask);
+
+        _mm256_storeu_si256((__m256i*)out, pack_32(v));
+        done += 32;
+        out += 24;
+        out_avail -= 24;
+    }
+    return done + uu_bulk_sse41(in + done, in_len - done, out, out_avail);
+}
+
+__attribute__((target("avx2")))
+static size_t qp_span_avx2(const uint8_t* in, size_t len)
+{
+    size_t n = 0;
+
+    while ( len - n >= 32 )
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + n));
+        __m256i lit = _mm256_and_si256(
+            _mm256_cmpgt_epi8(v, _mm256_set1_epi8(0x1f)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7f), v));
+
+        lit = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('=')), lit);
+        lit = _mm256_or_si256(lit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+        lit = _mm256_or_si256(lit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+        lit = _mm256_or_si256(lit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+
+        uint32_t m = (uint32_t)_mm256_movemask_epi8(lit);
+
+        if ( m != 0xFFFFFFFF )
+            return n + __builtin_ctz(~m);
+
+        n += 32;
+    }
+    return n + qp_span_sse41(in + n, len - n);
+}
+
+#endif
+
+//-------------------------------------------------------------------------
+// dispatch
+//-------------------------------------------------------------------------
+
+enum SimdLevel { SIMD_NONE, SIMD_SSE41, SIMD_AVX2 };
+
+static SimdLevel get_simd_level()
+{
+#ifdef DECODE_SIMD_X86
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports("avx2") )
+        return SIMD_AVX2;
+
+    if ( __builtin_cpu_supports("sse4.1") )
+        return SIMD_SSE41;
+#endif
+    return SIMD_NONE;
+}
+
+static const SimdLevel simd_level = get_simd_level();
+
+struct DecodeKernels
+{
+    DecodeBulkFn b64;
+    DecodeBulkFn uu;
+    SpanFn qp;
+};
+
+static DecodeKernels get_kernels(SimdLevel level)
+{
+    switch ( level )
+    {
+#ifdef DECODE_SIMD_X86
+    case SIMD_AVX2:
+        return { b64_bulk_avx2, uu_bulk_avx2, qp_span_avx2 };
+
+    case SIMD_SSE41:
+        return { b64_bulk_sse41, uu_bulk_sse41, qp_span_sse41 };
+#endif
+    default:
+        break;
+    }
+    return { bulk_none, bulk_none, qp_span_scalar };
+}
+
+static DecodeKernels kernels = get_kernels(simd_level);
+
+size_t b64_decode_bulk(const uint8_t* in, size_t in_len, uint8_t* out, size_t out_avail)
+{ return kernels.b64(in, in_len, out, out_avail); }
+
+size_t uu_decode_bulk(const uint8_t* in, size_t in_len, uint8_t* out, size_t out_avail)
+{ return kernels.uu(in, in_len, out, out_avail); }
+
+size_t qp_literal_span(const uint8_t* in, size_t len)
+{ return kernels.qp(in, len); }
+
+//--------------------------------------------------------------------------
+// unit tests
+//--------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+static const char* const b64_alpha =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// deterministic pseudo random data so failures are reproducible
+static uint32_t test_rand(uint32_t& seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// base64 text with occasional '=', junk and line breaks sprinkled in
+static void make_b64_text(uint8_t* buf, size_t len, uint32_t seed, unsigned junk)
+{
+    for ( size_t i = 0; i < len; ++i )
+    {
+        uint32_t r = test_rand(seed);
+
+        if ( junk and !(r % junk) )
+            buf[i] = "=\r\n!.\x80 "[r % 7];
+        else
+            buf[i] = b64_alpha[r % 64];
+    }
+}
+
+static void make_qp_text(uint8_t* buf, size_t len, uint32_t seed)
+{
+    for ( size_t i = 0; i < len; ++i )
+    {
+        uint32_t r = test_rand(seed);
+
+        if ( !(r % 23) )
+            buf[i] = "=\r\n\t\x01\xff=3D"[r % 9];
+        else
+            buf[i] = 0x20 + r % 0x5f;
+    }
+}
+
+// the scalar decoders with the bulk kernels turned off
+static int b64_reference(
+    uint8_t* in, uint32_t in_len, uint8_t* out, uint32_t out_len, uint32_t* written)
+{
+    DecodeKernels save = kernels;
+    kernels = get_kernels(SIMD_NONE);
+    int rc = sf_base64decode(in, in_len, out, out_len, written);
+    kernels = save;
+    return rc;
+}
+
+static int qp_reference(
+    char* in, uint32_t in_len, char* out, uint32_t out_len, uint32_t* read, uint32_t* copied)
+{
+    DecodeKernels save = kernels;
+    kernels = get_kernels(SIMD_NONE);
+    int rc = sf_qpdecode(in, in_len, out, out_len, read, copied);
+    kernels = save;
+    return rc;
+}
+
+// alternate runs cover the sse4.1 kernels on avx2 hosts
+static SimdLevel sse_level()
+{ return simd_level < SIMD_SSE41 ? simd_level : SIMD_SSE41; }
+
+TEST_CASE("b64 bulk matches scalar", "[mime][decode_simd]")
+{
+    uint8_t in[4096], exp[4096], got[4096];
+
+    for ( uint32_t seed = 1; seed < 400; ++seed )
+    {
+        kernels = get_kernels(seed % 2 ? simd_level : sse_level());
+        size_t len = 1 + seed * 37 % sizeof(in);
+        uint32_t out_len = seed % 3 ? 3 * len / 4 : len / 3;
+        make_b64_text(in, len, seed, seed % 4 ? 0 : 512);
+
+        uint32_t exp_n = 0, got_n = 0;
+        int exp_rc = b64_reference(in, len, exp, out_len, &exp_n);
+        int got_rc = sf_base64decode(in, len, got, out_len, &got_n);
+
+        CHECK(exp_rc == got_rc);
+        REQUIRE(exp_n == got_n);
+        CHECK(!memcmp(exp, got, exp_n));
+    }
+    kernels = get_kernels(simd_level);
+}
+
+TEST_CASE("b64 bulk rejects padding and junk", "[mime][decode_simd]")
+{
+    uint8_t in[64], out[64];
+    make_b64_text(in, sizeof(in), 7, 0);
+
+    for ( unsigned i = 0; i < 256; ++i )
+    {
+        in[5] = (uint8_t)i;
+        size_t n = b64_decode_bulk(in, sizeof(in), out, sizeof(out));
+
+        if ( strchr(b64_alpha, (int)i) and i )
+            CHECK(n == sizeof(in));
+        else
+            CHECK(n == 0);
+    }
+}
+
+TEST_CASE("qp span matches scalar", "[mime][decode_simd]")
+{
+    uint8_t in[2048];
+    char exp[2048], got[2048];
+
+    for ( uint32_t seed = 1; seed < 400; ++seed )
+    {
+        kernels = get_kernels(seed % 2 ? simd_level : sse_level());
+        size_t len = 1 + seed * 53 % sizeof(in);
+        uint32_t out_len = seed % 2 ? len : len / 2 + 1;
+        make_qp_text(in, len, seed);
+
+        uint32_t exp_r = 0, exp_c = 0, got_r = 0, got_c = 0;
+        int exp_rc = qp_reference((char*)in, len, exp, out_len, &exp_r, &exp_c);
+        int got_rc = sf_qpdecode((char*)in, len, got, out_len, &got_r, &got_c);
+
+        CHECK(exp_rc == got_rc);
+        CHECK(exp_r == got_r);
+        REQUIRE(exp_c == got_c);
+        CHECK(!memcmp(exp, got, exp_c));
+    }
+    kernels = get_kernels(simd_level);
+
+    for ( unsigned i = 0; i < 256; ++i )
+    {
+        uint8_t c = (uint8_t)i;
+        CHECK(qp_literal_span(&c, 1) == qp_span_scalar(&c, 1));
+    }
+}
+
+TEST_CASE("uu bulk matches scalar", "[mime][decode_simd]")
+{
+    // 45 byte lines as written by uuencode
+    const char* text =
+        "begin 644 f\n"
+        "M5&AE('%U:6-K(&)R;W=N(&9O>\"!J=6UP<R!O=F5R('1H92!L87IY(&1O9RX@\n"
+        "M5&AE('%U:6-K(&)R;W=N(&9O>\"!J=6UP<R!O=F5R('1H92!L87IY(&1O9RX@\n"
+        "&5&AE(&5N\n"
+        "`\nend\n";
+    uint8_t exp[256], got[256];
+    uint32_t exp_r = 0, exp_c = 0, got_r = 0, got_c = 0;
+    bool b = false, e = false;
+
+    DecodeKernels save = kernels;
+    kernels = get_kernels(SIMD_NONE);
+    sf_uudecode((uint8_t*)text, strlen(text), exp, sizeof(exp), &exp_r, &exp_c, &b, &e);
+    kernels = save;
+
+    b = e = false;
+    sf_uudecode((uint8_t*)text, strlen(text), got, sizeof(got), &got_r, &got_c, &b, &e);
+
+    CHECK(exp_r == got_r);
+    REQUIRE(exp_c == got_c);
+    CHECK(!memcmp(exp, got, exp_c));
+}
+
+typedef Stopwatch<std::chrono::steady_clock> TestTimer;
+
+static double mb_per_sec(size_t bytes, const TestTimer& t)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(t.get()).count();
+    return us ? (double)bytes / us : 0.0;
+}
+
+// run with: snort --catch-test '[.perf]'
+TEST_CASE("b64 and qp decode throughput", "[.perf][mime][decode_simd]")
+{
+    const size_t len = 1 << 20;
+    uint8_t* in = new uint8_t[len];
+    uint8_t* out = new uint8_t[len];
+    uint32_t n, r;
+
+    for ( int pass = 0; pass < 2; ++pass )
+    {
+        TestTimer scalar, bulk;
+
+        if ( pass )
+            make_qp_text(in, len, 1);
+        else
+            make_b64_text(in, len, 1, 0);
+
+        for ( int i = 0; i < 64; ++i )
+        {
+            scalar.start();
+            if ( pass )
+                qp_reference((char*)in, len, (char*)out, len, &r, &n);
+            else
+                b64_reference(in, len, out, len, &n);
+            scalar.stop();
+
+            bulk.start();
+            if ( pass )
+                sf_qpdecode((char*)in, len, (char*)out, len, &r, &n);
+            else
+                sf_base64decode(in, len, out, len, &n);
+            bulk.stop();
+        }
+        WARN((pass ? "qp" : "b64") << " MB/s scalar = " << mb_per_sec(64 * len, scalar) <<
+            ", simd level " << (int)simd_level << " = " << mb_per_sec(64 * len, bulk));
+    }
+    delete[] in;
+    delete[] out;
+}
+
+#endif
+
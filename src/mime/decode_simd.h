@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// decode_simd.h
+
+#ifndef DECODE_SIMD_H
+#define DECODE_SIMD_H
+
+// Bulk kernels for the email attachment decoders.  Each kernel handles
+// only the common clean-data case and returns how much input it consumed;
+// the caller's byte-at-a-time loop picks up from there so the decoded
+// output is exactly what the scalar decoder produces.  SSE4.1 and AVX2
+// versions are selected at runtime; without either the b64 and uu kernels
+// consume nothing.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decode 4 character groups made only of the base64 alphabet (no '='
+// and no characters the decoder would skip).  Returns the number of input
+// bytes consumed, always a multiple of 4; consumed / 4 * 3 bytes were
+// written to out.  Never writes past out + out_avail.
+size_t b64_decode_bulk(const uint8_t* in, size_t in_len, uint8_t* out, size_t out_avail);
+
+// Decode 4 character uuencoded groups.  Same contract as b64_decode_bulk
+// except that uuencode has no invalid characters.
+size_t uu_decode_bulk(const uint8_t* in, size_t in_len, uint8_t* out, size_t out_avail);
+
+// Length of the leading run of bytes that quoted-printable passes through
+// unchanged: printable ascii other than '=', tab, CR and LF.
+size_t qp_literal_span(const uint8_t* in, size_t len);
+
+#endif
+
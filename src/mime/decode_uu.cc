@@ -25,6 +25,7 @@
 #include "utils/util_unfold.h"
 
 #include "decode_buffer.h"
+#include "decode_simd.h"
 
 #define UU_DECODE_CHAR(c) (((c) - 0x20) & 0x3f)
 
@@ -207,6 +208,12 @@ int sf_uudecode(uint8_t* src, uint32_t slen, uint8_t* dst, uint32_t dlen, uint32
 
             ptr++;
 
+            /* whole 4 character groups first */
+            uint32_t done = uu_decode_bulk(ptr, length & ~3, dptr, dend - dptr);
+            ptr += done;
+            dptr += done / 4 * 3;
+            length -= done;
+
             while ( length > 0 )
             {
                 *dptr++ = (UU_DECODE_CHAR(ptr[0]) << 2) | (UU_DECODE_CHAR(ptr[1]) >> 4);
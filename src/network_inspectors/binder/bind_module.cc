@@ -48,6 +48,8 @@ static const PegInfo bind_pegs[] =
     { "blocks", "block bindings" },
     { "allows", "allow bindings" },
     { "inspects", "inspect bindings" },
+    { "matches", "bindings matched by flows" },
+    { "net checks", "nets not indexed and checked per flow" },
     { nullptr, nullptr }
 };
 
@@ -36,6 +36,8 @@ struct BindStats
 {
     PegCount packets;
     PegCount verdicts[BindUse::BA_MAX];
+    PegCount matches;
+    PegCount net_checks;
 };
 
 extern THREAD_LOCAL BindStats bstats;
@@ -19,6 +19,9 @@
 
 #include "binder.h"
 
+#include <algorithm>
+#include <map>
+#include <unordered_map>
 #include <vector>
 
 #include "binding.h"
@@ -33,6 +36,7 @@
 #include "protocols/layer.h"
 #include "stream/stream_splitter.h"
 #include "profiler/profiler.h"
+#include "sfrt/sfrt.h"
 #include "utils/stats.h"
 #include "log/messages.h"
 #include "main/snort_config.h"
@@ -206,6 +210,483 @@ bool Binding::check_all(const Flow* flow) const
     return true;
 }
 
+//-------------------------------------------------------------------------
+// binding index
+//-------------------------------------------------------------------------
+
+// BindIndex finds the bindings that match a flow without running
+// check_all() on each of them.  Each condition is compiled into a table
+// from flow value to a mask with one bit per binding that accepts the
+// value.  Masks are interned so values accepted by the same bindings share
+// one mask.  The masks for a flow are ANDed and the remaining bits are
+// visited in binding order, so the result is the same as the linear scan.
+//
+// Networks are indexed with sfrt: each distinct prefix maps to the mask of
+// bindings with a prefix covering it, so the longest match gives all the
+// bindings containing the address.  Nets with negations or wildcards are
+// left to check_addr(), which is only called if the binding is still a
+// candidate after the other conditions.
+
+typedef uint64_t BindWord;
+
+#define BIND_WORD_BITS 64
+#define BIND_STACK_WORDS 16  // up to 1024 bindings without allocation
+
+class BindIndex
+{
+public:
+    BindIndex(const vector<Binding*>&);
+    ~BindIndex();
+
+    unsigned get_words() const
+    { return words; }
+
+    // sets the bits of the bindings that match flow
+    void get_matches(const Flow*, BindWord*) const;
+
+private:
+    typedef vector<BindWord> Mask;
+
+    void set_bit(Mask& m, unsigned i)
+    { m[i / BIND_WORD_BITS] |= (BindWord)1 << (i % BIND_WORD_BITS); }
+
+    unsigned intern(const Mask&);
+
+    const BindWord* get(unsigned off) const
+    { return &pool[off]; }
+
+    template <typename All, typename Accept>
+    void add_table(vector<unsigned>&, unsigned n, All, Accept);
+
+    void add_roles();
+    void add_policies();
+    void add_services();
+    void add_nets();
+
+    const BindWord* get_iface(int32_t) const;
+    const BindWord* get_net(const sfip_t*) const;
+    void check_nets(const Flow*, BindWord*) const;
+
+private:
+    const vector<Binding*>& bindings;
+    unsigned words;
+
+    vector<BindWord> pool;
+    map<Mask, unsigned> interned;  // only used while building
+
+    unsigned none;
+    unsigned server, client;  // role masks; either is in both
+
+    // each table is left empty if no binding restricts the condition
+    vector<unsigned> protos;
+    vector<unsigned> ifaces;
+    vector<unsigned> vlans;
+    vector<unsigned> ports;
+
+    unordered_map<unsigned, unsigned> policies;
+    unsigned any_policy;
+
+    unordered_map<string, unsigned> services;
+    unsigned no_service;
+
+    table_t* nets;
+    unsigned no_nets, slow_nets;
+    bool have_nets;
+};
+
+BindIndex::BindIndex(const vector<Binding*>& v) : bindings(v)
+{
+    words = (bindings.size() + BIND_WORD_BITS - 1) / BIND_WORD_BITS;
+    none = intern(Mask(words, 0));
+
+    nets = nullptr;
+    have_nets = false;
+    no_nets = slow_nets = none;
+
+    add_roles();
+
+    add_table(protos, 256,
+        [](const Binding*) { return false; },
+        [](const Binding* pb, unsigned k) { return (pb->when.protos & k) != 0; });
+
+    add_table(ifaces, 256,
+        [](const Binding* pb) { return pb->when.ifaces.all(); },
+        [](const Binding* pb, unsigned k) { return pb->when.ifaces.test(k); });
+
+    add_table(vlans, 4096,
+        [](const Binding* pb) { return pb->when.vlans.all(); },
+        [](const Binding* pb, unsigned k) { return pb->when.vlans.test(k); });
+
+    add_table(ports, 65536,
+        [](const Binding* pb) { return pb->when.ports.all(); },
+        [](const Binding* pb, unsigned k) { return pb->when.ports.test(k); });
+
+    add_policies();
+    add_services();
+
+    // last because the sfrt entries point into the finished pool
+    add_nets();
+
+    interned.clear();
+}
+
+BindIndex::~BindIndex()
+{
+    if ( nets )
+        sfrt_free(nets);
+}
+
+unsigned BindIndex::intern(const Mask& m)
+{
+    auto it = interned.find(m);
+
+    if ( it != interned.end() )
+        return it->second;
+
+    unsigned off = pool.size();
+    pool.insert(pool.end(), m.begin(), m.end());
+    interned[m] = off;
+    return off;
+}
+
+// entry k of tab is the mask of bindings that accept k
+template <typename All, typename Accept>
+void BindIndex::add_table(vector<unsigned>& tab, unsigned n, All accepts_all, Accept accept)
+{
+    Mask base(words, 0);
+    vector<unsigned> some;
+
+    for ( unsigned i = 0; i < bindings.size(); ++i )
+    {
+        if ( accepts_all(bindings[i]) )
+            set_bit(base, i);
+        else
+            some.push_back(i);
+    }
+
+    if ( some.empty() )
+        return;
+
+    tab.resize(n);
+
+    for ( unsigned k = 0; k < n; ++k )
+    {
+        Mask m = base;
+
+        for ( auto i : some )
+            if ( accept(bindings[i], k) )
+                set_bit(m, i);
+
+        tab[k] = intern(m);
+    }
+}
+
+void BindIndex::add_roles()
+{
+    Mask s(words, 0), c(words, 0);
+
+    for ( unsigned i = 0; i < bindings.size(); ++i )
+    {
+        BindWhen::Role r = bindings[i]->when.role;
+
+        if ( r == BindWhen::BR_SERVER or r == BindWhen::BR_EITHER )
+            set_bit(s, i);
+
+        if ( r == BindWhen::BR_CLIENT or r == BindWhen::BR_EITHER )
+            set_bit(c, i);
+    }
+    server = intern(s);
+    client = intern(c);
+}
+
+void BindIndex::add_policies()
+{
+    Mask any(words, 0);
+    vector<unsigned> ids;
+
+    for ( unsigned i = 0; i < bindings.size(); ++i )
+    {
+        if ( !bindings[i]->when.id )
+            set_bit(any, i);
+
+        else if ( std::find(ids.begin(), ids.end(), bindings[i]->when.id) == ids.end() )
+            ids.push_back(bindings[i]->when.id);
+    }
+    any_policy = intern(any);
+
+    for ( auto id : ids )
+    {
+        Mask m = any;
+
+        for ( unsigned i = 0; i < bindings.size(); ++i )
+            if ( bindings[i]->when.id == id )
+                set_bit(m, i);
+
+        policies[id] = intern(m);
+    }
+}
+
+void BindIndex::add_services()
+{
+    Mask empty(words, 0);
+    map<string, Mask> svcs;
+
+    for ( unsigned i = 0; i < bindings.size(); ++i )
+    {
+        const string& svc = bindings[i]->when.svc;
+
+        if ( svc.empty() )
+            set_bit(empty, i);
+
+        else
+        {
+            Mask& m = svcs[svc];
+
+            if ( m.empty() )
+                m.resize(words, 0);
+
+            set_bit(m, i);
+        }
+    }
+    no_service = intern(empty);
+
+    for ( auto& p : svcs )
+        services[p.first] = intern(p.second);
+}
+
+// nets that sfvar_ip_in() matches by positive prefixes only
+static bool is_indexable(const sfip_var_t* var)
+{
+    if ( var->neg_head or !var->head )
+        return false;
+
+    for ( const sfip_node_t* p = var->head; p; p = p->next )
+    {
+        if ( !p->ip or !sfip_is_set(p->ip) or !p->ip->bits )
+            return false;
+
+        if ( p->ip->family != AF_INET and p->ip->family != AF_INET6 )
+            return false;
+    }
+    return true;
+}
+
+static bool covers(const sfip_t* net, const sfip_t* sub)
+{
+    if ( net->family != sub->family or net->bits > sub->bits )
+        return false;
+
+    if ( net->family == AF_INET )
+        return sfip_fast_cont4(net, sub);
+
+    return sfip_fast_cont6(net, sub) != 0;
+}
+
+void BindIndex::add_nets()
+{
+    Mask unset(words, 0), slow(words, 0);
+    vector<pair<const sfip_t*, unsigned> > prefixes;
+
+    for ( unsigned i = 0; i < bindings.size(); ++i )
+    {
+        sfip_var_t* var = bindings[i]->when.nets;
+
+        if ( !var )
+            set_bit(unset, i);
+
+        else if ( !is_indexable(var) )
+            set_bit(slow, i);
+
+        else for ( const sfip_node_t* p = var->head; p; p = p->next )
+            prefixes.push_back(make_pair(p->ip, i));
+    }
+
+    if ( prefixes.empty() and slow == Mask(words, 0) )
+        return;
+
+    have_nets = true;
+
+    // shorter prefixes first so that each distinct net is seen once
+    std::stable_sort(prefixes.begin(), prefixes.end(),
+        [](const pair<const sfip_t*, unsigned>& a, const pair<const sfip_t*, unsigned>& b)
+        { return a.first->bits < b.first->bits; });
+
+    vector<pair<const sfip_t*, unsigned> > distinct;
+
+    for ( auto& p : prefixes )
+    {
+        bool dup = false;
+
+        for ( auto& d : distinct )
+        {
+            if ( d.first->bits == p.first->bits and covers(d.first, p.first) )
+            {
+                dup = true;
+                break;
+            }
+        }
+        if ( dup )
+            continue;
+
+        Mask m(words, 0);
+
+        for ( auto& q : prefixes )
+            if ( covers(q.first, p.first) )
+                set_bit(m, q.second);
+
+        distinct.push_back(make_pair(p.first, intern(m)));
+    }
+
+    // if the table can't be built every binding with nets is checked
+    Mask all_slow = slow;
+
+    for ( auto& p : prefixes )
+        set_bit(all_slow, p.second);
+
+    no_nets = intern(unset);
+    slow_nets = intern(slow);
+    unsigned fallback = intern(all_slow);
+
+    // the pool is final from here so the sfrt entries can point into it
+    if ( !distinct.empty() )
+        nets = sfrt_new(DIR_8x16, IPv6, distinct.size() + 1, (distinct.size() >> 6) + 2);
+
+    for ( auto& d : distinct )
+    {
+        if ( !nets )
+            break;
+
+        if ( sfrt_insert((sfip_t*)d.first, (unsigned char)d.first->bits,
+            (GENERIC)get(d.second), RT_FAVOR_SPECIFIC, nets) != RT_SUCCESS )
+        {
+            sfrt_free(nets);
+            nets = nullptr;
+        }
+    }
+
+    if ( !nets )
+        slow_nets = fallback;
+}
+
+const BindWord* BindIndex::get_iface(int32_t i) const
+{
+    if ( i < 0 )
+        i = 0;
+
+    if ( i >= (int32_t)ifaces.size() )
+        return get(none);
+
+    return get(ifaces[i]);
+}
+
+const BindWord* BindIndex::get_net(const sfip_t* ip) const
+{
+    if ( !nets )
+        return get(none);
+
+    const BindWord* p = (const BindWord*)sfrt_lookup((sfip_t*)ip, nets);
+    return p ? p : get(none);
+}
+
+// clear the candidates whose nets couldn't be indexed and don't match
+void BindIndex::check_nets(const Flow* flow, BindWord* m) const
+{
+    const BindWord* slow = get(slow_nets);
+
+    for ( unsigned w = 0; w < words; ++w )
+    {
+        BindWord b = m[w] & slow[w];
+
+        while ( b )
+        {
+            unsigned bit = __builtin_ctzll(b);
+            b &= b - 1;
+
+            if ( !bindings[w * BIND_WORD_BITS + bit]->check_addr(flow) )
+                m[w] &= ~((BindWord)1 << bit);
+
+            ++bstats.net_checks;
+        }
+    }
+}
+
+void BindIndex::get_matches(const Flow* flow, BindWord* m) const
+{
+    const BindWord* p = get(protos[to_utype(flow->pkt_type)]);
+
+    for ( unsigned i = 0; i < words; ++i )
+        m[i] = p[i];
+
+    if ( !policies.empty() )
+    {
+        auto it = policies.find(flow->policy_id);
+        p = get(it == policies.end() ? any_policy : it->second);
+
+        for ( unsigned i = 0; i < words; ++i )
+            m[i] &= p[i];
+    }
+
+    if ( !ifaces.empty() )
+    {
+        const BindWord* in = get_iface(flow->iface_in);
+        const BindWord* out = get_iface(flow->iface_out);
+
+        for ( unsigned i = 0; i < words; ++i )
+            m[i] &= in[i] | out[i];
+    }
+
+    if ( !vlans.empty() )
+    {
+        unsigned v = flow->key->vlan_tag;
+        p = get(v < vlans.size() ? vlans[v] : none);
+
+        for ( unsigned i = 0; i < words; ++i )
+            m[i] &= p[i];
+    }
+
+    const BindWord* s = get(server);
+    const BindWord* c = get(client);
+
+    if ( !ports.empty() )
+    {
+        const BindWord* sp = get(ports[flow->server_port]);
+        const BindWord* cp = get(ports[flow->client_port]);
+
+        for ( unsigned i = 0; i < words; ++i )
+            m[i] &= (sp[i] & s[i]) | (cp[i] & c[i]);
+    }
+    else
+    {
+        // check_port() still fails bindings without a role
+        for ( unsigned i = 0; i < words; ++i )
+            m[i] &= s[i] | c[i];
+    }
+
+    if ( flow->service )
+    {
+        auto it = services.find(flow->service);
+        p = get(it == services.end() ? none : it->second);
+    }
+    else
+        p = get(no_service);
+
+    for ( unsigned i = 0; i < words; ++i )
+        m[i] &= p[i];
+
+    if ( !have_nets )
+        return;
+
+    const BindWord* sn = get_net(&flow->server_ip);
+    const BindWord* cn = get_net(&flow->client_ip);
+    const BindWord* un = get(no_nets);
+    const BindWord* sl = get(slow_nets);
+
+    for ( unsigned i = 0; i < words; ++i )
+        m[i] &= un[i] | sl[i] | (sn[i] & s[i]) | (cn[i] & c[i]);
+
+    check_nets(flow, m);
+}
+
 //-------------------------------------------------------------------------
 // helpers
 //-------------------------------------------------------------------------
@@ -435,15 +916,19 @@ private:
 
 private:
     vector<Binding*> bindings;
+    BindIndex* index;
 };
 
 Binder::Binder(vector<Binding*>& v)
 {
     bindings = std::move(v);
+    index = nullptr;
 }
 
 Binder::~Binder()
 {
+    delete index;
+
     for ( auto* p : bindings )
         delete p;
 }
@@ -460,6 +945,8 @@ bool Binder::configure(SnortConfig* sc)
         if ( !pb->use.index )
             set_binding(sc, pb);
     }
+    delete index;
+    index = new BindIndex(bindings);
     return true;
 }
 
@@ -568,37 +1055,64 @@ void Binder::set_binding(SnortConfig*, Binding* pb)
         ParseError("can't bind %s", key);
 }
 
-// FIXIT-P this is a simple linear search until functionality is nailed
-// down.  performance should be the focus of the next iteration.
+// matching bindings are visited in order, as if check_all() were called on
+// each, until one finishes the search
 void Binder::get_bindings(Flow* flow, Stuff& stuff)
 {
-    Binding* pb;
-    unsigned i, sz = bindings.size();
+    if ( bindings.empty() )
+        return;
 
-    for ( i = 0; i < sz; i++ )
+    unsigned words = index->get_words();
+    BindWord buf[BIND_STACK_WORDS];
+    vector<BindWord> big;
+    BindWord* mask = buf;
+
+    if ( words > BIND_STACK_WORDS )
     {
-        pb = bindings[i];
+        big.resize(words);
+        mask = &big[0];
+    }
 
-        if ( !pb->check_all(flow) )
-            continue;
+    index->get_matches(flow, mask);
 
-        if ( !pb->use.index )
+    for ( unsigned w = 0; w < words; ++w )
+    {
+        BindWord b = mask[w];
+
+        while ( b )
         {
-            if ( stuff.update(pb) )
-                return;
-            else
-                continue;
-        }
+            unsigned bit = __builtin_ctzll(b);
+            unsigned i = w * BIND_WORD_BITS + bit;
+            b &= b - 1;
 
-        set_policies(snort_conf, pb->use.index - 1);
-        flow->policy_id = pb->use.index - 1;
+            Binding* pb = bindings[i];
+            ++bstats.matches;
 
-        Binder* sub = (Binder*)InspectorManager::get_binder();
+            if ( !pb->use.index )
+            {
+                if ( stuff.update(pb) )
+                    return;
+                else
+                    continue;
+            }
 
-        if ( sub )
-        {
-            sub->get_bindings(flow, stuff);
-            return;
+            set_policies(snort_conf, pb->use.index - 1);
+            flow->policy_id = pb->use.index - 1;
+
+            Binder* sub = (Binder*)InspectorManager::get_binder();
+
+            if ( sub )
+            {
+                sub->get_bindings(flow, stuff);
+                return;
+            }
+
+            // the rest must be matched against the new policy id; the
+            // words before this one are done and are not read again
+            index->get_matches(flow, mask);
+
+            BindWord done = (bit == BIND_WORD_BITS - 1) ? ~(BindWord)0 : ((BindWord)2 << bit) - 1;
+            b = mask[w] & ~done;
         }
     }
 }
@@ -50,7 +50,47 @@ void show_stats(PegCount*, const PegInfo*, IndexVec&, const char*) { }
 void show_stats(PegCount*, const PegInfo*, IndexVec&, const char*, FILE*) { }
 
 void sfvar_free(sfip_var_t*) {}
-bool sfvar_ip_in(sfip_var_t*, const sfip_t*) { return false; }
+
+// positive prefixes only, like the nets the index accepts
+bool sfvar_ip_in(sfip_var_t* var, const sfip_t* ip)
+{
+    for ( const sfip_node_t* p = var->head; p; p = p->next )
+        if ( covers(p->ip, ip) )
+            return true;
+
+    return false;
+}
+
+// longest prefix match over a list, enough to exercise the net index
+struct FakeRt
+{
+    std::vector<std::pair<sfip_t, GENERIC> > nets;
+};
+
+table_t* sfrt_new(char, char, long, uint32_t)
+{ return (table_t*)new FakeRt; }
+
+void sfrt_free(table_t* t)
+{ delete (FakeRt*)t; }
+
+int sfrt_insert(sfip_t* ip, unsigned char len, GENERIC data, int, table_t* t)
+{
+    sfip_t net = *ip;
+    net.bits = len;
+    ((FakeRt*)t)->nets.push_back(std::make_pair(net, data));
+    return RT_SUCCESS;
+}
+
+GENERIC sfrt_lookup(sfip_t* ip, table_t* t)
+{
+    const std::pair<sfip_t, GENERIC>* best = nullptr;
+
+    for ( auto& n : ((FakeRt*)t)->nets )
+        if ( covers(&n.first, ip) and (!best or n.first.bits > best->first.bits) )
+            best = &n;
+
+    return best ? best->second : nullptr;
+}
 SO_PUBLIC Inspector* InspectorManager::get_inspector(const char*, bool) { return s_inspector; }
 InspectorType InspectorManager::get_type(const char*) { return InspectorType::IT_BINDER; }
 Inspector* InspectorManager::get_binder() { return nullptr; }
@@ -101,6 +141,25 @@ Flow::~Flow() { }
 
 extern const BaseApi* nin_binder;
 
+static void set_ip4(sfip_t& ip, uint32_t addr, int16_t bits = 32)
+{
+    memset(&ip, 0, sizeof(ip));
+    ip.family = AF_INET;
+    ip.bits = bits;
+    ip.ip32[0] = htonl(addr);
+}
+
+static Flow* new_flow(FlowKey& key)
+{
+    Flow* flow = new Flow;
+    constexpr size_t offset = offsetof(Flow, flow_data);
+    memset((uint8_t*)flow+offset, 0, sizeof(Flow)-offset);
+
+    memset(&key, 0, sizeof(key));
+    flow->key = &key;
+    return flow;
+}
+
 TEST_GROUP(binder)
 {
     void setup()
@@ -154,6 +213,183 @@ TEST(binder, exec)
     delete[] conf;
 }
 
+// the index must select the same bindings, in the same order, as check_all()
+TEST(binder, index)
+{
+    vector<Binding*> v;
+    Binding* pb;
+
+    pb = new Binding;
+    pb->when.protos = (unsigned)PktType::TCP;
+    pb->when.ports.reset();
+    pb->when.ports.set(80);
+    pb->when.role = BindWhen::BR_SERVER;
+    v.push_back(pb);
+
+    pb = new Binding;
+    pb->when.vlans.reset();
+    pb->when.vlans.set(10);
+    v.push_back(pb);
+
+    pb = new Binding;
+    pb->when.ifaces.reset();
+    pb->when.ifaces.set(3);
+    v.push_back(pb);
+
+    pb = new Binding;
+    pb->when.svc = "http";
+    v.push_back(pb);
+
+    pb = new Binding;
+    pb->when.id = 2;
+    v.push_back(pb);
+
+    pb = new Binding;
+    pb->when.ports.reset();
+    pb->when.ports.set(1024);
+    pb->when.role = BindWhen::BR_CLIENT;
+    v.push_back(pb);
+
+    // not indexable, checked with sfvar_ip_in()
+    pb = new Binding;
+    pb->when.nets = new sfip_var_t;
+    memset(pb->when.nets, 0, sizeof(*pb->when.nets));
+    v.push_back(pb);
+
+    // indexed nets: 10.1.0.0/16 and 10.1.2.0/24 nested, for either role
+    sfip_t nets[3];
+    sfip_node_t nodes[3];
+    memset(nodes, 0, sizeof(nodes));
+
+    set_ip4(nets[0], 0x0a010000, 16);
+    set_ip4(nets[1], 0x0a010200, 24);
+    set_ip4(nets[2], 0xc0a80000, 16);
+
+    const BindWhen::Role roles[] = { BindWhen::BR_SERVER, BindWhen::BR_CLIENT, BindWhen::BR_EITHER };
+
+    for ( unsigned i = 0; i < 3; ++i )
+    {
+        nodes[i].ip = &nets[i];
+
+        pb = new Binding;
+        pb->when.nets = new sfip_var_t;
+        memset(pb->when.nets, 0, sizeof(*pb->when.nets));
+        pb->when.nets->head = &nodes[i];
+        pb->when.role = roles[i];
+        v.push_back(pb);
+    }
+
+    v.push_back(new Binding);
+
+    BindIndex index(v);
+    CHECK(index.get_words() == 1);
+
+    FlowKey key;
+    Flow* flow = new_flow(key);
+
+    sfip_t addrs[3];
+    set_ip4(addrs[0], 0x0a010203);
+    set_ip4(addrs[1], 0x0a010909);
+    set_ip4(addrs[2], 0xc0a80001);
+
+    PktType types[] = { PktType::TCP, PktType::UDP };
+    const char* svcs[] = { nullptr, "http", "ftp" };
+
+    for ( auto t : types )
+    for ( unsigned sp : { 80, 81 } )
+    for ( unsigned cp : { 1024, 5 } )
+    for ( unsigned vlan : { 0, 10 } )
+    for ( int iface : { -1, 0, 3 } )
+    for ( auto svc : svcs )
+    for ( unsigned id : { 0, 2 } )
+    for ( unsigned sip : { 0, 1, 2 } )
+    for ( unsigned cip : { 0, 1, 2 } )
+    {
+        flow->pkt_type = t;
+        flow->server_port = sp;
+        flow->client_port = cp;
+        key.vlan_tag = vlan;
+        flow->iface_in = iface;
+        flow->iface_out = 0;
+        flow->service = svc;
+        flow->policy_id = id;
+        flow->server_ip = addrs[sip];
+        flow->client_ip = addrs[cip];
+
+        BindWord expect = 0, mask = 0;
+
+        for ( unsigned i = 0; i < v.size(); ++i )
+            if ( v[i]->check_all(flow) )
+                expect |= (BindWord)1 << i;
+
+        index.get_matches(flow, &mask);
+        CHECK(expect == mask);
+    }
+
+    flow->key = nullptr;
+    delete flow;
+
+    for ( auto* p : v )
+    {
+        delete p->when.nets;
+        p->when.nets = nullptr;
+        delete p;
+    }
+}
+
+// after a binding switches policy, later bindings are matched against the
+// new policy id as check_all() would
+TEST(binder, policy_switch)
+{
+    struct
+    {
+        unsigned start_id;
+        BindUse::Action expect;
+    }
+    cases[] =
+    {
+        { 0, BindUse::BA_BLOCK },   // keyed on the new id, applies
+        { 3, BindUse::BA_ALLOW },   // keyed on the old id, skipped
+    };
+
+    for ( auto& c : cases )
+    {
+        vector<Binding*> v;
+        Binding* pb;
+
+        pb = new Binding;
+        pb->use.index = 2;  // policy id 1
+        v.push_back(pb);
+
+        pb = new Binding;
+        pb->when.id = c.start_id ? c.start_id : 1;
+        pb->use.action = BindUse::BA_BLOCK;
+        v.push_back(pb);
+
+        pb = new Binding;
+        pb->use.action = BindUse::BA_ALLOW;
+        v.push_back(pb);
+
+        Binder* b = new Binder(v);
+        b->configure(snort_conf);
+
+        FlowKey key;
+        Flow* flow = new_flow(key);
+        flow->pkt_type = PktType::UDP;
+        flow->policy_id = c.start_id;
+
+        memset(&bstats, 0, sizeof(bstats));
+        b->exec(BinderSpace::ExecOperation::EVAL_STANDBY_FLOW, flow);
+
+        CHECK(flow->policy_id == 1);
+        CHECK(bstats.verdicts[c.expect] == 1);
+
+        flow->key = nullptr;
+        delete flow;
+        delete b;
+    }
+}
+
 int main(int argc, char** argv)
 {
     return CommandLineTestRunner::RunAllTests(argc, argv);
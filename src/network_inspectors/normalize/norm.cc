@@ -25,6 +25,7 @@
 
 #include <string.h>
 
+#include "codecs/ip/checksum.h"
 #include "main/snort_config.h"
 #include "packet_io/sfdaq.h"
 #include "protocols/ipv4.h"
@@ -125,7 +126,7 @@ int Norm_Packet(NormalizerConfig* c, Packet* p)
         p->packet_flags |= PKT_MODIFIED;
         return 1;
     }
-    if ( p->packet_flags & PKT_RESIZED )
+    if ( p->packet_flags & (PKT_RESIZED | PKT_CKSUM_ADJUSTED) )
     {
         return 1;
     }
@@ -138,11 +139,28 @@ int Norm_Packet(NormalizerConfig* c, Packet* p)
 // avoided to ensure that we don't get tripped up by nested protocols.
 // TCP options count and length are a notable exception.
 //
-// also note that checksums are not calculated here.  they are only
-// calculated once after all normalizations are done (here, stream)
-// and any replacements are made.
+// also note that checksums are not calculated here.  edits to headers
+// with a checksum adjust that checksum (RFC 1624) and aren't counted as
+// changes unless an outer checksum covers them too (tunnels); anything
+// else is counted and the checksums are calculated once after all
+// normalizations are done (here, stream) and any replacements are made.
 //-----------------------------------------------------------------------
 
+// the checksum field is part of both save and h so it cancels out.
+// returns false if an enclosing layer (eg a udp tunnel) also has a
+// checksum over this one; that edit must be counted as a change.
+static inline bool Norm_Cksum(
+    Packet* p, uint8_t layer, uint16_t& cksum, const void* save, const void* h,
+    unsigned len, bool odd = false)
+{
+    if ( layer::has_outer_cksum(p, layer) )
+        return false;
+
+    cksum = checksum::cksum_update(cksum, save, h, len, odd);
+    p->packet_flags |= PKT_CKSUM_ADJUSTED;
+    return true;
+}
+
 #if 0
 static int Norm_Eth(Packet* p, uint8_t layer, int changes)
 {
@@ -179,6 +197,10 @@ static int Norm_IP4(
     uint16_t origbits = fragbits;
     const NormMode mode = get_norm_mode(c, p);
 
+    const uint8_t hlen = p->layers[layer].length;
+    uint8_t save[ip::IP4_HEADER_LEN + TCP_OPTLENMAX];
+    memcpy(save, h, hlen);
+
     if ( Norm_IsEnabled(c, NORM_IP4_TRIM) && (layer == 1) )
     {
         uint32_t len = p->layers[0].length + ntohs(h->ip_len);
@@ -196,6 +218,8 @@ static int Norm_IP4(
             normStats[PC_IP4_TRIM][mode]++;
         }
     }
+    const int prior = changes;
+
     if ( Norm_IsEnabled(c, NORM_IP4_TOS) )
     {
         if ( h->ip_tos )
@@ -267,6 +291,8 @@ static int Norm_IP4(
         }
         normStats[PC_IP4_OPTS][mode]++;
     }
+    if ( changes > prior and Norm_Cksum(p, layer, h->ip_csum, save, h, hlen) )
+        changes = prior;
     return changes;
 }
 
@@ -283,8 +309,11 @@ static int Norm_ICMP4(
     {
         if ( mode == NORM_MODE_ON )
         {
+            const icmp::IcmpCode code = h->code;
             h->code = icmp::IcmpCode::ECHO_CODE;
-            changes++;
+
+            if ( !Norm_Cksum(p, layer, h->csum, &code, &h->code, 1, true) )
+                changes++;
         }
         normStats[PC_ICMP4_ECHO][mode]++;
     }
@@ -332,8 +361,11 @@ static int Norm_ICMP6(
 
         if ( mode == NORM_MODE_ON )
         {
+            const icmp::IcmpCode code = h->code;
             h->code = static_cast<icmp::IcmpCode>(0);
-            changes++;
+
+            if ( !Norm_Cksum(p, layer, h->csum, &code, &h->code, 1, true) )
+                changes++;
         }
         normStats[PC_ICMP6_ECHO][mode]++;
     }
@@ -498,6 +530,12 @@ static int Norm_TCP(
 {
     tcp::TCPHdr* h = reinterpret_cast<tcp::TCPHdr*>(const_cast<uint8_t*>(p->layers[layer].start));
     const NormMode mode = get_norm_mode(c, p);
+    const int prior = changes;
+
+    // padding beyond the valid options is normalized too
+    const uint8_t hlen = h->hlen();
+    uint8_t save[tcp::TCP_MIN_HEADER_LEN + TCP_OPTLENMAX];
+    memcpy(save, h, hlen);
 
     if ( Norm_IsEnabled(c, NORM_TCP_RSV) )
     {
@@ -605,6 +643,8 @@ static int Norm_TCP(
                 tcp_options_len, valid_opts_len, changes);
         }
     }
+    if ( changes > prior and Norm_Cksum(p, layer, h->th_sum, save, h, hlen) )
+        changes = prior;
     return changes;
 }
 
@@ -0,0 +1,342 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// norm_test.cc
+// unit test main
+
+#include "network_inspectors/normalize/norm.cc"
+
+#include "main/policy.h"
+#include "managers/codec_manager.h"
+#include "protocols/ip.h"
+#include "protocols/udp.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+static NetworkPolicy s_policy;
+static bool s_forwarding = true;
+static Layer s_layers[8];
+
+NetworkPolicy::NetworkPolicy(PolicyId)
+{
+    min_ttl = 1;
+    new_ttl = 5;
+}
+
+NetworkPolicy::~NetworkPolicy() { }
+NetworkPolicy* get_network_policy() { return &s_policy; }
+
+bool SFDAQ::forwarding_packet(const DAQ_PktHdr_t*) { return s_forwarding; }
+
+// the few protocols normalized here
+static std::array<ProtocolIndex, max_protocol_id> get_proto_map()
+{
+    std::array<ProtocolIndex, max_protocol_id> map { };
+    map[to_utype(ProtocolId::ETHERTYPE_IPV4)] = 1;
+    map[to_utype(ProtocolId::UDP)] = 2;
+    map[to_utype(ProtocolId::TCP)] = 3;
+    map[to_utype(ProtocolId::ICMPV4)] = 4;
+    return map;
+}
+
+std::array<ProtocolIndex, max_protocol_id> CodecManager::s_proto_map = get_proto_map();
+
+void ip::IpApi::set(const IP4Hdr*) { }
+void ip::IpApi::set(const IP6Hdr*) { }
+void ip::IpApi::reset() { }
+const uint8_t* ip::IpApi::ip_data() const { return nullptr; }
+
+Packet::Packet(bool)
+{
+    layers = s_layers;
+    num_layers = 0;
+    packet_flags = 0;
+    ptrs.decode_flags = 0;
+    pkth = nullptr;
+}
+
+Packet::~Packet() { }
+
+//-------------------------------------------------------------------------
+// packets are built as [ip4/udp/]ip4/tcp|icmp4 with valid checksums
+//-------------------------------------------------------------------------
+
+static const unsigned ip_len = ip::IP4_HEADER_LEN;
+static const unsigned udp_len = udp::UDP_HEADER_LEN;
+static const unsigned tcp_len = tcp::TCP_MIN_HEADER_LEN;
+static const unsigned icmp_len = 8;
+static const unsigned data_len = 8;
+
+static void put16(uint8_t* p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+static uint16_t get16(const uint8_t* p)
+{ return (p[0] << 8) | p[1]; }
+
+static void set_ip4(uint8_t* h, unsigned len, IpProtocol proto, uint8_t last)
+{
+    h[0] = 0x45;
+    h[1] = 0x10;  // tos
+    put16(h + 2, len);
+    h[8] = 64;
+    h[9] = (uint8_t)proto;
+    h[12] = 10;
+    h[15] = last;
+    h[16] = 10;
+    h[19] = last + 1;
+
+    uint16_t c = checksum::ip_cksum((uint16_t*)h, ip_len);
+    memcpy(h + 10, &c, 2);
+}
+
+static checksum::Pseudoheader get_ph(const uint8_t* ip, unsigned len)
+{
+    checksum::Pseudoheader ph;
+    memcpy(&ph.sip, ip + 12, 4);
+    memcpy(&ph.dip, ip + 16, 4);
+    ph.zero = 0;
+    ph.protocol = (IpProtocol)ip[9];
+    ph.len = htons(len);
+    return ph;
+}
+
+// the sum over a header with a valid checksum is zero
+static bool ip4_ok(const uint8_t* ip)
+{ return !checksum::ip_cksum((const uint16_t*)ip, ip_len); }
+
+static bool tcp_ok(const uint8_t* ip, const uint8_t* h, unsigned len)
+{
+    checksum::Pseudoheader ph = get_ph(ip, len);
+    return !checksum::tcp_cksum((const uint16_t*)h, len, &ph);
+}
+
+// tcp with ecn flags for the normalizer to clear
+static void set_tcp(const uint8_t* ip, uint8_t* h)
+{
+    put16(h, 40000);
+    put16(h + 2, 80);
+    h[12] = (tcp_len / 4) << 4;
+    h[13] = TH_ACK|TH_ECE;
+    put16(h + 14, 8192);
+    memset(h + tcp_len, 'x', data_len);
+
+    checksum::Pseudoheader ph = get_ph(ip, tcp_len + data_len);
+    uint16_t c = checksum::tcp_cksum((uint16_t*)h, tcp_len + data_len, &ph);
+    memcpy(h + 16, &c, 2);
+}
+
+// echo with a nonzero code for the normalizer to clear
+static void set_icmp4(uint8_t* h)
+{
+    h[0] = ICMP_ECHO;
+    h[1] = 1;
+    memset(h + icmp_len, 'x', data_len);
+
+    uint16_t c = checksum::icmp_cksum((uint16_t*)h, icmp_len + data_len);
+    memcpy(h + 2, &c, 2);
+}
+
+static void set_udp(const uint8_t* ip, uint8_t* h, unsigned len, bool cksum)
+{
+    put16(h, 40000);
+    put16(h + 2, 2152);
+    put16(h + 4, len);
+
+    if ( cksum )
+    {
+        checksum::Pseudoheader ph = get_ph(ip, len);
+        uint16_t c = checksum::udp_cksum((uint16_t*)h, len, &ph);
+        memcpy(h + 6, &c, 2);
+    }
+}
+
+TEST_GROUP(norm)
+{
+    NormalizerConfig config;
+    DAQ_PktHdr_t pkth;
+    Packet* p;
+
+    uint8_t buf[256];
+    uint8_t* outer_ip;
+    uint8_t* ip;
+    uint8_t* xport;
+
+    void setup() override
+    {
+        memset(&config, 0, sizeof(config));
+        Norm_Enable(&config, NORM_IP4_TOS);
+        Norm_Enable(&config, NORM_ICMP4);
+        Norm_Enable(&config, NORM_TCP_ECN_PKT);
+        Norm_SetConfig(&config);
+
+        memset(&pkth, 0, sizeof(pkth));
+        memset(buf, 0, sizeof(buf));
+
+        p = new Packet(false);
+        p->pkth = &pkth;
+        s_forwarding = true;
+    }
+
+    void teardown() override
+    {
+        delete p;
+    }
+
+    void push(const uint8_t* h, ProtocolId id, unsigned len)
+    {
+        Layer& lyr = p->layers[p->num_layers++];
+        lyr.start = h;
+        lyr.prot_id = id;
+        lyr.length = len;
+    }
+
+    // tunnel is -1 for none, else whether the outer udp has a checksum
+    void build(IpProtocol proto, int tunnel = -1)
+    {
+        const unsigned inner_len = ip_len + data_len +
+            ((proto == IpProtocol::TCP) ? tcp_len : icmp_len);
+
+        ip = buf;
+
+        if ( tunnel >= 0 )
+        {
+            outer_ip = buf;
+            uint8_t* udp = outer_ip + ip_len;
+            ip = udp + udp_len;
+
+            set_ip4(outer_ip, ip_len + udp_len + inner_len, IpProtocol::UDP, 1);
+            push(outer_ip, ProtocolId::ETHERTYPE_IPV4, ip_len);
+            push(udp, ProtocolId::UDP, udp_len);
+        }
+        xport = ip + ip_len;
+
+        if ( proto == IpProtocol::TCP )
+        {
+            set_ip4(ip, inner_len, proto, 3);
+            set_tcp(ip, xport);
+            push(ip, ProtocolId::ETHERTYPE_IPV4, ip_len);
+            push(xport, ProtocolId::TCP, tcp_len);
+        }
+        else
+        {
+            set_ip4(ip, inner_len, proto, 3);
+            set_icmp4(xport);
+            push(ip, ProtocolId::ETHERTYPE_IPV4, ip_len);
+            push(xport, ProtocolId::ICMPV4, icmp_len);
+        }
+
+        if ( tunnel >= 0 )
+            set_udp(outer_ip, outer_ip + ip_len, udp_len + inner_len, tunnel);
+
+        pkth.caplen = pkth.pktlen = ip_len + inner_len +
+            ((tunnel >= 0) ? ip_len + udp_len : 0);
+    }
+};
+
+TEST(norm, adjust_in_place)
+{
+    build(IpProtocol::TCP);
+
+    CHECK(Norm_Packet(&config, p) == 1);
+    CHECK(p->packet_flags & PKT_CKSUM_ADJUSTED);
+    CHECK(!(p->packet_flags & PKT_MODIFIED));
+
+    CHECK(ip[1] == 0);
+    CHECK(xport[13] == TH_ACK);
+    CHECK(ip4_ok(ip));
+    CHECK(tcp_ok(ip, xport, tcp_len + data_len));
+}
+
+TEST(norm, icmp4_in_place)
+{
+    build(IpProtocol::ICMPV4);
+
+    CHECK(Norm_Packet(&config, p) == 1);
+    CHECK(!(p->packet_flags & PKT_MODIFIED));
+
+    CHECK(xport[1] == 0);
+    CHECK(!checksum::icmp_cksum((uint16_t*)xport, icmp_len + data_len));
+}
+
+TEST(norm, tunnel_with_cksum)
+{
+    build(IpProtocol::TCP, 1);
+    const uint16_t inner_ip_sum = get16(ip + 10);
+    const uint16_t tcp_sum = get16(xport + 16);
+
+    // the inner edits are left to encode_update() so the outer udp
+    // checksum is fixed too; the outer ip checksum is only over its header
+    CHECK(Norm_Packet(&config, p) == 1);
+    CHECK(p->packet_flags & PKT_MODIFIED);
+
+    CHECK(outer_ip[1] == 0);
+    CHECK(ip[1] == 0);
+    CHECK(xport[13] == TH_ACK);
+
+    CHECK(ip4_ok(outer_ip));
+    CHECK(get16(ip + 10) == inner_ip_sum);
+    CHECK(get16(xport + 16) == tcp_sum);
+}
+
+TEST(norm, icmp4_tunnel_with_cksum)
+{
+    build(IpProtocol::ICMPV4, 1);
+    const uint16_t icmp_sum = get16(xport + 2);
+
+    CHECK(Norm_Packet(&config, p) == 1);
+    CHECK(p->packet_flags & PKT_MODIFIED);
+
+    CHECK(xport[1] == 0);
+    CHECK(get16(xport + 2) == icmp_sum);
+}
+
+TEST(norm, tunnel_without_cksum)
+{
+    // a zero udp checksum wasn't computed so it doesn't go stale
+    build(IpProtocol::TCP, 0);
+
+    CHECK(Norm_Packet(&config, p) == 1);
+    CHECK(p->packet_flags & PKT_CKSUM_ADJUSTED);
+    CHECK(!(p->packet_flags & PKT_MODIFIED));
+
+    CHECK(ip4_ok(outer_ip));
+    CHECK(ip4_ok(ip));
+    CHECK(tcp_ok(ip, xport, tcp_len + data_len));
+    CHECK(get16(outer_ip + ip_len + 6) == 0);
+}
+
+TEST(norm, test_mode)
+{
+    build(IpProtocol::TCP, 1);
+    uint8_t orig[sizeof(buf)];
+    memcpy(orig, buf, sizeof(buf));
+    s_forwarding = false;
+
+    CHECK(Norm_Packet(&config, p) == 0);
+    CHECK(p->packet_flags == 0);
+    CHECK(!memcmp(orig, buf, sizeof(buf)));
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
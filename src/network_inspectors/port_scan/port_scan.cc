@@ -51,6 +51,7 @@
 #include "ps_detect.h"
 #include "ps_inspect.h"
 #include "ps_module.h"
+#include "ps_sketch.h"
 
 #include "ipobj.h"
 #include "log/messages.h"
@@ -769,8 +770,12 @@ static void PrintPortscanConf(PortscanConfig* config)
 
     if (!config->disabled)
     {
-        LogMessage("    Number of Nodes:   %ld\n",
-            config->common->memcap / (sizeof(PS_PROTO)*proto_cnt-1));
+        if ( config->common->sketch )
+            LogMessage("    Number of Nodes:   %u (sketch)\n",
+                PsSketch::get_nodes(config->common->memcap));
+        else
+            LogMessage("    Number of Nodes:   %ld\n",
+                config->common->memcap / (sizeof(PS_PROTO)*proto_cnt-1));
 
         if ( config->logfile )
             LogMessage("    Logfile:           %s\n", "yes");
@@ -875,7 +880,7 @@ bool PortScan::configure(SnortConfig* sc)
 void PortScan::tinit()
 {
     g_tmp_pkt = new Packet;
-    ps_init_hash(config->common->memcap);
+    ps_init_hash(config->common->memcap, config->common->sketch);
 
     if ( !config->logfile )
         return;
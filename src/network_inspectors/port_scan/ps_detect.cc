@@ -33,6 +33,7 @@
 */
 #include "ps_detect.h"
 #include "ps_inspect.h"
+#include "ps_sketch.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -73,6 +74,20 @@ typedef struct s_PS_ALERT_CONF
 
 static THREAD_LOCAL SFXHASH* portscan_hash = NULL;
 
+/*
+**  With port_scan_global.sketch, trackers live in portscan_sketch and
+**  are worked on in these copies for the current packet.
+*/
+struct PS_SKETCH_TRACKER
+{
+    PsSketchNode* node;
+    PS_TRACKER tracker;
+};
+
+static THREAD_LOCAL PsSketch* portscan_sketch = NULL;
+static THREAD_LOCAL PS_SKETCH_TRACKER sketch_scanner;
+static THREAD_LOCAL PS_SKETCH_TRACKER sketch_scanned;
+
 /*
 **  Scanning configurations.  This is where we configure what the thresholds
 **  are for the different types of scans, protocols, and sense levels.  If
@@ -194,13 +209,22 @@ void ps_cleanup()
         sfxhash_delete(portscan_hash);
         portscan_hash = NULL;
     }
+
+    delete portscan_sketch;
+    portscan_sketch = NULL;
 }
 
-void ps_init_hash(unsigned long memcap)
+void ps_init_hash(unsigned long memcap, bool sketch)
 {
-    if ( portscan_hash )
+    if ( portscan_hash || portscan_sketch )
         return;
 
+    if ( sketch )
+    {
+        portscan_sketch = new PsSketch(memcap);
+        return;
+    }
+
     int rows = 0;
     int factor = 0;
 #if SIZEOF_LONG_INT == 8
@@ -229,6 +253,9 @@ void ps_reset()
 {
     if (portscan_hash != NULL)
         sfxhash_make_empty(portscan_hash);
+
+    if (portscan_sketch != NULL)
+        portscan_sketch->clear();
 }
 
 /*
@@ -424,6 +451,42 @@ static int ps_tracker_get(PS_TRACKER** ht, PS_HASH_KEY* key)
     return 0;
 }
 
+/*
+**  NAME
+**    ps_sketch_get::
+*/
+/**
+**  Like ps_tracker_get() for the sketch.  The node is expanded into the
+**  working copy which must be passed to ps_sketch_save() after updates.
+*/
+static int ps_sketch_get(PS_SKETCH_TRACKER* st, PS_TRACKER** ht, PS_HASH_KEY* key)
+{
+    st->node = portscan_sketch->get(key, sizeof(*key), packet_time());
+
+    if (!st->node)
+    {
+        *ht = NULL;
+        return -1;
+    }
+
+    PsSketch::load(st->node, &st->tracker);
+    *ht = &st->tracker;
+
+    return 0;
+}
+
+static void ps_sketch_save(PS_TRACKER* scanner, PS_TRACKER* scanned)
+{
+    if (!portscan_sketch)
+        return;
+
+    if (scanner)
+        PsSketch::save(sketch_scanner.node, scanner);
+
+    if (scanned)
+        PsSketch::save(sketch_scanned.node, scanned);
+}
+
 int PortScan::ps_tracker_lookup(PS_PKT* ps_pkt, PS_TRACKER** scanner,
     PS_TRACKER** scanned)
 {
@@ -457,7 +520,10 @@ int PortScan::ps_tracker_lookup(PS_PKT* ps_pkt, PS_TRACKER** scanner,
         /*
         **  Get the scanned tracker.
         */
-        ps_tracker_get(scanned, &key);
+        if (portscan_sketch)
+            ps_sketch_get(&sketch_scanned, scanned, &key);
+        else
+            ps_tracker_get(scanned, &key);
     }
 
     /*
@@ -475,7 +541,10 @@ int PortScan::ps_tracker_lookup(PS_PKT* ps_pkt, PS_TRACKER** scanner,
         /*
         **  Get the scanner tracker
         */
-        ps_tracker_get(scanner, &key);
+        if (portscan_sketch)
+            ps_sketch_get(&sketch_scanner, scanner, &key);
+        else
+            ps_tracker_get(scanner, &key);
     }
 
     if ((*scanner == NULL) && (*scanned == NULL))
@@ -1630,10 +1699,21 @@ int PortScan::ps_detect(PS_PKT* ps_pkt)
         if (ps_tracker_lookup(ps_pkt, &scanner, &scanned))
             return 0;
 
-        if (ps_tracker_update(ps_pkt, scanner, scanned))
+        int ret = ps_tracker_update(ps_pkt, scanner, scanned);
+
+        /*
+        **  Repeated IPs are only taken back out of the unique counts of
+        **  sketch trackers here so save before the alert checks.
+        */
+        ps_sketch_save(scanner, scanned);
+
+        if (ret)
             return 0;
 
-        if (ps_tracker_alert(ps_pkt, scanner, scanned))
+        ret = ps_tracker_alert(ps_pkt, scanner, scanned);
+        ps_sketch_save(scanner, scanned);
+
+        if (ret)
             return 0;
 
         /* This is added to address the case of no
@@ -1663,3 +1743,209 @@ int PortScan::ps_detect(PS_PKT* ps_pkt)
     return 1;
 }
 
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+#include <vector>
+
+#include "catch/catch.hpp"
+
+#include "flow/flow.h"
+#include "protocols/ipv4.h"
+#include "ps_module.h"
+
+// runs packets through ps_detect() with trackers in the hash or the sketch
+class PsDetectTest
+{
+public:
+    PsDetectTest(bool sketch)
+    {
+        PortScanModule mod;
+        mod.begin(PS_NAME, 0, nullptr);
+        ps = new PortScan(&mod);
+
+        PortscanConfig* conf = ps->config;
+        conf->detect_scans = PS_PROTO_TCP;
+        conf->detect_scan_type = PS_TYPE_ALL;
+        conf->sense_level = PS_SENSE_LOW;
+
+        common.memcap = 1048576;
+        common.sketch = sketch;
+        conf->common = &common;
+
+        ps_init_hash(common.memcap, common.sketch);
+    }
+
+    ~PsDetectTest()
+    {
+        ps_cleanup();
+        delete ps;
+    }
+
+    int detect(Packet* p, PS_PKT& ps_pkt)
+    {
+        memset(&ps_pkt, 0, sizeof(ps_pkt));
+        ps_pkt.pkt = p;
+        return ps->ps_detect(&ps_pkt);
+    }
+
+private:
+    PortScan* ps;
+    PsCommon common;
+};
+
+struct PsTestPacket
+{
+    uint32_t src;
+    uint32_t dst;
+    uint16_t sp;
+    uint16_t dp;
+    uint8_t flags;
+    bool from_server;
+    bool with_flow;
+};
+
+#define SCANNER 0x0a010101
+#define DECOY   0x0a010102
+#define SCANNED 0x0a020202
+
+// a scan of ports 1 to 8 answered with resets, from the scanner and a
+// decoy, and then a server response on an open port
+static std::vector<PsTestPacket> get_scan()
+{
+    std::vector<PsTestPacket> v;
+
+    for ( uint16_t port = 1; port <= 8; port++ )
+    {
+        uint32_t src = (port % 3) ? SCANNER : DECOY;
+        v.push_back({ src, SCANNED, 40000, port, TH_SYN, false, false });
+        v.push_back({ SCANNED, src, port, 40000, TH_RST, true, false });
+    }
+    v.push_back({ SCANNER, SCANNED, 40000, 9, TH_SYN, false, false });
+    v.push_back({ SCANNED, SCANNER, 80, 40000, TH_SYN|TH_ACK, true, true });
+    return v;
+}
+
+struct PsTestResult
+{
+    int ret;
+    bool scanner;
+    bool scanned;
+    PS_TRACKER scanner_tracker;
+    PS_TRACKER scanned_tracker;
+};
+
+static std::vector<PsTestResult> run_scan(bool sketch)
+{
+    PsDetectTest pdt(sketch);
+    std::vector<PsTestResult> results;
+
+    Flow flow;
+    flow.update_session_flags(SSNFLAG_SEEN_BOTH);
+
+    struct timeval tv = { 1000, 0 };
+
+    for ( auto& tp : get_scan() )
+    {
+        ip::IP4Hdr ip4;
+        memset(&ip4, 0, sizeof(ip4));
+        ip4.ip_verhl = 0x45;
+        ip4.ip_proto = IpProtocol::TCP;
+        ip4.ip_src = htonl(tp.src);
+        ip4.ip_dst = htonl(tp.dst);
+
+        tcp::TCPHdr tcph;
+        memset(&tcph, 0, sizeof(tcph));
+        tcph.th_flags = tp.flags;
+
+        Packet p(false);
+        p.ptrs.ip_api.set(&ip4);
+        p.ptrs.tcph = &tcph;
+        p.ptrs.sp = tp.sp;
+        p.ptrs.dp = tp.dp;
+        p.packet_flags = tp.from_server ? PKT_FROM_SERVER : PKT_FROM_CLIENT;
+        p.flow = tp.with_flow ? &flow : nullptr;
+
+        tv.tv_sec++;
+        packet_time_update(&tv);
+
+        PS_PKT ps_pkt;
+        PsTestResult r;
+        memset(&r, 0, sizeof(r));
+
+        r.ret = pdt.detect(&p, ps_pkt);
+        r.scanner = ps_pkt.scanner != nullptr;
+        r.scanned = ps_pkt.scanned != nullptr;
+
+        if ( r.scanner )
+            r.scanner_tracker = *ps_pkt.scanner;
+
+        if ( r.scanned )
+            r.scanned_tracker = *ps_pkt.scanned;
+
+        results.push_back(r);
+    }
+    return results;
+}
+
+static void check_same(const PS_TRACKER& a, const PS_TRACKER& b)
+{
+    CHECK(a.priority_node == b.priority_node);
+    CHECK(a.proto.connection_count == b.proto.connection_count);
+    CHECK(a.proto.priority_count == b.proto.priority_count);
+    CHECK(a.proto.u_ip_count == b.proto.u_ip_count);
+    CHECK(a.proto.u_port_count == b.proto.u_port_count);
+    CHECK(a.proto.low_p == b.proto.low_p);
+    CHECK(a.proto.high_p == b.proto.high_p);
+    CHECK(a.proto.alerts == b.proto.alerts);
+    CHECK(a.proto.open_ports_cnt == b.proto.open_ports_cnt);
+    CHECK(!memcmp(a.proto.open_ports, b.proto.open_ports, sizeof(a.proto.open_ports)));
+}
+
+TEST_CASE("ps_detect sketch", "[ps_detect]")
+{
+    std::vector<PsTestResult> hash = run_scan(false);
+    std::vector<PsTestResult> sketch = run_scan(true);
+
+    REQUIRE(hash.size() == sketch.size());
+
+    // the scan is detected and the open port reported
+    bool alerted = false;
+
+    for ( auto& r : hash )
+    {
+        if ( r.scanned and r.scanned_tracker.proto.alerts == PS_ALERT_ONE_TO_ONE )
+            alerted = true;
+    }
+    CHECK(alerted);
+
+    const PsTestResult& last = hash.back();
+    REQUIRE(last.scanned);
+    CHECK(last.scanned_tracker.proto.alerts == PS_ALERT_OPEN_PORT);
+    CHECK(last.scanned_tracker.proto.open_ports_cnt == 1);
+    CHECK(last.scanned_tracker.proto.open_ports[0] == 80);
+
+    // the source changed 5 times over 9 attempts
+    CHECK(last.scanned_tracker.proto.u_ip_count == 5);
+
+    // the sketch gives the same trackers and alerts at every step
+    for ( unsigned i = 0; i < hash.size(); i++ )
+    {
+        INFO("packet " << i);
+        CHECK(hash[i].ret == sketch[i].ret);
+        REQUIRE(hash[i].scanner == sketch[i].scanner);
+        REQUIRE(hash[i].scanned == sketch[i].scanned);
+
+        if ( hash[i].scanner )
+            check_same(hash[i].scanner_tracker, sketch[i].scanner_tracker);
+
+        if ( hash[i].scanned )
+            check_same(hash[i].scanned_tracker, sketch[i].scanned_tracker);
+    }
+}
+
+#endif
+
@@ -31,8 +31,9 @@
 struct PsCommon
 {
     unsigned long memcap;
+    bool sketch;
 
-    PsCommon() { memcap = 0; }
+    PsCommon() { memcap = 0; sketch = false; }
 };
 
 struct PortscanConfig
@@ -48,6 +48,10 @@ public:
     void tterm() override;
 
 private:
+#ifdef UNIT_TEST
+    friend class PsDetectTest;
+#endif
+
     void ps_parse(SnortConfig*, char*);
 
     int ps_ignore_ip(
@@ -101,7 +105,7 @@ void ps_reset();
 int ps_detect(PS_PKT* p);
 void ps_tracker_print(PS_TRACKER* tracker);
 
-void ps_init_hash(unsigned long);
+void ps_init_hash(unsigned long, bool sketch);
 
 #endif
 
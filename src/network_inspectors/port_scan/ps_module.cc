@@ -206,6 +206,9 @@ static const Parameter psg_params[] =
     { "memcap", Parameter::PT_INT, "1:", "1048576",
       "maximum tracker memory" },
 
+    { "sketch", Parameter::PT_BOOL, nullptr, "false",
+      "use compact trackers to track more hosts within memcap" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -236,6 +239,9 @@ bool PortScanGlobalModule::set(const char*, Value& v, SnortConfig*)
     if ( v.is("memcap") )
         common->memcap = v.get_long();
 
+    else if ( v.is("sketch") )
+        common->sketch = v.get_bool();
+
     else
         return false;
 
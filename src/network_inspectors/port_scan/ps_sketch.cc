@@ -0,0 +1,435 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// ps_sketch.cc
+
+#include "ps_sketch.h"
+
+#include <string.h>
+
+#include "sfip/sf_ip.h"
+
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
+//-------------------------------------------------------------------------
+// hashing
+//-------------------------------------------------------------------------
+
+static inline uint64_t mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t hash_bytes(const void* data, unsigned len, uint64_t seed)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t h = seed ^ len;
+
+    while ( len >= 8 )
+    {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        h = mix64(h ^ w);
+        p += 8;
+        len -= 8;
+    }
+    if ( len )
+    {
+        uint64_t w = 0;
+        memcpy(&w, p, len);
+        h = mix64(h ^ w);
+    }
+    return h;
+}
+
+static inline uint16_t clamp16(int n)
+{
+    if ( n < 0 )
+        return 0;
+
+    return n > UINT16_MAX ? UINT16_MAX : (uint16_t)n;
+}
+
+//-------------------------------------------------------------------------
+// count-min sketch
+//-------------------------------------------------------------------------
+
+// rows are indexed by double hashing the key's set and fingerprint so the
+// count for a resident node can be found without its key
+#define CMS_INDEX(a, b, i) ((i) * cms_width + ((a) + (i) * (b)) % cms_width)
+
+void PsSketch::cms_decay(time_t now)
+{
+    if ( now < next_decay )
+        return;
+
+    for ( unsigned i = 0; i < PS_SKETCH_DEPTH * cms_width; i++ )
+        cms[i] >>= 1;
+
+    next_decay = now + PS_SKETCH_DECAY;
+}
+
+// conservative update: only the smallest counters are raised
+unsigned PsSketch::cms_add(uint32_t fp, unsigned set)
+{
+    uint64_t h = mix64(((uint64_t)fp << 32) | set);
+    uint32_t a = (uint32_t)h, b = (uint32_t)(h >> 32) | 1;
+
+    unsigned idx[PS_SKETCH_DEPTH];
+    unsigned min = UINT16_MAX;
+
+    for ( unsigned i = 0; i < PS_SKETCH_DEPTH; i++ )
+    {
+        idx[i] = CMS_INDEX(a, b, i);
+
+        if ( cms[idx[i]] < min )
+            min = cms[idx[i]];
+    }
+    if ( min < UINT16_MAX )
+        min++;
+
+    for ( unsigned i = 0; i < PS_SKETCH_DEPTH; i++ )
+    {
+        if ( cms[idx[i]] < min )
+            cms[idx[i]] = min;
+    }
+    return min;
+}
+
+unsigned PsSketch::cms_get(uint32_t fp, unsigned set)
+{
+    uint64_t h = mix64(((uint64_t)fp << 32) | set);
+    uint32_t a = (uint32_t)h, b = (uint32_t)(h >> 32) | 1;
+    unsigned min = UINT16_MAX;
+
+    for ( unsigned i = 0; i < PS_SKETCH_DEPTH; i++ )
+    {
+        unsigned c = cms[CMS_INDEX(a, b, i)];
+
+        if ( c < min )
+            min = c;
+    }
+    return min;
+}
+
+//-------------------------------------------------------------------------
+// tracker table
+//-------------------------------------------------------------------------
+
+// an eighth of the memcap goes to the count-min sketch, the rest to nodes
+void PsSketch::get_sizes(unsigned long memcap, unsigned& sets, unsigned& width)
+{
+    const unsigned long row = PS_SKETCH_DEPTH * sizeof(uint16_t);
+
+    width = memcap / 8 / row;
+
+    if ( width < 64 )
+        width = 64;
+
+    unsigned long used = width * row;
+    unsigned long rest = memcap > used ? memcap - used : 0;
+
+    sets = rest / (PS_SKETCH_WAYS * sizeof(PsSketchNode));
+
+    if ( !sets )
+        sets = 1;
+}
+
+unsigned PsSketch::get_nodes(unsigned long memcap)
+{
+    unsigned sets, width;
+    get_sizes(memcap, sets, width);
+    return sets * PS_SKETCH_WAYS;
+}
+
+PsSketch::PsSketch(unsigned long memcap)
+{
+    get_sizes(memcap, num_sets, cms_width);
+
+    nodes = new PsSketchNode[num_sets * PS_SKETCH_WAYS]();
+    cms = new uint16_t[PS_SKETCH_DEPTH * cms_width]();
+    next_decay = 0;
+}
+
+PsSketch::~PsSketch()
+{
+    delete[] nodes;
+    delete[] cms;
+}
+
+void PsSketch::clear()
+{
+    memset(nodes, 0, num_sets * PS_SKETCH_WAYS * sizeof(*nodes));
+    memset(cms, 0, PS_SKETCH_DEPTH * cms_width * sizeof(*cms));
+    next_decay = 0;
+}
+
+// free and expired nodes are taken first.  otherwise the least busy node
+// that isn't a priority tracker is evicted, but only if it is no busier
+// than key; ties go to key.
+PsSketchNode* PsSketch::get(const void* key, unsigned len, time_t now)
+{
+    uint64_t h = hash_bytes(key, len, 0);
+    unsigned set = (unsigned)(h % num_sets);
+    uint32_t fp = (uint32_t)(h >> 32);
+
+    if ( !fp )
+        fp = 1;
+
+    cms_decay(now);
+    unsigned busy = cms_add(fp, set);
+
+    PsSketchNode* n = nodes + set * PS_SKETCH_WAYS;
+    PsSketchNode* victim = nullptr;
+    unsigned least = busy + 1;
+
+    for ( unsigned i = 0; i < PS_SKETCH_WAYS; i++ )
+    {
+        if ( n[i].fp == fp )
+            return n + i;
+
+        if ( !least )
+            continue;
+
+        if ( !n[i].fp or (time_t)n[i].window < now )
+        {
+            victim = n + i;
+            least = 0;
+        }
+        else if ( !n[i].priority_node )
+        {
+            unsigned c = cms_get(n[i].fp, set);
+
+            if ( c < least )
+            {
+                victim = n + i;
+                least = c;
+            }
+        }
+    }
+    if ( !victim )
+        return nullptr;
+
+    memset(victim, 0, sizeof(*victim));
+    victim->fp = fp;
+    return victim;
+}
+
+//-------------------------------------------------------------------------
+// tracker conversion
+//-------------------------------------------------------------------------
+
+// the IP range isn't kept; the range in an alert covers at most the packet
+// that raised it.  the last IP is left unset so ps_proto_update() counts
+// every IP as new and save() takes back repeats.
+void PsSketch::load(const PsSketchNode* n, PS_TRACKER* t)
+{
+    memset(t, 0, sizeof(*t));
+    t->priority_node = n->priority_node;
+
+    PS_PROTO& p = t->proto;
+    p.connection_count = n->connection_count;
+    p.priority_count = n->priority_count;
+    p.u_ip_count = n->u_ip_count;
+    p.u_port_count = n->u_port_count;
+    p.u_ports = n->u_port;
+    p.low_p = n->low_p;
+    p.high_p = n->high_p;
+    p.alerts = n->alerts;
+    p.window = n->window;
+
+    memcpy(p.open_ports, n->open_ports, sizeof(n->open_ports));
+    p.open_ports_cnt = n->open_ports_cnt;
+}
+
+void PsSketch::save(PsSketchNode* n, PS_TRACKER* t)
+{
+    PS_PROTO& p = t->proto;
+
+    // a new window was started from scratch
+    if ( n->window != (uint32_t)p.window )
+    {
+        n->u_ip = 0;
+        n->window = (uint32_t)p.window;
+    }
+
+    if ( sfip_is_set(p.u_ips) )
+    {
+        uint32_t h = (uint32_t)hash_bytes(p.u_ips.ip8, p.u_ips.is_ip6() ? 16 : 4, p.u_ips.family);
+
+        if ( !h )
+            h = 1;
+
+        if ( h == n->u_ip and p.u_ip_count > 0 )
+            p.u_ip_count--;
+
+        n->u_ip = h;
+        sfip_clear(p.u_ips);
+    }
+
+    n->connection_count = clamp16(p.connection_count);
+    n->priority_count = clamp16(p.priority_count);
+    n->u_ip_count = clamp16(p.u_ip_count);
+    n->u_port_count = clamp16(p.u_port_count);
+    n->u_port = p.u_ports;
+    n->low_p = p.low_p;
+    n->high_p = p.high_p;
+    n->alerts = p.alerts;
+    n->priority_node = t->priority_node;
+
+    memcpy(n->open_ports, p.open_ports, sizeof(n->open_ports));
+    n->open_ports_cnt = p.open_ports_cnt;
+}
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+TEST_CASE("ps_sketch get", "[ps_sketch]")
+{
+    // one set
+    PsSketch ps(PS_SKETCH_WAYS * sizeof(PsSketchNode));
+    CHECK(ps.get_nodes() == PS_SKETCH_WAYS);
+
+    unsigned key = 0;
+    PsSketchNode* n = ps.get(&key, sizeof(key), 1);
+    REQUIRE(n);
+    n->window = 100;
+
+    for ( unsigned i = 0; i < 100; i++ )
+        CHECK(ps.get(&key, sizeof(key), 2) == n);
+
+    // a busy key keeps its node while one-off keys churn the others or
+    // are turned away
+    unsigned admitted = 0;
+
+    for ( key = 1; key < 200; key++ )
+    {
+        PsSketchNode* m = ps.get(&key, sizeof(key), 2);
+
+        if ( !m )
+            continue;
+
+        CHECK(m != n);
+        m->window = 100;
+        admitted++;
+    }
+    CHECK(admitted >= PS_SKETCH_WAYS);
+
+    key = 0;
+    CHECK(ps.get(&key, sizeof(key), 2) == n);
+
+    // live priority trackers aren't evicted
+    PsSketch pri(PS_SKETCH_WAYS * sizeof(PsSketchNode));
+
+    for ( key = 0; key < PS_SKETCH_WAYS; key++ )
+    {
+        PsSketchNode* m = pri.get(&key, sizeof(key), 1);
+        REQUIRE(m);
+        m->window = 100;
+        m->priority_node = 1;
+    }
+    CHECK(!pri.get(&key, sizeof(key), 1));
+
+    // until they expire
+    CHECK(pri.get(&key, sizeof(key), 101));
+
+    pri.clear();
+    CHECK(pri.get(&key, sizeof(key), 1));
+}
+
+static void add_attempt(PsSketchNode* n, PS_TRACKER* t, uint32_t ip, uint16_t port)
+{
+    PsSketch::load(n, t);
+    PS_PROTO& p = t->proto;
+
+    // what ps_proto_update() does with the loaded tracker
+    p.connection_count++;
+    p.u_ip_count++;
+    p.u_ips.family = AF_INET;
+    p.u_ips.ip32[0] = ip;
+
+    if ( p.u_ports != port )
+    {
+        p.u_port_count++;
+        p.u_ports = port;
+    }
+    PsSketch::save(n, t);
+}
+
+TEST_CASE("ps_sketch tracker", "[ps_sketch]")
+{
+    PsSketchNode n;
+    memset(&n, 0, sizeof(n));
+
+    PS_TRACKER t;
+    PsSketch::load(&n, &t);
+
+    // start a window
+    t.proto.window = 100;
+    PsSketch::save(&n, &t);
+
+    // changes from the last value are counted as with the hash
+    add_attempt(&n, &t, 0x01020304, 80);
+    CHECK(t.proto.u_ip_count == 1);
+    CHECK(t.proto.u_port_count == 1);
+    CHECK(!sfip_is_set(t.proto.u_ips));
+
+    add_attempt(&n, &t, 0x01020304, 81);
+    add_attempt(&n, &t, 0x01020305, 81);
+    add_attempt(&n, &t, 0x01020304, 80);
+
+    PsSketch::load(&n, &t);
+    CHECK(t.proto.connection_count == 4);
+    CHECK(t.proto.u_ip_count == 3);
+    CHECK(t.proto.u_port_count == 3);
+    CHECK(t.proto.u_ports == 80);
+    CHECK(t.proto.window == 100);
+
+    // open ports are kept
+    t.proto.open_ports[0] = 22;
+    t.proto.open_ports_cnt = 1;
+    PsSketch::save(&n, &t);
+
+    PsSketch::load(&n, &t);
+    CHECK(t.proto.open_ports_cnt == 1);
+    CHECK(t.proto.open_ports[0] == 22);
+
+    // a new window starts from scratch
+    memset(&t.proto, 0, sizeof(t.proto));
+    t.proto.window = 200;
+    PsSketch::save(&n, &t);
+    add_attempt(&n, &t, 0x01020304, 80);
+
+    CHECK(n.u_ip_count == 1);
+    CHECK(n.u_port_count == 1);
+    CHECK(n.connection_count == 1);
+    CHECK(n.open_ports_cnt == 0);
+}
+
+#endif
+
@@ -0,0 +1,102 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// ps_sketch.h
+
+#ifndef PS_SKETCH_H
+#define PS_SKETCH_H
+
+// PsSketch is the compact tracker store used when port_scan_global.sketch
+// is set.  Trackers are fixed size nodes in a set associative table with
+// no pointers or allocations per node.  Unique IPs and ports are counted
+// against the last value seen as with the hash; the last IP is kept as a
+// hash instead of an address.  A count-min sketch of recent activity per
+// key picks the node to evict from a full set and keeps a new key from
+// evicting a busier one, so a flood of one-off sources can't push out
+// real scanners.
+//
+// Detection still works on a PS_TRACKER: load() expands a node into one
+// and save() folds the updates back into the node.
+
+#include <stdint.h>
+#include <time.h>
+
+#include "ps_detect.h"
+
+#define PS_SKETCH_WAYS 4      // nodes per set
+#define PS_SKETCH_DEPTH 4     // count-min rows
+#define PS_SKETCH_DECAY 60    // seconds between count-min halvings
+
+struct PsSketchNode
+{
+    uint32_t fp;              // key fingerprint; 0 if free
+    uint32_t window;
+    uint32_t u_ip;            // hash of the last IP; 0 if none
+
+    uint16_t connection_count;
+    uint16_t priority_count;
+    uint16_t u_ip_count;
+    uint16_t u_port_count;
+    uint16_t u_port;
+    uint16_t low_p;
+    uint16_t high_p;
+    uint16_t open_ports[PS_OPEN_PORTS];
+
+    uint8_t open_ports_cnt;
+    uint8_t alerts;
+    uint8_t priority_node;
+};
+
+class PsSketch
+{
+public:
+    PsSketch(unsigned long memcap);
+    ~PsSketch();
+
+    // find or claim the node for key; returns nullptr if every node in
+    // the set is busier than key or is a live priority tracker
+    PsSketchNode* get(const void* key, unsigned len, time_t now);
+
+    void clear();
+
+    unsigned get_nodes() const
+    { return num_sets * PS_SKETCH_WAYS; }
+
+    static unsigned get_nodes(unsigned long memcap);
+
+    static void load(const PsSketchNode*, PS_TRACKER*);
+    static void save(PsSketchNode*, PS_TRACKER*);
+
+private:
+    static void get_sizes(unsigned long memcap, unsigned& sets, unsigned& width);
+
+    void cms_decay(time_t now);
+    unsigned cms_add(uint32_t fp, unsigned set);
+    unsigned cms_get(uint32_t fp, unsigned set);
+
+private:
+    PsSketchNode* nodes;
+    unsigned num_sets;
+
+    uint16_t* cms;
+    unsigned cms_width;
+    time_t next_decay;
+};
+
+#endif
+
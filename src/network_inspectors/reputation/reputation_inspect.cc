@@ -326,6 +326,11 @@ static void snort_reputation(ReputationConfig* config, Packet* p)
     else if (MONITORED == decision)
     {
         SnortEventqAdd(GID_REPUTATION, REPUTATION_EVENT_MONITOR);
+
+        // keep the flow from being bypassed
+        if (p->flow)
+            p->flow->set_session_flags(SSNFLAG_MONITORED);
+
         reputationstats.monitored++;
     }
     else if (WHITELISTED_TRUST == decision)
@@ -63,6 +63,9 @@ struct PortGroup
     unsigned rule_count;
     unsigned nfp_rule_count;
 
+    // number of other port objects or services using this group
+    unsigned share_count;
+
     // FIXIT-L these runtime counts are only valid with one packet thread
     unsigned match_count;
     unsigned event_count;
@@ -39,6 +39,9 @@ struct GREHdr
 
     inline uint16_t raw_proto() const
     { return ether_type; }
+
+    inline bool has_checksum() const
+    { return flags & 0x80; }
 };
 } // namespace gre
 
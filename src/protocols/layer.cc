@@ -26,6 +26,8 @@
 #include "protocols/ipv4.h"
 #include "protocols/ipv6.h"
 #include "protocols/ip.h"
+#include "protocols/gre.h"
+#include "protocols/udp.h"
 #include "main/thread.h"
 
 namespace layer
@@ -249,6 +251,37 @@ int get_inner_ip_lyr_index(const Packet* const p)
     return -1;
 }
 
+bool has_outer_cksum(const Packet* const p, uint8_t lyr)
+{
+    for (uint8_t i = 0; i < lyr && i < p->num_layers; i++)
+    {
+        const Layer& l = p->layers[i];
+
+        switch (l.prot_id)
+        {
+        case ProtocolId::TCP:
+        case ProtocolId::ICMPV4:
+        case ProtocolId::ICMPV6:
+            return true;
+
+        case ProtocolId::UDP:
+            // a zero udp checksum wasn't computed
+            if (reinterpret_cast<const udp::UDPHdr*>(l.start)->uh_chk)
+                return true;
+            break;
+
+        case ProtocolId::GRE:
+            if (reinterpret_cast<const gre::GREHdr*>(l.start)->has_checksum())
+                return true;
+            break;
+
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
 bool set_inner_ip_api(const Packet* const p,
     ip::IpApi& api,
     int8_t& curr_layer)
@@ -79,6 +79,7 @@ extern "C" {
 
 #define PKT_FILE_EVENT_SET   0x00400000
 #define PKT_IGNORE           0x00800000  /* this packet should be ignored, based on port */
+#define PKT_CKSUM_ADJUSTED   0x01000000  /* edits made with checksums adjusted in place */
 #define PKT_UNUSED_FLAGS     0xfe000000
 
 // 0x40000000 are available
@@ -38,12 +38,20 @@
 #include "protocols/eth.h"
 #include "protocols/icmp4.h"
 #include "protocols/icmp6.h"
+#include "protocols/ipv4.h"
+#include "protocols/ipv6.h"
+#include "protocols/tcp.h"
+#include "protocols/tcp_options.h"
+#include "protocols/teredo.h"
+#include "protocols/udp.h"
+#include "protocols/vlan.h"
 #include "profiler/profiler.h"
 #include "parser/parser.h"
 
 #include "codecs/codec_module.h"
 #include "codecs/ip/checksum.h"
 #include "utils/stats.h"
+#include "utils/util.h"
 #include "log/text_log.h"
 #include "main/snort_debug.h"
 #include "packet_io/sfdaq.h"
@@ -51,6 +59,7 @@
 #include "stream/stream.h"
 
 THREAD_LOCAL ProfileStats decodePerfStats;
+THREAD_LOCAL ProfileStats checksumPerfStats;
 
 // Decoding statistics
 
@@ -133,6 +142,501 @@ RawData::RawData(const DAQ_PktHdr_t* h, const uint8_t* p)
     len = h->caplen;
 }
 
+//-------------------------------------------------------------------------
+// fast path
+//
+// Most traffic is eth[/vlan]/ip4|ip6/tcp|udp with nothing of note.  Those
+// packets are decoded here in one pass with the same results the codecs
+// give: same layers, DecodeData, proto_bits, and decode counts.  Anything
+// a codec would alert on, count, or hand off (ip options, fragments, ip6
+// extensions, tunnels, bad checksums, odd flags, ports, or addresses)
+// returns false before the packet is touched and the codecs decode it.
+//-------------------------------------------------------------------------
+
+#define FAST_MAX_VLANS 2
+
+struct FastDecode
+{
+    bool enabled;
+    ProtocolIndex eth;
+    ProtocolIndex vlan;
+    ProtocolIndex ip4;
+    ProtocolIndex ip6;
+    ProtocolIndex tcp;
+    ProtocolIndex udp;
+    ProtocolIndex done;
+};
+
+static THREAD_LOCAL FastDecode s_fast { false, 0, 0, 0, 0, 0, 0, 0 };
+
+void PacketManager::thread_init()
+{
+    auto is_codec = [](ProtocolIndex idx, const char* name)
+    {
+        const Codec* cd = CodecManager::s_protocols[idx];
+        return cd and !strcmp(cd->get_name(), name);
+    };
+
+    s_fast.eth = CodecManager::grinder;
+    s_fast.vlan = proto_idx(ProtocolId::ETHERTYPE_8021Q);
+    s_fast.ip4 = proto_idx(ProtocolId::ETHERTYPE_IPV4);
+    s_fast.ip6 = proto_idx(ProtocolId::ETHERTYPE_IPV6);
+    s_fast.tcp = proto_idx(ProtocolId::TCP);
+    s_fast.udp = proto_idx(ProtocolId::UDP);
+    s_fast.done = proto_idx(ProtocolId::FINISHED_DECODE);
+
+    // the fast path only stands in for the builtin codecs
+    s_fast.enabled =
+        CodecManager::grinder_id == ProtocolId::ETHERNET_802_3 and
+        is_codec(s_fast.eth, "eth") and is_codec(s_fast.vlan, "vlan") and
+        is_codec(s_fast.ip4, "ipv4") and is_codec(s_fast.ip6, "ipv6") and
+        is_codec(s_fast.tcp, "tcp") and is_codec(s_fast.udp, "udp") and
+        is_codec(s_fast.done, "unknown");
+}
+
+static inline bool fast_ip4(const ip::IP4Hdr* iph, uint32_t len)
+{
+    if ( len < ip::IP4_HEADER_LEN or iph->ver() != 4 )
+        return false;
+
+    // no options and not a fragment; df is ok
+    if ( iph->hlen() != ip::IP4_HEADER_LEN or (iph->off_w_flags() & 0xBFFF) )
+        return false;
+
+    if ( iph->len() < ip::IP4_HEADER_LEN or iph->len() > len )
+        return false;
+
+    if ( iph->ip_src == iph->ip_dst or iph->is_src_broadcast() or iph->is_dst_broadcast() )
+        return false;
+
+    // loopback, this net, multicast, and reserved (which includes the
+    // reserved multicast ranges) all alert
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(&iph->ip_src);
+    const uint8_t* dst = reinterpret_cast<const uint8_t*>(&iph->ip_dst);
+
+    for ( uint8_t msb : { src[0], dst[0] } )
+    {
+        if ( msb == ip::IP4_LOOPBACK or msb == ip::IP4_THIS_NET or
+            (msb >> 4) == ip::IP4_MULTICAST or (msb >> 4) == ip::IP4_RESERVED )
+            return false;
+    }
+
+    if ( SnortConfig::ip_checksums() )
+    {
+        Profile profile(checksumPerfStats);
+
+        if ( checksum::ip_cksum((const uint16_t*)iph, ip::IP4_HEADER_LEN) )
+            return false;
+    }
+
+    return iph->proto() == IpProtocol::TCP or iph->proto() == IpProtocol::UDP;
+}
+
+static inline bool fast_ip6(const ip::IP6Hdr* ip6h, uint32_t len)
+{
+    if ( len < ip::IP6_HEADER_LEN or ip6h->ver() != 6 )
+        return false;
+
+    // jumbograms (0 length) fail later in tcp or udp
+    if ( ip6h->len() + (uint32_t)ip::IP6_HEADER_LEN > len )
+        return false;
+
+    const ip::snort_in6_addr* src = ip6h->get_src();
+    const ip::snort_in6_addr* dst = ip6h->get_dst();
+
+    if ( ip6h->is_src_multicast() or ip6h->is_dst_multicast() or !memcmp(src, dst, sizeof(*src)) )
+        return false;
+
+    // unspecified, loopback, and embedded ip4 addresses
+    if ( !(src->u6_addr32[0] | src->u6_addr32[1]) or !(dst->u6_addr32[0] | dst->u6_addr32[1]) )
+        return false;
+
+    // no extension headers
+    return ip6h->next() == IpProtocol::TCP or ip6h->next() == IpProtocol::UDP;
+}
+
+// only the common options; returns the valid option length which is
+// shorter than len if there is an eol
+static inline bool fast_tcp_opts(const uint8_t* opt, unsigned len, unsigned& valid)
+{
+    unsigned i = 0;
+
+    while ( i < len )
+    {
+        const tcp::TcpOptCode code = (tcp::TcpOptCode)opt[i];
+
+        if ( code == tcp::TcpOptCode::EOL )
+        {
+            valid = i;
+            return true;
+        }
+        if ( code == tcp::TcpOptCode::NOP )
+        {
+            i++;
+            continue;
+        }
+        if ( i + 2 > len )
+            return false;
+
+        const unsigned olen = opt[i + 1];
+
+        switch ( code )
+        {
+        case tcp::TcpOptCode::MAXSEG:
+            if ( olen != tcp::TCPOLEN_MAXSEG )
+                return false;
+            break;
+
+        case tcp::TcpOptCode::SACKOK:
+            if ( olen != tcp::TCPOLEN_SACKOK )
+                return false;
+            break;
+
+        case tcp::TcpOptCode::WSCALE:
+            if ( olen != tcp::TCPOLEN_WSCALE or i + olen > len or opt[i + 2] > 14 )
+                return false;
+            break;
+
+        case tcp::TcpOptCode::TIMESTAMP:
+            if ( olen != tcp::TCPOLEN_TIMESTAMP )
+                return false;
+            break;
+
+        case tcp::TcpOptCode::SACK:
+            if ( olen < 2 )
+                return false;
+            break;
+
+        default:
+            return false;
+        }
+        if ( i + olen > len )
+            return false;
+
+        i += olen;
+    }
+    valid = len;
+    return true;
+}
+
+static inline bool fast_tcp(
+    const tcp::TCPHdr* tcph, uint32_t len, const ip::IP4Hdr* iph, const ip::IP6Hdr* ip6h,
+    const DAQ_PktHdr_t* pkth, unsigned& lyr_len)
+{
+    if ( len < tcp::TCP_MIN_HEADER_LEN )
+        return false;
+
+    const uint16_t hlen = tcph->hlen();
+
+    if ( hlen < tcp::TCP_MIN_HEADER_LEN or hlen > len )
+        return false;
+
+    const uint8_t flags = tcph->th_flags;
+
+    // anything the codec alerts on; urg covers xmas and bad urp
+    if ( flags & TH_URG )
+        return false;
+
+    if ( flags & TH_SYN )
+    {
+        if ( flags & (TH_RST|TH_FIN) )
+            return false;
+
+        // naptha and shaft
+        if ( (flags & TH_NORESERVED) == TH_SYN and
+            (tcph->th_seq == 6060842 or tcph->seq() == 674711609) )
+            return false;
+    }
+    else if ( !(flags & (TH_ACK|TH_RST)) )
+        return false;
+
+    if ( (flags & (TH_FIN|TH_PUSH)) and !(flags & TH_ACK) )
+        return false;
+
+    if ( !tcph->th_sport or !tcph->th_dport )
+        return false;
+
+    unsigned opt_len = hlen - tcp::TCP_MIN_HEADER_LEN;
+    unsigned valid = 0;
+
+    if ( opt_len and !fast_tcp_opts((const uint8_t*)tcph + tcp::TCP_MIN_HEADER_LEN, opt_len, valid) )
+        return false;
+
+    if ( SnortConfig::tcp_checksums() and !SnortConfig::tcp_checksum_offloaded(pkth) )
+    {
+        Profile profile(checksumPerfStats);
+        uint16_t csum;
+
+        if ( iph )
+        {
+            checksum::Pseudoheader ph;
+            ph.sip = iph->get_src();
+            ph.dip = iph->get_dst();
+            ph.zero = 0;
+            ph.protocol = iph->proto();
+            ph.len = htons((uint16_t)len);
+            csum = checksum::tcp_cksum((const uint16_t*)tcph, len, &ph);
+        }
+        else
+        {
+            checksum::Pseudoheader6 ph6;
+            COPY4(ph6.sip, ip6h->get_src()->u6_addr32);
+            COPY4(ph6.dip, ip6h->get_dst()->u6_addr32);
+            ph6.zero = 0;
+            ph6.protocol = ip6h->next();
+            ph6.len = htons((uint16_t)len);
+            csum = checksum::tcp_cksum((const uint16_t*)tcph, len, &ph6);
+        }
+        if ( csum )
+            return false;
+    }
+    lyr_len = tcp::TCP_MIN_HEADER_LEN + valid;
+    return true;
+}
+
+static inline bool fast_udp(
+    const udp::UDPHdr* udph, uint32_t len, const ip::IP4Hdr* iph, const ip::IP6Hdr* ip6h)
+{
+    if ( len < udp::UDP_HEADER_LEN or udph->len() != len )
+        return false;
+
+    if ( len - udp::UDP_HEADER_LEN > 4000 )
+        return false;
+
+    const uint16_t sp = udph->src_port();
+    const uint16_t dp = udph->dst_port();
+
+    if ( !sp or !dp )
+        return false;
+
+    // the codec hands these on
+    if ( SnortConfig::gtp_decoding() and
+        (SnortConfig::is_gtp_port(sp) or SnortConfig::is_gtp_port(dp)) )
+        return false;
+
+    if ( teredo::is_teredo_port(sp) or teredo::is_teredo_port(dp) or
+        SnortConfig::deep_teredo_inspection() )
+        return false;
+
+    if ( ip6h and !udph->uh_chk )
+        return false;
+
+    if ( SnortConfig::udp_checksums() and udph->uh_chk )
+    {
+        Profile profile(checksumPerfStats);
+        uint16_t csum;
+
+        if ( iph )
+        {
+            checksum::Pseudoheader ph;
+            ph.sip = iph->get_src();
+            ph.dip = iph->get_dst();
+            ph.zero = 0;
+            ph.protocol = iph->proto();
+            ph.len = udph->uh_len;
+            csum = checksum::udp_cksum((const uint16_t*)udph, len, &ph);
+        }
+        else
+        {
+            checksum::Pseudoheader6 ph6;
+            COPY4(ph6.sip, ip6h->get_src()->u6_addr32);
+            COPY4(ph6.dip, ip6h->get_dst()->u6_addr32);
+            ph6.zero = 0;
+            ph6.protocol = ip6h->next();
+            ph6.len = htons((uint16_t)len);
+            csum = checksum::udp_cksum((const uint16_t*)udph, len, &ph6);
+        }
+        if ( csum )
+            return false;
+    }
+    return true;
+}
+
+bool PacketManager::fast_decode(Packet* p, RawData& raw)
+{
+    const uint8_t* data = raw.data;
+    uint32_t len = raw.len;
+
+    if ( len < eth::ETH_HEADER_LEN )
+        return false;
+
+    const eth::EtherHdr* eh = reinterpret_cast<const eth::EtherHdr*>(data);
+    ProtocolId type = eh->ethertype();
+    uint32_t off = eth::ETH_HEADER_LEN;
+    unsigned vlans = 0;
+
+    while ( type == ProtocolId::ETHERTYPE_8021Q )
+    {
+        if ( vlans == FAST_MAX_VLANS or len - off < sizeof(vlan::VlanTagHdr) )
+            return false;
+
+        const vlan::VlanTagHdr* vh = reinterpret_cast<const vlan::VlanTagHdr*>(data + off);
+
+        if ( vh->vid() == 0 or vh->vid() == 4095 )
+            return false;
+
+        type = (ProtocolId)vh->proto();
+        off += sizeof(vlan::VlanTagHdr);
+        vlans++;
+    }
+
+    // eth + vlans + ip + transport
+    if ( vlans + 3u > CodecManager::max_layers )
+        return false;
+
+    const ip::IP4Hdr* iph = nullptr;
+    const ip::IP6Hdr* ip6h = nullptr;
+    uint32_t ip_len;
+    uint32_t ip_hlen;
+    IpProtocol next;
+
+    if ( type == ProtocolId::ETHERTYPE_IPV4 )
+    {
+        iph = reinterpret_cast<const ip::IP4Hdr*>(data + off);
+
+        if ( !fast_ip4(iph, len - off) )
+            return false;
+
+        ip_len = iph->len();
+        ip_hlen = ip::IP4_HEADER_LEN;
+        next = iph->proto();
+    }
+    else if ( type == ProtocolId::ETHERTYPE_IPV6 )
+    {
+        ip6h = reinterpret_cast<const ip::IP6Hdr*>(data + off);
+
+        if ( !fast_ip6(ip6h, len - off) )
+            return false;
+
+        ip_len = ip6h->len() + ip::IP6_HEADER_LEN;
+        ip_hlen = ip::IP6_HEADER_LEN;
+        next = ip6h->next();
+    }
+    else
+        return false;
+
+    const uint8_t* xport = data + off + ip_hlen;
+    const uint32_t xport_len = ip_len - ip_hlen;
+    unsigned xport_hlen = udp::UDP_HEADER_LEN;
+
+    if ( next == IpProtocol::TCP )
+    {
+        if ( !fast_tcp(reinterpret_cast<const tcp::TCPHdr*>(xport), xport_len,
+            iph, ip6h, raw.pkth, xport_hlen) )
+            return false;
+    }
+    else if ( !fast_udp(reinterpret_cast<const udp::UDPHdr*>(xport), xport_len, iph, ip6h) )
+        return false;
+
+    // valid; now fill in the packet as the codecs would
+    push_layer(p, CodecManager::grinder_id, data, eth::ETH_HEADER_LEN);
+    s_stats[s_fast.eth + stat_offset]++;
+
+    for ( unsigned i = 0; i < vlans; ++i )
+    {
+        push_layer(p, ProtocolId::ETHERTYPE_8021Q,
+            data + eth::ETH_HEADER_LEN + i * sizeof(vlan::VlanTagHdr), sizeof(vlan::VlanTagHdr));
+        s_stats[s_fast.vlan + stat_offset]++;
+    }
+
+    push_layer(p, type, data + off, ip_hlen);
+
+    if ( iph )
+    {
+        p->ptrs.ip_api.set(iph);
+        s_stats[s_fast.ip4 + stat_offset]++;
+    }
+    else
+    {
+        p->ptrs.ip_api.set(ip6h);
+        s_stats[s_fast.ip6 + stat_offset]++;
+    }
+    p->ip_proto_next = next;
+
+    const ProtocolId xport_id = (ProtocolId)next;
+    push_layer(p, xport_id, xport, xport_hlen);
+
+    if ( next == IpProtocol::TCP )
+    {
+        const tcp::TCPHdr* tcph = reinterpret_cast<const tcp::TCPHdr*>(xport);
+        p->ptrs.tcph = tcph;
+        p->ptrs.sp = tcph->src_port();
+        p->ptrs.dp = tcph->dst_port();
+        p->ptrs.set_pkt_type(PktType::TCP);
+        p->proto_bits |= PROTO_BIT__TCP;
+        s_stats[s_fast.tcp + stat_offset]++;
+
+        // the header length including any options after an eol
+        xport_hlen = tcph->hlen();
+    }
+    else
+    {
+        const udp::UDPHdr* udph = reinterpret_cast<const udp::UDPHdr*>(xport);
+        p->ptrs.udph = udph;
+        p->ptrs.sp = udph->src_port();
+        p->ptrs.dp = udph->dst_port();
+        p->ptrs.set_pkt_type(PktType::UDP);
+        p->proto_bits |= PROTO_BIT__UDP;
+        s_stats[s_fast.udp + stat_offset]++;
+    }
+    s_stats[s_fast.done + stat_offset]++;
+
+    p->proto_bits |= PROTO_BIT__ETH | PROTO_BIT__IP;
+
+    if ( vlans )
+        p->proto_bits |= PROTO_BIT__VLAN;
+
+    raw.data = xport + xport_hlen;
+    raw.len = xport_len - xport_hlen;
+    return true;
+}
+
+#if defined(REG_TEST) || defined(UNIT_TEST)
+// true if the fast path filled in the packet as the codecs did
+static bool same_decode(const Packet* slow, const Packet* fast)
+{
+    bool same =
+        slow->num_layers == fast->num_layers and slow->proto_bits == fast->proto_bits and
+        slow->ip_proto_next == fast->ip_proto_next and
+        slow->data == fast->data and slow->dsize == fast->dsize and
+        slow->ptrs.tcph == fast->ptrs.tcph and slow->ptrs.udph == fast->ptrs.udph and
+        slow->ptrs.icmph == fast->ptrs.icmph and
+        slow->ptrs.sp == fast->ptrs.sp and slow->ptrs.dp == fast->ptrs.dp and
+        slow->ptrs.decode_flags == fast->ptrs.decode_flags and
+        slow->ptrs.get_pkt_type() == fast->ptrs.get_pkt_type() and
+        slow->ptrs.ip_api == fast->ptrs.ip_api;
+
+    for ( unsigned i = 0; same and i < fast->num_layers; ++i )
+    {
+        same = slow->layers[i].prot_id == fast->layers[i].prot_id and
+            slow->layers[i].start == fast->layers[i].start and
+            slow->layers[i].length == fast->layers[i].length;
+    }
+    return same;
+}
+#endif
+
+#ifdef REG_TEST
+// decode again with the codecs and complain about any difference
+void PacketManager::check_fast_decode(
+    const Packet* p, const DAQ_PktHdr_t* pkthdr, const uint8_t* pkt, bool cooked)
+{
+    Packet slow(false);
+    auto stats = s_stats;
+
+    s_fast.enabled = false;
+    decode(&slow, pkthdr, pkt, cooked);
+    s_fast.enabled = true;
+
+    s_stats = stats;
+    layer::set_packet_pointer(p);
+
+    if ( !same_decode(&slow, p) )
+        ErrorMessage("fast decode differs from codecs for packet " STDu64 "\n",
+            s_stats[total_processed]);
+}
+#endif
+
 //-------------------------------------------------------------------------
 // Encode/Decode functions
 //-------------------------------------------------------------------------
@@ -160,6 +664,16 @@ void PacketManager::decode(
 
     s_stats[total_processed]++;
 
+    if ( s_fast.enabled and fast_decode(p, raw) )
+    {
+        p->data = raw.data;
+        p->dsize = (uint16_t)raw.len;
+#ifdef REG_TEST
+        check_fast_decode(p, pkthdr, pkt, cooked);
+#endif
+        return;
+    }
+
     // loop until the protocol id is no longer valid
     while (CodecManager::s_protocols[mapped_prot]->decode(raw, codec_data, p->ptrs))
     {
@@ -765,6 +1279,58 @@ static inline void add_flag(UpdateFlags& flags,
         flags |= flag_to_add;
 }
 
+// the layer of the tcp or udp header; 0 if there is none
+static uint8_t xport_layer(const Packet* p)
+{
+    const void* h = p->ptrs.tcph ?
+        (const void*)p->ptrs.tcph : (const void*)p->ptrs.udph;
+
+    uint8_t i = p->num_layers;
+
+    while ( i > 0 )
+    {
+        if ( p->layers[--i].start == h )
+            return i;
+    }
+    return 0;
+}
+
+void PacketManager::rewrite(Packet* p, uint8_t* pos, const void* data, unsigned len)
+{
+    if ( !(p->packet_flags & PKT_PSEUDO) and !layer::has_outer_cksum(p, xport_layer(p)) )
+    {
+        if ( p->is_tcp() )
+        {
+            tcp::TCPHdr* h = const_cast<tcp::TCPHdr*>(p->ptrs.tcph);
+            bool odd = (pos - (uint8_t*)h) & 1;
+
+            Profile profile(checksumPerfStats);
+            h->th_sum = checksum::cksum_update(h->th_sum, pos, data, len, odd);
+            memcpy(pos, data, len);
+            p->packet_flags |= PKT_CKSUM_ADJUSTED;
+            return;
+        }
+        // a zero udp checksum wasn't computed so there is nothing to adjust
+        if ( p->is_udp() and p->ptrs.udph->uh_chk )
+        {
+            udp::UDPHdr* h = const_cast<udp::UDPHdr*>(p->ptrs.udph);
+            bool odd = (pos - (uint8_t*)h) & 1;
+
+            Profile profile(checksumPerfStats);
+            h->uh_chk = checksum::cksum_update(h->uh_chk, pos, data, len, odd);
+
+            if ( !h->uh_chk )
+                h->uh_chk = 0xffff;
+
+            memcpy(pos, data, len);
+            p->packet_flags |= PKT_CKSUM_ADJUSTED;
+            return;
+        }
+    }
+    memcpy(pos, data, len);
+    p->packet_flags |= PKT_MODIFIED;
+}
+
 void PacketManager::encode_update(Packet* p)
 {
     uint32_t len = p->dsize;
@@ -911,3 +1477,515 @@ void PacketManager::log_protocols(TextLog* const text_log,
     }
 }
 
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+
+#include "main/policy.h"
+
+static void put16(uint8_t* p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+static void put32(uint8_t* p, uint32_t v)
+{
+    put16(p, v >> 16);
+    put16(p + 2, v & 0xffff);
+}
+
+// eth[/vlan...]/ip4|ip6/tcp|udp with valid lengths; fields may be changed
+// before fix() sets the checksums
+class TestPkt
+{
+public:
+    TestPkt(unsigned vlans, bool ip6, IpProtocol proto, uint8_t flags = TH_SYN,
+        const std::vector<uint8_t>& opts = { }, unsigned dsize = 0);
+
+    uint8_t* ip()
+    { return buf.data() + ip_off; }
+
+    uint8_t* xport()
+    { return buf.data() + xport_off; }
+
+    void fix();
+
+    std::vector<uint8_t> buf;
+    unsigned ip_off;
+    unsigned xport_off;
+    unsigned xport_len;
+    bool ip6;
+    IpProtocol proto;
+};
+
+TestPkt::TestPkt(
+    unsigned vlans, bool v6, IpProtocol ipp, uint8_t flags,
+    const std::vector<uint8_t>& opts, unsigned dsize)
+{
+    ip6 = v6;
+    proto = ipp;
+
+    const unsigned ip_hlen = ip6 ? ip::IP6_HEADER_LEN : ip::IP4_HEADER_LEN;
+    const unsigned xport_hlen = (proto == IpProtocol::TCP) ?
+        tcp::TCP_MIN_HEADER_LEN + opts.size() : udp::UDP_HEADER_LEN;
+
+    ip_off = eth::ETH_HEADER_LEN + vlans * sizeof(vlan::VlanTagHdr);
+    xport_off = ip_off + ip_hlen;
+    xport_len = xport_hlen + dsize;
+    buf.assign(xport_off + xport_len, 0);
+
+    uint8_t* b = buf.data();
+    const uint16_t ip_type = ip6 ? 0x86dd : 0x0800;
+
+    memcpy(b, "\x00\x11\x22\x33\x44\x55\x00\x66\x77\x88\x99\xaa", 12);
+    put16(b + 12, vlans ? 0x8100 : ip_type);
+
+    for ( unsigned i = 0; i < vlans; ++i )
+    {
+        uint8_t* v = b + eth::ETH_HEADER_LEN + i * sizeof(vlan::VlanTagHdr);
+        put16(v, 10 + i);
+        put16(v + 2, (i + 1 < vlans) ? 0x8100 : ip_type);
+    }
+
+    uint8_t* h = ip();
+
+    if ( ip6 )
+    {
+        h[0] = 0x60;
+        put16(h + 4, xport_len);
+        h[6] = (uint8_t)proto;
+        h[7] = 64;
+        put32(h + 8, 0x20010db8);
+        h[23] = 1;
+        put32(h + 24, 0x20010db8);
+        h[39] = 2;
+    }
+    else
+    {
+        h[0] = 0x45;
+        put16(h + 2, ip_hlen + xport_len);
+        put16(h + 4, 1);
+        put16(h + 6, 0x4000);
+        h[8] = 64;
+        h[9] = (uint8_t)proto;
+        put32(h + 12, 0x0a010203);
+        put32(h + 16, 0x0a040506);
+    }
+
+    uint8_t* x = xport();
+    put16(x, 40000);
+
+    if ( proto == IpProtocol::TCP )
+    {
+        put16(x + 2, 80);
+        put32(x + 4, 1);
+        put32(x + 8, (flags & TH_ACK) ? 1 : 0);
+        x[12] = (xport_hlen / 4) << 4;
+        x[13] = flags;
+        put16(x + 14, 8192);
+
+        if ( !opts.empty() )
+            memcpy(x + tcp::TCP_MIN_HEADER_LEN, opts.data(), opts.size());
+    }
+    else
+    {
+        put16(x + 2, 53);
+        put16(x + 4, xport_len);
+    }
+
+    for ( unsigned i = 0; i < dsize; ++i )
+        x[xport_hlen + i] = 'a' + i % 26;
+}
+
+void TestPkt::fix()
+{
+    uint8_t* h = ip();
+    uint8_t* x = xport();
+    uint8_t* chk = x + ((proto == IpProtocol::TCP) ? 16 : 6);
+    uint16_t c;
+
+    memset(chk, 0, 2);
+
+    if ( ip6 )
+    {
+        checksum::Pseudoheader6 ph6;
+        memcpy(ph6.sip, h + 8, sizeof(ph6.sip));
+        memcpy(ph6.dip, h + 24, sizeof(ph6.dip));
+        ph6.zero = 0;
+        ph6.protocol = proto;
+        ph6.len = htons((uint16_t)xport_len);
+
+        c = (proto == IpProtocol::TCP) ?
+            checksum::tcp_cksum((const uint16_t*)x, xport_len, &ph6) :
+            checksum::udp_cksum((const uint16_t*)x, xport_len, &ph6);
+    }
+    else
+    {
+        memset(h + 10, 0, 2);
+        c = checksum::ip_cksum((const uint16_t*)h, ip::IP4_HEADER_LEN);
+        memcpy(h + 10, &c, 2);
+
+        checksum::Pseudoheader ph;
+        memcpy(&ph.sip, h + 12, sizeof(ph.sip));
+        memcpy(&ph.dip, h + 16, sizeof(ph.dip));
+        ph.zero = 0;
+        ph.protocol = proto;
+        ph.len = htons((uint16_t)xport_len);
+
+        c = (proto == IpProtocol::TCP) ?
+            checksum::tcp_cksum((const uint16_t*)x, xport_len, &ph) :
+            checksum::udp_cksum((const uint16_t*)x, xport_len, &ph);
+    }
+    memcpy(chk, &c, 2);
+}
+
+// decodes packets with the builtin codecs and with the fast path
+class FastDecodeTest
+{
+public:
+    // eth as the grinder the way a packet thread has it
+    static bool init()
+    {
+        set_default_policy();
+
+        for ( unsigned i = 0; i < CodecManager::s_protocols.size(); ++i )
+        {
+            const Codec* cd = CodecManager::s_protocols[i];
+
+            if ( cd and !strcmp(cd->get_name(), "eth") )
+            {
+                CodecManager::grinder = i;
+                CodecManager::grinder_id = ProtocolId::ETHERNET_802_3;
+                break;
+            }
+        }
+        CodecManager::max_layers = DEFAULT_LAYERMAX;
+        PacketManager::thread_init();
+
+        return s_fast.enabled;
+    }
+
+    static void check(const TestPkt& tp, bool fast)
+    {
+        DAQ_PktHdr_t hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.caplen = hdr.pktlen = tp.buf.size();
+
+        const uint8_t* pkt = tp.buf.data();
+        const auto start = PacketManager::s_stats;
+
+        Packet probe(false);
+        RawData raw(&hdr, pkt);
+        CHECK(PacketManager::fast_decode(&probe, raw) == fast);
+
+        Packet slow(false);
+        PacketManager::s_stats = start;
+        s_fast.enabled = false;
+        PacketManager::decode(&slow, &hdr, pkt);
+        s_fast.enabled = true;
+
+        const auto slow_stats = PacketManager::s_stats;
+
+        Packet quick(false);
+        PacketManager::s_stats = start;
+        PacketManager::decode(&quick, &hdr, pkt);
+
+        CHECK(same_decode(&slow, &quick));
+        CHECK((PacketManager::s_stats == slow_stats));
+
+        PacketManager::s_stats = start;
+    }
+};
+
+TEST_CASE("fast decode", "[PacketManager]")
+{
+    if ( !FastDecodeTest::init() )
+    {
+        WARN("fast decode needs the builtin codecs");
+        return;
+    }
+
+    const std::vector<uint8_t> mss = { 2, 4, 0x05, 0xb4 };
+    const std::vector<uint8_t> ts = { 1, 1, 8, 10, 0, 0, 0, 1, 0, 0, 0, 0 };
+    const std::vector<uint8_t> eol = { 2, 4, 0x05, 0xb4, 0, 0x99, 0x99, 0x99 };
+    const std::vector<uint8_t> wscale = { 3, 3, 15, 1 };
+
+    SECTION("valid")
+    {
+        TestPkt pkts[] =
+        {
+            { 0, false, IpProtocol::TCP, TH_SYN, mss },
+            { 1, false, IpProtocol::UDP, 0, { }, 100 },
+            { 2, true, IpProtocol::TCP, TH_ACK|TH_PUSH, ts, 200 },
+            { 0, true, IpProtocol::UDP, 0, { }, 10 },
+            { 0, false, IpProtocol::TCP, TH_ACK, eol, 50 },
+            { 1, true, IpProtocol::TCP, TH_RST|TH_ACK },
+        };
+
+        for ( auto& tp : pkts )
+        {
+            tp.fix();
+            FastDecodeTest::check(tp, true);
+        }
+    }
+
+    SECTION("ip4")
+    {
+        TestPkt tp(0, false, IpProtocol::TCP, TH_ACK, { }, 20);
+        tp.fix();
+
+        SECTION("bad checksum")
+        {
+            tp.ip()[10] ^= 0xff;
+        }
+        SECTION("fragment")
+        {
+            put16(tp.ip() + 6, 0x2000);
+            tp.fix();
+        }
+        SECTION("options")
+        {
+            tp.ip()[0] = 0x46;
+            tp.fix();
+        }
+        SECTION("too long")
+        {
+            put16(tp.ip() + 2, tp.buf.size());
+            tp.fix();
+        }
+        SECTION("same addresses")
+        {
+            memcpy(tp.ip() + 16, tp.ip() + 12, 4);
+            tp.fix();
+        }
+        SECTION("loopback")
+        {
+            tp.ip()[12] = 127;
+            tp.fix();
+        }
+        SECTION("truncated")
+        {
+            tp.buf.resize(tp.ip_off + 10);
+        }
+        FastDecodeTest::check(tp, false);
+    }
+
+    SECTION("ip6")
+    {
+        TestPkt tp(0, true, IpProtocol::UDP, 0, { }, 20);
+        tp.fix();
+
+        SECTION("extension")
+        {
+            tp.ip()[6] = 0;
+        }
+        SECTION("multicast")
+        {
+            tp.ip()[24] = 0xff;
+            tp.fix();
+        }
+        SECTION("zero checksum")
+        {
+            memset(tp.xport() + 6, 0, 2);
+        }
+        FastDecodeTest::check(tp, false);
+    }
+
+    SECTION("tcp")
+    {
+        TestPkt tp(0, false, IpProtocol::TCP, TH_SYN, mss);
+        tp.fix();
+
+        SECTION("bad checksum")
+        {
+            tp.xport()[16] ^= 1;
+        }
+        SECTION("syn fin")
+        {
+            tp.xport()[13] = TH_SYN|TH_FIN;
+            tp.fix();
+        }
+        SECTION("no flags")
+        {
+            tp.xport()[13] = 0;
+            tp.fix();
+        }
+        SECTION("port 0")
+        {
+            put16(tp.xport() + 2, 0);
+            tp.fix();
+        }
+        SECTION("bad option")
+        {
+            memcpy(tp.xport() + tcp::TCP_MIN_HEADER_LEN, wscale.data(), wscale.size());
+            tp.fix();
+        }
+        SECTION("long header")
+        {
+            tp.xport()[12] = 0xf0;
+            tp.fix();
+        }
+        FastDecodeTest::check(tp, false);
+    }
+
+    SECTION("udp")
+    {
+        TestPkt tp(0, false, IpProtocol::UDP, 0, { }, 20);
+        tp.fix();
+
+        SECTION("bad length")
+        {
+            put16(tp.xport() + 4, tp.xport_len - 1);
+            tp.fix();
+        }
+        SECTION("teredo")
+        {
+            put16(tp.xport() + 2, 3544);
+            tp.fix();
+        }
+        FastDecodeTest::check(tp, false);
+    }
+
+    SECTION("eth")
+    {
+        TestPkt tp(1, false, IpProtocol::UDP, 0, { }, 20);
+        tp.fix();
+
+        SECTION("three vlans")
+        {
+            tp = TestPkt(3, false, IpProtocol::UDP, 0, { }, 20);
+            tp.fix();
+        }
+        SECTION("vlan 0")
+        {
+            put16(tp.buf.data() + eth::ETH_HEADER_LEN, 0);
+        }
+        SECTION("other type")
+        {
+            put16(tp.buf.data() + 12, 0x88b5);
+        }
+        SECTION("short")
+        {
+            tp.buf.resize(eth::ETH_HEADER_LEN - 4);
+        }
+        FastDecodeTest::check(tp, false);
+    }
+}
+
+// eth/ip4/udp/teredo around the ip6 packet in inner
+static TestPkt teredo_pkt(const TestPkt& inner, bool cksum)
+{
+    const unsigned len = inner.buf.size() - inner.ip_off;
+    TestPkt tp(0, false, IpProtocol::UDP, 0, { }, len);
+
+    put16(tp.xport() + 2, teredo::TEREDO_PORT);
+    memcpy(tp.xport() + udp::UDP_HEADER_LEN, inner.buf.data() + inner.ip_off, len);
+    tp.fix();
+
+    if ( !cksum )
+        memset(tp.xport() + 6, 0, 2);
+
+    return tp;
+}
+
+// decode tp and overwrite the payload at off with s
+static uint32_t rewrite(TestPkt& tp, unsigned off, const char* s, PktType type)
+{
+    DAQ_PktHdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.caplen = hdr.pktlen = tp.buf.size();
+
+    Packet p(false);
+    PacketManager::decode(&p, &hdr, tp.buf.data());
+    REQUIRE(p.ptrs.get_pkt_type() == type);
+    REQUIRE(p.dsize >= off + strlen(s));
+
+    PacketManager::rewrite(&p, const_cast<uint8_t*>(p.data) + off, s, strlen(s));
+    return p.packet_flags & (PKT_CKSUM_ADJUSTED | PKT_MODIFIED);
+}
+
+TEST_CASE("rewrite", "[PacketManager]")
+{
+    if ( !FastDecodeTest::init() )
+    {
+        WARN("rewrite needs the builtin codecs");
+        return;
+    }
+
+    SECTION("tcp")
+    {
+        for ( unsigned off : { 0, 1, 6, 7 } )
+        {
+            TestPkt tp(0, false, IpProtocol::TCP, TH_ACK|TH_PUSH, { }, 20);
+            tp.fix();
+
+            TestPkt want = tp;
+            memcpy(want.xport() + tcp::TCP_MIN_HEADER_LEN + off, "xyz", 3);
+            want.fix();
+
+            CHECK(rewrite(tp, off, "xyz", PktType::TCP) == PKT_CKSUM_ADJUSTED);
+            CHECK(tp.buf == want.buf);
+        }
+    }
+    SECTION("udp")
+    {
+        for ( bool v6 : { false, true } )
+        {
+            TestPkt tp(0, v6, IpProtocol::UDP, 0, { }, 20);
+            tp.fix();
+
+            TestPkt want = tp;
+            memcpy(want.xport() + udp::UDP_HEADER_LEN + 3, "abcd", 4);
+            want.fix();
+
+            CHECK(rewrite(tp, 3, "abcd", PktType::UDP) == PKT_CKSUM_ADJUSTED);
+            CHECK(tp.buf == want.buf);
+        }
+    }
+    SECTION("udp no checksum")
+    {
+        TestPkt tp(0, false, IpProtocol::UDP, 0, { }, 20);
+        tp.fix();
+        memset(tp.xport() + 6, 0, 2);
+
+        CHECK(rewrite(tp, 0, "abcd", PktType::UDP) == PKT_MODIFIED);
+        CHECK(!memcmp(tp.xport() + 6, "\0\0", 2));
+    }
+    SECTION("tunneled")
+    {
+        // teredo addresses are 2001::/32
+        TestPkt inner(0, true, IpProtocol::TCP, TH_ACK|TH_PUSH, { }, 20);
+        memset(inner.ip() + 10, 0, 2);
+        memset(inner.ip() + 26, 0, 2);
+        inner.fix();
+
+        TestPkt want = inner;
+        memcpy(want.xport() + tcp::TCP_MIN_HEADER_LEN + 5, "xyz", 3);
+        want.fix();
+
+        SECTION("outer checksum")
+        {
+            // the inner edit would leave the outer udp checksum stale
+            TestPkt tp = teredo_pkt(inner, true);
+            TestPkt orig = tp;
+
+            CHECK(rewrite(tp, 5, "xyz", PktType::TCP) == PKT_MODIFIED);
+            CHECK(!memcmp(tp.xport() + 6, orig.xport() + 6, 2));
+            CHECK(tp.buf != orig.buf);
+        }
+        SECTION("no outer checksum")
+        {
+            TestPkt tp = teredo_pkt(inner, false);
+
+            CHECK(rewrite(tp, 5, "xyz", PktType::TCP) == PKT_CKSUM_ADJUSTED);
+            CHECK(tp.buf == teredo_pkt(want, false).buf);
+        }
+    }
+}
+
+#endif
@@ -70,6 +70,13 @@ public:
     // after Snort has changed any data in this packet
     static void encode_update(Packet*);
 
+    // copy len bytes of data over pos in the packet's tcp or udp segment
+    // and adjust that checksum in place (RFC 1624) so encode_update() can
+    // skip the full recompute.  falls back to setting PKT_MODIFIED if the
+    // checksum can't be adjusted or an outer layer (eg a udp tunnel) has a
+    // checksum over it too.  pos must not cover the checksum field.
+    static void rewrite(Packet*, uint8_t* pos, const void* data, unsigned len);
+
     //--------------------------------------------------------------------
     // FIXIT-L encode_format() should be replaced with a function that
     // does format and update in one step for packets cooked for internal
@@ -143,10 +150,23 @@ public:
 
 private:
     // The only time we should accumulate is when CodecManager tells us too
-    friend void CodecManager::thread_term();
+    friend void CodecManager::thread_term(bool);
     static void accumulate();
     static void pop_teredo(Packet*, RawData&);
 
+    // set up the fast path once the codecs are known
+    friend void CodecManager::thread_init(SnortConfig*);
+    static void thread_init();
+
+    // decode common, clean packets without the codecs
+    static bool fast_decode(Packet*, RawData&);
+#ifdef REG_TEST
+    static void check_fast_decode(const Packet*, const struct _daq_pkthdr*, const uint8_t*, bool);
+#endif
+#ifdef UNIT_TEST
+    friend class FastDecodeTest;
+#endif
+
     static bool encode(const Packet*, EncodeFlags,
         uint8_t lyr_start, IpProtocol next_prot, Buffer& buf);
 
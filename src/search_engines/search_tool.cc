@@ -23,9 +23,12 @@
 #include <stdlib.h>
 #include <ctype.h>
 
+#include <unordered_map>
+
 #include "main/thread.h"
 #include "framework/mpse.h"
 #include "managers/mpse_manager.h"
+#include "utils/stats.h"
 
 SearchTool::SearchTool() : SearchTool("ac_bnfa")
 {
@@ -128,3 +131,106 @@ int SearchTool::find_all(
     return num;
 }
 
+//-------------------------------------------------------------------------
+// shared tools
+//-------------------------------------------------------------------------
+
+struct SharedTool
+{
+    SearchTool* tool;
+    unsigned refs;
+    unsigned bytes;  // sum of pattern lengths
+};
+
+// keyed by method and the patterns with their ids and case flags
+static std::unordered_map<std::string, SharedTool> shared_tools;
+
+static unsigned tools_built = 0;
+static unsigned tools_shared = 0;
+static uint64_t bytes_saved = 0;
+
+void SearchTool::PatternSet::add(const char* pat, unsigned len, int id, bool no_case)
+{
+    Pattern p = { std::string(pat, len), id, no_case };
+    pats.push_back(p);
+}
+
+SearchTool* SearchTool::acquire(const PatternSet& ps)
+{
+    std::string key = ps.method;
+    key.push_back('\0');
+
+    unsigned bytes = 0;
+
+    for ( const auto& p : ps.pats )
+    {
+        uint32_t hdr[3] = { (uint32_t)p.id, (uint32_t)p.pat.size(), p.no_case };
+        key.append((const char*)hdr, sizeof(hdr));
+        key.append(p.pat);
+        bytes += p.pat.size();
+    }
+
+    auto it = shared_tools.find(key);
+
+    if ( it != shared_tools.end() )
+    {
+        it->second.refs++;
+        tools_shared++;
+        bytes_saved += bytes;
+        return it->second.tool;
+    }
+
+    SearchTool* st = new SearchTool(ps.method.c_str());
+
+    for ( const auto& p : ps.pats )
+        st->add(p.pat.c_str(), p.pat.size(), p.id, p.no_case);
+
+    st->prep();
+
+    SharedTool sh = { st, 1, bytes };
+    shared_tools.emplace(key, sh);
+    tools_built++;
+
+    return st;
+}
+
+void SearchTool::release(SearchTool* st)
+{
+    for ( auto it = shared_tools.begin(); it != shared_tools.end(); ++it )
+    {
+        if ( it->second.tool != st )
+            continue;
+
+        if ( !--it->second.refs )
+        {
+            delete st;
+            shared_tools.erase(it);
+
+            // erase keeps the buckets; give them back with the last tool
+            if ( shared_tools.empty() )
+                std::unordered_map<std::string, SharedTool>().swap(shared_tools);
+        }
+        return;
+    }
+}
+
+void SearchTool::show_shared()
+{
+    if ( !tools_built and !tools_shared )
+        return;
+
+    uint64_t bytes = 0;
+
+    for ( const auto& it : shared_tools )
+        bytes += it.second.bytes;
+
+    LogLabel("search tool sharing");
+    LogCount("tools built", tools_built);
+    LogCount("tools shared", tools_shared);
+    LogCount("live tools", shared_tools.size());
+    LogCount("pattern bytes", bytes);
+    LogCount("pattern bytes saved", bytes_saved);
+
+    tools_built = tools_shared = 0;
+    bytes_saved = 0;
+}
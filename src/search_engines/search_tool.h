@@ -20,10 +20,48 @@
 #ifndef SEARCH_TOOL_H
 #define SEARCH_TOOL_H
 
+#include <string>
+#include <vector>
+
 #include "framework/mpse.h"
 
 class SO_PUBLIC SearchTool
 {
+public:
+    // patterns for a shared tool are collected first so that the tool is
+    // only built if there isn't one already with the same method and
+    // patterns (in the same order)
+    class SO_PUBLIC PatternSet
+    {
+    public:
+        PatternSet(const char* method = "ac_bnfa")
+        { this->method = method; }
+
+        void add(const char* pattern, unsigned len, int s_id, bool no_case = true);
+
+    private:
+        friend class SearchTool;
+
+        struct Pattern
+        {
+            std::string pat;
+            int id;
+            bool no_case;
+        };
+
+        std::string method;
+        std::vector<Pattern> pats;
+    };
+
+    // shared tools are reference counted and read only.  inspectors in any
+    // policy that acquire the same set get the same tool and a reload that
+    // doesn't change the set keeps it.  call from the main thread only.
+    static SearchTool* acquire(const PatternSet&);
+    static void release(SearchTool*);
+
+    // log tools built and shared since the last call
+    static void show_shared();
+
 public:
     SearchTool();
     SearchTool(const char* method);
@@ -86,6 +86,9 @@ void FatalError(const char*,...)
 void LogCount(char const*, uint64_t, FILE*)
 { }
 
+void LogLabel(const char*, FILE*)
+{ }
+
 void LogStat(const char*, double, FILE* = stdout)
 {}
 
@@ -130,9 +133,9 @@ Mpse* MpseManager::get_search_engine(const char *type)
     return acf;
 }
 
-void MpseManager::delete_search_engine(Mpse *)
+void MpseManager::delete_search_engine(Mpse* p)
 {
-    mpse_api->dtor(acf);
+    mpse_api->dtor(p);
 }
 
 Mpse::Mpse(const char*, bool) { }
@@ -235,6 +238,41 @@ TEST(search_tool_tests, search_all_ac_full)
     delete stool;
 }
 
+TEST(search_tool_tests, shared)
+{
+    SearchTool::PatternSet a("ac_full"), b("ac_full"), c("ac_full");
+
+    a.add("the", 3, 1);
+    a.add("away", 4, 2112);
+
+    b.add("the", 3, 1);
+    b.add("away", 4, 2112);
+
+    c.add("the", 3, 1);
+    c.add("away", 4, 2112, false);
+
+    SearchTool* sa = SearchTool::acquire(a);
+    SearchTool* sb = SearchTool::acquire(b);
+    SearchTool* sc = SearchTool::acquire(c);
+
+    CHECK(sa);
+    CHECK(sa == sb);
+    CHECK(sa != sc);
+    CHECK(sc->max_len == 4);
+
+    const char* datastr = "the tuba ran away";
+    CHECK(sb->find(datastr, strlen(datastr), Test_SearchStrFound) == 2);
+
+    SearchTool::release(sa);
+    SearchTool::show_shared();
+
+    // still held by b
+    CHECK(sb->find(datastr, strlen(datastr), Test_SearchStrFound) == 2);
+
+    SearchTool::release(sb);
+    SearchTool::release(sc);
+}
+
 //-------------------------------------------------------------------------
 // main
 //-------------------------------------------------------------------------
@@ -30,6 +30,10 @@
 #include "dce_tcp_module.h"
 #include "dce_smb_utils.h"
 
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
 THREAD_LOCAL int co_reassembled = 0;
 
 /********************************************************************
@@ -1111,20 +1115,27 @@ static DCE2_RpktType DCE2_CoGetRpktType(DCE2_SsnData* sd, DCE2_BufType btype)
  *
  * Creates a reassembled buffer based on the kind of data
  * (fragment, segment or both) we want to put in the reassembled
- * buffer.
+ * buffer.  The last fragment, if given, is still in the packet and
+ * is gathered after the buffered fragments rather than being added
+ * to the fragment buffer first.
  *
  ********************************************************************/
 static Packet* DCE2_CoGetRpkt(DCE2_SsnData* sd, DCE2_CoTracker* cot,
-    DCE2_CoRpktType co_rtype, DCE2_RpktType* rtype)
+    DCE2_CoRpktType co_rtype, DCE2_RpktType* rtype, const DCE2_BufView* last_frag)
 {
     DCE2_CoSeg* seg_buf = DCE2_CoGetSegPtr(sd, cot);
     DCE2_Buffer* frag_buf = DCE2_CoGetFragBuf(sd, &cot->frag_tracker);
     const uint8_t* frag_data = nullptr, * seg_data = nullptr;
     uint32_t frag_len = 0, seg_len = 0;
+    DCE2_BufView views[3];
+    unsigned num_views = 0;
     Packet* rpkt = nullptr;
 
     *rtype = DCE2_RPKT_TYPE__NULL;
 
+    if ((last_frag != nullptr) && (last_frag->len == 0))
+        last_frag = nullptr;
+
     switch (co_rtype)
     {
     case DCE2_CO_RPKT_TYPE__ALL:
@@ -1165,8 +1176,10 @@ static Packet* DCE2_CoGetRpkt(DCE2_SsnData* sd, DCE2_CoTracker* cot,
         return nullptr;
     }
 
+    bool have_frag = (frag_data != nullptr) || (last_frag != nullptr);
+
     /* Seg stub data will be added to end of frag data */
-    if ((frag_data != nullptr) && (seg_data != nullptr))
+    if (have_frag && (seg_data != nullptr))
     {
         uint16_t hdr_size = sizeof(DceRpcCoHdr) + sizeof(DceRpcCoRequest);
 
@@ -1190,7 +1203,7 @@ static Packet* DCE2_CoGetRpkt(DCE2_SsnData* sd, DCE2_CoTracker* cot,
         }
     }
 
-    if (frag_data != nullptr)
+    if (have_frag)
         *rtype = DCE2_CoGetRpktType(sd, DCE2_BUF_TYPE__FRAG);
     else if (seg_data != nullptr)
         *rtype = DCE2_CoGetRpktType(sd, DCE2_BUF_TYPE__SEG);
@@ -1199,34 +1212,27 @@ static Packet* DCE2_CoGetRpkt(DCE2_SsnData* sd, DCE2_CoTracker* cot,
         return nullptr;
 
     if (frag_data != nullptr)
+        views[num_views++] = { frag_data, frag_len };
+
+    if (last_frag != nullptr)
+        views[num_views++] = *last_frag;
+
+    /* If there's frag data, seg stub data goes at the end of it */
+    if (seg_data != nullptr)
+        views[num_views++] = { seg_data, seg_len };
+
+    rpkt = DCE2_GetRpkt(sd->wire_pkt, *rtype, views, num_views);
+    if (rpkt == nullptr)
     {
-        rpkt = DCE2_GetRpkt(sd->wire_pkt, *rtype, frag_data, frag_len);
-        if (rpkt == nullptr)
-        {
-            DebugMessage(DEBUG_DCE_COMMON, "Failed to create reassembly buffer.\n");
-            return nullptr;
-        }
-        if (seg_data != nullptr)
-        {
-            /* If this fails, we'll still have the frag data */
-            DCE2_AddDataToRpkt(rpkt, seg_data, seg_len);
-        }
-    }
-    else if (seg_data != nullptr)
-    {
-        rpkt = DCE2_GetRpkt(sd->wire_pkt, *rtype, seg_data, seg_len);
-        if (rpkt == nullptr)
-        {
-            DebugMessage(DEBUG_DCE_COMMON, "Failed to create reassembly packet.\n");
-            return nullptr;
-        }
+        DebugMessage(DEBUG_DCE_COMMON, "Failed to create reassembly packet.\n");
+        return nullptr;
     }
 
     return rpkt;
 }
 
 static Packet* dce_co_reassemble(DCE2_SsnData* sd, DCE2_CoTracker* cot,
-    DCE2_CoRpktType co_rtype,DceRpcCoHdr** co_hdr)
+    DCE2_CoRpktType co_rtype, const DCE2_BufView* last_frag, DceRpcCoHdr** co_hdr)
 {
     DCE2_RpktType rpkt_type;
     Packet* rpkt;
@@ -1245,7 +1251,7 @@ static Packet* dce_co_reassemble(DCE2_SsnData* sd, DCE2_CoTracker* cot,
         Profile profile(dce2_smb_pstat_co_reass);
     }
 
-    rpkt = DCE2_CoGetRpkt(sd, cot, co_rtype, &rpkt_type);
+    rpkt = DCE2_CoGetRpkt(sd, cot, co_rtype, &rpkt_type, last_frag);
     if (rpkt == nullptr)
     {
         DebugMessage(DEBUG_DCE_COMMON, "Could not create DCE/RPC frag reassembled buffer.\n");
@@ -1319,10 +1325,11 @@ static Packet* dce_co_reassemble(DCE2_SsnData* sd, DCE2_CoTracker* cot,
  *
  *
  ********************************************************************/
-static void DCE2_CoReassemble(DCE2_SsnData* sd, DCE2_CoTracker* cot, DCE2_CoRpktType co_rtype)
+static void DCE2_CoReassemble(DCE2_SsnData* sd, DCE2_CoTracker* cot,
+    DCE2_CoRpktType co_rtype, const DCE2_BufView* last_frag = nullptr)
 {
     DceRpcCoHdr* co_hdr = nullptr;
-    Packet* rpkt = dce_co_reassemble(sd,cot,co_rtype,&co_hdr);
+    Packet* rpkt = dce_co_reassemble(sd, cot, co_rtype, last_frag, &co_hdr);
 
     if ( !rpkt )
         return;
@@ -1344,15 +1351,16 @@ static void DCE2_CoReassemble(DCE2_SsnData* sd, DCE2_CoTracker* cot, DCE2_CoRpkt
     co_reassembled = 1;
 }
 
-static inline void DCE2_CoFragReassemble(DCE2_SsnData* sd, DCE2_CoTracker* cot)
+static inline void DCE2_CoFragReassemble(DCE2_SsnData* sd, DCE2_CoTracker* cot,
+    const DCE2_BufView* last_frag = nullptr)
 {
-    DCE2_CoReassemble(sd, cot, DCE2_CO_RPKT_TYPE__FRAG);
+    DCE2_CoReassemble(sd, cot, DCE2_CO_RPKT_TYPE__FRAG, last_frag);
 }
 
 static DCE2_Ret dce_co_handle_frag(DCE2_SsnData* sd, DCE2_CoTracker* cot,
     const DceRpcCoHdr* co_hdr, const uint8_t* frag_ptr,
     uint16_t frag_len, DCE2_Buffer* frag_buf,
-    uint16_t max_frag_data)
+    uint16_t max_frag_data, DCE2_BufView* last_frag)
 {
     uint32_t size = (frag_len < DCE2_CO__MIN_ALLOC_SIZE) ? DCE2_CO__MIN_ALLOC_SIZE : frag_len;
     DCE2_BufferMinAddFlag mflag = DCE2_BUFFER_MIN_ADD_FLAG__USE;
@@ -1423,12 +1431,20 @@ static DCE2_Ret dce_co_handle_frag(DCE2_SsnData* sd, DCE2_CoTracker* cot,
     if ((DCE2_BufferLength(frag_buf) + frag_len) > max_frag_data)
         frag_len = max_frag_data - (uint16_t)DCE2_BufferLength(frag_buf);
 
+    /* The last fragment is flushed right away so it is gathered straight
+     * from the packet instead of being copied into the buffer first */
+    if (DceRpcCoLastFrag(co_hdr))
+    {
+        last_frag->data = frag_ptr;
+        last_frag->len = frag_len;
+        return DCE2_RET__SUCCESS;
+    }
+
     if (frag_len != 0)
     {
-        /* If it's the last fragment we're going to flush so just alloc
-         * exactly what we need ... or if there is more data than can fit
-         * in the reassembly buffer */
-        if (DceRpcCoLastFrag(co_hdr) || (DCE2_BufferLength(frag_buf) == max_frag_data))
+        /* If there is more data than can fit in the reassembly buffer
+         * just alloc exactly what we need */
+        if (DCE2_BufferLength(frag_buf) == max_frag_data)
             mflag = DCE2_BUFFER_MIN_ADD_FLAG__IGNORE;
 
         status = DCE2_BufferAddData(frag_buf, frag_ptr,
@@ -1441,6 +1457,8 @@ static DCE2_Ret dce_co_handle_frag(DCE2_SsnData* sd, DCE2_CoTracker* cot,
             DCE2_BufferEmpty(frag_buf);
             return DCE2_RET__ERROR;
         }
+
+        dce_common_stats->buffered_bytes += frag_len;
     }
     return(DCE2_RET__SUCCESS);
 }
@@ -1459,6 +1477,7 @@ static void DCE2_CoHandleFrag(DCE2_SsnData* sd, DCE2_CoTracker* cot,
 {
     DCE2_Ret ret_val;
     DCE2_Buffer* frag_buf = DCE2_CoGetFragBuf(sd, &cot->frag_tracker);
+    DCE2_BufView last_frag = { nullptr, 0 };
     uint16_t max_frag_data;
 
     /* Check for potential overflow */
@@ -1467,13 +1486,14 @@ static void DCE2_CoHandleFrag(DCE2_SsnData* sd, DCE2_CoTracker* cot,
     else
         max_frag_data = DCE2_GetRpktMaxData(sd, DCE2_RPKT_TYPE__TCP_CO_FRAG);
 
-    ret_val = dce_co_handle_frag(sd, cot,co_hdr, frag_ptr, frag_len,frag_buf,max_frag_data);
+    ret_val = dce_co_handle_frag(sd, cot, co_hdr, frag_ptr, frag_len, frag_buf,
+        max_frag_data, &last_frag);
     if (ret_val == DCE2_RET__SUCCESS)
     {
         /* Reassemble if we got a last frag ... */
         if (DceRpcCoLastFrag(co_hdr))
         {
-            DCE2_CoFragReassemble(sd, cot);
+            DCE2_CoFragReassemble(sd, cot, &last_frag);
             DCE2_BufferEmpty(frag_buf);
 
             /* Set this for the server response since response doesn't
@@ -2333,6 +2353,8 @@ static DCE2_Ret DCE2_CoHandleSegmentation(DCE2_SsnData* sd, DCE2_CoSeg* seg,
     status = DCE2_HandleSegmentation(seg->buf,
         data_ptr, data_len, need_len, data_used);
 
+    dce_get_proto_stats_ptr(sd)->buffered_bytes += *data_used;
+
     return status;
 }
 
@@ -2489,3 +2511,180 @@ dce2_coprocess_exit:
         DCE2_CoEarlyReassemble(sd, cot);
 }
 
+
+#ifdef UNIT_TEST
+class DceCoTest
+{
+public:
+    DceCoTest()
+    {
+        // as set up by dce2_tcp_thread_init
+        for (int i = 0; i < DCE2_TCP_RPKT_TYPE_MAX; i++)
+        {
+            save[i] = dce2_tcp_rpkt[i];
+            Packet* p = (Packet*)snort_calloc(sizeof(Packet));
+            p->data = (uint8_t*)snort_calloc(DCE2_REASSEMBLY_BUF_SIZE);
+            p->endianness = (Endianness*)new DceEndianness();
+            dce2_tcp_rpkt[i] = p;
+        }
+        wire.packet_flags = PKT_FROM_CLIENT;
+
+        conf.common.max_frag_len = DCE2_SENTINEL;
+
+        memset(&sd, 0, sizeof(sd));
+        sd.trans = DCE2_TRANS_TYPE__TCP;
+        sd.wire_pkt = &wire;
+        sd.config = &conf;
+
+        memset(&cot, 0, sizeof(cot));
+        DCE2_CoInitTracker(&cot);
+
+        memset(&hdr, 0, sizeof(hdr));
+    }
+
+    ~DceCoTest()
+    {
+        DCE2_CoCleanTracker(&cot);
+
+        for (int i = 0; i < DCE2_TCP_RPKT_TYPE_MAX; i++)
+        {
+            Packet* p = dce2_tcp_rpkt[i];
+            snort_free((void*)p->data);
+            delete p->endianness;
+            snort_free(p);
+            dce2_tcp_rpkt[i] = save[i];
+        }
+    }
+
+    DCE2_Ret frag(uint8_t flags, const uint8_t* data, uint16_t len, uint16_t max = UINT16_MAX)
+    {
+        hdr.pfc_flags = flags;
+        last = { nullptr, 0 };
+        return dce_co_handle_frag(&sd, &cot, &hdr, data, len,
+            DCE2_CoGetFragBuf(&sd, &cot.frag_tracker), max, &last);
+    }
+
+    Packet* rpkt()
+    {
+        DCE2_RpktType rtype;
+        Packet* p = DCE2_CoGetRpkt(&sd, &cot, DCE2_CO_RPKT_TYPE__FRAG, &rtype, &last);
+        CHECK(rtype == DCE2_RPKT_TYPE__TCP_CO_FRAG);
+        return p;
+    }
+
+    uint32_t buffered()
+    { return DCE2_BufferLength(DCE2_CoGetFragBuf(&sd, &cot.frag_tracker)); }
+
+    Packet* save[DCE2_TCP_RPKT_TYPE_MAX];
+    Packet wire { false };
+    dce2CoProtoConf conf;
+    DCE2_SsnData sd;
+    DCE2_CoTracker cot;
+    DceRpcCoHdr hdr;
+    DCE2_BufView last;
+};
+
+TEST_CASE("dce rpkt views", "[dce]")
+{
+    DceCoTest t;
+    const uint8_t abc[] = "abc", defg[] = "defg";
+    PegCount reassembled = dce2_tcp_stats.reassembled_bytes;
+
+    SECTION("gather")
+    {
+        DCE2_BufView views[] = { { abc, 3 }, { nullptr, 0 }, { defg, 4 }, { abc, 0 } };
+        Packet* p = DCE2_GetRpkt(&t.wire, DCE2_RPKT_TYPE__TCP_CO_SEG, views, 4);
+
+        REQUIRE(p != nullptr);
+        CHECK(p->dsize == 7);
+        CHECK(!memcmp(p->data, "abcdefg", 7));
+        CHECK(p->is_from_client());
+        CHECK(dce2_tcp_stats.reassembled_bytes == reassembled + 7);
+    }
+    SECTION("mock header")
+    {
+        DCE2_BufView views[] = { { abc, 3 }, { defg, 4 } };
+        Packet* p = DCE2_GetRpkt(&t.wire, DCE2_RPKT_TYPE__TCP_CO_FRAG, views, 2);
+
+        REQUIRE(p != nullptr);
+        CHECK(p->dsize == DCE2_MOCK_HDR_LEN__CO_CLI + 7);
+        CHECK(!memcmp(p->data + DCE2_MOCK_HDR_LEN__CO_CLI, "abcdefg", 7));
+    }
+    SECTION("single")
+    {
+        Packet* p = DCE2_GetRpkt(&t.wire, DCE2_RPKT_TYPE__TCP_CO_SEG, defg, 4);
+
+        REQUIRE(p != nullptr);
+        CHECK(p->dsize == 4);
+        CHECK(!memcmp(p->data, "defg", 4));
+    }
+    SECTION("truncated")
+    {
+        static uint8_t big[60000];
+        DCE2_BufView views[] = { { big, sizeof(big) }, { big, sizeof(big) }, { abc, 3 } };
+        Packet* p = DCE2_GetRpkt(&t.wire, DCE2_RPKT_TYPE__TCP_CO_FRAG, views, 3);
+
+        REQUIRE(p != nullptr);
+        CHECK(p->dsize == DCE2_REASSEMBLY_BUF_SIZE);
+        CHECK(dce2_tcp_stats.reassembled_bytes ==
+            reassembled + DCE2_REASSEMBLY_BUF_SIZE - DCE2_MOCK_HDR_LEN__CO_CLI);
+    }
+}
+
+TEST_CASE("dce last frag", "[dce]")
+{
+    DceCoTest t;
+    uint8_t a[100], b[100], c[50];
+
+    memset(a, 'a', sizeof(a));
+    memset(b, 'b', sizeof(b));
+    memset(c, 'c', sizeof(c));
+
+    PegCount buffered = dce2_tcp_stats.buffered_bytes;
+    const uint16_t hdr_len = DCE2_MOCK_HDR_LEN__CO_CLI;
+
+    SECTION("from packet")
+    {
+        CHECK(t.frag(DCERPC_CO_PFC_FLAGS__FIRST_FRAG, a, sizeof(a)) == DCE2_RET__SUCCESS);
+        CHECK(t.last.len == 0);
+        CHECK(t.frag(0, b, sizeof(b)) == DCE2_RET__SUCCESS);
+        CHECK(t.buffered() == 200);
+
+        // the last one is left in the packet
+        CHECK(t.frag(DCERPC_CO_PFC_FLAGS__LAST_FRAG, c, sizeof(c)) == DCE2_RET__SUCCESS);
+        CHECK((t.last.data == c));
+        CHECK(t.last.len == sizeof(c));
+        CHECK(t.buffered() == 200);
+        CHECK(dce2_tcp_stats.buffered_bytes == buffered + 200);
+
+        Packet* p = t.rpkt();
+        REQUIRE(p != nullptr);
+        REQUIRE(p->dsize == hdr_len + 250);
+        CHECK(!memcmp(p->data + hdr_len, a, 100));
+        CHECK(!memcmp(p->data + hdr_len + 100, b, 100));
+        CHECK(!memcmp(p->data + hdr_len + 200, c, 50));
+    }
+    SECTION("only frag")
+    {
+        uint8_t flags = DCERPC_CO_PFC_FLAGS__FIRST_FRAG | DCERPC_CO_PFC_FLAGS__LAST_FRAG;
+        CHECK(t.frag(flags, c, sizeof(c)) == DCE2_RET__SUCCESS);
+        CHECK(t.buffered() == 0);
+        CHECK(dce2_tcp_stats.buffered_bytes == buffered);
+
+        Packet* p = t.rpkt();
+        REQUIRE(p != nullptr);
+        REQUIRE(p->dsize == hdr_len + 50);
+        CHECK(!memcmp(p->data + hdr_len, c, 50));
+    }
+    SECTION("max frag data")
+    {
+        CHECK(t.frag(DCERPC_CO_PFC_FLAGS__FIRST_FRAG, a, sizeof(a), 120) == DCE2_RET__SUCCESS);
+        CHECK(t.frag(DCERPC_CO_PFC_FLAGS__LAST_FRAG, c, sizeof(c), 120) == DCE2_RET__SUCCESS);
+        CHECK(t.last.len == 20);
+
+        Packet* p = t.rpkt();
+        REQUIRE(p != nullptr);
+        CHECK(p->dsize == hdr_len + 120);
+    }
+}
+#endif
@@ -407,8 +407,31 @@ static void dce2_fill_rpkt_info(Packet* rpkt, Packet* p)
     rpkt->user_policy_id = p->user_policy_id;
 }
 
+static inline dce2CommonStats* dce2_get_rpkt_stats(DCE2_RpktType rpkt_type)
+{
+    if (rpkt_type < DCE2_TCP_RPKT_TYPE_START)
+        return((dce2CommonStats*)&dce2_smb_stats);
+
+    return((dce2CommonStats*)&dce2_tcp_stats);
+}
+
 Packet* DCE2_GetRpkt(Packet* p,DCE2_RpktType rpkt_type,
     const uint8_t* data, uint32_t data_len)
+{
+    DCE2_BufView view = { data, data_len };
+    return DCE2_GetRpkt(p, rpkt_type, &view, 1);
+}
+
+/********************************************************************
+ * Function: DCE2_GetRpkt()
+ *
+ * Gathers the views into the reassembly packet for rpkt_type after
+ * the mock headers.  This is the only copy made of data that is not
+ * already sitting in a buffer; anything that doesn't fit is dropped.
+ *
+ ********************************************************************/
+Packet* DCE2_GetRpkt(Packet* p,DCE2_RpktType rpkt_type,
+    const DCE2_BufView* views, unsigned num_views)
 {
     Packet* rpkt = nullptr;
     uint16_t data_overhead = 0;
@@ -514,14 +537,25 @@ Packet* DCE2_GetRpkt(Packet* p,DCE2_RpktType rpkt_type,
         return nullptr;
     }
 
-    if ((data_overhead + data_len) > DCE2_REASSEMBLY_BUF_SIZE)
-        data_len -= (data_overhead + data_len) - DCE2_REASSEMBLY_BUF_SIZE;
+    uint8_t* data_ptr = (uint8_t*)rpkt->data + data_overhead;
+    uint32_t avail = DCE2_REASSEMBLY_BUF_SIZE - data_overhead;
+    uint32_t data_len = 0;
 
-    if (data_len > DCE2_REASSEMBLY_BUF_SIZE - data_overhead)
-        return nullptr;
+    for (unsigned i = 0; (i < num_views) && (data_len < avail); i++)
+    {
+        uint32_t len = views[i].len;
+
+        if ((views[i].data == nullptr) || (len == 0))
+            continue;
+
+        if (len > avail - data_len)
+            len = avail - data_len;
+
+        memcpy_s(data_ptr + data_len, avail - data_len, views[i].data, len);
+        data_len += len;
+    }
 
-    memcpy_s((void*)(rpkt->data + data_overhead),
-        DCE2_REASSEMBLY_BUF_SIZE - data_overhead, data, data_len);
+    dce2_get_rpkt_stats(rpkt_type)->reassembled_bytes += data_len;
 
     rpkt->dsize = data_len + data_overhead;
     return rpkt;
@@ -88,6 +88,8 @@ struct dce2CommonStats
     PegCount co_srv_min_frag_size;
     PegCount co_srv_seg_reassembled;
     PegCount co_srv_frag_reassembled;
+    PegCount buffered_bytes;
+    PegCount reassembled_bytes;
 };
 #define DCE2_SARG__POLICY_WIN2000       "Win2000"
 #define DCE2_SARG__POLICY_WINXP         "WinXP"
@@ -168,6 +170,15 @@ enum DCE2_RpktType
     DCE2_RPKT_TYPE__MAX
 };
 
+/* A piece of a reassembled packet; the pieces are copied back to back
+ * into the reassembly packet so buffered data and the data in hand don't
+ * have to be joined first */
+struct DCE2_BufView
+{
+    const uint8_t* data;
+    uint32_t len;
+};
+
 struct DCE2_Roptions
 {
     /* dce_iface */
@@ -430,6 +441,8 @@ bool dce2_paf_abort(Flow*, DCE2_SsnData*);
 void DCE2_Detect(DCE2_SsnData*);
 Packet* DCE2_GetRpkt(Packet*, DCE2_RpktType,
     const uint8_t*, uint32_t);
+Packet* DCE2_GetRpkt(Packet*, DCE2_RpktType,
+    const DCE2_BufView*, unsigned);
 DCE2_Ret DCE2_PushPkt(Packet*,DCE2_SsnData*);
 void DCE2_PopPkt(DCE2_SsnData*);
 uint16_t DCE2_GetRpktMaxData(DCE2_SsnData*, DCE2_RpktType);
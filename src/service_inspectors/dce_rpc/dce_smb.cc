@@ -3183,6 +3183,7 @@ static void dce2_smb_thread_term()
     {
         DCE2_CStackDestroy(dce2_pkt_stack);
         dce2_pkt_stack = nullptr;
+        DCE2_BufferPoolTerm();
     }
 }
 
@@ -206,6 +206,8 @@ struct dce2SmbStats
     PegCount co_srv_min_frag_size;
     PegCount co_srv_seg_reassembled;
     PegCount co_srv_frag_reassembled;
+    PegCount buffered_bytes;
+    PegCount reassembled_bytes;
 
     PegCount smb_sessions;
     PegCount smb_pkts;
@@ -411,6 +411,8 @@ static DCE2_Ret DCE2_SmbWriteAndXRawRequest(DCE2_SmbSsnData* ssd, const SmbNtHdr
                 return DCE2_RET__ERROR;
             }
 
+            dce2_smb_stats.buffered_bytes += dcnt;
+
             if (ftracker->fp_writex_raw->remaining == 0)
             {
                 const uint8_t* data_ptr = DCE2_BufferData(ftracker->fp_writex_raw->buf);
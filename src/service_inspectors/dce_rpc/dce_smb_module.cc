@@ -68,6 +68,10 @@ static const PegInfo dce2_smb_pegs[] =
       "total connection-oriented server segments reassembled" },
     { "Server frags reassembled",
       "total connection-oriented server fragments reassembled" },
+    { "Bytes buffered",
+      "total bytes copied into segmentation and fragmentation buffers" },
+    { "Bytes reassembled",
+      "total bytes copied into reassembled packets" },
     { "Sessions", "total smb sessions" },
     { "Packets", "total smb packets" },
     { "Ignored bytes", "total ignored bytes" },
@@ -379,6 +379,8 @@ DCE2_Ret DCE2_SmbBufferTransactionData(DCE2_SmbTransactionTracker* ttracker,
         return DCE2_RET__ERROR;
     }
 
+    dce2_smb_stats.buffered_bytes += dcnt;
+
     DebugMessage(DEBUG_DCE_SMB,
         "Successfully buffered transaction data.\n");
 
@@ -406,6 +408,8 @@ DCE2_Ret DCE2_SmbBufferTransactionParameters(DCE2_SmbTransactionTracker* ttracke
         return DCE2_RET__ERROR;
     }
 
+    dce2_smb_stats.buffered_bytes += pcnt;
+
     DebugMessage(DEBUG_DCE_SMB,
         "Successfully buffered transaction parameter data.\n");
 
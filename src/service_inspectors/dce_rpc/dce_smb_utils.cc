@@ -1396,6 +1396,9 @@ DCE2_Ret DCE2_SmbHandleSegmentation(DCE2_Buffer** buf,
     DCE2_Ret status = DCE2_BufferAddData(*buf, data_ptr, add_len,
         DCE2_BufferLength(*buf), DCE2_BUFFER_MIN_ADD_FLAG__IGNORE);
 
+    if (status == DCE2_RET__SUCCESS)
+        dce2_smb_stats.buffered_bytes += add_len;
+
     return status;
 }
 
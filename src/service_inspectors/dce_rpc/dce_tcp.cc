@@ -306,6 +306,7 @@ static void dce2_tcp_thread_term()
     {
         DCE2_CStackDestroy(dce2_pkt_stack);
         dce2_pkt_stack = nullptr;
+        DCE2_BufferPoolTerm();
     }
 }
 
@@ -74,6 +74,8 @@ struct dce2TcpStats
     PegCount co_srv_min_frag_size;
     PegCount co_srv_seg_reassembled;
     PegCount co_srv_frag_reassembled;
+    PegCount buffered_bytes;
+    PegCount reassembled_bytes;
 
     /*DCE TCP specific*/
     PegCount tcp_sessions;
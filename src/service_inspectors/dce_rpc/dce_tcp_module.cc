@@ -99,6 +99,10 @@ static const PegInfo dce2_tcp_pegs[] =
       "total connection-oriented server segments reassembled" },
     { "Server frags reassembled",
       "total connection-oriented server fragments reassembled" },
+    { "Bytes buffered",
+      "total bytes copied into segmentation and fragmentation buffers" },
+    { "Bytes reassembled",
+      "total bytes copied into reassembled packets" },
     { "tcp sessions", "total tcp sessions" },
     { "tcp packets", "total tcp packets" },
     { nullptr, nullptr }
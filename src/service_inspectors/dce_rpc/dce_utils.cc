@@ -20,9 +20,14 @@
 #include "dce_utils.h"
 
 #include "main/snort_debug.h"
+#include "main/thread.h"
 #include "utils/util.h"
 #include "utils/safec.h"
 
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
 /********************************************************************
  * Function: DCE2_GetValue()
  *
@@ -311,14 +316,139 @@ void DCE2_PrintPktData(const uint8_t*, const uint16_t)
 
 #endif // DEBUG_MSGS
 
+/* Slabs released by destroyed buffers are kept for the next session on
+ * this thread rather than going back to the heap. */
+static THREAD_LOCAL uint8_t* slab_pool[DCE2_BUFFER__SLAB_CLASSES][DCE2_BUFFER__POOL_MAX];
+static THREAD_LOCAL unsigned slab_count[DCE2_BUFFER__SLAB_CLASSES];
+static THREAD_LOCAL uint32_t slab_bytes = 0;
+static THREAD_LOCAL bool slab_pool_closed = false;
+
+static inline unsigned DCE2_SlabClass(uint32_t slab_size)
+{
+    unsigned c = 0;
+
+    while (((uint32_t)DCE2_BUFFER__SLAB_MIN << c) < slab_size)
+        c++;
+
+    return c;
+}
+
+/* Returns nullptr when a new slab would go past the memcap */
+static uint8_t* DCE2_SlabAlloc(uint32_t slab_size)
+{
+    unsigned c = DCE2_SlabClass(slab_size);
+
+    if (slab_count[c] > 0)
+        return slab_pool[c][--slab_count[c]];
+
+    if ((slab_bytes + slab_size) > DCE2_BUFFER__SLAB_MEMCAP)
+        return nullptr;
+
+    slab_bytes += slab_size;
+    return (uint8_t*)snort_alloc(slab_size);
+}
+
+static void DCE2_SlabFree(uint8_t* slab, uint32_t slab_size)
+{
+    unsigned c = DCE2_SlabClass(slab_size);
+
+    if (!slab_pool_closed && (slab_count[c] < DCE2_BUFFER__POOL_MAX))
+    {
+        slab_pool[c][slab_count[c]++] = slab;
+        return;
+    }
+
+    slab_bytes -= slab_size;
+    snort_free(slab);
+}
+
+void DCE2_BufferPoolTerm()
+{
+    for (unsigned c = 0; c < DCE2_BUFFER__SLAB_CLASSES; c++)
+    {
+        while (slab_count[c] > 0)
+        {
+            slab_bytes -= DCE2_BUFFER__SLAB_MIN << c;
+            snort_free(slab_pool[c][--slab_count[c]]);
+        }
+    }
+
+    /* Sessions may still be released after the inspectors are gone */
+    slab_pool_closed = true;
+}
+
+static inline void DCE2_BufferFreeData(DCE2_Buffer* buf)
+{
+    if (buf->data == nullptr)
+        return;
+
+    if (buf->pooled)
+        DCE2_SlabFree(buf->data, buf->size);
+    else
+        snort_free((void*)buf->data);
+
+    buf->data = nullptr;
+    buf->pooled = false;
+}
+
+/********************************************************************
+ * Function: DCE2_BufferResize()
+ *
+ * Moves the buffer to storage of at least new_size bytes keeping
+ * the current contents.  Sizes past DCE2_BUFFER__POOL_MIN that fit
+ * in a slab get the smallest pooled slab that holds them while the
+ * slab memcap allows.  Other buffers grow geometrically if minimum
+ * adds are in use.
+ *
+ ********************************************************************/
+static DCE2_Ret DCE2_BufferResize(DCE2_Buffer* buf, uint32_t new_size,
+    DCE2_BufferMinAddFlag mflag)
+{
+    uint8_t* tmp = nullptr;
+    bool pooled = false;
+
+    if (new_size <= buf->size)
+        return DCE2_RET__SUCCESS;
+
+    if ((new_size > DCE2_BUFFER__POOL_MIN) && (new_size <= DCE2_BUFFER__SLAB_SIZE))
+    {
+        uint32_t slab_size = DCE2_BUFFER__SLAB_MIN << DCE2_SlabClass(new_size);
+
+        tmp = DCE2_SlabAlloc(slab_size);
+        if (tmp != nullptr)
+        {
+            new_size = slab_size;
+            pooled = true;
+        }
+    }
+
+    if (tmp == nullptr)
+    {
+        if ((mflag == DCE2_BUFFER_MIN_ADD_FLAG__USE) && (new_size < 2 * buf->size))
+            new_size = 2 * buf->size;
+
+        tmp = (uint8_t*)snort_calloc(new_size);
+    }
+
+    if ((buf->data != nullptr) && (buf->len != 0))
+        memcpy_s(tmp, new_size, buf->data, buf->len);
+
+    DCE2_BufferFreeData(buf);
+
+    buf->data = tmp;
+    buf->size = new_size;
+    buf->pooled = pooled;
+
+    return DCE2_RET__SUCCESS;
+}
+
 DCE2_Buffer* DCE2_BufferNew(uint32_t initial_size, uint32_t min_add_size)
 {
     DCE2_Buffer* buf = (DCE2_Buffer*)snort_calloc(sizeof(DCE2_Buffer));
 
     if (initial_size != 0)
-        buf->data = (uint8_t*)snort_calloc(initial_size);
+        DCE2_BufferResize(buf, initial_size, DCE2_BUFFER_MIN_ADD_FLAG__IGNORE);
 
-    buf->size = initial_size;
     buf->len = 0;
     buf->min_add_size = min_add_size;
     buf->offset = 0;
@@ -363,36 +493,25 @@ DCE2_Ret DCE2_BufferAddData(DCE2_Buffer* buf, const uint8_t* data,
     if (data_len == 0)
         return DCE2_RET__SUCCESS;
 
-    if (buf->data == nullptr)
-    {
-        uint32_t size = data_offset + data_len;
-
-        if ((size < buf->min_add_size) && (mflag == DCE2_BUFFER_MIN_ADD_FLAG__USE))
-            size = buf->min_add_size;
-
-        buf->data = (uint8_t*)snort_calloc(size);
-        buf->size = size;
-    }
-    else if ((data_offset + data_len) > buf->size)
+    if ((data_offset + data_len) > buf->size)
     {
-        uint8_t* tmp;
         uint32_t new_size = data_offset + data_len;
 
         if (((new_size - buf->size) < buf->min_add_size) && (mflag ==
             DCE2_BUFFER_MIN_ADD_FLAG__USE))
             new_size = buf->size + buf->min_add_size;
 
-        tmp = (uint8_t*)DCE2_ReAlloc(buf->data, buf->size, new_size);
-        if (tmp == nullptr)
+        if (DCE2_BufferResize(buf, new_size, mflag) != DCE2_RET__SUCCESS)
             return DCE2_RET__ERROR;
-
-        buf->data = tmp;
-        buf->size = new_size;
     }
 
     if (data_len > buf->size - data_offset)
         return DCE2_RET__ERROR;
 
+    /* Pooled slabs aren't zeroed so clear any hole left by an offset add */
+    if (data_offset > buf->len)
+        memset(buf->data + buf->len, 0, data_offset - buf->len);
+
     memcpy_s(buf->data + data_offset, buf->size - data_offset, data, data_len);
 
     if ((data_offset + data_len) > buf->len)
@@ -406,9 +525,145 @@ void DCE2_BufferDestroy(DCE2_Buffer* buf)
     if (buf == nullptr)
         return;
 
-    if (buf->data != nullptr)
-        snort_free((void*)buf->data);
-
+    DCE2_BufferFreeData(buf);
     snort_free((void*)buf);
 }
 
+
+#ifdef UNIT_TEST
+// empty the pool and open it again for the next test
+static void DCE2_BufferPoolReset()
+{
+    DCE2_BufferPoolTerm();
+    slab_pool_closed = false;
+}
+
+TEST_CASE("dce buffer size classes", "[dce]")
+{
+    DCE2_BufferPoolReset();
+
+    uint8_t data[DCE2_BUFFER__SLAB_SIZE];
+    for (unsigned i = 0; i < sizeof(data); i++)
+        data[i] = (uint8_t)i;
+
+    DCE2_Buffer* buf = DCE2_BufferNew(1024, 1024);
+    CHECK(!buf->pooled);
+    CHECK(buf->size == 1024);
+
+    // small buffers double on the heap
+    DCE2_BufferAddData(buf, data, 1500, 0, DCE2_BUFFER_MIN_ADD_FLAG__USE);
+    CHECK(!buf->pooled);
+    CHECK(buf->size == 2048);
+
+    // past 4K the smallest slab that fits
+    DCE2_BufferAddData(buf, data + 1500, 3500, 1500, DCE2_BUFFER_MIN_ADD_FLAG__USE);
+    CHECK(buf->pooled);
+    CHECK(buf->size == 8192);
+    CHECK(slab_bytes == 8192);
+
+    DCE2_BufferAddData(buf, data + 5000, 5000, 5000, DCE2_BUFFER_MIN_ADD_FLAG__USE);
+    CHECK(buf->pooled);
+    CHECK(buf->size == 16384);
+
+    DCE2_BufferAddData(buf, data + 10000, 40000, 10000, DCE2_BUFFER_MIN_ADD_FLAG__USE);
+    CHECK(buf->pooled);
+    CHECK(buf->size == DCE2_BUFFER__SLAB_SIZE);
+
+    CHECK(buf->len == 50000);
+    CHECK(!memcmp(buf->data, data, buf->len));
+
+    // the outgrown slabs were kept
+    CHECK(slab_count[0] == 1);
+    CHECK(slab_count[1] == 1);
+    CHECK(slab_bytes == 8192 + 16384 + DCE2_BUFFER__SLAB_SIZE);
+
+    // a slab can't be grown so this goes to the heap
+    DCE2_BufferAddData(buf, data, 1000, DCE2_BUFFER__SLAB_SIZE, DCE2_BUFFER_MIN_ADD_FLAG__USE);
+    CHECK(!buf->pooled);
+    CHECK(buf->size == 2 * DCE2_BUFFER__SLAB_SIZE);
+    CHECK(slab_count[3] == 1);
+
+    DCE2_BufferDestroy(buf);
+    DCE2_BufferPoolReset();
+    CHECK(slab_bytes == 0);
+}
+
+TEST_CASE("dce buffer pool", "[dce]")
+{
+    DCE2_BufferPoolReset();
+
+    SECTION("reuse")
+    {
+        DCE2_Buffer* buf = DCE2_BufferNew(6000, 0);
+        uint8_t* slab = buf->data;
+        DCE2_BufferDestroy(buf);
+        CHECK(slab_count[0] == 1);
+
+        buf = DCE2_BufferNew(8000, 0);
+        CHECK(buf->data == slab);
+        CHECK(slab_count[0] == 0);
+        DCE2_BufferDestroy(buf);
+
+        // other classes don't take it
+        buf = DCE2_BufferNew(9000, 0);
+        CHECK(buf->data != slab);
+        CHECK(buf->size == 16384);
+        DCE2_BufferDestroy(buf);
+
+        CHECK(slab_count[0] == 1);
+        CHECK(slab_count[1] == 1);
+    }
+    SECTION("idle limit")
+    {
+        DCE2_Buffer* bufs[DCE2_BUFFER__POOL_MAX + 1];
+
+        for (auto& b : bufs)
+            b = DCE2_BufferNew(DCE2_BUFFER__SLAB_SIZE, 0);
+
+        CHECK(slab_bytes == (DCE2_BUFFER__POOL_MAX + 1) * DCE2_BUFFER__SLAB_SIZE);
+
+        for (auto& b : bufs)
+            DCE2_BufferDestroy(b);
+
+        CHECK(slab_count[3] == DCE2_BUFFER__POOL_MAX);
+        CHECK(slab_bytes == DCE2_BUFFER__POOL_MAX * DCE2_BUFFER__SLAB_SIZE);
+    }
+    SECTION("memcap")
+    {
+        const unsigned max = DCE2_BUFFER__SLAB_MEMCAP / DCE2_BUFFER__SLAB_SIZE;
+        DCE2_Buffer* bufs[max + 1];
+
+        for (auto& b : bufs)
+            b = DCE2_BufferNew(DCE2_BUFFER__SLAB_SIZE, 0);
+
+        for (unsigned i = 0; i < max; i++)
+            CHECK(bufs[i]->pooled);
+
+        // past the cap the buffer is allocated as before
+        CHECK(!bufs[max]->pooled);
+        CHECK(bufs[max]->size == DCE2_BUFFER__SLAB_SIZE);
+        CHECK(slab_bytes == DCE2_BUFFER__SLAB_MEMCAP);
+
+        for (auto& b : bufs)
+            DCE2_BufferDestroy(b);
+    }
+    SECTION("term")
+    {
+        DCE2_Buffer* live = DCE2_BufferNew(6000, 0);
+        DCE2_Buffer* dead = DCE2_BufferNew(6000, 0);
+        DCE2_BufferDestroy(dead);
+        CHECK(slab_count[0] == 1);
+
+        DCE2_BufferPoolTerm();
+        CHECK(slab_count[0] == 0);
+        CHECK(slab_bytes == 8192);
+
+        // sessions released after term free to the heap
+        DCE2_BufferDestroy(live);
+        CHECK(slab_count[0] == 0);
+        CHECK(slab_bytes == 0);
+    }
+    DCE2_BufferPoolReset();
+    CHECK(slab_bytes == 0);
+}
+#endif
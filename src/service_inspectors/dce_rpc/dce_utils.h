@@ -30,6 +30,19 @@
 #define DCE2_SENTINEL -1
 #define DCE2_CFG_TOK__END            '\0'
 
+/* Buffers that outgrow DCE2_BUFFER__POOL_MIN move to pooled slabs in
+ * power of two size classes from 8K up to a full 64K reassembly packet,
+ * so they are copied at most 4 more times however many fragments are
+ * added.  Each thread holds at most DCE2_BUFFER__SLAB_MEMCAP of slabs,
+ * in use or idle, of which at most DCE2_BUFFER__POOL_MAX per class (960K)
+ * are idle.  Past the cap buffers grow on the heap instead. */
+#define DCE2_BUFFER__POOL_MIN     4096
+#define DCE2_BUFFER__SLAB_MIN     8192
+#define DCE2_BUFFER__SLAB_SIZE    65536
+#define DCE2_BUFFER__SLAB_CLASSES 4
+#define DCE2_BUFFER__POOL_MAX     8
+#define DCE2_BUFFER__SLAB_MEMCAP  (4 * 1024 * 1024)
+
 /********************************************************************
  * Enumerations
  ********************************************************************/
@@ -110,6 +123,7 @@ struct DCE2_Buffer
     uint32_t size;
     uint32_t min_add_size;
     uint32_t offset;
+    bool pooled;
 };
 
 /********************************************************************
@@ -135,6 +149,7 @@ void* DCE2_ReAlloc(void*, uint32_t, uint32_t);
 DCE2_Ret DCE2_BufferAddData(DCE2_Buffer*, const uint8_t*,
     uint32_t, uint32_t, DCE2_BufferMinAddFlag);
 void DCE2_BufferDestroy(DCE2_Buffer* buf);
+void DCE2_BufferPoolTerm();
 
 /********************************************************************
  * Function: DCE2_IsSpaceChar()
@@ -202,7 +202,7 @@ void do_detection(Packet* p)
      // detection engine into the protocol module.  This idea scales much
      // better than having all these Packet struct field checks in the
      // main detection engine for each protocol field.
-    get_data_bus().publish(PACKET_EVENT, p);
+    get_data_bus().publish(PACKET_EVENT_ID, p);
 
     DisableInspection();
 }
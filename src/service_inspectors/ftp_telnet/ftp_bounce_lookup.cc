@@ -57,14 +57,8 @@
  */
 int ftp_bounce_lookup_init(BOUNCE_LOOKUP** BounceLookup)
 {
-    KMAP* km = KMapNew((KMapUserFreeFunc)CleanupFTPBounceTo);
-    *BounceLookup = km;
-    if (*BounceLookup == NULL)
-    {
-        return FTPP_MEM_ALLOC_FAIL;
-    }
-
-    km->nocase = 1;
+    /* Keys are binary addresses so they aren't case folded */
+    *BounceLookup = new KeywordMap(false, CleanupFTPBounceTo);
 
     return FTPP_SUCCESS;
 }
@@ -83,18 +77,11 @@ int ftp_bounce_lookup_init(BOUNCE_LOOKUP** BounceLookup)
  */
 int ftp_bounce_lookup_cleanup(BOUNCE_LOOKUP** BounceLookup)
 {
-    KMAP* km;
-
     if (BounceLookup == NULL)
         return FTPP_INVALID_ARG;
 
-    km = *BounceLookup;
-
-    if (km)
-    {
-        KMapDelete(km);
-        *BounceLookup = NULL;
-    }
+    delete *BounceLookup;
+    *BounceLookup = NULL;
 
     return FTPP_SUCCESS;
 }
@@ -118,28 +105,17 @@ int ftp_bounce_lookup_cleanup(BOUNCE_LOOKUP** BounceLookup)
 int ftp_bounce_lookup_add(BOUNCE_LOOKUP* BounceLookup,
     const sfip_t* Ip, FTP_BOUNCE_TO* BounceTo)
 {
-    int iRet;
-
     if (!BounceLookup || !BounceTo)
     {
         return FTPP_INVALID_ARG;
     }
 
-    iRet = KMapAdd(BounceLookup, (void*)Ip, Ip->sfip_size(), (void*)BounceTo);
-
-    if (iRet)
+    /*
+     * This means the key has already been added.
+     */
+    if (!BounceLookup->add(Ip, Ip->sfip_size(), BounceTo))
     {
-        /*
-         * This means the key has already been added.
-        */
-        if (iRet == 1)
-        {
-            return FTPP_NONFATAL_ERR;
-        }
-        else
-        {
-            return FTPP_MEM_ALLOC_FAIL;
-        }
+        return FTPP_NONFATAL_ERR;
     }
 
     return FTPP_SUCCESS;
@@ -181,7 +157,7 @@ FTP_BOUNCE_TO* ftp_bounce_lookup_find(
 
     *iError = FTPP_SUCCESS;
 
-    BounceTo = (FTP_BOUNCE_TO*)KMapFind(BounceLookup, (void*)Ip, Ip->sfip_size());
+    BounceTo = (FTP_BOUNCE_TO*)BounceLookup->find(Ip, Ip->sfip_size());
     if (!BounceTo)
     {
         *iError = FTPP_NOT_FOUND;
@@ -223,7 +199,7 @@ FTP_BOUNCE_TO* ftp_bounce_lookup_first(BOUNCE_LOOKUP* BounceLookup,
 
     *iError = FTPP_SUCCESS;
 
-    BounceTo = (FTP_BOUNCE_TO*)KMapFindFirst(BounceLookup);
+    BounceTo = (FTP_BOUNCE_TO*)BounceLookup->first();
     if (!BounceTo)
     {
         *iError = FTPP_NOT_FOUND;
@@ -266,7 +242,7 @@ FTP_BOUNCE_TO* ftp_bounce_lookup_next(BOUNCE_LOOKUP* BounceLookup,
 
     *iError = FTPP_SUCCESS;
 
-    BounceTo = (FTP_BOUNCE_TO*)KMapFindNext(BounceLookup);
+    BounceTo = (FTP_BOUNCE_TO*)BounceLookup->next();
     if (!BounceTo)
     {
         *iError = FTPP_NOT_FOUND;
@@ -56,14 +56,7 @@
  */
 int ftp_cmd_lookup_init(CMD_LOOKUP** CmdLookup)
 {
-    KMAP* km = KMapNew((KMapUserFreeFunc)CleanupFTPCMDConf);
-    *CmdLookup = km;
-    if (*CmdLookup == NULL)
-    {
-        return FTPP_MEM_ALLOC_FAIL;
-    }
-
-    km->nocase = 1;
+    *CmdLookup = new KeywordMap(true, CleanupFTPCMDConf);
 
     return FTPP_SUCCESS;
 }
@@ -82,18 +75,11 @@ int ftp_cmd_lookup_init(CMD_LOOKUP** CmdLookup)
  */
 int ftp_cmd_lookup_cleanup(CMD_LOOKUP** CmdLookup)
 {
-    KMAP* km;
-
     if (CmdLookup == NULL)
         return FTPP_INVALID_ARG;
 
-    km = *CmdLookup;
-
-    if (km)
-    {
-        KMapDelete(km);
-        *CmdLookup = NULL;
-    }
+    delete *CmdLookup;
+    *CmdLookup = NULL;
 
     return FTPP_SUCCESS;
 }
@@ -121,27 +107,17 @@ int ftp_cmd_lookup_cleanup(CMD_LOOKUP** CmdLookup)
 int ftp_cmd_lookup_add(CMD_LOOKUP* CmdLookup, const char* cmd, int len,
     FTP_CMD_CONF* FTPCmd)
 {
-    int iRet;
-
     if (!CmdLookup || !FTPCmd)
     {
         return FTPP_INVALID_ARG;
     }
 
-    iRet = KMapAdd(CmdLookup, (void*)cmd, len, (void*)FTPCmd);
-    if (iRet)
+    /*
+     * This means the key has already been added.
+     */
+    if (!CmdLookup->add(cmd, len, FTPCmd))
     {
-        /*
-         * This means the key has already been added.
-         */
-        if (iRet == 1)
-        {
-            return FTPP_NONFATAL_ERR;
-        }
-        else
-        {
-            return FTPP_MEM_ALLOC_FAIL;
-        }
+        return FTPP_NONFATAL_ERR;
     }
 
     return FTPP_SUCCESS;
@@ -185,7 +161,7 @@ FTP_CMD_CONF* ftp_cmd_lookup_find(CMD_LOOKUP* CmdLookup,
 
     *iError = FTPP_SUCCESS;
 
-    FTPCmd = (FTP_CMD_CONF*)KMapFind(CmdLookup,(void*)cmd,len);
+    FTPCmd = (FTP_CMD_CONF*)CmdLookup->find(cmd, len);
     if (!FTPCmd)
     {
         *iError = FTPP_NOT_FOUND;
@@ -225,7 +201,7 @@ FTP_CMD_CONF* ftp_cmd_lookup_first(CMD_LOOKUP* CmdLookup,
 
     *iError = FTPP_SUCCESS;
 
-    FTPCmd = (FTP_CMD_CONF*)KMapFindFirst(CmdLookup);
+    FTPCmd = (FTP_CMD_CONF*)CmdLookup->first();
     if (!FTPCmd)
     {
         *iError = FTPP_NOT_FOUND;
@@ -268,7 +244,7 @@ FTP_CMD_CONF* ftp_cmd_lookup_next(CMD_LOOKUP* CmdLookup,
 
     *iError = FTPP_SUCCESS;
 
-    FTPCmd = (FTP_CMD_CONF*)KMapFindNext(CmdLookup);
+    FTPCmd = (FTP_CMD_CONF*)CmdLookup->next();
     if (!FTPCmd)
     {
         *iError = FTPP_NOT_FOUND;
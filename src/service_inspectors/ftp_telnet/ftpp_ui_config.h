@@ -41,7 +41,7 @@
 #include "framework/bits.h"
 #include "sfip/sfip_t.h"
 #include "sfrt/sfrt.h"
-#include "utils/kmap.h"
+#include "utils/keyword_map.h"
 
 /*
  * Defines
@@ -56,14 +56,14 @@
 #define MIN_CMD 3
 #define MAX_CMD 4
 
-typedef KMAP BOUNCE_LOOKUP;
+typedef KeywordMap BOUNCE_LOOKUP;
 
 /*
  * Defines a search type for the FTP commands in the client
  * global configuration.  We want this generic so we can change
  * it easily if we change the search type.
  */
-typedef KMAP CMD_LOOKUP;
+typedef KeywordMap CMD_LOOKUP;
 
 typedef enum s_FTP_PARAM_TYPE
 {
@@ -190,33 +190,32 @@ static IMAPData* SetNewIMAPData(IMAP_PROTO_CONF* config, Packet* p)
 static void IMAP_SearchInit()
 {
     const IMAPToken* tmp;
-    imap_cmd_search_mpse = new SearchTool();
+    SearchTool::PatternSet cmds, resps;
 
     for (tmp = &imap_known_cmds[0]; tmp->name != NULL; tmp++)
     {
         imap_cmd_search[tmp->search_id].name = tmp->name;
         imap_cmd_search[tmp->search_id].name_len = tmp->name_len;
-        imap_cmd_search_mpse->add(tmp->name, tmp->name_len, tmp->search_id);
+        cmds.add(tmp->name, tmp->name_len, tmp->search_id);
     }
-    imap_cmd_search_mpse->prep();
-    imap_resp_search_mpse = new SearchTool();
+    imap_cmd_search_mpse = SearchTool::acquire(cmds);
 
     for (tmp = &imap_resps[0]; tmp->name != NULL; tmp++)
     {
         imap_resp_search[tmp->search_id].name = tmp->name;
         imap_resp_search[tmp->search_id].name_len = tmp->name_len;
-        imap_resp_search_mpse->add(tmp->name, tmp->name_len, tmp->search_id);
+        resps.add(tmp->name, tmp->name_len, tmp->search_id);
     }
-    imap_resp_search_mpse->prep();
+    imap_resp_search_mpse = SearchTool::acquire(resps);
 }
 
 static void IMAP_SearchFree()
 {
     if (imap_cmd_search_mpse != NULL)
-        delete imap_cmd_search_mpse;
+        SearchTool::release(imap_cmd_search_mpse);
 
     if (imap_resp_search_mpse != NULL)
-        delete imap_resp_search_mpse;
+        SearchTool::release(imap_resp_search_mpse);
 }
 
 static void IMAP_ResetState(Flow* ssn)
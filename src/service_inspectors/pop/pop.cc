@@ -146,33 +146,32 @@ static POPData* SetNewPOPData(POP_PROTO_CONF* config, Packet* p)
 static void POP_SearchInit()
 {
     const POPToken* tmp;
-    pop_cmd_search_mpse = new SearchTool();
+    SearchTool::PatternSet cmds, resps;
 
     for (tmp = &pop_known_cmds[0]; tmp->name != NULL; tmp++)
     {
         pop_cmd_search[tmp->search_id].name = tmp->name;
         pop_cmd_search[tmp->search_id].name_len = tmp->name_len;
-        pop_cmd_search_mpse->add(tmp->name, tmp->name_len, tmp->search_id);
+        cmds.add(tmp->name, tmp->name_len, tmp->search_id);
     }
-    pop_cmd_search_mpse->prep();
-    pop_resp_search_mpse = new SearchTool();
+    pop_cmd_search_mpse = SearchTool::acquire(cmds);
 
     for (tmp = &pop_resps[0]; tmp->name != NULL; tmp++)
     {
         pop_resp_search[tmp->search_id].name = tmp->name;
         pop_resp_search[tmp->search_id].name_len = tmp->name_len;
-        pop_resp_search_mpse->add(tmp->name, tmp->name_len, tmp->search_id);
+        resps.add(tmp->name, tmp->name_len, tmp->search_id);
     }
-    pop_resp_search_mpse->prep();
+    pop_resp_search_mpse = SearchTool::acquire(resps);
 }
 
 static void POP_SearchFree()
 {
     if (pop_cmd_search_mpse != NULL)
-        delete pop_cmd_search_mpse;
+        SearchTool::release(pop_cmd_search_mpse);
 
     if (pop_resp_search_mpse != NULL)
-        delete pop_resp_search_mpse;
+        SearchTool::release(pop_resp_search_mpse);
 }
 
 static void POP_ResetState(Flow* ssn)
@@ -379,6 +379,7 @@ static void mod_dtor(Module* m)
 static void sip_init()
 {
     SipFlowData::init();
+    sip_parser_init();
 }
 
 static Inspector* sip_ctor(Module* m)
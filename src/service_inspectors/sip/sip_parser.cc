@@ -26,6 +26,10 @@
 #ifndef HAVE_PARSER_H
 #include <ctype.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "main/snort_types.h"
 #include "main/snort_debug.h"
 #include "main/snort_config.h"
@@ -130,6 +134,96 @@ SIPbodyField bodyFields[] =
     { NULL, 0, NULL }
 };
 
+/*
+ * Field names are dispatched through tables built by sip_parser_init().
+ * Header names (full and short) hash on length and their first and last
+ * characters, which are distinct for all the names above, into a table
+ * with no collisions so each line costs one hash and one compare.  SDP
+ * fields are all a single character followed by '='.
+ */
+#define SIP_FIELD_HASH_SIZE 64
+#define SIP_FIELD_NONE      (-1)
+
+static int8_t headerHash[SIP_FIELD_HASH_SIZE];
+static unsigned headerSeed = 0;
+static int8_t bodyIndex[256];
+
+static inline unsigned sip_field_hash(const char* name, unsigned len, unsigned seed)
+{
+    unsigned h = (tolower((unsigned char)name[0]) << 8) | tolower((unsigned char)name[len - 1]);
+    h = (h ^ (len << 16)) * seed;
+    return (h >> 24) & (SIP_FIELD_HASH_SIZE - 1);
+}
+
+static bool sip_hash_field(const char* name, int findex, unsigned seed)
+{
+    unsigned h = sip_field_hash(name, strlen(name), seed);
+
+    if (SIP_FIELD_NONE != headerHash[h])
+        return false;
+
+    headerHash[h] = findex;
+    return true;
+}
+
+// find a seed that maps every name to its own slot
+void sip_parser_init()
+{
+    if (headerSeed)
+        return;
+
+    for (unsigned seed = 0x9E3779B1; ; seed += 2)
+    {
+        bool ok = true;
+        memset(headerHash, SIP_FIELD_NONE, sizeof(headerHash));
+
+        for (int findex = 0; ok && headerFields[findex].fname; findex++)
+        {
+            ok = sip_hash_field(headerFields[findex].fname, findex, seed);
+
+            if (ok && headerFields[findex].shortName)
+                ok = sip_hash_field(headerFields[findex].shortName, findex, seed);
+        }
+        if (ok)
+        {
+            headerSeed = seed;
+            break;
+        }
+    }
+
+    memset(bodyIndex, SIP_FIELD_NONE, sizeof(bodyIndex));
+
+    for (int findex = 0; bodyFields[findex].fname; findex++)
+    {
+        int c = (unsigned char)bodyFields[findex].fname[0];
+        bodyIndex[tolower(c)] = bodyIndex[toupper(c)] = findex;
+    }
+}
+
+static inline int sip_find_headField(const char* name, int len)
+{
+    if (len <= 0)
+        return SIP_FIELD_NONE;
+
+    int findex = headerHash[sip_field_hash(name, len, headerSeed)];
+
+    if (SIP_FIELD_NONE == findex)
+        return SIP_FIELD_NONE;
+
+    const SIPheaderField& hf = headerFields[findex];
+
+    if (1 == len)
+    {
+        if (hf.shortName &&
+            tolower((unsigned char)hf.shortName[0]) == tolower((unsigned char)name[0]))
+            return findex;
+    }
+    else if ((hf.fnameLen == len) && (0 == strncasecmp(hf.fname, name, len)))
+        return findex;
+
+    return SIP_FIELD_NONE;
+}
+
 /********************************************************************
  * Function: sip_process_headField()
  *
@@ -148,7 +242,7 @@ SIPbodyField bodyFields[] =
 static int sip_process_headField(SIPMsg* msg, const char* start, const char* end,
     int* lastFieldIndex, SIP_PROTO_CONF* config)
 {
-    int findex =0;
+    int findex;
     int length = end -start;
     char* colonIndex;
     char* newStart, * newEnd, newLength;
@@ -175,25 +269,9 @@ static int sip_process_headField(SIPMsg* msg, const char* start, const char* end
     newLength =  newEnd - newStart;
 
     /*Find out whether the field name needs to process*/
-    while (NULL != headerFields[findex].fname)
-    {
-        //Use the full name to check
-        if ((headerFields[findex].fnameLen == newLength)&&
-            (0 == strncasecmp(headerFields[findex].fname, newStart, newLength)))
-        {
-            break;
-        }
-        //Use short name to check
-        else if ((NULL != headerFields[findex].shortName) &&
-            ( 1 == newLength)&&
-            (0 == strncasecmp(headerFields[findex].shortName, newStart, newLength)))
-        {
-            break;
-        }
-        findex++;
-    }
+    findex = sip_find_headField(newStart, newLength);
 
-    if (NULL != headerFields[findex].fname)
+    if (SIP_FIELD_NONE != findex)
     {
         // Found the field name, evaluate the value
         SIP_TrimSP(colonIndex + 1, end, &newStart, &newEnd);
@@ -220,19 +298,16 @@ static int sip_process_headField(SIPMsg* msg, const char* start, const char* end
  ********************************************************************/
 static int sip_process_bodyField(SIPMsg* msg, const char* start, const char* end)
 {
-    int findex =0;
-    if (start == end)
+    if (end - start < 2 || '=' != start[1])
         return SIP_PARSE_SUCCESS;
+
     /*Find out whether the field name needs to process*/
-    while (NULL != bodyFields[findex].fname)
+    int findex = bodyIndex[(uint8_t)start[0]];
+
+    if (SIP_FIELD_NONE != findex)
     {
         int length = bodyFields[findex].fnameLen;
-        if (0 == strncasecmp(bodyFields[findex].fname, start,length))
-        {
-            return (bodyFields[findex].setfield(msg,start + length, end));
-        }
-
-        findex++;
+        return (bodyFields[findex].setfield(msg,start + length, end));
     }
     return SIP_PARSE_SUCCESS;
 }
@@ -259,6 +334,25 @@ static int sip_find_linebreak(const char* start, char* end, char** lineEnd)
 
     char* s = (char*)start;
 
+#ifdef __SSE2__
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    while (end - s >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)s);
+        int mask = _mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+
+        if (mask)
+        {
+            s += __builtin_ctz(mask);
+            break;
+        }
+        s += 16;
+    }
+#endif
+
     while ((s < end) && !('\r' ==*s || '\n' == *s))
     {
         s++;
@@ -1414,5 +1508,164 @@ void sip_freeMediaList(SIP_MediaList medias)
     }
 }
 
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+#include <chrono>
+#include "catch/catch.hpp"
+#include "time/stopwatch.h"
+
+// the original dispatch
+static int sip_find_headField_linear(const char* name, int len)
+{
+    for (int findex = 0; headerFields[findex].fname; findex++)
+    {
+        if ((headerFields[findex].fnameLen == len) &&
+            (0 == strncasecmp(headerFields[findex].fname, name, len)))
+            return findex;
+
+        if (headerFields[findex].shortName && (1 == len) &&
+            (0 == strncasecmp(headerFields[findex].shortName, name, len)))
+            return findex;
+    }
+    return SIP_FIELD_NONE;
+}
+
+TEST_CASE("sip header field hash", "[sip]")
+{
+    sip_parser_init();
+
+    const char* names[] =
+    {
+        "Via", "VIA", "v", "V", "from", "F", "To", "t", "call-id", "I",
+        "CSeq", "contact", "M", "authorization", "content-type", "C",
+        "Content-Length", "l", "content-encoding", "E", "user-agent",
+        "SERVER", "Max-Forwards", "Allow", "x", "Vii", "Tx", "Contacts",
+        "Call-IE", "Content-Typf", "Supported"
+    };
+
+    for (auto name : names)
+    {
+        int len = strlen(name);
+        CHECK(sip_find_headField(name, len) == sip_find_headField_linear(name, len));
+    }
+    CHECK(sip_find_headField("Via", 0) == SIP_FIELD_NONE);
+}
+
+TEST_CASE("sip line breaks", "[sip]")
+{
+    char buf[64];
+    char* next;
+
+    for (unsigned pos = 0; pos < sizeof(buf); pos++)
+    {
+        memset(buf, 'a', sizeof(buf));
+        buf[pos] = '\r';
+
+        if (pos + 1 < sizeof(buf))
+            buf[pos + 1] = '\n';
+
+        int n = sip_find_linebreak(buf, buf + sizeof(buf), &next);
+        CHECK(n == ((pos + 1 < sizeof(buf)) ? 2 : 1));
+        CHECK(next == buf + pos + n);
+    }
+    memset(buf, 'a', sizeof(buf));
+    CHECK(sip_find_linebreak(buf, buf + sizeof(buf), &next) == 0);
+    CHECK(next == nullptr);
+}
+
+static const char* invite =
+    "INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP pc33.atlanta.example.com;branch=z9hG4bK776asdhds\r\n"
+    "Max-Forwards: 70\r\n"
+    "To: Bob <sip:bob@biloxi.example.com>\r\n"
+    "From: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"
+    "Call-ID: a84b4c76e66710@pc33.atlanta.example.com\r\n"
+    "CSeq: 314159 INVITE\r\n"
+    "Contact: <sip:alice@pc33.atlanta.example.com>\r\n"
+    "User-Agent: softphone 1.0\r\n"
+    "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE\r\n"
+    "Supported: replaces, timer\r\n"
+    "Content-Type: application/sdp\r\n"
+    "Content-Length: 130\r\n"
+    "\r\n"
+    "v=0\r\n"
+    "o=alice 2890844526 2890844526 IN IP4 10.1.2.3\r\n"
+    "s=-\r\n"
+    "c=IN IP4 10.1.2.3\r\n"
+    "t=0 0\r\n"
+    "m=audio 49170 RTP/AVP 0\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n";
+
+// run with: snort --catch-test '[.perf]'
+TEST_CASE("sip parse throughput", "[.perf][sip]")
+{
+    sip_parser_init();
+
+    SIP_PROTO_CONF config;
+    memset(&config, 0, sizeof(config));
+    config.maxUriLen = config.maxCallIdLen = 256;
+    config.maxFromLen = config.maxToLen = config.maxContactLen = 256;
+    config.maxViaLen = config.maxContentLen = 1024;
+    config.maxRequestNameLen = 20;
+    SIP_SetDefaultMethods(&config);
+
+    const unsigned num = 200000;
+    size_t len = strlen(invite);
+    char* buf = new char[len];
+    memcpy(buf, invite, len);
+
+    Stopwatch<std::chrono::steady_clock> parse, linear, hash;
+    int status = true;
+
+    parse.start();
+    for (unsigned i = 0; i < num; i++)
+    {
+        SIPMsg msg;
+        memset(&msg, 0, sizeof(msg));
+        status &= sip_parse(&msg, buf, buf + len, &config);
+        sip_freeMsg(&msg);
+    }
+    parse.stop();
+    CHECK(status);
+
+    // dispatch of the header names in the message above
+    const char* names[] =
+    {
+        "Via", "Max-Forwards", "To", "From", "Call-ID", "CSeq",
+        "Contact", "User-Agent", "Allow", "Supported", "Content-Type",
+        "Content-Length"
+    };
+    int sum[2] = { 0, 0 };
+
+    linear.start();
+    for (unsigned i = 0; i < num; i++)
+        for (auto name : names)
+            sum[0] += sip_find_headField_linear(name, strlen(name));
+    linear.stop();
+
+    hash.start();
+    for (unsigned i = 0; i < num; i++)
+        for (auto name : names)
+            sum[1] += sip_find_headField(name, strlen(name));
+    hash.stop();
+
+    CHECK(sum[0] == sum[1]);
+
+    auto us = [](const Stopwatch<std::chrono::steady_clock>& sw)
+    { return (double)std::chrono::duration_cast<std::chrono::microseconds>(sw.get()).count(); };
+
+    WARN("sip messages/sec = " << num * 1.0e6 / us(parse) <<
+        ", header lookups ns linear = " << us(linear) * 1.0e3 / (num * 12) <<
+        ", hashed = " << us(hash) * 1.0e3 / (num * 12));
+
+    SIP_DeleteMethods(config.methods);
+    delete[] buf;
+}
+
 #endif
 
+#endif
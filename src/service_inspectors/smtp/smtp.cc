@@ -260,45 +260,46 @@ static void SMTP_TermCmds(SMTP_PROTO_CONF* config)
     snort_free(config->cmd_config);
 }
 
+// configs with the same commands share one matcher
 static void SMTP_CommandSearchInit(SMTP_PROTO_CONF* config)
 {
-    config->cmd_search_mpse = new SearchTool();
+    SearchTool::PatternSet cmds;
     config->cmd_search = (SMTPSearch*)snort_calloc(config->num_cmds, sizeof(*config->cmd_search));
 
     for ( const SMTPToken* tmp = config->cmds; tmp->name != NULL; tmp++ )
     {
         config->cmd_search[tmp->search_id].name = (char *)tmp->name;
         config->cmd_search[tmp->search_id].name_len = tmp->name_len;
-        config->cmd_search_mpse->add(tmp->name, tmp->name_len, tmp->search_id);
+        cmds.add(tmp->name, tmp->name_len, tmp->search_id);
     }
 
-    config->cmd_search_mpse->prep();
+    config->cmd_search_mpse = SearchTool::acquire(cmds);
 }
 
 static void SMTP_CommandSearchTerm(SMTP_PROTO_CONF* config)
 {
     snort_free(config->cmd_search);
-    delete config->cmd_search_mpse;
+    SearchTool::release(config->cmd_search_mpse);
 }
 
 static void SMTP_ResponseSearchInit()
 {
     const SMTPToken* tmp;
-    smtp_resp_search_mpse = new SearchTool();
+    SearchTool::PatternSet resps;
 
     for (tmp = &smtp_resps[0]; tmp->name != NULL; tmp++)
     {
         smtp_resp_search[tmp->search_id].name = (char *)tmp->name;
         smtp_resp_search[tmp->search_id].name_len = tmp->name_len;
-        smtp_resp_search_mpse->add(tmp->name, tmp->name_len, tmp->search_id);
+        resps.add(tmp->name, tmp->name_len, tmp->search_id);
     }
-    smtp_resp_search_mpse->prep();
+    smtp_resp_search_mpse = SearchTool::acquire(resps);
 }
 
 static void SMTP_SearchFree()
 {
     if (smtp_resp_search_mpse != NULL)
-        delete smtp_resp_search_mpse;
+        SearchTool::release(smtp_resp_search_mpse);
 }
 
 static int AddCmd(SMTP_PROTO_CONF* config, const char* name, SMTPCmdTypeEnum type)
@@ -233,10 +233,10 @@ static inline uint32_t SSLPP_process_app(SSL_PROTO_CONF* config, uint32_t ssn_fl
         ssn_flags |= SSL_ENCRYPTED_FLAG;
 
         // Heartbleed check is disabled. Stop inspection on this session.
-        if (!config->max_heartbeat_len)
+        if (!config->max_heartbeat_len &&
+            Stream::bypass(packet->flow, packet, BypassReason::ENCRYPTED))
         {
             DebugMessage(DEBUG_SSL, "STOPPING INSPECTION (process_app)\n");
-            Stream::stop_inspection(packet->flow, packet, SSN_DIR_BOTH, -1, 0);
             sslstats.stopped++;
         }
         else if (!(new_flags & SSL_HEARTBEAT_SEEN))
@@ -261,10 +261,10 @@ static inline void SSLPP_process_other(SSL_PROTO_CONF* config, SSLData* sd, uint
     {
         sd->ssn_flags |= SSL_ENCRYPTED_FLAG | new_flags;
 
-        if (!config->max_heartbeat_len)
+        if (!config->max_heartbeat_len &&
+            Stream::bypass(packet->flow, packet, BypassReason::ENCRYPTED))
         {
             DebugMessage(DEBUG_SSL, "STOPPING INSPECTION (process_other)\n");
-            Stream::stop_inspection(packet->flow, packet, SSN_DIR_BOTH, -1, 0);
         }
         else if (!(new_flags & SSL_HEARTBEAT_SEEN))
         {
@@ -19,26 +19,525 @@
 
 #include "magic.h"
 
-MagicPage::MagicPage(const MagicBook& b) : book(b)
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
+using namespace std;
+
+// spells may be preceded by whitespace at the very start of the flow
+static bool is_space(int c)
+{ return c == ' ' or c == '\t' or c == '\r' or c == '\n'; }
+
+MagicBook::MagicBook()
 {
-    for ( int i = 0; i < 256; ++i )
-        next[i] = nullptr;
-    any = nullptr;
+    memset(classes, 0, sizeof(classes));
+    num_classes = 1;
+    start = dead;
+    depth = 0;
 }
 
-MagicPage::~MagicPage()
+MagicBook::~MagicBook() { }
+
+bool MagicBook::add(const char* key, const char* val, HexVector& hv, bool spell)
 {
-    for ( int i = 0; i < 256; ++i )
+    if ( hv.empty() )
+        return false;
+
+    for ( auto& m : magic )
     {
-        if ( next[i] && next[i] != this )
-            delete next[i];
+        if ( m.spell == spell and m.key == key )
+            return false;
     }
-    delete any;
+
+    Magic m;
+    m.hv = std::move(hv);
+    m.key = key;
+    m.value = val;
+    m.spell = spell;
+
+    magic.push_back(m);
+    return true;
 }
 
-MagicBook::MagicBook()
-{ root = new MagicPage(*this); }
+size_t MagicBook::size() const
+{
+    return sizeof(*this) + next.size() * sizeof(next[0]) + match.size() * sizeof(match[0]);
+}
+
+const char* MagicBook::find_spell(
+    const uint8_t* data, unsigned len, MagicState& s, unsigned& scanned) const
+{
+    const MagicState* row;
+
+    if ( depth )
+    {
+        if ( len > depth - scanned )
+            len = depth - scanned;
+
+        scanned += len;
+    }
+
+    for ( unsigned i = 0; i < len and !done(s); ++i )
+    {
+        row = &next[s * num_classes];
+        s = row[classes[data[i]]];
+    }
+
+    if ( match[s] )
+        return magic[match[s] - 1].value.c_str();
+
+    if ( depth and scanned == depth )
+        s = dead;
+
+    return nullptr;
+}
+
+//-------------------------------------------------------------------------
+// compilation
+//-------------------------------------------------------------------------
+
+// bytes that no pattern tells apart share a class so that the transition
+// table has one column per class instead of one per byte
+void MagicBook::set_classes()
+{
+    bool spells = false;
+    vector<pair<uint16_t, bool> > lits;  // distinct literals and foldedness
+
+    for ( auto& m : magic )
+    {
+        spells = spells or m.spell;
+
+        for ( auto c : m.hv )
+        {
+            if ( c < 256 )
+                lits.push_back(make_pair(c, m.spell));
+        }
+    }
+    sort(lits.begin(), lits.end());
+    lits.erase(unique(lits.begin(), lits.end()), lits.end());
+
+    map<vector<bool>, uint8_t> sigs;
+
+    for ( int b = 0; b < 256; ++b )
+    {
+        vector<bool> sig;
+
+        for ( auto& l : lits )
+            sig.push_back(l.second ? toupper(b) == l.first : b == l.first);
+
+        sig.push_back(spells and is_space(b));
+
+        auto it = sigs.find(sig);
+
+        if ( it == sigs.end() )
+        {
+            uint8_t id = sigs.size();
+            it = sigs.insert(make_pair(sig, id)).first;
+        }
+        classes[b] = it->second;
+    }
+    num_classes = sigs.size();
+}
+
+// subset construction; NFA positions are (magic index, token index) with
+// START standing for the beginning of the flow before any non-space byte
+#define START 0xFFFFFFFF
+
+static inline uint32_t pos(unsigned k, unsigned j)
+{ return (k << 16) | j; }
+
+bool MagicBook::build()
+{
+    unsigned rep[256];  // a byte in each class
+
+    for ( int b = 255; b >= 0; --b )
+        rep[classes[b]] = b;
+
+    // add (k, j) and the positions reachable from it without input
+    auto close = [this](vector<uint32_t>& set, unsigned k, unsigned j)
+    {
+        const HexVector& hv = magic[k].hv;
+        set.push_back(pos(k, j));
+
+        while ( j < hv.size() and hv[j] == MAGIC_STAR )
+            set.push_back(pos(k, ++j));
+    };
+
+    auto starts = [this, &close](vector<uint32_t>& set, bool spells_only)
+    {
+        for ( unsigned k = 0; k < magic.size(); ++k )
+            if ( !spells_only or magic[k].spell )
+                close(set, k, 0);
+    };
+
+    auto normalize = [](vector<uint32_t>& set)
+    {
+        sort(set.begin(), set.end());
+        set.erase(unique(set.begin(), set.end()), set.end());
+    };
+
+    vector<vector<uint32_t> > sets;
+    map<vector<uint32_t>, MagicState> ids;
+
+    // state 0 is the empty set; it is dead
+    sets.push_back(vector<uint32_t>());
+    ids[sets[0]] = dead;
+
+    vector<uint32_t> set;
+    set.push_back(START);
+    starts(set, false);
+    normalize(set);
+
+    ids[set] = start = 1;
+    sets.push_back(set);
+
+    for ( unsigned s = 0; s < sets.size(); ++s )
+    {
+        // first match in priority order, if any
+        uint16_t hit = 0;
+
+        for ( auto p : sets[s] )
+        {
+            if ( p == START )
+                continue;
+
+            unsigned k = p >> 16, j = p & 0xFFFF;
+
+            if ( j == magic[k].hv.size() and (!hit or k + 1 < hit) )
+                hit = k + 1;
+        }
+        match.push_back(hit);
+
+        for ( unsigned c = 0; c < num_classes; ++c )
+        {
+            // hits and dead ends are final
+            if ( hit or !s )
+            {
+                next.push_back(s);
+                continue;
+            }
+
+            int b = rep[c];
+            set.clear();
+
+            for ( auto p : sets[s] )
+            {
+                if ( p == START )
+                {
+                    if ( is_space(b) )
+                    {
+                        set.push_back(START);
+                        starts(set, true);
+                    }
+                    continue;
+                }
+
+                unsigned k = p >> 16, j = p & 0xFFFF;
+                const Magic& m = magic[k];
+
+                if ( j == m.hv.size() )
+                    continue;
+
+                uint16_t t = m.hv[j];
+
+                if ( t == MAGIC_STAR )
+                    close(set, k, j);
+
+                else if ( t == MAGIC_ANY or t == (m.spell ? toupper(b) : b) )
+                    close(set, k, j + 1);
+            }
+            normalize(set);
+
+            auto it = ids.find(set);
+
+            if ( it == ids.end() )
+            {
+                if ( sets.size() > 0xFFFF )
+                    return false;
+
+                MagicState id = sets.size();
+                it = ids.insert(make_pair(set, id)).first;
+                sets.push_back(set);
+            }
+            next.push_back(it->second);
+        }
+    }
+    return true;
+}
+
+// Moore's algorithm: split states by hit until the transitions agree
+void MagicBook::minimize()
+{
+    unsigned n = match.size();
+    vector<unsigned> block(n), prev;
+    unsigned num_blocks = 0;
+
+    for ( unsigned s = 0; s < n; ++s )
+        block[s] = match[s];
+
+    while ( true )
+    {
+        map<vector<unsigned>, unsigned> sigs;
+        vector<unsigned> sig(num_classes + 1);
+
+        prev = block;
+
+        for ( unsigned s = 0; s < n; ++s )
+        {
+            sig[0] = prev[s];
+
+            for ( unsigned c = 0; c < num_classes; ++c )
+                sig[c + 1] = prev[next[s * num_classes + c]];
+
+            auto it = sigs.find(sig);
+
+            if ( it == sigs.end() )
+            {
+                unsigned id = sigs.size();
+                it = sigs.insert(make_pair(sig, id)).first;
+            }
+            block[s] = it->second;
+        }
+
+        if ( sigs.size() == num_blocks )
+            break;
+
+        num_blocks = sigs.size();
+    }
+
+    // renumber so that the dead block stays 0
+    vector<int> id(num_blocks, -1);
+    unsigned num = 0;
+
+    id[block[dead]] = num++;
+
+    for ( unsigned s = 0; s < n; ++s )
+        if ( id[block[s]] < 0 )
+            id[block[s]] = num++;
+
+    vector<MagicState> min_next(num * num_classes);
+    vector<uint16_t> min_match(num);
+
+    for ( unsigned s = 0; s < n; ++s )
+    {
+        unsigned t = id[block[s]];
+        min_match[t] = match[s];
+
+        for ( unsigned c = 0; c < num_classes; ++c )
+            min_next[t * num_classes + c] = id[block[next[s * num_classes + c]]];
+    }
+
+    start = id[block[start]];
+    next.swap(min_next);
+    match.swap(min_match);
+}
+
+bool MagicBook::compile()
+{
+    // hexes take precedence over spells that hit at the same byte
+    stable_partition(magic.begin(), magic.end(), [](const Magic& m) { return !m.spell; });
+
+    next.clear();
+    match.clear();
+
+    set_classes();
+
+    if ( !build() )
+        return false;
+
+    minimize();
+
+    // beyond the longest pattern without '*' only those with it are alive
+    if ( depth )
+    {
+        for ( auto& m : magic )
+        {
+            if ( m.hv.size() > depth and
+                find(m.hv.begin(), m.hv.end(), MAGIC_STAR) == m.hv.end() )
+                depth = m.hv.size();
+        }
+    }
+
+    for ( auto& m : magic )
+        HexVector().swap(m.hv);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+static const char* scan(MagicBook& b, const char* s, MagicState& state, unsigned& scanned)
+{ return b.find_spell((const uint8_t*)s, strlen(s), state, scanned); }
+
+static const char* scan(MagicBook& b, const char* s, MagicState& state)
+{
+    unsigned scanned = 0;
+    return scan(b, s, state, scanned);
+}
+
+static const char* scan(MagicBook& b, const char* s)
+{
+    MagicState state = b.page1();
+    return scan(b, s, state);
+}
+
+static const char* scan(MagicBook& b, const uint8_t* data, unsigned len)
+{
+    MagicState state = b.page1();
+    unsigned scanned = 0;
+    return b.find_spell(data, len, state, scanned);
+}
+
+TEST_CASE("spells", "[wizard]")
+{
+    MagicBook b;
+
+    CHECK(b.add_spell("GET", "http"));
+    CHECK(b.add_spell("220*FTP", "ftp"));
+    CHECK(b.add_spell("220*SMTP", "smtp"));
+    CHECK(b.add_spell("** OK", "imap"));
+    CHECK(b.add_spell("*SSH", "ssh"));
+    CHECK(!b.add_spell("GET", "other"));
+    CHECK(!b.add_spell("", "empty"));
+    CHECK(b.compile());
+
+    CHECK(!strcmp(scan(b, "get / HTTP/1.1"), "http"));
+    CHECK(!strcmp(scan(b, " \r\nGET /"), "http"));
+    CHECK(!strcmp(scan(b, "220 ProFTPD Server ready FTP"), "ftp"));
+    CHECK(!strcmp(scan(b, "220 mail ESMTP Postfix"), "smtp"));
+    CHECK(!strcmp(scan(b, "* OK IMAP4 ready"), "imap"));
+    CHECK(!strcmp(scan(b, "SSH-2.0-OpenSSH"), "ssh"));
+    CHECK(!strcmp(scan(b, "xyz SSH"), "ssh"));
+
+    CHECK(!scan(b, "GE"));
+    CHECK(!scan(b, "POST / HTTP/1.1"));
+    CHECK(!scan(b, "x GET"));
+}
+
+TEST_CASE("spells across segments", "[wizard]")
+{
+    MagicBook b;
+    CHECK(b.add_spell("220*FTP", "ftp"));
+    CHECK(b.add_spell("HELO", "smtp"));
+    CHECK(b.compile());
+
+    MagicState s = b.page1();
+    CHECK(!scan(b, "22", s));
+    CHECK(!b.done(s));
+    CHECK(!scan(b, "0 Welcome to the F", s));
+    CHECK(!strcmp(scan(b, "TP server", s), "ftp"));
+    CHECK(b.done(s));
+
+    s = b.page1();
+    CHECK(!scan(b, "HEL", s));
+    CHECK(!scan(b, "X", s));
+    CHECK(b.done(s));
+}
+
+TEST_CASE("hexes", "[wizard]")
+{
+    MagicBook b;
+
+    CHECK(b.add_hex("|05 00|", "dcerpc"));
+    CHECK(b.add_hex("|FF|SMB", "smb"));
+    CHECK(b.add_hex("??|0 0|", "modbus"));
+    CHECK(!b.add_hex("|0G|", "bad"));
+    CHECK(b.compile());
+
+    const uint8_t dce[] = { 0x05, 0x00, 0x0b };
+    const uint8_t smb[] = { 0xFF, 'S', 'M', 'B' };
+    const uint8_t smb_lc[] = { 0xFF, 's', 'm', 'b' };
+    const uint8_t mod[] = { 0x12, 0x34, 0x00, 0x00 };
+    const uint8_t ws[] = { ' ', 0x05, 0x00 };
+
+    CHECK(!strcmp(scan(b, dce, sizeof(dce)), "dcerpc"));
+    CHECK(!strcmp(scan(b, smb, sizeof(smb)), "smb"));
+    CHECK(!scan(b, smb_lc, sizeof(smb_lc)));
+    CHECK(!strcmp(scan(b, mod, sizeof(mod)), "modbus"));
+
+    // no whitespace skipping for hexes
+    CHECK(!scan(b, ws, sizeof(ws)));
+}
+
+TEST_CASE("hexes before spells", "[wizard]")
+{
+    MagicBook b;
+    CHECK(b.add_spell("AB", "spell"));
+    CHECK(b.add_hex("AB", "hex"));
+    CHECK(b.add_spell("A*Z", "late"));
+    CHECK(b.add_hex("A?C", "short"));
+    CHECK(b.compile());
+
+    CHECK(!strcmp(scan(b, "AB"), "hex"));
+    CHECK(!strcmp(scan(b, "ab"), "spell"));
+    CHECK(!strcmp(scan(b, "AXC"), "short"));
+    CHECK(!strcmp(scan(b, "AXXZ"), "late"));
+}
+
+TEST_CASE("depth", "[wizard]")
+{
+    MagicBook b;
+    b.set_depth(16);
+    CHECK(b.add_spell("*SSH", "ssh"));
+    CHECK(b.add_spell("0123456789abcdefghij", "long"));
+    CHECK(b.compile());
+
+    // longer patterns without '*' raise the depth
+    CHECK(b.get_depth() == 20);
+
+    CHECK(!strcmp(scan(b, "0123456789ABCDEFGHIJ"), "long"));
+    CHECK(!strcmp(scan(b, "xxxxxxxxxxxxxxxSSH"), "ssh"));
+    CHECK(!scan(b, "xxxxxxxxxxxxxxxxxxSSH"));
+
+    // the depth spans segments and the scan ends there
+    MagicState s = b.page1();
+    unsigned scanned = 0;
+
+    for ( unsigned i = 0; i < 4; ++i )
+        CHECK(!scan(b, "xxxxx", s, scanned));
+
+    CHECK(scanned == 20);
+    CHECK(b.done(s));
+    CHECK(!scan(b, "SSH", s, scanned));
+    CHECK(scanned == 20);
+
+    // no limit
+    MagicBook u;
+    CHECK(u.add_spell("*SSH", "ssh"));
+    CHECK(u.compile());
+    CHECK(u.get_depth() == 0);
+
+    std::string banner(1000, 'x');
+    banner += "SSH";
+    CHECK(!strcmp(scan(u, banner.c_str()), "ssh"));
+}
+
+TEST_CASE("compact", "[wizard]")
+{
+    MagicBook b;
+    const char* methods[] = { "GET", "HEAD", "POST", "PUT", "DELETE", "TRACE", "CONNECT",
+        "OPTIONS", "PROPFIND", "PROPPATCH", "MKCOL", "COPY", "MOVE", "LOCK", "UNLOCK" };
+
+    for ( auto m : methods )
+        CHECK(b.add_spell(m, "http"));
+
+    CHECK(b.compile());
+
+    // a 256 pointer page per trie node took more than this for one node
+    CHECK(b.size() < 256 * sizeof(void*) * 8);
+    CHECK(!strcmp(scan(b, "PROPPATCH /x"), "http"));
+}
 
-MagicBook::~MagicBook()
-{ delete root; }
+#endif
 
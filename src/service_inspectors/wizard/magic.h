@@ -17,86 +17,107 @@
 //--------------------------------------------------------------------------
 // magic.h author Russ Combs <rucombs@cisco.com>
 
+#include <stdint.h>
+
 #include <string>
 #include <vector>
 
 #ifndef MAGIC_H
 #define MAGIC_H
 
-class MagicBook;
-
-struct MagicPage
-{
-    std::string key;
-    std::string value;
-
-    MagicPage* next[256];
-    MagicPage* any;
-
-    const MagicBook& book;
-
-    MagicPage(const MagicBook&);
-    ~MagicPage();
-};
+// MagicBook holds the hexes and spells for one direction.  Once all are
+// added, compile() builds a single minimized DFA from them so that a scan
+// is one table lookup per byte with no backtracking.  The scan state is a
+// MagicState, which the caller keeps between calls to continue the scan
+// on the next segment.
+//
+// The first pattern matched in the data wins.  If a hex and a spell
+// match at the same byte the hex wins; otherwise the first one added.
+//
+// Spells with '*' and the leading whitespace skip can keep a scan alive
+// indefinitely, so a scan gives up after the depth set before compile().
+// Patterns without '*' that are longer than the depth still match.
 
+typedef uint16_t MagicState;
 typedef std::vector<uint16_t> HexVector;
 
-// MagicBook is a set of MagicPages implementing a trie
+// HexVector values above the byte range
+#define MAGIC_ANY  0x100  // hex ?, exactly one byte
+#define MAGIC_STAR 0x200  // spell *, any number of bytes
 
 class MagicBook
 {
 public:
-    virtual ~MagicBook();
+    MagicBook();
+    ~MagicBook();
 
-    virtual bool add_spell(const char* key, const char* val) = 0;
-    virtual const char* find_spell(const uint8_t*, unsigned len, const MagicPage*&) const = 0;
+    //-------------------------------------------------------------------------
+    // hexes - a sequence of pipe delimited hex, text literals, and wild chars
+    // designated by '?' (indicating one arbitrary byte)
+    //-------------------------------------------------------------------------
+    bool add_hex(const char* key, const char* val);
 
-    const MagicPage* page1()
-    { return root; }
+    //-------------------------------------------------------------------------
+    // spells - a sequence of case insensitive text strings with wild cards
+    // designated by * (indicating any number of arbitrary bytes)
+    //-------------------------------------------------------------------------
+    bool add_spell(const char* key, const char* val);
 
-protected:
-    MagicBook();
-    MagicPage* root;
-};
+    // maximum bytes to scan, 0 for no limit
+    void set_depth(unsigned d)
+    { depth = d; }
 
-//-------------------------------------------------------------------------
-// spells - a sequence of case insensitive text strings with wild cards
-// designated by * (indicating any number of arbitrary bytes)
-//-------------------------------------------------------------------------
+    bool compile();
 
-class SpellBook : public MagicBook
-{
-public:
-    SpellBook();
-    ~SpellBook() { }
+    MagicState page1() const
+    { return start; }
 
-    bool add_spell(const char*, const char*);
-    const char* find_spell(const uint8_t*, unsigned len, const MagicPage*&) const;
+    // the depth in effect after compile()
+    unsigned get_depth() const
+    { return depth; }
 
-private:
-    bool translate(const char*, HexVector&);
-    void add_spell(const char*, const char*, HexVector&, unsigned, MagicPage*);
-    const MagicPage* find_spell(const uint8_t*, unsigned, const MagicPage*, unsigned) const;
-};
+    // returns the matched service, if any, and updates the state and the
+    // bytes scanned so far, which start at 0
+    const char* find_spell(
+        const uint8_t*, unsigned len, MagicState&, unsigned& scanned) const;
 
-//-------------------------------------------------------------------------
-// hexes - a sequence of pipe delimited hex, text literals, and wild chars
-// designated by '?' (indicating one arbitrary byte)
-//-------------------------------------------------------------------------
+    // true if the scan hit or can't hit
+    bool done(MagicState s) const
+    { return s == dead or match[s]; }
 
-class HexBook : public MagicBook
-{
-public:
-    HexBook() { }
-    ~HexBook() { }
+    // bytes used by the compiled tables
+    size_t size() const;
 
-    bool add_spell(const char*, const char*);
-    const char* find_spell(const uint8_t*, unsigned len, const MagicPage*&) const;
+private:
+    struct Magic
+    {
+        HexVector hv;
+        std::string key;
+        std::string value;
+        bool spell;
+    };
+
+    bool add(const char* key, const char* val, HexVector&, bool spell);
+    bool hex_translate(const char*, HexVector&);
+    bool spell_translate(const char*, HexVector&);
+
+    void set_classes();
+    bool build();
+    void minimize();
 
 private:
-    bool translate(const char*, HexVector&);
-    void add_spell(const char*, const char*, HexVector&, unsigned, MagicPage*);
-    const MagicPage* find_spell(const uint8_t*, unsigned, const MagicPage*, unsigned) const;
+    std::vector<Magic> magic;  // in priority order
+
+    uint8_t classes[256];
+    unsigned num_classes;
+
+    std::vector<MagicState> next;  // state * num_classes + class
+    std::vector<uint16_t> match;   // state -> 1 + magic index, 0 if none
+
+    MagicState start;
+    static const MagicState dead = 0;
+
+    unsigned depth;
 };
 
 #endif
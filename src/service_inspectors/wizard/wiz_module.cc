@@ -25,6 +25,7 @@
 
 #include <string>
 
+#include "log/messages.h"
 #include "magic.h"
 
 using namespace std;
@@ -91,6 +92,10 @@ static const Parameter wizard_spells_params[] =
 
 static const Parameter s_params[] =
 {
+    { "max_search_depth", Parameter::PT_INT, "0:65535", "16",
+      "maximum number of bytes to scan in each direction (0 is unlimited); "
+      "longer hexes and spells without * still match" },
+
     { "hexes", Parameter::PT_LIST, wizard_hexes_params, nullptr,
       "criteria for binary service identification" },
 
@@ -102,19 +107,15 @@ static const Parameter s_params[] =
 
 WizardModule::WizardModule() : Module(WIZ_NAME, WIZ_HELP, s_params)
 {
-    c2s_hexes = nullptr;
-    s2c_hexes = nullptr;
-    c2s_spells = nullptr;
-    s2c_spells = nullptr;
+    c2s_book = nullptr;
+    s2c_book = nullptr;
+    max_search_depth = 16;
 }
 
 WizardModule::~WizardModule()
 {
-    delete c2s_hexes;
-    delete s2c_hexes;
-
-    delete c2s_spells;
-    delete s2c_spells;
+    delete c2s_book;
+    delete s2c_book;
 }
 
 ProfileStats* WizardModule::get_profile() const
@@ -122,7 +123,10 @@ ProfileStats* WizardModule::get_profile() const
 
 bool WizardModule::set(const char*, Value& v, SnortConfig*)
 {
-    if ( v.is("service") )
+    if ( v.is("max_search_depth") )
+        max_search_depth = v.get_long();
+
+    else if ( v.is("service") )
         service = v.get_string();
 
     // FIXIT-L implement proto and client_first
@@ -148,11 +152,9 @@ bool WizardModule::begin(const char* fqn, int, SnortConfig*)
 {
     if ( !strcmp(fqn, "wizard") )
     {
-        c2s_hexes = new HexBook;
-        s2c_hexes = new HexBook;
-
-        c2s_spells = new SpellBook;
-        s2c_spells = new SpellBook;
+        c2s_book = new MagicBook;
+        s2c_book = new MagicBook;
+        max_search_depth = 16;
     }
     else if ( !strcmp(fqn, "wizard.hexes") )
         hex = true;
@@ -178,64 +180,45 @@ bool WizardModule::begin(const char* fqn, int, SnortConfig*)
 void WizardModule::add_spells(MagicBook* b, string& service)
 {
     for ( auto p : spells )
-        b->add_spell(p.c_str(), service.c_str());
+    {
+        if ( hex )
+            b->add_hex(p.c_str(), service.c_str());
+        else
+            b->add_spell(p.c_str(), service.c_str());
+    }
 }
 
-bool WizardModule::end(const char*, int idx, SnortConfig*)
+bool WizardModule::end(const char* fqn, int idx, SnortConfig*)
 {
+    if ( !strcmp(fqn, "wizard") )
+    {
+        c2s_book->set_depth(max_search_depth);
+        s2c_book->set_depth(max_search_depth);
+
+        if ( !c2s_book->compile() or !s2c_book->compile() )
+        {
+            ParseError("%s: too many hexes and spells", fqn);
+            return false;
+        }
+        return true;
+    }
+
     if ( !idx )
         return true;
 
-    if ( hex )
-    {
-        if ( c2s )
-            add_spells(c2s_hexes, service);
-        else
-            add_spells(s2c_hexes, service);
-    }
-    else
-    {
-        if ( c2s )
-            add_spells(c2s_spells, service);
-        else
-            add_spells(s2c_spells, service);
-    }
+    add_spells(c2s ? c2s_book : s2c_book, service);
     spells.clear();
     service.clear();
 
     return true;
 }
 
-MagicBook* WizardModule::get_book(bool c2s, bool hex)
+MagicBook* WizardModule::get_book(bool c2s)
 {
-    int k = c2s ? 1 : 0;
-    k |= (hex ? 2 : 0);
-
-    MagicBook* b = nullptr;
-
-    switch ( k )
-    {
-    case 0:
-        b = s2c_spells;
-        s2c_spells = nullptr;
-        break;
-
-    case 1:
-        b = c2s_spells;
-        c2s_spells = nullptr;
-        break;
-
-    case 2:
-        b = s2c_hexes;
-        s2c_hexes = nullptr;
-        break;
-
-    case 3:
-        b = c2s_hexes;
-        c2s_hexes = nullptr;
-        break;
-    }
-    return b;
+    MagicBook*& b = c2s ? c2s_book : s2c_book;
+    MagicBook* book = b;
+    b = nullptr;
+    return book;
 }
 
 const PegInfo* WizardModule::get_pegs() const
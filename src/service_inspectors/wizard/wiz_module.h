@@ -52,7 +52,7 @@ public:
     PegCount* get_counts() const override;
     ProfileStats* get_profile() const override;
 
-    MagicBook* get_book(bool c2s, bool hex);
+    MagicBook* get_book(bool c2s);
 
 private:
     void add_spells(MagicBook*, std::string&);
@@ -63,12 +63,11 @@ private:
 
     std::string service;
     std::vector<std::string> spells;
+    unsigned max_search_depth;
 
-    MagicBook* c2s_hexes;
-    MagicBook* s2c_hexes;
-
-    MagicBook* c2s_spells;
-    MagicBook* s2c_spells;
+    // hexes and spells for each direction share one book
+    MagicBook* c2s_book;
+    MagicBook* s2c_book;
 };
 
 #endif
@@ -65,8 +65,9 @@ THREAD_LOCAL WizStats tstats;
 
 struct Wand
 {
-    const MagicPage* hex;
-    const MagicPage* spell;
+    const MagicBook* book;
+    MagicState state;
+    unsigned scanned;  // bytes, up to the book's depth
 };
 
 class Wizard;
@@ -102,14 +103,11 @@ public:
 
     void reset(Wand&, bool tcp, bool c2s);
     bool cast_spell(Wand&, Flow*, const uint8_t*, unsigned);
-    bool spellbind(const MagicPage*&, Flow*, const uint8_t*, unsigned);
+    bool spellbind(Wand&, Flow*, const uint8_t*, unsigned);
 
 public:
-    MagicBook* c2s_hexes;
-    MagicBook* s2c_hexes;
-
-    MagicBook* c2s_spells;
-    MagicBook* s2c_spells;
+    MagicBook* c2s_book;
+    MagicBook* s2c_book;
 };
 
 //-------------------------------------------------------------------------
@@ -131,7 +129,6 @@ MagicSplitter::~MagicSplitter()
     wizard->rem_ref();
 }
 
-// FIXIT-M stop search on hit and failure (no possible match)
 StreamSplitter::Status MagicSplitter::scan(
     Flow* f, const uint8_t* data, uint32_t len,
     uint32_t, uint32_t*)
@@ -150,34 +147,21 @@ StreamSplitter::Status MagicSplitter::scan(
 
 Wizard::Wizard(WizardModule* m)
 {
-    c2s_hexes = m->get_book(true, true);
-    s2c_hexes = m->get_book(false, true);
-
-    c2s_spells = m->get_book(true, false);
-    s2c_spells = m->get_book(false, false);
+    c2s_book = m->get_book(true);
+    s2c_book = m->get_book(false);
 }
 
 Wizard::~Wizard()
 {
-    delete c2s_hexes;
-    delete s2c_hexes;
-
-    delete c2s_spells;
-    delete s2c_spells;
+    delete c2s_book;
+    delete s2c_book;
 }
 
 void Wizard::reset(Wand& w, bool /*tcp*/, bool c2s)
 {
-    if ( c2s )
-    {
-        w.hex = c2s_hexes->page1();
-        w.spell = c2s_spells->page1();
-    }
-    else
-    {
-        w.hex = s2c_hexes->page1();
-        w.spell = s2c_spells->page1();
-    }
+    w.book = c2s ? c2s_book : s2c_book;
+    w.state = w.book->page1();
+    w.scanned = 0;
 }
 
 void Wizard::eval(Packet* p)
@@ -203,9 +187,9 @@ StreamSplitter* Wizard::get_splitter(bool c2s)
 }
 
 bool Wizard::spellbind(
-    const MagicPage*& m, Flow* f, const uint8_t* data, unsigned len)
+    Wand& w, Flow* f, const uint8_t* data, unsigned len)
 {
-    f->service = m->book.find_spell(data, len, m);
+    f->service = w.book->find_spell(data, len, w.state, w.scanned);
 
     if (f->service != nullptr)
     {
@@ -221,13 +205,12 @@ bool Wizard::spellbind(
 bool Wizard::cast_spell(
     Wand& w, Flow* f, const uint8_t* data, unsigned len)
 {
-    if ( w.hex && spellbind(w.hex, f, data, len) )
-        return true;
+    // once the scan hits, dies, or reaches the depth there is nothing
+    // left to learn
+    if ( w.book->done(w.state) )
+        return false;
 
-    if ( w.spell && spellbind(w.spell, f, data, len) )
-        return true;
-
-    return false;
+    return spellbind(w, f, data, len);
 }
 
 //-------------------------------------------------------------------------
@@ -213,15 +213,22 @@ bool SideChannel::process(int max_messages)
     DebugMessage(DEBUG_SIDE_CHANNEL,"SideChannelManager::process()\n");
     bool received_message = false;
 
+    const unsigned batch_max = 32;
+    ConnectorMsgHandle* handles[batch_max];
+
     while (true)
     {
-        // get message if one is available.
-        ConnectorMsgHandle* handle = connector_receive->receive_message(false);
-        // if none, we are complete
-        if ( handle == nullptr )
-            break;
-        else
+        unsigned max = batch_max;
+
+        if ( (max_messages > 0) && ((unsigned)max_messages < max) )
+            max = max_messages;
+
+        // get the messages that are available; if none, we are complete
+        unsigned count = connector_receive->receive_messages(handles, max);
+
+        for ( unsigned i = 0; i < count; i++ )
         {
+            ConnectorMsgHandle* handle = handles[i];
             SCMessage* msg = new SCMessage;
             // get the ConnectorMsg from the (at this point) abstract class
             ConnectorMsg* connector_msg = connector_receive->get_connector_msg(handle);
@@ -244,10 +251,13 @@ bool SideChannel::process(int max_messages)
 
             if ( receive_handler != nullptr )
                 (receive_handler)(msg);
-
-            if ( (max_messages > 0) && (--max_messages == 0) )
-                break;
         }
+
+        if ( (max_messages > 0) && ((max_messages -= count) == 0) )
+            break;
+
+        if ( count < max )
+            break;
     }
     return received_message;
 }
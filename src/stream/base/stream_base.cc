@@ -39,6 +39,10 @@
 THREAD_LOCAL ProfileStats s5PerfStats;
 THREAD_LOCAL FlowControl* flow_con = nullptr;
 
+// the policy flow_con bypasses with; changes when a reload brings a new
+// StreamBase with its own copy
+static THREAD_LOCAL const FlowBypassConfig* bypass_cfg = nullptr;
+
 static BaseStats g_stats;
 THREAD_LOCAL BaseStats stream_base_stats;
 
@@ -68,6 +72,16 @@ THREAD_LOCAL BaseStats stream_base_stats;
     stream_base_stats.proto ## _ha_prunes = \
         flow_con->get_prunes(PktType::pkttype, PruneReason::HA)
 
+#define BYPASS_PEGS(reason_str) \
+    { reason_str " bypasses", "flows bypassed by " reason_str }, \
+    { reason_str " bypass packets", "packets seen after " reason_str " bypass" }, \
+    { reason_str " bypass bytes", "bytes seen after " reason_str " bypass" }
+
+#define SET_BYPASS_COUNTS(reason, type) \
+    stream_base_stats.reason ## _bypasses = bs.flows[to_utype(BypassReason::type)], \
+    stream_base_stats.reason ## _bypass_packets = bs.packets[to_utype(BypassReason::type)], \
+    stream_base_stats.reason ## _bypass_bytes = bs.bytes[to_utype(BypassReason::type)]
+
 // FIXIT-L dependency on stats define in another file
 const PegInfo base_pegs[] =
 {
@@ -77,6 +91,9 @@ const PegInfo base_pegs[] =
     PROTO_PEGS("udp"),
     PROTO_PEGS("user"),
     PROTO_PEGS("file"),
+    BYPASS_PEGS("encrypted"),
+    BYPASS_PEGS("size"),
+    BYPASS_PEGS("age"),
     { nullptr, nullptr }
 };
 
@@ -93,6 +110,11 @@ void base_sum()
     SET_PROTO_COUNTS(user, PDU);
     SET_PROTO_COUNTS(file, FILE);
 
+    const BypassStats& bs = flow_con->get_bypass_stats();
+    SET_BYPASS_COUNTS(encrypted, ENCRYPTED);
+    SET_BYPASS_COUNTS(size, SIZE);
+    SET_BYPASS_COUNTS(age, AGE);
+
     sum_stats((PegCount*)&g_stats, (PegCount*)&stream_base_stats,
         array_size(base_pegs)-1);
 }
@@ -146,12 +168,14 @@ public:
     void eval(Packet*) override;
 
 public:
-    const StreamModuleConfig* config;
+    StreamModuleConfig config;
 };
 
+// the module's config is rewritten on reload while packet threads are
+// still using this instance so take a copy
 StreamBase::StreamBase(const StreamModuleConfig* c)
 {
-    config = c;
+    config = *c;
 }
 
 void StreamBase::tinit()
@@ -162,41 +186,44 @@ void StreamBase::tinit()
 
     StreamHAManager::tinit();
 
-    if ( config->ip_cfg.max_sessions )
+    if ( config.ip_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::IP)) )
-            flow_con->init_ip(config->ip_cfg, f);
+            flow_con->init_ip(config.ip_cfg, f);
     }
-    if ( config->icmp_cfg.max_sessions )
+    if ( config.icmp_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::ICMP)) )
-            flow_con->init_icmp(config->icmp_cfg, f);
+            flow_con->init_icmp(config.icmp_cfg, f);
     }
-    if ( config->tcp_cfg.max_sessions )
+    if ( config.tcp_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::TCP)) )
-            flow_con->init_tcp(config->tcp_cfg, f);
+            flow_con->init_tcp(config.tcp_cfg, f);
     }
-    if ( config->udp_cfg.max_sessions )
+    if ( config.udp_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::UDP)) )
-            flow_con->init_udp(config->udp_cfg, f);
+            flow_con->init_udp(config.udp_cfg, f);
     }
-    if ( config->user_cfg.max_sessions )
+    if ( config.user_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::PDU)) )
-            flow_con->init_user(config->user_cfg, f);
+            flow_con->init_user(config.user_cfg, f);
     }
-    if ( config->file_cfg.max_sessions )
+    if ( config.file_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::FILE)) )
-            flow_con->init_file(config->file_cfg, f);
+            flow_con->init_file(config.file_cfg, f);
     }
-    uint32_t max = config->tcp_cfg.max_sessions + config->udp_cfg.max_sessions
-        + config->user_cfg.max_sessions;
+    uint32_t max = config.tcp_cfg.max_sessions + config.udp_cfg.max_sessions
+        + config.user_cfg.max_sessions;
 
     if ( max > 0 )
         flow_con->init_exp(max);
+
+    bypass_cfg = &config.bypass_cfg;
+    flow_con->init_bypass(*bypass_cfg);
 }
 
 void StreamBase::tterm()
@@ -214,6 +241,12 @@ void StreamBase::eval(Packet* p)
 {
     Profile profile(s5PerfStats);
 
+    if ( bypass_cfg != &config.bypass_cfg )
+    {
+        bypass_cfg = &config.bypass_cfg;
+        flow_con->init_bypass(*bypass_cfg);
+    }
+
     if ( !is_eligible(p) )
         return;
 
@@ -221,7 +254,7 @@ void StreamBase::eval(Packet* p)
     {
     case PktType::IP:
         if ( p->has_ip() and
-            ((p->ptrs.decode_flags & DECODE_FRAG) or !config->ip_frags_only) )
+            ((p->ptrs.decode_flags & DECODE_FRAG) or !config.ip_frags_only) )
             flow_con->process_ip(p);
         break;
 
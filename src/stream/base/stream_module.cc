@@ -54,11 +54,32 @@ CACHE_PARAMS(file_params,    "128",  "30", "180", "5");
     { cache, Parameter::PT_TABLE, params, nullptr, \
       "configure " proto " cache limits" }
 
+static const Parameter bypass_params[] =
+{
+    { "bytes", Parameter::PT_INT, "0:", "0",
+      "stop inspecting flows after this many bytes (0 is off)" },
+
+    { "seconds", Parameter::PT_INT, "0:", "0",
+      "stop inspecting flows after this many seconds (0 is off)" },
+
+    { "services", Parameter::PT_STRING, nullptr, nullptr,
+      "space separated list of services eligible for bytes and seconds bypass (default is all)" },
+
+    { "app_ids", Parameter::PT_STRING, nullptr, nullptr,
+      "space separated list of service or payload appids eligible for bytes and seconds bypass" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
 static const Parameter s_params[] =
 {
     { "ip_frags_only", Parameter::PT_BOOL, nullptr, "false",
       "don't process non-frag flows" },
 
+    { "bypass", Parameter::PT_TABLE, bypass_params, nullptr,
+      "whitelist flows past a size or age; flows with flowbits set or flagged "
+      "by reputation are never bypassed" },
+
     CACHE_TABLE("ip_cache",   "ip",   ip_params),
     CACHE_TABLE("icmp_cache", "icmp", icmp_params),
     CACHE_TABLE("tcp_cache",  "tcp",  tcp_params),
@@ -87,6 +108,15 @@ const StreamModuleConfig* StreamModule::get_data()
     return &config;
 }
 
+bool StreamModule::begin(const char* fqn, int, SnortConfig*)
+{
+    // the lists are appended to so start over on reload
+    if ( !strcmp(fqn, MOD_NAME) )
+        config.bypass_cfg = FlowBypassConfig();
+
+    return true;
+}
+
 bool StreamModule::set(const char* fqn, Value& v, SnortConfig*)
 {
     FlowConfig* fc = nullptr;
@@ -96,6 +126,9 @@ bool StreamModule::set(const char* fqn, Value& v, SnortConfig*)
         config.ip_frags_only = v.get_bool();
         return true;
     }
+    else if ( strstr(fqn, "bypass") )
+        return set_bypass(v);
+
     else if ( strstr(fqn, "ip_cache") )
         fc = &config.ip_cfg;
 
@@ -132,6 +165,38 @@ bool StreamModule::set(const char* fqn, Value& v, SnortConfig*)
     return true;
 }
 
+bool StreamModule::set_bypass(Value& v)
+{
+    FlowBypassConfig& fbc = config.bypass_cfg;
+
+    if ( v.is("bytes") )
+        fbc.bytes = v.get_long();
+
+    else if ( v.is("seconds") )
+        fbc.seconds = v.get_long();
+
+    else if ( v.is("services") )
+    {
+        string tok;
+        v.set_first_token();
+
+        while ( v.get_next_token(tok) )
+            fbc.services.push_back(tok);
+    }
+    else if ( v.is("app_ids") )
+    {
+        string tok;
+        v.set_first_token();
+
+        while ( v.get_next_token(tok) )
+            fbc.app_ids.push_back(strtol(tok.c_str(), nullptr, 0));
+    }
+    else
+        return false;
+
+    return true;
+}
+
 void StreamModule::sum_stats()
 { base_sum(); }
 
@@ -53,6 +53,16 @@ struct BaseStats
     PROTO_FIELDS(udp);
     PROTO_FIELDS(user);
     PROTO_FIELDS(file);
+
+    PegCount encrypted_bypasses;
+    PegCount encrypted_bypass_packets;
+    PegCount encrypted_bypass_bytes;
+    PegCount size_bypasses;
+    PegCount size_bypass_packets;
+    PegCount size_bypass_bytes;
+    PegCount age_bypasses;
+    PegCount age_bypass_packets;
+    PegCount age_bypass_bytes;
 };
 
 extern const PegInfo base_pegs[];
@@ -67,6 +77,7 @@ struct StreamModuleConfig
     FlowConfig udp_cfg;
     FlowConfig user_cfg;
     FlowConfig file_cfg;
+    FlowBypassConfig bypass_cfg;
     bool ip_frags_only;
 };
 
@@ -75,6 +86,7 @@ class StreamModule : public Module
 public:
     StreamModule();
 
+    bool begin(const char*, int, SnortConfig*) override;
     bool set(const char*, Value&, SnortConfig*) override;
 
     const PegInfo* get_pegs() const override;
@@ -86,6 +98,9 @@ public:
     void show_stats() override;
     void reset_stats() override;
 
+private:
+    bool set_bypass(Value&);
+
 private:
     StreamModuleConfig config;
 };
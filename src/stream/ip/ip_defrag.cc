@@ -75,6 +75,7 @@
 #include <rpc/types.h>
 #include <errno.h>
 #include <array>
+#include <random>
 
 #include "framework/codec.h"
 #include "flow/flow_control.h"
@@ -144,6 +145,12 @@ struct Fragment
     Fragment* prev;
     Fragment* next;
 
+    /* treap over the fraglist order; see frag_tree_*() */
+    Fragment* parent;
+    Fragment* lchild;
+    Fragment* rchild;
+    uint32_t prio;
+
     int ord;
     char last;
 };
@@ -155,6 +162,7 @@ static THREAD_LOCAL unsigned long mem_in_use = 0; /* memory in use, used for sel
 
 static THREAD_LOCAL uint32_t pkt_snaplen = 0;
 static THREAD_LOCAL Packet** defrag_pkts;  // An array of Packet pointers
+static THREAD_LOCAL uint32_t frag_prio_seed = 2463534242; /* reseeded in tinit() */
 
 /* enum for policy names */
 static const char* const frag_policy_names[] =
@@ -907,6 +915,125 @@ static void FragRebuild(FragTracker* ft, Packet* p)
     ft->frag_flags = ft->frag_flags | FRAG_REBUILT;
 }
 
+//-------------------------------------------------------------------------
+// fraglist index
+//
+// The fraglist is also linked as a treap whose in-order walk is the list
+// order.  Nodes are placed by position rather than by key so add_node()
+// and delete_node() keep the two in step and insert() finds a new frag's
+// neighbors in O(log n) instead of walking the list.  The list is sorted
+// by offset since stored frags don't overlap.  Priorities are random per
+// thread so a fragment train can't be ordered to unbalance the tree.
+//-------------------------------------------------------------------------
+
+static inline uint32_t frag_tree_prio()
+{
+    // xorshift32
+    uint32_t x = frag_prio_seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return frag_prio_seed = x;
+}
+
+/* put node where old is in old's parent */
+static inline void frag_tree_replace(FragTracker* ft, Fragment* old, Fragment* node)
+{
+    Fragment* parent = old->parent;
+
+    if (!parent)
+        ft->fragtree = node;
+    else if (parent->lchild == old)
+        parent->lchild = node;
+    else
+        parent->rchild = node;
+
+    if (node)
+        node->parent = parent;
+}
+
+/* lift node above its parent, keeping the in-order walk */
+static void frag_tree_rotate(FragTracker* ft, Fragment* node)
+{
+    Fragment* parent = node->parent;
+    frag_tree_replace(ft, parent, node);
+
+    if (parent->lchild == node)
+    {
+        parent->lchild = node->rchild;
+        if (parent->lchild)
+            parent->lchild->parent = parent;
+        node->rchild = parent;
+    }
+    else
+    {
+        parent->rchild = node->lchild;
+        if (parent->rchild)
+            parent->rchild->parent = parent;
+        node->lchild = parent;
+    }
+    parent->parent = node;
+}
+
+/* index a node already linked into the fraglist */
+static void frag_tree_insert(FragTracker* ft, Fragment* node)
+{
+    node->lchild = node->rchild = NULL;
+    node->prio = frag_tree_prio();
+
+    if (node->prev and !node->prev->rchild)
+    {
+        node->prev->rchild = node;
+        node->parent = node->prev;
+    }
+    else if (node->next)
+    {
+        /* next is leftmost in prev's right subtree (or the whole tree)
+         * so its left is free */
+        node->next->lchild = node;
+        node->parent = node->next;
+    }
+    else
+    {
+        ft->fragtree = node;
+        node->parent = NULL;
+    }
+
+    while (node->parent and node->parent->prio < node->prio)
+        frag_tree_rotate(ft, node);
+}
+
+static void frag_tree_remove(FragTracker* ft, Fragment* node)
+{
+    while (node->lchild and node->rchild)
+    {
+        if (node->lchild->prio > node->rchild->prio)
+            frag_tree_rotate(ft, node->lchild);
+        else
+            frag_tree_rotate(ft, node->rchild);
+    }
+    frag_tree_replace(ft, node, node->lchild ? node->lchild : node->rchild);
+}
+
+/* first frag at or after offset, same as walking the list */
+static Fragment* frag_tree_lower_bound(const FragTracker* ft, uint16_t offset)
+{
+    Fragment* node = ft->fragtree;
+    Fragment* found = NULL;
+
+    while (node)
+    {
+        if (node->offset >= offset)
+        {
+            found = node;
+            node = node->lchild;
+        }
+        else
+            node = node->rchild;
+    }
+    return found;
+}
+
 /**
  * Plug a Fragment into the fraglist of a FragTracker
  *
@@ -940,6 +1067,7 @@ static inline void add_node(FragTracker* ft, Fragment* prev,
         ft->fraglist = node;
     }
 
+    frag_tree_insert(ft, node);
     ft->fraglist_count++;
 }
 
@@ -996,6 +1124,7 @@ static inline void delete_node(FragTracker* ft, Fragment* node)
         ft->fraglist_tail = node->prev;
     }
 
+    frag_tree_remove(ft, node);
     delete_frag(node);
     ft->fraglist_count--;
 }
@@ -1026,6 +1155,7 @@ static void delete_tracker(FragTracker* ft)
         delete_frag(dump_me);
     }
     ft->fraglist = NULL;
+    ft->fragtree = NULL;
     if (ft->ip_options_data)
     {
         snort_free(ft->ip_options_data);
@@ -1065,6 +1195,10 @@ void Defrag::tinit()
 
     defrag_pkts[0] = new Packet();
     pkt_snaplen = SFDAQ::get_snap_len();
+
+    /* must be nonzero for xorshift */
+    std::random_device rd;
+    frag_prio_seed = rd() | 1;
 }
 
 void Defrag::tterm()
@@ -1315,7 +1449,6 @@ int Defrag::insert(Packet* p, FragTracker* ft, FragEngine* fe)
     int16_t slide = 0;      /* slide up the front of the current frag */
     int done = 0;           /* flag for right-side overlap handling loop */
     int addthis = 1;           /* flag for right-side overlap handling loop */
-    int i = 0;              /* counter */
     int firstLastOk;
     int ret = FRAG_INSERT_OK;
     unsigned char lastfrag = 0; /* Set to 1 when this is the 'last' frag */
@@ -1323,7 +1456,6 @@ int Defrag::insert(Packet* p, FragTracker* ft, FragEngine* fe)
     Fragment* right = NULL; /* frag ptr for right-side overlap loop */
     Fragment* newfrag = NULL;  /* new frag container */
     Fragment* left = NULL;     /* left-side overlap fragment ptr */
-    Fragment* idx = NULL;      /* indexing fragment pointer for loops */
     Fragment* dump_me = NULL;  /* frag ptr for complete overlaps to dump */
     const uint8_t* fragStart;
     int16_t fragLength;
@@ -1462,36 +1594,17 @@ int Defrag::insert(Packet* p, FragTracker* ft, FragEngine* fe)
     ft->frag_pkts++;
 
     DebugFormat(DEBUG_FRAG,
-        "Walking frag list (%d nodes), new frag %d@%d\n",
+        "Searching frag list (%d nodes), new frag %d@%d\n",
         ft->fraglist_count, fragLength, frag_offset);
 
     /*
      * Need to figure out where in the frag list this frag should go
      * and who its neighbors are
      */
-    for (idx = ft->fraglist; idx; idx = idx->next)
-    {
-        i++;
-        right = idx;
+    right = frag_tree_lower_bound(ft, frag_offset);
+    left = right ? right->prev : ft->fraglist_tail;
 
-        DebugFormat(DEBUG_FRAG,
-            "%d right o %d s %d ptr %p prv %p nxt %p\n",
-            i, right->offset, right->size, (void*) right,
-            (void*) right->prev, (void*) right->next);
-
-        if (right->offset >= frag_offset)
-        {
-            break;
-        }
-
-        left = right;
-    }
-
-    /*
-     * null things out if we walk to the end of the list
-     */
-    if (idx == NULL)
-        right = NULL;
+    DebugFormat(DEBUG_FRAG, "left %p right %p\n", (void*) left, (void*) right);
 
     /*
      * handle forward (left-side) overlaps...
@@ -2144,6 +2257,7 @@ int Defrag::new_tracker(Packet* p, FragTracker* ft)
     /* insert the fragment into the frag list */
     ft->fraglist = f;
     ft->fraglist_tail = f;
+    ft->fragtree = f;
     ft->fraglist_count = 1;  /* XXX: Are these duplciates? */
     ft->frag_pkts = 1;
 
@@ -2400,3 +2514,218 @@ inline int Defrag::expire(Packet*, FragTracker* ft, FragEngine* fe)
     return FRAG_OK;
 }
 
+
+#ifdef UNIT_TEST
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "time/stopwatch.h"
+
+/* the walk insert() used before the index */
+static Fragment* frag_list_lower_bound(const FragTracker* ft, uint16_t offset)
+{
+    for (Fragment* f = ft->fraglist; f; f = f->next)
+        if (f->offset >= offset)
+            return f;
+
+    return NULL;
+}
+
+static Fragment* frag_tree_add(FragTracker* ft, uint16_t offset)
+{
+    Fragment* f = (Fragment*)snort_calloc(sizeof(Fragment));
+    f->offset = offset;
+    f->size = 8;
+
+    Fragment* right = frag_tree_lower_bound(ft, offset);
+    add_node(ft, right ? right->prev : ft->fraglist_tail, f);
+    return f;
+}
+
+/* check links and heap order; returns in-order nodes */
+static void frag_tree_walk(Fragment* node, std::vector<Fragment*>& v)
+{
+    if (!node)
+        return;
+
+    if (node->lchild)
+    {
+        CHECK(node->lchild->parent == node);
+        CHECK(node->lchild->prio <= node->prio);
+    }
+    if (node->rchild)
+    {
+        CHECK(node->rchild->parent == node);
+        CHECK(node->rchild->prio <= node->prio);
+    }
+    frag_tree_walk(node->lchild, v);
+    v.push_back(node);
+    frag_tree_walk(node->rchild, v);
+}
+
+static void frag_tree_check(FragTracker* ft)
+{
+    std::vector<Fragment*> v;
+    frag_tree_walk(ft->fragtree, v);
+
+    if (ft->fragtree)
+        CHECK(ft->fragtree->parent == NULL);
+
+    REQUIRE((int)v.size() == ft->fraglist_count);
+
+    Fragment* f = ft->fraglist;
+    for (auto t : v)
+    {
+        REQUIRE(t == f);
+        f = f->next;
+    }
+}
+
+static unsigned frag_tree_depth(Fragment* node)
+{
+    if (!node)
+        return 0;
+
+    unsigned l = frag_tree_depth(node->lchild);
+    unsigned r = frag_tree_depth(node->rchild);
+    return 1 + (l > r ? l : r);
+}
+
+TEST_CASE("frag tree matches list", "[ip_defrag]")
+{
+    FragTracker ft;
+    memset(&ft, 0, sizeof(ft));
+    std::mt19937 rng(1);
+
+    std::vector<uint16_t> offs;
+    for (uint16_t i = 0; i < 2000; i++)
+        offs.push_back(i * 8);
+
+    std::shuffle(offs.begin(), offs.end(), rng);
+
+    for (auto o : offs)
+        frag_tree_add(&ft, o);
+
+    frag_tree_check(&ft);
+    CHECK(frag_tree_depth(ft.fragtree) < 64);
+
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        uint16_t o = rng() % 17000;
+        CHECK(frag_tree_lower_bound(&ft, o) == frag_list_lower_bound(&ft, o));
+    }
+
+    for (unsigned i = 0; i < 1500; i++)
+    {
+        Fragment* f = frag_tree_lower_bound(&ft, rng() % 16000);
+
+        if (!f)
+            f = ft.fraglist_tail;
+
+        delete_node(&ft, f);
+    }
+    frag_tree_check(&ft);
+
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        uint16_t o = rng() % 17000;
+        CHECK(frag_tree_lower_bound(&ft, o) == frag_list_lower_bound(&ft, o));
+    }
+
+    while (ft.fraglist)
+        delete_node(&ft, ft.fraglist);
+
+    CHECK(ft.fragtree == NULL);
+    CHECK(ft.fraglist_tail == NULL);
+}
+
+TEST_CASE("frag tree ordered trains", "[ip_defrag]")
+{
+    FragTracker ft;
+    memset(&ft, 0, sizeof(ft));
+
+    /* sorted input is the worst case for an unbalanced tree */
+    for (int i = 0; i < 4096; i++)
+        frag_tree_add(&ft, i * 8);
+
+    frag_tree_check(&ft);
+    CHECK(frag_tree_depth(ft.fragtree) < 64);
+    delete_tracker(&ft);
+    CHECK(ft.fragtree == NULL);
+    memset(&ft, 0, sizeof(ft));
+
+    for (int i = 4095; i >= 0; i--)
+        frag_tree_add(&ft, i * 8);
+
+    frag_tree_check(&ft);
+    CHECK(frag_tree_depth(ft.fragtree) < 64);
+    delete_tracker(&ft);
+}
+
+static void frag_list_add(FragTracker* ft, uint16_t offset)
+{
+    Fragment* f = (Fragment*)snort_calloc(sizeof(Fragment));
+    f->offset = offset;
+    f->size = 8;
+
+    Fragment* left = NULL;
+
+    for (Fragment* idx = ft->fraglist; idx; idx = idx->next)
+    {
+        if (idx->offset >= offset)
+            break;
+
+        left = idx;
+    }
+    add_node(ft, left, f);
+}
+
+/* trains of every 8 byte fragment in a 64K datagram; this is the search
+ * insert() does for each frag before handling any overlaps */
+TEST_CASE("frag train search cost", "[.perf][ip_defrag]")
+{
+    const int num = 8191;
+    std::vector<uint16_t> offs;
+
+    for (int i = 0; i < num; i++)
+        offs.push_back(i * 8);
+
+    std::vector<uint16_t> shuffled = offs;
+    std::mt19937 rng(1);
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    for (auto train : { &offs, &shuffled })
+    {
+        FragTracker ft;
+        memset(&ft, 0, sizeof(ft));
+        Stopwatch<std::chrono::steady_clock> sw;
+
+        sw.start();
+        for (auto o : *train)
+            frag_list_add(&ft, o);
+        sw.stop();
+        auto list_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+        delete_tracker(&ft);
+        memset(&ft, 0, sizeof(ft));
+
+        sw.reset();
+        sw.start();
+        for (auto o : *train)
+            frag_tree_add(&ft, o);
+        sw.stop();
+        auto tree_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+
+        frag_tree_check(&ft);
+        delete_tracker(&ft);
+
+        WARN((train == &offs ? "in order" : "shuffled") << ", " << num <<
+            " frags, list walk: " << list_ns / num << " ns/frag, tree: " <<
+            tree_ns / num << " ns/frag");
+    }
+}
+
+#endif
+
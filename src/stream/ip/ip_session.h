@@ -56,6 +56,7 @@ struct FragTracker
     Fragment* fraglist;      /* list of fragments */
     Fragment* fraglist_tail; /* tail ptr for easy appending */
     int fraglist_count;       /* handy dandy counter */
+    Fragment* fragtree;      /* root of the offset index over fraglist */
 
     uint32_t alert_gid[MAX_FRAG_ALERTS]; /* flag alerts seen in a frag list  */
     uint32_t alert_sid[MAX_FRAG_ALERTS]; /* flag alerts seen in a frag list  */
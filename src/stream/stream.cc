@@ -244,6 +244,12 @@ void Stream::stop_inspection(
     flow->set_state(Flow::FlowState::ALLOW);
 }
 
+bool Stream::bypass(Flow* flow, Packet* p, BypassReason reason)
+{
+    assert(flow_con);
+    return flow_con->bypass(flow, p, reason);
+}
+
 void Stream::resume_inspection(Flow* flow, char dir)
 {
     if (!flow)
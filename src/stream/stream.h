@@ -104,6 +104,10 @@ public:
     // FIXIT-L stop_inspection() does not currently support the bytes/response parameters
     static void stop_inspection(Flow*, Packet*, char dir, int32_t bytes, int rspFlag);
 
+    // Stop inspection on a flow for good if the stream bypass policy allows it.
+    // Returns false if the flow must still be inspected.
+    static bool bypass(Flow*, Packet*, BypassReason);
+
     // Adds entry to the expected session cache with a flow key generated from the network
     // n-tuple parameters specified.  Inspection will be turned off for this expected session
     // when it arrives.
@@ -26,6 +26,7 @@
 #include "log/messages.h"
 #include "main/snort_debug.h"
 #include "protocols/packet.h"
+#include "protocols/packet_manager.h"
 
 #include "tcp_module.h"
 #include "tcp_event_logger.h"
@@ -170,8 +171,8 @@ int SegmentOverlapEditor::left_overlap_keep_first()
             if (tcp_ips_data == NORM_MODE_ON)
             {
                 unsigned offset = tsd->get_seg_seq() - left->seq;
-                memcpy((uint8_t*)tsd->get_pkt()->data, left->payload()+offset, tsd->get_seg_len());
-                tsd->get_pkt()->packet_flags |= PKT_MODIFIED;
+                PacketManager::rewrite(tsd->get_pkt(), (uint8_t*)tsd->get_pkt()->data,
+                    left->payload()+offset, tsd->get_seg_len());
             }
             tcp_norm_stats[PC_TCP_IPS_DATA][tcp_ips_data]++;
         }
@@ -181,8 +182,8 @@ int SegmentOverlapEditor::left_overlap_keep_first()
             {
                 unsigned offset = tsd->get_seg_seq() - left->seq;
                 unsigned length = left->seq + left->payload_size - tsd->get_seg_seq();
-                memcpy((uint8_t*)tsd->get_pkt()->data, left->payload()+offset, length);
-                tsd->get_pkt()->packet_flags |= PKT_MODIFIED;
+                PacketManager::rewrite(tsd->get_pkt(), (uint8_t*)tsd->get_pkt()->data,
+                    left->payload()+offset, length);
             }
 
             tcp_norm_stats[PC_TCP_IPS_DATA][tcp_ips_data]++;
@@ -295,8 +296,8 @@ void SegmentOverlapEditor::right_overlap_truncate_new()
     {
         unsigned offset = right->seq - tsd->get_seg_seq();
         unsigned length = tsd->get_seg_seq() + tsd->get_seg_len() - right->seq;
-        memcpy((uint8_t*)tsd->get_pkt()->data + offset, right->payload(), length);
-        tsd->get_pkt()->packet_flags |= PKT_MODIFIED;
+        PacketManager::rewrite(tsd->get_pkt(), (uint8_t*)tsd->get_pkt()->data + offset,
+            right->payload(), length);
     }
 
     tcp_norm_stats[PC_TCP_IPS_DATA][tcp_ips_data]++;
@@ -312,8 +313,8 @@ int SegmentOverlapEditor::full_right_overlap_truncate_new()
     if ( tcp_ips_data == NORM_MODE_ON )
     {
         unsigned offset = right->seq - tsd->get_seg_seq();
-        memcpy((uint8_t*)tsd->get_pkt()->data + offset, right->payload(), right->payload_size);
-        tsd->get_pkt()->packet_flags |= PKT_MODIFIED;
+        PacketManager::rewrite(tsd->get_pkt(), (uint8_t*)tsd->get_pkt()->data + offset,
+            right->payload(), right->payload_size);
     }
 
     tcp_norm_stats[PC_TCP_IPS_DATA][tcp_ips_data]++;
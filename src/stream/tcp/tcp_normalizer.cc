@@ -20,6 +20,7 @@
 // Created on: Jul 31, 2015
 
 #include "packet_io/active.h"
+#include "protocols/packet_manager.h"
 
 #include "tcp_normalizer.h"
 #include "tcp_event_logger.h"
@@ -96,8 +97,9 @@ bool TcpNormalizer::strip_tcp_timestamp(
     if (mode == NORM_MODE_ON)
     {
         // set raw option bytes to nops
-        memset((void*)opt, (uint32_t)tcp::TcpOptCode::NOP, tcp::TCPOLEN_TIMESTAMP);
-        tsd.get_pkt()->packet_flags |= PKT_MODIFIED;
+        uint8_t nops[tcp::TCPOLEN_TIMESTAMP];
+        memset(nops, (uint32_t)tcp::TcpOptCode::NOP, sizeof(nops));
+        PacketManager::rewrite(tsd.get_pkt(), (uint8_t*)opt, nops, sizeof(nops));
         return true;
     }
 
@@ -160,8 +162,9 @@ void TcpNormalizer::ecn_stripper(Packet* p)
     {
         if (strip_ecn == NORM_MODE_ON)
         {
-            ((tcp::TCPHdr*)p->ptrs.tcph)->th_flags &= ~(TH_ECE | TH_CWR);
-            p->packet_flags |= PKT_MODIFIED;
+            tcp::TCPHdr* h = (tcp::TCPHdr*)p->ptrs.tcph;
+            uint8_t flags = h->th_flags & ~(TH_ECE | TH_CWR);
+            PacketManager::rewrite(p, &h->th_flags, &flags, 1);
         }
 
         tcp_norm_stats[PC_TCP_ECN_SSN][strip_ecn]++;
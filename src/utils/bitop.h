@@ -39,6 +39,7 @@ public:
     void set(unsigned int bit);
     bool is_set(unsigned int bit) const;
     void clear(unsigned int bit);
+    bool is_clear() const;
 
     size_t size() const;
 
@@ -95,6 +96,16 @@ inline void BitOp::clear(unsigned int bit)
     bit_buf[bit >> 3] &= ~mask(bit);
 }
 
+// Check whether no bits are set in the bit buffer.
+inline bool BitOp::is_clear() const
+{
+    for ( size_t i = 0; i < buf_size; ++i )
+        if ( bit_buf[i] )
+            return false;
+
+    return true;
+}
+
 inline size_t BitOp::size() const
 { return buf_size << 3; }
 
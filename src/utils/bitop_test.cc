@@ -42,6 +42,17 @@ TEST_CASE( "bitop", "[bitop]" )
         CHECK( bitop.get_buf_element(0) == 0x01 );
     }
 
+    SECTION( "is_clear" )
+    {
+        CHECK( bitop.is_clear() );
+
+        bitop.set(17);
+        CHECK_FALSE( bitop.is_clear() );
+
+        bitop.clear(17);
+        CHECK( bitop.is_clear() );
+    }
+
     SECTION( "size" )
     {
         CHECK( bitop.size() == 24 );
@@ -0,0 +1,341 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// keyword_map.cc
+
+#include "keyword_map.h"
+
+#ifdef UNIT_TEST
+#include <string.h>
+
+#include <chrono>
+
+#include "catch/catch.hpp"
+#include "time/stopwatch.h"
+#include "utils/kmap.h"
+#endif
+
+#define PREFIX_LEN sizeof(uint64_t)
+
+static inline uint8_t fold(uint8_t c)
+{ return (c >= 'A' and c <= 'Z') ? c + ('a' - 'A') : c; }
+
+KeywordMap::KeywordMap(bool nc, UserFree uf)
+{
+    user_free = uf;
+    cursor = 0;
+    nocase = nc;
+}
+
+KeywordMap::~KeywordMap()
+{
+    if ( !user_free )
+        return;
+
+    for ( auto& e : entries )
+        if ( e.data )
+            user_free(e.data);
+}
+
+// big endian so the integer order is the byte order
+uint64_t KeywordMap::get_prefix(const uint8_t* key, unsigned len) const
+{
+    uint64_t prefix = 0;
+    unsigned i;
+
+    for ( i = 0; i < len and i < PREFIX_LEN; ++i )
+        prefix = (prefix << 8) | (nocase ? fold(key[i]) : key[i]);
+
+    for ( ; i < PREFIX_LEN; ++i )
+        prefix <<= 8;
+
+    return prefix;
+}
+
+int KeywordMap::compare(
+    const Entry& e, uint64_t prefix, const uint8_t* key, unsigned len) const
+{
+    if ( e.prefix != prefix )
+        return e.prefix < prefix ? -1 : 1;
+
+    if ( e.len != len )
+        return e.len < len ? -1 : 1;
+
+    const uint8_t* t = (const uint8_t*)tail.data() + e.tail_off;
+
+    for ( unsigned i = PREFIX_LEN; i < len; ++i )
+    {
+        uint8_t c = nocase ? fold(key[i]) : key[i];
+
+        if ( t[i - PREFIX_LEN] != c )
+            return t[i - PREFIX_LEN] < c ? -1 : 1;
+    }
+    return 0;
+}
+
+unsigned KeywordMap::lower_bound(uint64_t prefix, const uint8_t* key, unsigned len) const
+{
+    unsigned lo = 0, hi = entries.size();
+
+    while ( lo < hi )
+    {
+        unsigned mid = (lo + hi) / 2;
+
+        if ( compare(entries[mid], prefix, key, len) < 0 )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+bool KeywordMap::add(const void* pv, unsigned len, void* data)
+{
+    const uint8_t* key = (const uint8_t*)pv;
+    uint64_t prefix = get_prefix(key, len);
+    unsigned idx = lower_bound(prefix, key, len);
+
+    if ( idx < entries.size() and !compare(entries[idx], prefix, key, len) )
+        return false;
+
+    Entry e = { prefix, len, (uint32_t)tail.size(), data };
+
+    for ( unsigned i = PREFIX_LEN; i < len; ++i )
+        tail.push_back((char)(nocase ? fold(key[i]) : key[i]));
+
+    entries.insert(entries.begin() + idx, e);
+    cursor = 0;
+
+    return true;
+}
+
+void* KeywordMap::find(const void* pv, unsigned len) const
+{
+    const uint8_t* key = (const uint8_t*)pv;
+    uint64_t prefix = get_prefix(key, len);
+    unsigned idx = lower_bound(prefix, key, len);
+
+    if ( idx < entries.size() and !compare(entries[idx], prefix, key, len) )
+        return entries[idx].data;
+
+    return nullptr;
+}
+
+void* KeywordMap::first()
+{
+    cursor = 0;
+    return next();
+}
+
+void* KeywordMap::next()
+{
+    if ( cursor >= entries.size() )
+        return nullptr;
+
+    return entries[cursor++].data;
+}
+
+size_t KeywordMap::get_memory() const
+{
+    return sizeof(*this) + entries.capacity() * sizeof(Entry) + tail.capacity();
+}
+
+#ifdef UNIT_TEST
+
+static const char* const ftp_cmds[] =
+{
+    "ABOR", "ACCT", "ADAT", "ALLO", "APPE", "AUTH", "CCC", "CDUP", "CEL",
+    "CLNT", "CMD", "CONF", "CWD", "DELE", "ENC", "EPRT", "EPSV", "ESTA",
+    "ESTP", "FEAT", "HELP", "LANG", "LIST", "LPRT", "LPSV", "MACB", "MAIL",
+    "MDTM", "MIC", "MKD", "MLSD", "MLST", "MODE", "NLST", "NOOP", "OPTS",
+    "PASS", "PASV", "PBSZ", "PORT", "PROT", "PWD", "QUIT", "REIN", "REST",
+    "RETR", "RMD", "RNFR", "RNTO", "SDUP", "SITE", "SIZE", "SMNT", "STAT",
+    "STOR", "STOU", "STRU", "SYST", "TEST", "TYPE", "USER", "XCUP", "XCRT",
+    "XCWD", "XMAS", "XMD5", "XMKD", "XPWD", "XRCP", "XRMD", "XRSQ", "XSEM",
+    "XSEN", "XSHA1", "XSHA256",
+};
+
+static const unsigned num_cmds = sizeof(ftp_cmds) / sizeof(ftp_cmds[0]);
+
+static unsigned freed = 0;
+
+static void count_free(void*)
+{ freed++; }
+
+TEST_CASE("keyword map", "[keyword_map]")
+{
+    SECTION("nocase lookup")
+    {
+        KeywordMap km(true);
+
+        for ( unsigned i = 0; i < num_cmds; ++i )
+            CHECK(km.add(ftp_cmds[i], strlen(ftp_cmds[i]), (void*)ftp_cmds[i]));
+
+        CHECK(km.get_count() == num_cmds);
+
+        for ( unsigned i = 0; i < num_cmds; ++i )
+        {
+            std::string s = ftp_cmds[i];
+            CHECK(km.find(s.c_str(), s.size()) == ftp_cmds[i]);
+
+            for ( auto& c : s )
+                c = tolower(c);
+
+            CHECK(km.find(s.c_str(), s.size()) == ftp_cmds[i]);
+        }
+
+        CHECK(!km.find("RET", 3));
+        CHECK(!km.find("RETRX", 5));
+        CHECK(!km.find("XSHA2", 5));
+        CHECK(!km.find("", 0));
+
+        // already mapped in any case
+        CHECK(!km.add("retr", 4, nullptr));
+        CHECK(km.get_count() == num_cmds);
+    }
+
+    SECTION("case and binary keys")
+    {
+        KeywordMap km(false);
+        const uint8_t a[] = { 'A', 0, 1, 2 };
+        const uint8_t b[] = { 'a', 0, 1, 2 };
+        const uint8_t c[] = { 'A', 0, 1 };
+
+        CHECK(km.add(a, sizeof(a), (void*)a));
+        CHECK(km.add(b, sizeof(b), (void*)b));
+        CHECK(km.add(c, sizeof(c), (void*)c));
+
+        CHECK(km.find(a, sizeof(a)) == a);
+        CHECK(km.find(b, sizeof(b)) == b);
+        CHECK(km.find(c, sizeof(c)) == c);
+        CHECK(!km.find(a, 2));
+    }
+
+    SECTION("long keys")
+    {
+        KeywordMap km(true);
+        const char* k1 = "abcdefghijklmnop";
+        const char* k2 = "ABCDEFGHIJKLMNOQ";
+        const char* k3 = "abcdefgh";
+
+        CHECK(km.add(k1, strlen(k1), (void*)k1));
+        CHECK(km.add(k2, strlen(k2), (void*)k2));
+        CHECK(km.add(k3, strlen(k3), (void*)k3));
+        CHECK(!km.add("ABCDEFGHIJKLMNOP", 16, nullptr));
+
+        CHECK(km.find("ABCDEFGHijklmnop", 16) == k1);
+        CHECK(km.find("abcdefghijklmnoq", 16) == k2);
+        CHECK(km.find("ABCDEFGH", 8) == k3);
+        CHECK(!km.find("abcdefghijklmno", 15));
+    }
+
+    SECTION("iterate and free")
+    {
+        freed = 0;
+        {
+            KeywordMap km(true, count_free);
+
+            for ( unsigned i = 0; i < num_cmds; ++i )
+                km.add(ftp_cmds[i], strlen(ftp_cmds[i]), (void*)ftp_cmds[i]);
+
+            unsigned n = 0;
+            const char* last = "";
+
+            for ( void* p = km.first(); p; p = km.next() )
+            {
+                CHECK(strcmp(last, (const char*)p) < 0);
+                last = (const char*)p;
+                n++;
+            }
+            CHECK(n == num_cmds);
+        }
+        CHECK(freed == num_cmds);
+    }
+}
+
+// run with: snort --catch-test '[.perf]'
+TEST_CASE("keyword map vs kmap", "[.perf]")
+{
+    KMAP* kmap = KMapNew(nullptr);
+    KMapSetNoCase(kmap, 1);
+
+    KeywordMap km(true);
+
+    size_t kmap_mem = sizeof(KMAP);
+
+    for ( unsigned i = 0; i < num_cmds; ++i )
+    {
+        unsigned len = strlen(ftp_cmds[i]);
+        KMapAdd(kmap, (void*)ftp_cmds[i], len, (void*)ftp_cmds[i]);
+        km.add(ftp_cmds[i], len, (void*)ftp_cmds[i]);
+        kmap_mem += sizeof(KEYNODE) + len;
+    }
+    kmap_mem += kmap->nchars * sizeof(KMAPNODE);
+
+    // mostly hits in mixed case with some misses like a control channel
+    std::vector<std::string> queries;
+
+    for ( unsigned i = 0; i < num_cmds; ++i )
+    {
+        std::string s = ftp_cmds[i];
+        queries.push_back(s);
+
+        for ( auto& c : s )
+            c = tolower(c);
+
+        queries.push_back(s);
+        s.back() = '?';
+        queries.push_back(s);
+    }
+
+    const unsigned loops = 20000;
+    unsigned hits[2] = { 0, 0 };
+    double rate[2];
+
+    for ( int which = 0; which < 2; ++which )
+    {
+        Stopwatch<std::chrono::steady_clock> sw;
+        sw.start();
+
+        for ( unsigned n = 0; n < loops; ++n )
+        {
+            for ( auto& q : queries )
+            {
+                void* p = which ?
+                    km.find(q.c_str(), q.size()) :
+                    KMapFind(kmap, (void*)q.c_str(), q.size());
+
+                if ( p )
+                    hits[which]++;
+            }
+        }
+        sw.stop();
+
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sw.get()).count();
+        rate[which] = (double)loops * queries.size() * 1.0e9 / ns;
+    }
+
+    CHECK(hits[0] == hits[1]);
+
+    WARN("kmap lookups/sec = " << rate[0] << ", memory = " << kmap_mem);
+    WARN("keyword map lookups/sec = " << rate[1] << ", memory = " << km.get_memory());
+
+    KMapDelete(kmap);
+}
+
+#endif
+
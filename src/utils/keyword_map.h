@@ -0,0 +1,83 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2016-2016 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// keyword_map.h
+
+#ifndef KEYWORD_MAP_H
+#define KEYWORD_MAP_H
+
+// KeywordMap maps short keys such as protocol commands to user data.  It
+// is meant for tables that are filled in at configure time and only
+// searched after that.  Entries are kept sorted in one flat array keyed by
+// the first 8 bytes of the key packed into an integer so most lookups are
+// a binary search over integer compares.  Bytes past the first 8 are kept
+// together in one buffer.  Keys may be binary and are optionally folded to
+// lower case.  Each add keeps the array sorted so there is no build step.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "main/snort_types.h"
+
+class SO_PUBLIC KeywordMap
+{
+public:
+    typedef void (* UserFree)(void*);
+
+    KeywordMap(bool nocase, UserFree = nullptr);
+    ~KeywordMap();
+
+    // returns false if the key is already mapped
+    bool add(const void* key, unsigned len, void* data);
+
+    void* find(const void* key, unsigned len) const;
+
+    // iterate over the data in key order
+    void* first();
+    void* next();
+
+    unsigned get_count() const
+    { return entries.size(); }
+
+    size_t get_memory() const;
+
+private:
+    struct Entry
+    {
+        uint64_t prefix;
+        uint32_t len;
+        uint32_t tail_off;  // where bytes past the prefix start in tail
+        void* data;
+    };
+
+    uint64_t get_prefix(const uint8_t*, unsigned len) const;
+    int compare(const Entry&, uint64_t prefix, const uint8_t*, unsigned len) const;
+    unsigned lower_bound(uint64_t prefix, const uint8_t*, unsigned len) const;
+
+private:
+    std::vector<Entry> entries;
+    std::string tail;
+    UserFree user_free;
+    unsigned cursor;
+    bool nocase;
+};
+
+#endif
+
@@ -24,6 +24,14 @@
 #include <string.h>
 #include "main/thread.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
 #define INVALID_HEX_VAL -1
 #define MAX_BUF 8
 #define NON_ASCII_CHAR 0xff
@@ -99,6 +107,10 @@ typedef enum
 static int hex_lookup[256];
 static int valid_chars[256];
 
+// chars that the top level fsm copies straight through from its initial
+// state; anything that may start a keyword or is whitespace is excluded
+static bool js_plain[256];
+
 static THREAD_LOCAL char decoded_out[6335];
 
 typedef struct
@@ -413,6 +425,11 @@ void InitJSNormLookupTable()
         hex_lookup[iCtr] = iNum;
         iNum++;
     }
+
+    for (iCtr = 0; iCtr < 256; iCtr++)
+        js_plain[iCtr] = !isspace(iCtr) && !strchr("UuSsDd<", iCtr);
+
+    js_plain[0] = true;
 }
 
 static inline int outBounds(const char* start, const char* end, char* ptr)
@@ -605,7 +622,7 @@ static int PNormDecode(char* src, uint16_t srclen, char* dst, uint16_t dstlen, u
 
     while (ptr < end)
     {
-        iRet = PNorm_scan_fsm(&s, *ptr, js);
+        iRet = PNorm_scan_fsm(&s, (uint8_t)*ptr, js);
         ptr++;
     }
 
@@ -787,7 +804,7 @@ static void StringFromCharCodeDecode(char* src, uint16_t srclen, char** ptr, cha
 
     while (!outBounds(start, end, *ptr))
     {
-        iRet = SFCC_scan_fsm(&s, **ptr);
+        iRet = SFCC_scan_fsm(&s, (uint8_t)**ptr);
         if (iRet != RET_OK)
         {
             if ( (iRet == RET_INV) && ((*ptr - 1) > start ))
@@ -1056,7 +1073,7 @@ static void UnescapeDecode(char* src, uint16_t srclen, char** ptr, char** dst, u
 
     while (!outBounds(start, end, *ptr))
     {
-        iRet = Unescape_scan_fsm(&s, **ptr, js);
+        iRet = Unescape_scan_fsm(&s, (uint8_t)**ptr, js);
         if (iRet != RET_OK)
         {
             /*if( (iRet == RET_INV) && ((*ptr - 1) > start ))
@@ -1131,6 +1148,47 @@ static void WriteJSNorm(JSNormState* s, char* copy_buf, uint16_t copy_len, JSSta
     s->dest.len = dptr - dstart;
 }
 
+// Length of the leading run of plain chars.  The vector check is
+// conservative: a few plain chars (eg 0x1c) are sent to the scalar check.
+static uint16_t JSPlainSpan(const char* src, uint16_t len)
+{
+    uint16_t n = 0;
+
+#ifdef __SSE2__
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+
+    while ( len - n >= 16 )
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + n));
+        __m128i lc = _mm_or_si128(v, lower);
+        __m128i ws = _mm_sub_epi8(v, tab);
+
+        __m128i hit = _mm_cmpeq_epi8(lc, _mm_set1_epi8('u'));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(lc, _mm_set1_epi8('s')));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(lc, _mm_set1_epi8('d')));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(lc, _mm_set1_epi8('<')));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(lc, lower));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(ws, four), ws));
+
+        unsigned m = (unsigned)_mm_movemask_epi8(hit);
+
+        if ( m )
+        {
+            n += __builtin_ctz(m);
+            break;
+        }
+        n += 16;
+    }
+#endif
+
+    while ( n < len && js_plain[(uint8_t)src[n]] )
+        n++;
+
+    return n;
+}
+
 static int JSNorm_exec(JSNormState* s, ActionJSNorm a, int c, char* src, uint16_t srclen,
     char** ptr, JSState* js)
 {
@@ -1213,8 +1271,9 @@ static int JSNorm_scan_fsm(JSNormState* s, int c, char* src, uint16_t srclen, ch
     return(JSNorm_exec(s, (ActionJSNorm)m->action, c, src, srclen, ptr, js));
 }
 
-int JSNormalizeDecode(char* src, uint16_t srclen, char* dst, uint16_t destlen, char** ptr,
-    int* bytes_copied, JSState* js, uint8_t* iis_unicode_map)
+// fast is only cleared by the unit tests to check the runs against the fsm
+static int JSNormalize(char* src, uint16_t srclen, char* dst, uint16_t destlen, char** ptr,
+    int* bytes_copied, JSState* js, uint8_t* iis_unicode_map, bool fast)
 {
     int iRet = RET_OK;
     const char* start, * end;
@@ -1239,7 +1298,22 @@ int JSNormalizeDecode(char* src, uint16_t srclen, char* dst, uint16_t destlen, c
 
     while (!outBounds(start, end, *ptr))
     {
-        iRet = JSNorm_scan_fsm(&s, **ptr, src, srclen, ptr, js);
+        /* From the initial state plain chars are just copied, so take
+         * them in runs instead of stepping the fsm for each one. */
+        if ( !s.fsm && fast )
+        {
+            uint16_t run = JSPlainSpan(*ptr, end - *ptr);
+
+            if ( run )
+            {
+                WriteJSNorm(&s, *ptr, run, js);
+                s.prev_event = (*ptr)[run - 1];
+                *ptr += run;
+                continue;
+            }
+        }
+
+        iRet = JSNorm_scan_fsm(&s, (uint8_t)**ptr, src, srclen, ptr, js);
         if (iRet != RET_OK)
         {
             break;
@@ -1258,6 +1332,12 @@ int JSNormalizeDecode(char* src, uint16_t srclen, char* dst, uint16_t destlen, c
     return RET_OK;
 }
 
+int JSNormalizeDecode(char* src, uint16_t srclen, char* dst, uint16_t destlen, char** ptr,
+    int* bytes_copied, JSState* js, uint8_t* iis_unicode_map)
+{
+    return JSNormalize(src, srclen, dst, destlen, ptr, bytes_copied, js, iis_unicode_map, true);
+}
+
 /*
 int main(int argc, char *argv[])
 {
@@ -1308,3 +1388,86 @@ int main(int argc, char *argv[])
 
 }*/
 
+//--------------------------------------------------------------------------
+// unit tests
+//--------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+static const char* const js_tokens[] =
+{
+    "unescape(", "UnEscape (", "String.fromCharCode(", "decodeURI(", "decodeURIComponent(",
+    "%41", "%u0042", "\\x43", "\\u0044", "0x45,", "70,", "0105,", ")", "(", "'", "\"", "+",
+    "   ", "\t\r\n", "</script>", "</SCRIPT >", "<div>", "document.write", "var s = 1;",
+    "uuu", "sss", "ddd", "<<", "\x1c", "\x80\xff", "\\'", "\\\"", "abcdefghijklmnopqrstuvwxyz"
+};
+
+static uint32_t js_rand(uint32_t& seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static int run_jsnorm(
+    bool fast, char* src, uint16_t srclen, char* dst, uint16_t dstlen, char** ptr, JSState& js)
+{
+    int copied = 0;
+    *ptr = src;
+    JSNormalize(src, srclen, dst, dstlen, ptr, &copied, &js, nullptr, fast);
+    return copied;
+}
+
+TEST_CASE("jsnorm fast path matches fsm", "[jsnorm]")
+{
+    InitJSNormLookupTable();
+
+    const unsigned num_tokens = sizeof(js_tokens) / sizeof(js_tokens[0]);
+    char src[4096], exp[4096], got[4096];
+
+    for ( uint32_t seed = 1; seed < 500; ++seed )
+    {
+        uint32_t r = seed;
+        uint16_t len = 0;
+
+        while ( len < sizeof(src) - 64 )
+        {
+            const char* t = js_tokens[js_rand(r) % num_tokens];
+            size_t n = strlen(t);
+            memcpy(src + len, t, n);
+            len += n;
+
+            if ( !(js_rand(r) % 97) )
+                break;
+        }
+
+        uint16_t dstlen = seed % 5 ? sizeof(exp) : len / 3;
+        JSState exp_js = { 3, 1, 0 };
+        JSState got_js = { 3, 1, 0 };
+        char* exp_ptr, * got_ptr;
+
+        int exp_n = run_jsnorm(false, src, len, exp, dstlen, &exp_ptr, exp_js);
+        int got_n = run_jsnorm(true, src, len, got, dstlen, &got_ptr, got_js);
+
+        CHECK(exp_ptr == got_ptr);
+        CHECK(exp_js.alerts == got_js.alerts);
+        REQUIRE(exp_n == got_n);
+        CHECK(!memcmp(exp, got, exp_n));
+    }
+}
+
+TEST_CASE("jsnorm plain span", "[jsnorm]")
+{
+    InitJSNormLookupTable();
+
+    char buf[40];
+
+    for ( unsigned c = 0; c < 256; ++c )
+    {
+        memset(buf, 'a', sizeof(buf));
+        buf[33] = (char)c;
+        CHECK(JSPlainSpan(buf, sizeof(buf)) == (js_plain[c] ? sizeof(buf) : 33));
+    }
+}
+
+#endif
+